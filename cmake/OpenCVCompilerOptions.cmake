@@ -131,6 +131,14 @@ if(CMAKE_COMPILER_IS_GNUCXX)
       add_extra_compiler_option(-mavx)
     endif()
 
+    if(ENABLE_AVX2)
+      add_extra_compiler_option(-mavx2)
+    endif()
+
+    if(ENABLE_POPCNT)
+      add_extra_compiler_option(-mpopcnt)
+    endif()
+
     # GCC depresses SSEx instructions when -mavx is used. Instead, it generates new AVX instructions or AVX equivalence for all SSEx instructions when needed.
     if(NOT OPENCV_EXTRA_CXX_FLAGS MATCHES "-mavx")
       if(ENABLE_SSE3)
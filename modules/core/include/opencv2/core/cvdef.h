@@ -111,6 +111,7 @@
 #define CV_CPU_POPCNT  8
 #define CV_CPU_AVX    10
 #define CV_CPU_NEON   11
+#define CV_CPU_AVX2   12
 #define CV_HARDWARE_MAX_FEATURE 255
 
 // do not include SSE/AVX/NEON headers for NVCC compiler
@@ -136,6 +137,10 @@
 #    include <nmmintrin.h>
 #    define CV_SSE4_2 1
 #  endif
+#  if defined __POPCNT__ || (defined _MSC_VER && _MSC_VER >= 1500)
+#    include <nmmintrin.h>
+#    define CV_POPCNT 1
+#  endif
 #  if defined __AVX__ || (defined _MSC_FULL_VER && _MSC_FULL_VER >= 160040219)
 // MS Visual Studio 2010 (2012?) has no macro pre-defined to identify the use of /arch:AVX
 // See: http://connect.microsoft.com/VisualStudio/feedback/details/605858/arch-avx-should-define-a-predefined-macro-in-x64-and-set-a-unique-value-for-m-ix86-fp-in-win32
@@ -147,6 +152,10 @@
 #      define __xgetbv() 0
 #    endif
 #  endif
+#  if defined __AVX2__ || (defined _MSC_VER && _MSC_VER >= 1800)
+#    include <immintrin.h>
+#    define CV_AVX2 1
+#  endif
 #endif
 
 #if (defined WIN32 || defined _WIN32) && defined(_M_ARM)
@@ -179,9 +188,15 @@
 #ifndef CV_SSE4_2
 #  define CV_SSE4_2 0
 #endif
+#ifndef CV_POPCNT
+#  define CV_POPCNT 0
+#endif
 #ifndef CV_AVX
 #  define CV_AVX 0
 #endif
+#ifndef CV_AVX2
+#  define CV_AVX2 0
+#endif
 #ifndef CV_NEON
 #  define CV_NEON 0
 #endif
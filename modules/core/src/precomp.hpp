@@ -191,6 +191,8 @@ struct NoVec
 extern volatile bool USE_SSE2;
 extern volatile bool USE_SSE4_2;
 extern volatile bool USE_AVX;
+extern volatile bool USE_POPCNT;
+extern volatile bool USE_AVX2;
 
 enum { BLOCK_SIZE = 1024 };
 
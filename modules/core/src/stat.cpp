@@ -1325,9 +1325,150 @@ static int normHamming(const uchar* a, int n)
     return result;
 }
 
+// The POPCNT and AVX2 kernels are compiled either when the instruction sets are enabled
+// for the whole build, or, with GCC, as separate functions for the specific targets,
+// which are dispatched at runtime.
+#if (defined __GNUC__ && !defined __clang__ && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) && \
+    (defined __x86_64__ || defined __i386__)
+#  include <immintrin.h>
+#  define CV_HAMMING_TARGET_DISPATCH 1
+#else
+#  define CV_HAMMING_TARGET_DISPATCH 0
+#endif
+
+#if CV_POPCNT
+#  define CV_HAMMING_POPCNT 1
+#  define CV_HAMMING_POPCNT_TARGET
+#elif CV_HAMMING_TARGET_DISPATCH
+#  define CV_HAMMING_POPCNT 1
+#  define CV_HAMMING_POPCNT_TARGET __attribute__((target("popcnt")))
+#else
+#  define CV_HAMMING_POPCNT 0
+#endif
+
+#if CV_AVX2 && CV_POPCNT
+#  define CV_HAMMING_AVX2 1
+#  define CV_HAMMING_AVX2_TARGET
+#elif CV_HAMMING_TARGET_DISPATCH
+#  define CV_HAMMING_AVX2 1
+#  define CV_HAMMING_AVX2_TARGET __attribute__((target("avx2,popcnt")))
+#else
+#  define CV_HAMMING_AVX2 0
+#endif
+
+#if CV_HAMMING_POPCNT
+static CV_HAMMING_POPCNT_TARGET inline int normHammingPOPCNT(const uchar* a, const uchar* b, int n)
+{
+    int i = 0, result = 0;
+#if defined __x86_64__ || defined _M_X64
+    for( ; i <= n - 8; i += 8 )
+        result += (int)_mm_popcnt_u64(*(const uint64*)(a + i) ^ *(const uint64*)(b + i));
+#endif
+    for( ; i <= n - 4; i += 4 )
+        result += _mm_popcnt_u32(*(const unsigned*)(a + i) ^ *(const unsigned*)(b + i));
+    for( ; i < n; i++ )
+        result += popCountTable[a[i] ^ b[i]];
+    return result;
+}
+
+static CV_HAMMING_POPCNT_TARGET void batchDistHammingPOPCNT(const uchar* src1, const uchar* src2, size_t step2,
+                                                           int nvecs, int len, int* dist, const uchar* mask)
+{
+    // the lengths of the common binary descriptors are passed as constants,
+    // so that the kernel is fully unrolled for them
+    int val0 = INT_MAX;
+    for( int i = 0; i < nvecs; i++ )
+    {
+        const uchar* b = src2 + step2*i;
+        if( mask && !mask[i] )
+            dist[i] = val0;
+        else if( len == 32 )
+            dist[i] = normHammingPOPCNT(src1, b, 32);
+        else if( len == 64 )
+            dist[i] = normHammingPOPCNT(src1, b, 64);
+        else
+            dist[i] = normHammingPOPCNT(src1, b, len);
+    }
+}
+#endif
+
+#if CV_HAMMING_AVX2
+// counts the bits with two lookups of 4-bit values in a 16-entry table
+static CV_HAMMING_AVX2_TARGET inline int normHammingAVX2(const uchar* a, const uchar* b, int n)
+{
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i mask4 = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sum = zero;
+
+    int i = 0;
+    for( ; i <= n - 32; i += 32 )
+    {
+        __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a + i)),
+                                     _mm256_loadu_si256((const __m256i*)(b + i)));
+        __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask4)),
+                                      _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask4)));
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(cnt, zero));
+    }
+
+    __m128i sum2 = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    int result = _mm_cvtsi128_si32(sum2) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sum2, sum2));
+
+    for( ; i <= n - 4; i += 4 )
+        result += _mm_popcnt_u32(*(const unsigned*)(a + i) ^ *(const unsigned*)(b + i));
+    for( ; i < n; i++ )
+        result += popCountTable[a[i] ^ b[i]];
+    return result;
+}
+
+static CV_HAMMING_AVX2_TARGET void batchDistHammingAVX2(const uchar* src1, const uchar* src2, size_t step2,
+                                                       int nvecs, int len, int* dist, const uchar* mask)
+{
+    int val0 = INT_MAX;
+    for( int i = 0; i < nvecs; i++ )
+    {
+        const uchar* b = src2 + step2*i;
+        if( mask && !mask[i] )
+            dist[i] = val0;
+        else if( len == 64 )
+            dist[i] = normHammingAVX2(src1, b, 64);
+        else
+            dist[i] = normHammingAVX2(src1, b, len);
+    }
+}
+#endif
+
 int normHamming(const uchar* a, const uchar* b, int n)
 {
+#if CV_HAMMING_AVX2
+    if( n >= 64 && USE_AVX2 && USE_POPCNT )
+        return normHammingAVX2(a, b, n);
+#endif
+#if CV_HAMMING_POPCNT
+    if( USE_POPCNT )
+        return normHammingPOPCNT(a, b, n);
+#endif
+
     int i = 0, result = 0;
+#if CV_SSE2
+    if( USE_SSE2 )
+    {
+        const __m128i m1 = _mm_set1_epi8(0x55), m2 = _mm_set1_epi8(0x33), m4 = _mm_set1_epi8(0x0f);
+        const __m128i zero = _mm_setzero_si128();
+        __m128i sum = zero;
+        for( ; i <= n - 16; i += 16 )
+        {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(a + i)),
+                                      _mm_loadu_si128((const __m128i*)(b + i)));
+            v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi16(v, 1), m1));
+            v = _mm_add_epi8(_mm_and_si128(v, m2), _mm_and_si128(_mm_srli_epi16(v, 2), m2));
+            v = _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi16(v, 4)), m4);
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(v, zero));
+        }
+        result = _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sum, sum));
+    }
+#endif
 #if CV_NEON
     {
         uint32x4_t bits = vmovq_n_u32(0);
@@ -2311,6 +2452,20 @@ static void batchDistHamming(const uchar* src1, const uchar* src2, size_t step2,
                              int nvecs, int len, int* dist, const uchar* mask)
 {
     step2 /= sizeof(src2[0]);
+#if CV_HAMMING_AVX2
+    if( len >= 64 && USE_AVX2 && USE_POPCNT )
+    {
+        batchDistHammingAVX2(src1, src2, step2, nvecs, len, dist, mask);
+        return;
+    }
+#endif
+#if CV_HAMMING_POPCNT
+    if( USE_POPCNT )
+    {
+        batchDistHammingPOPCNT(src1, src2, step2, nvecs, len, dist, mask);
+        return;
+    }
+#endif
     if( !mask )
     {
         for( int i = 0; i < nvecs; i++ )
@@ -2393,6 +2548,9 @@ typedef void (*BatchDistFunc)(const uchar* src1, const uchar* src2, size_t step2
                               int nvecs, int len, uchar* dist, const uchar* mask);
 
 
+// the size of the block of the train descriptors processed at once in batchDistance
+static const size_t BATCH_DIST_BLOCK_BYTES = 1 << 16;
+
 struct BatchDistInvoker : public ParallelLoopBody
 {
     BatchDistInvoker( const Mat& _src1, const Mat& _src2,
@@ -2412,35 +2570,48 @@ struct BatchDistInvoker : public ParallelLoopBody
 
     void operator()(const Range& range) const
     {
-        AutoBuffer<int> buf(src2->rows);
+        // The train descriptors are processed by blocks that stay in the cache while
+        // all the query descriptors of the range are matched against them.
+        // For every query descriptor the train descriptors are still visited in the increasing order,
+        // so the k best matches are the same as with the row-by-row processing.
+        int blockSize = std::max((int)(BATCH_DIST_BLOCK_BYTES / (src2->cols*src2->elemSize())), 1);
+        blockSize = std::min(blockSize, src2->rows);
+        size_t esz = dist->elemSize();
+
+        AutoBuffer<int> buf(blockSize);
         int* bufptr = buf;
 
-        for( int i = range.start; i < range.end; i++ )
+        for( int j0 = 0; j0 < src2->rows; j0 += blockSize )
         {
-            func(src1->ptr(i), src2->ptr(), src2->step, src2->rows, src2->cols,
-                 K > 0 ? (uchar*)bufptr : dist->ptr(i), mask->data ? mask->ptr(i) : 0);
+            int j1 = std::min(j0 + blockSize, src2->rows);
 
-            if( K > 0 )
+            for( int i = range.start; i < range.end; i++ )
             {
-                int* nidxptr = nidx->ptr<int>(i);
-                // since positive float's can be compared just like int's,
-                // we handle both CV_32S and CV_32F cases with a single branch
-                int* distptr = (int*)dist->ptr(i);
+                func(src1->ptr(i), src2->ptr(j0), src2->step, j1 - j0, src2->cols,
+                     K > 0 ? (uchar*)bufptr : dist->ptr(i) + j0*esz, mask->data ? mask->ptr(i) + j0 : 0);
 
-                int j, k;
-
-                for( j = 0; j < src2->rows; j++ )
+                if( K > 0 )
                 {
-                    int d = bufptr[j];
-                    if( d < distptr[K-1] )
+                    int* nidxptr = nidx->ptr<int>(i);
+                    // since positive float's can be compared just like int's,
+                    // we handle both CV_32S and CV_32F cases with a single branch
+                    int* distptr = (int*)dist->ptr(i);
+
+                    int j, k;
+
+                    for( j = j0; j < j1; j++ )
                     {
-                        for( k = K-2; k >= 0 && distptr[k] > d; k-- )
+                        int d = bufptr[j - j0];
+                        if( d < distptr[K-1] )
                         {
-                            nidxptr[k+1] = nidxptr[k];
-                            distptr[k+1] = distptr[k];
+                            for( k = K-2; k >= 0 && distptr[k] > d; k-- )
+                            {
+                                nidxptr[k+1] = nidxptr[k];
+                                distptr[k+1] = distptr[k];
+                            }
+                            nidxptr[k+1] = j + update;
+                            distptr[k+1] = d;
                         }
-                        nidxptr[k+1] = j + update;
-                        distptr[k+1] = d;
                     }
                 }
             }
@@ -222,6 +222,92 @@ struct HWFeatures
             f.have[CV_CPU_AVX]    = (((cpuid_data[2] & (1<<28)) != 0)&&((cpuid_data[2] & (1<<27)) != 0));//OS uses XSAVE_XRSTORE and CPU support AVX
         }
 
+        // AVX2 is reported in the extended features (leaf 7). It can be used only if the CPU
+        // has that leaf and the OS saves the YMM state (XCR0 bits 1 and 2, read with XGETBV)
+        int max_leaf = 0, cpuid_data_ex[4] = { 0, 0, 0, 0 };
+        bool os_ymm = false;
+    #if defined _MSC_VER && (defined _M_IX86 || defined _M_X64)
+        int cpuid_data_0[4];
+        __cpuid(cpuid_data_0, 0);
+        max_leaf = cpuid_data_0[0];
+    #elif defined __GNUC__ && (defined __i386__ || defined __x86_64__)
+        #ifdef __x86_64__
+        asm __volatile__
+        (
+         "movl $0, %%eax\n\t"
+         "cpuid\n\t"
+         :[eax]"=a"(max_leaf)
+         :
+         : "ebx", "ecx", "edx", "cc"
+        );
+        #else
+        asm volatile
+        (
+         "pushl %%ebx\n\t"
+         "movl $0,%%eax\n\t"
+         "cpuid\n\t"
+         "popl %%ebx\n\t"
+         : "=a"(max_leaf)
+         :
+         : "ecx", "edx", "cc"
+        );
+        #endif
+    #endif
+
+        if( f.have[CV_CPU_AVX] ) // the OSXSAVE bit is set, so XGETBV is available
+        {
+    #if defined _MSC_VER && (defined _M_IX86 || defined _M_X64) && _MSC_FULL_VER >= 160040219
+            os_ymm = (_xgetbv(0) & 6) == 6;
+    #elif defined __GNUC__ && (defined __i386__ || defined __x86_64__)
+            unsigned xcr0_lo = 0, xcr0_hi = 0;
+            asm volatile
+            (
+             ".byte 0x0f, 0x01, 0xd0\n\t" // xgetbv
+             : "=a"(xcr0_lo), "=d"(xcr0_hi)
+             : "c"(0)
+            );
+            os_ymm = (xcr0_lo & 6) == 6;
+    #endif
+        }
+
+        if( max_leaf >= 7 )
+        {
+    #if defined _MSC_VER && (defined _M_IX86 || defined _M_X64) && _MSC_VER >= 1600
+            __cpuidex(cpuid_data_ex, 7, 0);
+    #elif defined __GNUC__ && (defined __i386__ || defined __x86_64__)
+            #ifdef __x86_64__
+            asm __volatile__
+            (
+             "movl $7, %%eax\n\t"
+             "movl $0, %%ecx\n\t"
+             "cpuid\n\t"
+             :[eax]"=a"(cpuid_data_ex[0]),[ebx]"=b"(cpuid_data_ex[1]),[ecx]"=c"(cpuid_data_ex[2]),[edx]"=d"(cpuid_data_ex[3])
+             :
+             : "cc"
+            );
+            #else
+            asm volatile
+            (
+             "pushl %%ebx\n\t"
+             "movl $7,%%eax\n\t"
+             "movl $0,%%ecx\n\t"
+             "cpuid\n\t"
+             "movl %%ebx,%%esi\n\t"
+             "popl %%ebx\n\t"
+             : "=a"(cpuid_data_ex[0]), "=S"(cpuid_data_ex[1]), "=c"(cpuid_data_ex[2]), "=d"(cpuid_data_ex[3])
+             :
+             : "cc"
+            );
+            #endif
+    #endif
+        }
+
+        if( f.x86_family >= 6 )
+        {
+            f.have[CV_CPU_AVX2]   = f.have[CV_CPU_AVX] && os_ymm && max_leaf >= 7 &&
+                                    (cpuid_data_ex[1] & (1<<5)) != 0;
+        }
+
         return f;
     }
 
@@ -252,12 +338,16 @@ IPPInitializer ippInitializer;
 volatile bool USE_SSE2 = featuresEnabled.have[CV_CPU_SSE2];
 volatile bool USE_SSE4_2 = featuresEnabled.have[CV_CPU_SSE4_2];
 volatile bool USE_AVX = featuresEnabled.have[CV_CPU_AVX];
+volatile bool USE_POPCNT = featuresEnabled.have[CV_CPU_POPCNT];
+volatile bool USE_AVX2 = featuresEnabled.have[CV_CPU_AVX2];
 
 void setUseOptimized( bool flag )
 {
     useOptimizedFlag = flag;
     currentFeatures = flag ? &featuresEnabled : &featuresDisabled;
     USE_SSE2 = currentFeatures->have[CV_CPU_SSE2];
+    USE_POPCNT = currentFeatures->have[CV_CPU_POPCNT];
+    USE_AVX2 = currentFeatures->have[CV_CPU_AVX2];
 }
 
 bool useOptimized(void)
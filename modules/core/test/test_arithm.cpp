@@ -1564,3 +1564,49 @@ TEST(Core_round, CvRound)
     ASSERT_EQ(-2, cvRound(-2.5));
     ASSERT_EQ(-4, cvRound(-3.5));
 }
+
+static int naiveHamming(const uchar* a, const uchar* b, int n)
+{
+    int result = 0;
+    for( int i = 0; i < n; i++ )
+        for( int k = 0; k < 8; k++ )
+            result += ((a[i] ^ b[i]) >> k) & 1;
+    return result;
+}
+
+TEST(Core_Hamming, batchDistance)
+{
+    RNG& rng = theRNG();
+    bool useOptimized = cv::useOptimized();
+    const int lengths[] = { 1, 3, 8, 15, 16, 17, 31, 32, 33, 48, 61, 64, 65, 100, 128, 256 };
+
+    for( int opt = 0; opt < 2; opt++ )
+    {
+        cv::setUseOptimized(opt == 0);
+
+        for( size_t l = 0; l < sizeof(lengths)/sizeof(lengths[0]); l++ )
+        {
+            const int len = lengths[l];
+            Mat query(1, len, CV_8U), train(50, len, CV_8U), mask(1, train.rows, CV_8U);
+            rng.fill(query, RNG::UNIFORM, 0, 256);
+            rng.fill(train, RNG::UNIFORM, 0, 256);
+            rng.fill(mask, RNG::UNIFORM, 0, 2);
+            // an all-ones row gives the maximal distance
+            train.row(0).setTo(Scalar::all(255));
+
+            Mat dist, maskedDist;
+            batchDistance(query, train, dist, CV_32S, noArray(), NORM_HAMMING);
+            batchDistance(query, train, maskedDist, CV_32S, noArray(), NORM_HAMMING, 0, mask);
+
+            for( int i = 0; i < train.rows; i++ )
+            {
+                int expected = naiveHamming(query.ptr(), train.ptr(i), len);
+                ASSERT_EQ(expected, dist.at<int>(i)) << "len = " << len << ", optimized = " << (opt == 0);
+                ASSERT_EQ(expected, normHamming(query.ptr(), train.ptr(i), len));
+                ASSERT_EQ(mask.at<uchar>(i) ? expected : INT_MAX, maskedDist.at<int>(i));
+            }
+        }
+    }
+
+    cv::setUseOptimized(useOptimized);
+}
@@ -121,6 +121,12 @@ public:
     // Return true if detector object is empty
     CV_WRAP virtual bool empty() const;
 
+    /*
+     * Returns true if detectImpl() may be called concurrently for different images.
+     * The grid and pyramid adapted detectors run the wrapped detector in parallel only then.
+     */
+    virtual bool isThreadSafe() const;
+
     // Create feature detector by detector name.
     CV_WRAP static Ptr<FeatureDetector> create( const String& detectorType );
 
@@ -172,6 +178,12 @@ public:
 
     CV_WRAP virtual bool empty() const;
 
+    /*
+     * Returns true if computeImpl() may be called concurrently for different images.
+     * The image collection variant of compute() processes the images in parallel only then.
+     */
+    virtual bool isThreadSafe() const;
+
     CV_WRAP static Ptr<DescriptorExtractor> create( const String& descriptorExtractorType );
 
 protected:
@@ -208,6 +220,8 @@ public:
 
     CV_WRAP void compute( const Mat& image, CV_OUT CV_IN_OUT std::vector<KeyPoint>& keypoints, CV_OUT Mat& descriptors ) const;
 
+    virtual bool isThreadSafe() const;
+
     // Create feature detector and descriptor extractor by name.
     CV_WRAP static Ptr<Feature2D> create( const String& name );
 };
@@ -226,6 +240,7 @@ public:
     int descriptorSize() const;
     // returns the descriptor type
     int descriptorType() const;
+    bool isThreadSafe() const;
 
     // Compute the BRISK features on an image
     void operator()(InputArray image, InputArray mask, std::vector<KeyPoint>& keypoints) const;
@@ -307,6 +322,8 @@ protected:
 /*!
  ORB implementation.
 */
+struct ORBPyramidBuffers;
+
 class CV_EXPORTS_W ORB : public Feature2D
 {
 public:
@@ -320,6 +337,7 @@ public:
     int descriptorSize() const;
     // returns the descriptor type
     int descriptorType() const;
+    bool isThreadSafe() const;
 
     // Compute the ORB features and descriptors on an image
     void operator()(InputArray image, InputArray mask, std::vector<KeyPoint>& keypoints) const;
@@ -343,6 +361,9 @@ protected:
     CV_PROP_RW int WTA_K;
     CV_PROP_RW int scoreType;
     CV_PROP_RW int patchSize;
+
+    // the scale pyramid buffers kept between the calls
+    Ptr<ORBPyramidBuffers> pyramidBuffers;
 };
 
 typedef ORB OrbFeatureDetector;
@@ -377,6 +398,8 @@ public:
     /** returns the descriptor type */
     virtual int descriptorType() const;
 
+    virtual bool isThreadSafe() const;
+
     /** select the 512 "best description pairs"
          * @param images grayscale images set
          * @param keypoints set of detected keypoints
@@ -447,6 +470,8 @@ protected:
 
  It returns the regions, each of those is encoded as a contour.
 */
+struct MSERBuffers;
+
 class CV_EXPORTS_W MSER : public FeatureDetector
 {
 public:
@@ -459,6 +484,7 @@ public:
     //! the operator that extracts the MSERs from the image or the specific part of it
     CV_WRAP_AS(detect) void operator()( const Mat& image, CV_OUT std::vector<std::vector<Point> >& msers,
                                         const Mat& mask=Mat() ) const;
+    bool isThreadSafe() const;
     AlgorithmInfo* info() const;
 
 protected:
@@ -473,6 +499,9 @@ protected:
     double areaThreshold;
     double minMargin;
     int edgeBlurSize;
+
+    // the working buffers kept between the calls
+    Ptr<MSERBuffers> buffers;
 };
 
 typedef MSER MserFeatureDetector;
@@ -495,6 +524,7 @@ public:
     CV_WRAP_AS(detect) void operator()(const Mat& image,
                 CV_OUT std::vector<KeyPoint>& keypoints) const;
 
+    bool isThreadSafe() const;
     AlgorithmInfo* info() const;
 
 protected:
@@ -524,6 +554,7 @@ public:
 
     CV_WRAP FastFeatureDetector( int threshold=10, bool nonmaxSuppression=true);
     CV_WRAP FastFeatureDetector( int threshold, bool nonmaxSuppression, int type);
+    bool isThreadSafe() const;
     AlgorithmInfo* info() const;
 
 protected:
@@ -540,6 +571,7 @@ class CV_EXPORTS_W GFTTDetector : public FeatureDetector
 public:
     CV_WRAP GFTTDetector( int maxCorners=1000, double qualityLevel=0.01, double minDistance=1,
                           int blockSize=3, bool useHarrisDetector=false, double k=0.04 );
+    bool isThreadSafe() const;
     AlgorithmInfo* info() const;
 
 protected:
@@ -591,6 +623,7 @@ public:
 
   virtual void read( const FileNode& fn );
   virtual void write( FileStorage& fs ) const;
+  virtual bool isThreadSafe() const;
 
 protected:
   struct CV_EXPORTS Center
@@ -616,6 +649,7 @@ public:
                                    int initXyStep=6, int initImgBound=0,
                                    bool varyXyStepWithScale=true,
                                    bool varyImgBoundWithScale=false );
+    bool isThreadSafe() const;
     AlgorithmInfo* info() const;
 
 protected:
@@ -634,7 +668,10 @@ protected:
 
 /*
  * Adapts a detector to partition the source image into a grid and detect
- * points in each cell.
+ * points in each cell. Each cell keeps its maxTotalKeypoints/(gridRows*gridCols)
+ * strongest keypoints; the budget left unused by sparse cells is filled with the
+ * strongest of the remaining keypoints of the whole image. The cells are processed
+ * in parallel if the wrapped detector is thread-safe.
  */
 class CV_EXPORTS_W GridAdaptedFeatureDetector : public FeatureDetector
 {
@@ -652,6 +689,7 @@ public:
 
     // TODO implement read/write
     virtual bool empty() const;
+    virtual bool isThreadSafe() const;
 
     AlgorithmInfo* info() const;
 
@@ -667,6 +705,7 @@ protected:
 /*
  * Adapts a detector to detect points over multiple levels of a Gaussian
  * pyramid. Useful for detectors that are not inherently scaled.
+ * The levels are processed in parallel if the wrapped detector is thread-safe.
  */
 class CV_EXPORTS_W PyramidAdaptedFeatureDetector : public FeatureDetector
 {
@@ -676,6 +715,7 @@ public:
 
     // TODO implement read/write
     virtual bool empty() const;
+    virtual bool isThreadSafe() const;
 
 protected:
     virtual void detectImpl( const Mat& image, std::vector<KeyPoint>& keypoints, const Mat& mask=Mat() ) const;
@@ -839,6 +879,7 @@ public:
     virtual int descriptorType() const;
 
     virtual bool empty() const;
+    virtual bool isThreadSafe() const;
 
 protected:
     virtual void computeImpl( const Mat& image, std::vector<KeyPoint>& keypoints, Mat& descriptors ) const;
@@ -863,6 +904,7 @@ public:
 
     virtual int descriptorSize() const;
     virtual int descriptorType() const;
+    virtual bool isThreadSafe() const;
 
     /// @todo read and write for brief
 
@@ -871,7 +913,7 @@ public:
 protected:
     virtual void computeImpl(const Mat& image, std::vector<KeyPoint>& keypoints, Mat& descriptors) const;
 
-    typedef void(*PixelTestFn)(const Mat&, const std::vector<KeyPoint>&, Mat&);
+    typedef void(*PixelTestFn)(const Mat&, const std::vector<KeyPoint>&, const Range&, Mat&);
 
     int bytes_;
     PixelTestFn test_fn_;
@@ -1074,6 +1116,9 @@ protected:
 
         // Vector of matrices "descriptors" will be merged to one matrix "mergedDescriptors" here.
         void set( const std::vector<Mat>& descriptors );
+        // Descriptors of further images are appended to "mergedDescriptors". The matrix may be
+        // reallocated, but the rows it already has are kept.
+        void append( const std::vector<Mat>& descriptors );
         virtual void clear();
 
         const Mat& getDescriptors() const;
@@ -1082,6 +1127,7 @@ protected:
         void getLocalIdx( int globalDescIdx, int& imgIdx, int& localDescIdx ) const;
 
         int size() const;
+        int imageCount() const;
 
     protected:
         Mat mergedDescriptors;
@@ -1125,6 +1171,14 @@ public:
 
     virtual Ptr<DescriptorMatcher> clone( bool emptyTrainData=false ) const;
 
+    //! finds k best matches for each query descriptor in the train descriptor collection;
+    //! the matches are stored in queryDescriptors.rows x k matrices, unused elements of trainIdx and imgIdx are -1
+    void knnMatchCollection( const Mat& queryDescriptors, Mat& trainIdx, Mat& imgIdx, Mat& distance, int k,
+                             const std::vector<Mat>& masks=std::vector<Mat>() );
+    //! converts the matrices produced by knnMatchCollection to the vectors of DMatch
+    static void knnMatchConvert( const Mat& trainIdx, const Mat& imgIdx, const Mat& distance,
+                                 std::vector<std::vector<DMatch> >& matches, bool compactResult=false );
+
     AlgorithmInfo* info() const;
 protected:
     virtual void knnMatchImpl( const Mat& queryDescriptors, std::vector<std::vector<DMatch> >& matches, int k,
@@ -1157,6 +1211,12 @@ public:
     virtual void train();
     virtual bool isMaskSupported() const;
 
+    // Saves the trained flann index to a file
+    void saveIndex( const String& filename ) const;
+    // Loads the flann index saved by saveIndex() instead of training it.
+    // The train descriptor collection must be the one the index was saved with.
+    bool loadIndex( const String& filename );
+
     virtual Ptr<DescriptorMatcher> clone( bool emptyTrainData=false ) const;
 
     AlgorithmInfo* info() const;
@@ -1494,6 +1554,40 @@ protected:
     int flags;
 };
 
+/*
+ * This is BOWTrainer using mini-batch k-means (D. Sculley, "Web-scale k-means clustering").
+ * Every iteration moves the centers towards a small random batch of descriptors, so the
+ * training descriptors do not have to be merged into one matrix. Descriptors can also be
+ * streamed to update() without storing them at all.
+ */
+class CV_EXPORTS BOWMiniBatchKMeansTrainer : public BOWTrainer
+{
+public:
+    BOWMiniBatchKMeansTrainer( int clusterCount, int batchSize=1000,
+                               const TermCriteria& termcrit=TermCriteria(TermCriteria::COUNT+TermCriteria::EPS, 100, 1e-3) );
+    virtual ~BOWMiniBatchKMeansTrainer();
+
+    // Returns trained vocabulary (i.e. cluster centers).
+    virtual Mat cluster() const;
+    virtual Mat cluster( const Mat& descriptors ) const;
+
+    // Moves the streamed cluster centers towards the descriptors, which are not stored.
+    void update( const Mat& descriptors );
+    // Returns the cluster centers of the descriptors passed to update() so far.
+    Mat getVocabulary() const;
+
+    virtual void clear();
+
+protected:
+    int clusterCount;
+    int batchSize;
+    TermCriteria termcrit;
+
+    Mat centers;
+    std::vector<int> counts;
+    Mat pending;
+};
+
 /*
  * Class to compute image descriptor using bag of visual words.
  */
@@ -1508,6 +1602,12 @@ public:
     const Mat& getVocabulary() const;
     void compute( const Mat& image, std::vector<KeyPoint>& keypoints, Mat& imgDescriptor,
                   std::vector<std::vector<int> >* pointIdxsOfClusters=0, Mat* descriptors=0 );
+    void compute( const Mat& keypointDescriptors, Mat& imgDescriptor,
+                  std::vector<std::vector<int> >* pointIdxsOfClusters=0 );
+    // Batched variants: the descriptors of many images are matched against the vocabulary at once.
+    void compute( const std::vector<Mat>& keypointDescriptors, std::vector<Mat>& imgDescriptors );
+    void compute( const std::vector<Mat>& images, std::vector<std::vector<KeyPoint> >& keypoints,
+                  std::vector<Mat>& imgDescriptors );
     // compute() is not constant because DescriptorMatcher::match is not constant
 
     int descriptorSize() const;
@@ -1,4 +1,5 @@
 #include "perf_precomp.hpp"
+#include "opencv2/imgproc.hpp"
 
 using namespace std;
 using namespace cv;
@@ -41,3 +42,26 @@ PERF_TEST_P(fast, detect, testing::Combine(
 
     SANITY_CHECK_KEYPOINTS(points);
 }
+
+typedef perf::TestBaseWithParam<FastType> fast_4K;
+
+PERF_TEST_P(fast_4K, detect, FastType::all())
+{
+    int type = GetParam();
+
+    // piecewise constant image with a mild noise, which gives a realistic number of corners
+    RNG rng(12345);
+    Mat small(135, 240, CV_8UC1), frame, noise(2160, 3840, CV_8UC1);
+    rng.fill(small, RNG::UNIFORM, 0, 256);
+    resize(small, frame, noise.size(), 0, 0, INTER_NEAREST);
+    rng.fill(noise, RNG::UNIFORM, 0, 16);
+    frame += noise;
+
+    declare.in(frame);
+
+    vector<KeyPoint> points;
+
+    TEST_CYCLE() FAST(frame, points, 20, true, type);
+
+    SANITY_CHECK_KEYPOINTS(points);
+}
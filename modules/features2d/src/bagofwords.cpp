@@ -115,6 +115,146 @@ Mat BOWKMeansTrainer::cluster( const Mat& _descriptors ) const
     return vocabulary;
 }
 
+// Assigns every row of batch to its nearest center and moves that center towards the row
+// with a per-center learning rate of 1/(number of rows assigned to the center so far).
+// Returns the largest center shift.
+static double miniBatchStep( const Mat& batch, Mat& centers, std::vector<int>& counts )
+{
+    Mat dist, labels, oldCenters = centers.clone();
+    batchDistance( batch, centers, dist, CV_32F, labels, NORM_L2SQR, 1 );
+
+    for( int i = 0; i < batch.rows; i++ )
+    {
+        int k = labels.at<int>(i);
+        CV_Assert( 0 <= k && k < centers.rows );
+        float eta = 1.f/++counts[k];
+        const float* x = batch.ptr<float>(i);
+        float* c = centers.ptr<float>(k);
+        for( int j = 0; j < centers.cols; j++ )
+            c[j] += eta*(x[j] - c[j]);
+    }
+
+    double maxShift = 0;
+    for( int k = 0; k < centers.rows; k++ )
+        maxShift = std::max( maxShift, norm(centers.row(k), oldCenters.row(k), NORM_L2) );
+    return maxShift;
+}
+
+// Seeds the centers with k-means++ and a single Lloyd iteration on a small sample.
+static void initCenters( const Mat& sample, int clusterCount, Mat& centers, std::vector<int>& counts )
+{
+    CV_Assert( sample.rows >= clusterCount );
+    Mat labels;
+    kmeans( sample, clusterCount, labels, TermCriteria(TermCriteria::COUNT, 1, 0), 1, KMEANS_PP_CENTERS, centers );
+
+    counts.assign( clusterCount, 0 );
+    for( int i = 0; i < labels.rows; i++ )
+        counts[labels.at<int>(i)]++;
+}
+
+// Copies randomly chosen rows of the descriptor set into a CV_32F matrix.
+static void sampleRows( const std::vector<Mat>& descriptors, const std::vector<int>& startIdxs,
+                        int count, RNG& rng, Mat& sample )
+{
+    int total = startIdxs.back();
+    sample.create( count, descriptors[0].cols, CV_32F );
+    for( int i = 0; i < count; i++ )
+    {
+        int idx = rng.uniform( 0, total );
+        int m = (int)(std::upper_bound( startIdxs.begin(), startIdxs.end(), idx ) - startIdxs.begin()) - 1;
+        Mat dst = sample.row(i);
+        descriptors[m].row(idx - startIdxs[m]).convertTo( dst, CV_32F );
+    }
+}
+
+static Mat miniBatchKMeans( const std::vector<Mat>& descriptors, int clusterCount, int batchSize,
+                            const TermCriteria& termcrit )
+{
+    CV_Assert( !descriptors.empty() && clusterCount > 0 && batchSize > 0 );
+
+    std::vector<int> startIdxs( 1, 0 );
+    for( size_t i = 0; i < descriptors.size(); i++ )
+    {
+        CV_Assert( descriptors[i].cols == descriptors[0].cols && descriptors[i].channels() == 1 );
+        startIdxs.push_back( startIdxs.back() + descriptors[i].rows );
+    }
+    int total = startIdxs.back();
+    CV_Assert( total >= clusterCount );
+
+    int maxIters = termcrit.type & TermCriteria::COUNT ? termcrit.maxCount : 100;
+    double eps = termcrit.type & TermCriteria::EPS ? termcrit.epsilon : 0;
+
+    RNG& rng = theRNG();
+    Mat sample, centers;
+    std::vector<int> counts;
+    sampleRows( descriptors, startIdxs, std::min( total, std::max( batchSize, 3*clusterCount ) ), rng, sample );
+    initCenters( sample, clusterCount, centers, counts );
+
+    for( int iter = 0; iter < maxIters; iter++ )
+    {
+        sampleRows( descriptors, startIdxs, batchSize, rng, sample );
+        if( miniBatchStep( sample, centers, counts ) <= eps )
+            break;
+    }
+    return centers;
+}
+
+BOWMiniBatchKMeansTrainer::BOWMiniBatchKMeansTrainer( int _clusterCount, int _batchSize,
+                                                      const TermCriteria& _termcrit ) :
+    clusterCount(_clusterCount), batchSize(_batchSize), termcrit(_termcrit)
+{}
+
+BOWMiniBatchKMeansTrainer::~BOWMiniBatchKMeansTrainer()
+{}
+
+Mat BOWMiniBatchKMeansTrainer::cluster() const
+{
+    CV_Assert( !descriptors.empty() );
+    return miniBatchKMeans( descriptors, clusterCount, batchSize, termcrit );
+}
+
+Mat BOWMiniBatchKMeansTrainer::cluster( const Mat& _descriptors ) const
+{
+    return miniBatchKMeans( std::vector<Mat>(1, _descriptors), clusterCount, batchSize, termcrit );
+}
+
+void BOWMiniBatchKMeansTrainer::update( const Mat& _descriptors )
+{
+    CV_Assert( !_descriptors.empty() && _descriptors.channels() == 1 );
+    CV_Assert( centers.empty() || centers.cols == _descriptors.cols );
+
+    Mat batch;
+    _descriptors.convertTo( batch, CV_32F );
+
+    if( centers.empty() )
+    {
+        // collect enough descriptors to seed the centers
+        pending.push_back( batch );
+        if( pending.rows >= clusterCount )
+        {
+            initCenters( pending, clusterCount, centers, counts );
+            pending.release();
+        }
+        return;
+    }
+
+    for( int start = 0; start < batch.rows; start += batchSize )
+        miniBatchStep( batch.rowRange(start, std::min(start + batchSize, batch.rows)), centers, counts );
+}
+
+Mat BOWMiniBatchKMeansTrainer::getVocabulary() const
+{
+    return centers.clone();
+}
+
+void BOWMiniBatchKMeansTrainer::clear()
+{
+    BOWTrainer::clear();
+    centers.release();
+    counts.clear();
+    pending.release();
+}
+
 
 BOWImgDescriptorExtractor::BOWImgDescriptorExtractor( const Ptr<DescriptorExtractor>& _dextractor,
                                                       const Ptr<DescriptorMatcher>& _dmatcher ) :
@@ -144,30 +284,35 @@ void BOWImgDescriptorExtractor::compute( const Mat& image, std::vector<KeyPoint>
     if( keypoints.empty() )
         return;
 
-    int clusterCount = descriptorSize(); // = vocabulary.rows
-
     // Compute descriptors for the image.
     Mat descriptors;
     dextractor->compute( image, keypoints, descriptors );
 
-    // Match keypoint descriptors to cluster center (to vocabulary)
-    std::vector<DMatch> matches;
-    dmatcher->match( descriptors, matches );
+    compute( descriptors, imgDescriptor, pointIdxsOfClusters );
 
-    // Compute image descriptor
+    // Add the descriptors of image keypoints
+    if (_descriptors) {
+        *_descriptors = descriptors.clone();
+    }
+}
+
+// Builds the normalized histogram of the words matched by the rows of one image.
+static void computeHistogram( const std::vector<DMatch>& matches, int start, int count, int clusterCount,
+                              Mat& imgDescriptor, std::vector<std::vector<int> >* pointIdxsOfClusters )
+{
     if( pointIdxsOfClusters )
     {
         pointIdxsOfClusters->clear();
         pointIdxsOfClusters->resize(clusterCount);
     }
 
-    imgDescriptor = Mat( 1, clusterCount, descriptorType(), Scalar::all(0.0) );
+    imgDescriptor = Mat( 1, clusterCount, CV_32FC1, Scalar::all(0.0) );
     float *dptr = (float*)imgDescriptor.data;
-    for( size_t i = 0; i < matches.size(); i++ )
+    for( int i = 0; i < count; i++ )
     {
-        int queryIdx = matches[i].queryIdx;
-        int trainIdx = matches[i].trainIdx; // cluster index
-        CV_Assert( queryIdx == (int)i );
+        int queryIdx = matches[start + i].queryIdx - start;
+        int trainIdx = matches[start + i].trainIdx; // cluster index
+        CV_Assert( queryIdx == i );
 
         dptr[trainIdx] = dptr[trainIdx] + 1.f;
         if( pointIdxsOfClusters )
@@ -175,14 +320,81 @@ void BOWImgDescriptorExtractor::compute( const Mat& image, std::vector<KeyPoint>
     }
 
     // Normalize image descriptor.
-    imgDescriptor /= descriptors.rows;
+    imgDescriptor /= count;
+}
 
-    // Add the descriptors of image keypoints
-    if (_descriptors) {
-        *_descriptors = descriptors.clone();
+void BOWImgDescriptorExtractor::compute( const Mat& keypointDescriptors, Mat& imgDescriptor,
+                                         std::vector<std::vector<int> >* pointIdxsOfClusters )
+{
+    CV_Assert( !vocabulary.empty() );
+    imgDescriptor.release();
+
+    if( keypointDescriptors.empty() )
+        return;
+
+    // Match keypoint descriptors to cluster center (to vocabulary)
+    std::vector<DMatch> matches;
+    dmatcher->match( keypointDescriptors, matches );
+    CV_Assert( (int)matches.size() == keypointDescriptors.rows );
+
+    computeHistogram( matches, 0, keypointDescriptors.rows, descriptorSize(), imgDescriptor, pointIdxsOfClusters );
+}
+
+void BOWImgDescriptorExtractor::compute( const std::vector<Mat>& keypointDescriptors, std::vector<Mat>& imgDescriptors )
+{
+    CV_Assert( !vocabulary.empty() );
+
+    // The descriptors of consecutive images are matched in batches of about this many rows,
+    // so that the matcher search runs on large queries without copying the whole set.
+    const int BATCH_ROWS = 1 << 16;
+    int clusterCount = descriptorSize();
+
+    imgDescriptors.resize( keypointDescriptors.size() );
+    for( size_t first = 0; first < keypointDescriptors.size(); )
+    {
+        size_t last = first;
+        int rows = 0;
+        while( last < keypointDescriptors.size() && (rows == 0 || rows + keypointDescriptors[last].rows <= BATCH_ROWS) )
+            rows += keypointDescriptors[last++].rows;
+
+        std::vector<DMatch> matches;
+        if( rows > 0 )
+        {
+            Mat batch;
+            for( size_t i = first; i < last; i++ )
+                if( !keypointDescriptors[i].empty() )
+                    batch.push_back( keypointDescriptors[i] );
+            dmatcher->match( batch, matches );
+            CV_Assert( (int)matches.size() == rows );
+        }
+
+        for( int start = 0; first < last; first++ )
+        {
+            int count = keypointDescriptors[first].rows;
+            if( count == 0 )
+            {
+                imgDescriptors[first].release();
+                continue;
+            }
+            computeHistogram( matches, start, count, clusterCount, imgDescriptors[first], 0 );
+            start += count;
+        }
     }
 }
 
+void BOWImgDescriptorExtractor::compute( const std::vector<Mat>& images, std::vector<std::vector<KeyPoint> >& keypoints,
+                                         std::vector<Mat>& imgDescriptors )
+{
+    std::vector<Mat> descriptors;
+    dextractor->compute( images, keypoints, descriptors );
+
+    for( size_t i = 0; i < keypoints.size(); i++ )
+        if( keypoints[i].empty() )
+            descriptors[i].release();
+
+    compute( descriptors, imgDescriptors );
+}
+
 int BOWImgDescriptorExtractor::descriptorSize() const
 {
     return vocabulary.empty() ? 0 : vocabulary.rows;
@@ -276,6 +276,11 @@ void SimpleBlobDetector::findBlobs(const cv::Mat &image, const cv::Mat &binaryIm
 #endif
 }
 
+bool SimpleBlobDetector::isThreadSafe() const
+{
+    return true;
+}
+
 void SimpleBlobDetector::detectImpl(const cv::Mat& image, std::vector<cv::KeyPoint>& keypoints, const cv::Mat&) const
 {
     //TODO: support mask
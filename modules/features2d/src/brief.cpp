@@ -61,9 +61,9 @@ inline int smoothedSum(const Mat& sum, const KeyPoint& pt, int y, int x)
            + sum.at<int>(img_y - HALF_KERNEL, img_x - HALF_KERNEL);
 }
 
-static void pixelTests16(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors)
+static void pixelTests16(const Mat& sum, const std::vector<KeyPoint>& keypoints, const Range& range, Mat& descriptors)
 {
-    for (int i = 0; i < (int)keypoints.size(); ++i)
+    for (int i = range.start; i < range.end; ++i)
     {
         uchar* desc = descriptors.ptr(i);
         const KeyPoint& pt = keypoints[i];
@@ -71,9 +71,9 @@ static void pixelTests16(const Mat& sum, const std::vector<KeyPoint>& keypoints,
     }
 }
 
-static void pixelTests32(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors)
+static void pixelTests32(const Mat& sum, const std::vector<KeyPoint>& keypoints, const Range& range, Mat& descriptors)
 {
-    for (int i = 0; i < (int)keypoints.size(); ++i)
+    for (int i = range.start; i < range.end; ++i)
     {
         uchar* desc = descriptors.ptr(i);
         const KeyPoint& pt = keypoints[i];
@@ -82,9 +82,9 @@ static void pixelTests32(const Mat& sum, const std::vector<KeyPoint>& keypoints,
     }
 }
 
-static void pixelTests64(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors)
+static void pixelTests64(const Mat& sum, const std::vector<KeyPoint>& keypoints, const Range& range, Mat& descriptors)
 {
-    for (int i = 0; i < (int)keypoints.size(); ++i)
+    for (int i = range.start; i < range.end; ++i)
     {
         uchar* desc = descriptors.ptr(i);
         const KeyPoint& pt = keypoints[i];
@@ -96,6 +96,32 @@ static void pixelTests64(const Mat& sum, const std::vector<KeyPoint>& keypoints,
 namespace cv
 {
 
+typedef void(*BriefPixelTestFn)(const Mat&, const std::vector<KeyPoint>&, const Range&, Mat&);
+
+class BriefPixelTestsInvoker : public ParallelLoopBody
+{
+public:
+    enum { BLOCK_SIZE = 256 };
+
+    BriefPixelTestsInvoker(BriefPixelTestFn _test_fn, const Mat& _sum,
+                           const std::vector<KeyPoint>& _keypoints, Mat& _descriptors) :
+        test_fn(_test_fn), sum(&_sum), keypoints(&_keypoints), descriptors(&_descriptors)
+    {
+    }
+
+    void operator()(const Range& range) const
+    {
+        Range r(range.start*BLOCK_SIZE, std::min(range.end*BLOCK_SIZE, (int)keypoints->size()));
+        test_fn(*sum, *keypoints, r, *descriptors);
+    }
+
+private:
+    BriefPixelTestFn test_fn;
+    const Mat* sum;
+    const std::vector<KeyPoint>* keypoints;
+    Mat* descriptors;
+};
+
 BriefDescriptorExtractor::BriefDescriptorExtractor(int bytes) :
     bytes_(bytes), test_fn_(NULL)
 {
@@ -125,6 +151,11 @@ int BriefDescriptorExtractor::descriptorType() const
     return CV_8UC1;
 }
 
+bool BriefDescriptorExtractor::isThreadSafe() const
+{
+    return true;
+}
+
 void BriefDescriptorExtractor::read( const FileNode& fn)
 {
     int dSize = fn["descriptorSize"];
@@ -154,22 +185,31 @@ void BriefDescriptorExtractor::computeImpl(const Mat& image, std::vector<KeyPoin
 {
     // Construct integral image for fast smoothing (box filter)
     Mat sum;
+    Size imageSize;
 
-    Mat grayImage = image;
-    if( image.type() != CV_8U ) cvtColor( image, grayImage, COLOR_BGR2GRAY );
-
-    ///TODO allow the user to pass in a precomputed integral image
-    //if(image.type() == CV_32S)
-    //  sum = image;
-    //else
+    if( image.type() == CV_32SC1 )
+    {
+        // the integral image of a grayscale image has been passed in
+        CV_Assert( image.rows > 1 && image.cols > 1 );
+        sum = image;
+        imageSize = Size(image.cols - 1, image.rows - 1);
+    }
+    else
+    {
+        Mat grayImage = image;
+        if( image.type() != CV_8U ) cvtColor( image, grayImage, COLOR_BGR2GRAY );
 
-    integral( grayImage, sum, CV_32S);
+        integral( grayImage, sum, CV_32S);
+        imageSize = image.size();
+    }
 
     //Remove keypoints very close to the border
-    KeyPointsFilter::runByImageBorder(keypoints, image.size(), PATCH_SIZE/2 + KERNEL_SIZE/2);
+    KeyPointsFilter::runByImageBorder(keypoints, imageSize, PATCH_SIZE/2 + KERNEL_SIZE/2);
 
     descriptors = Mat::zeros((int)keypoints.size(), bytes_, CV_8U);
-    test_fn_(sum, keypoints, descriptors);
+
+    int nblocks = ((int)keypoints.size() + BriefPixelTestsInvoker::BLOCK_SIZE - 1)/BriefPixelTestsInvoker::BLOCK_SIZE;
+    parallel_for_(Range(0, nblocks), BriefPixelTestsInvoker(test_fn_, sum, keypoints, descriptors));
 }
 
 } // namespace cv
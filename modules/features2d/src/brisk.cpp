@@ -350,23 +350,15 @@ BRISK::generateKernel(std::vector<float> &radiusList, std::vector<int> &numberLi
   strings_ = (int) ceil((float(noShortPairs_)) / 128.0) * 4 * 4;
 }
 
-// simple alternative:
-inline int
-BRISK::smoothedIntensity(const cv::Mat& image, const cv::Mat& integral, const float key_x,
-                                            const float key_y, const unsigned int scale, const unsigned int rot,
-                                            const unsigned int point) const
+// smoothed intensity of the image around the (xf, yf) position of a pattern point
+static inline int
+briskSmoothedIntensity(const cv::Mat& image, const cv::Mat& integral, const float xf, const float yf,
+                       const float sigma_half)
 {
-
-  // get the float position
-  const BriskPatternPoint& briskPoint = patternPoints_[scale * n_rot_ * points_ + rot * points_ + point];
-  const float xf = briskPoint.x + key_x;
-  const float yf = briskPoint.y + key_y;
   const int x = int(xf);
   const int y = int(yf);
   const int& imagecols = image.cols;
 
-  // get the sigma:
-  const float sigma_half = briskPoint.sigma;
   const float area = 4.0f * sigma_half * sigma_half;
 
   // calculate output:
@@ -510,6 +502,16 @@ BRISK::smoothedIntensity(const cv::Mat& image, const cv::Mat& integral, const fl
   return (ret_val + scaling2 / 2) / scaling2;
 }
 
+// simple alternative:
+inline int
+BRISK::smoothedIntensity(const cv::Mat& image, const cv::Mat& integral, const float key_x,
+                                            const float key_y, const unsigned int scale, const unsigned int rot,
+                                            const unsigned int point) const
+{
+  const BriskPatternPoint& briskPoint = patternPoints_[scale * n_rot_ * points_ + rot * points_ + point];
+  return briskSmoothedIntensity(image, integral, briskPoint.x + key_x, briskPoint.y + key_y, briskPoint.sigma);
+}
+
 inline bool
 RoiPredicate(const float minX, const float minY, const float maxX, const float maxY, const KeyPoint& keyPt)
 {
@@ -517,6 +519,159 @@ RoiPredicate(const float minX, const float minY, const float maxX, const float m
   return (pt.x < minX) || (pt.x >= maxX) || (pt.y < minY) || (pt.y >= maxY);
 }
 
+enum { BRISK_DESCRIPTOR_CHUNK_SIZE = 32 };
+
+// computes the orientations and/or the descriptors of the chunks of the keypoints;
+// the pattern tables are passed by the BRISK instance that owns them
+template<typename PatternPoint, typename ShortPair, typename LongPair>
+class BriskDescriptorInvoker : public ParallelLoopBody
+{
+public:
+  BriskDescriptorInvoker(const PatternPoint* _patternPoints, unsigned int _points, unsigned int _n_rot,
+                         const ShortPair* _shortPairs, unsigned int _noShortPairs,
+                         const LongPair* _longPairs, unsigned int _noLongPairs,
+                         const Mat& _image, const Mat& _integral,
+                         std::vector<KeyPoint>& _keypoints, const std::vector<int>& _kscales,
+                         Mat& _descriptors, bool _doDescriptors, bool _doOrientation)
+  {
+    patternPoints = _patternPoints;
+    points = _points;
+    n_rot = _n_rot;
+    shortPairs = _shortPairs;
+    noShortPairs = _noShortPairs;
+    longPairs = _longPairs;
+    noLongPairs = _noLongPairs;
+    image = &_image;
+    integral = &_integral;
+    keypoints = &_keypoints;
+    kscales = &_kscales;
+    descriptors = &_descriptors;
+    doDescriptors = _doDescriptors;
+    doOrientation = _doOrientation;
+  }
+
+  void
+  operator()(const Range& range) const
+  {
+    cv::AutoBuffer<int> _values(points); // for temporary use
+    int* values = _values;
+    size_t kstart = (size_t)range.start * BRISK_DESCRIPTOR_CHUNK_SIZE;
+    size_t kend = std::min((size_t)range.end * BRISK_DESCRIPTOR_CHUNK_SIZE, keypoints->size());
+
+    // temporary variables containing gray values at sample points:
+    int t1;
+    int t2;
+
+    for (size_t k = kstart; k < kend; k++)
+    {
+      cv::KeyPoint& kp = (*keypoints)[k];
+      const int scale = (*kscales)[k];
+      const float x = kp.pt.x;
+      const float y = kp.pt.y;
+
+      if (doOrientation)
+      {
+          // get the gray values in the unrotated pattern
+          for (unsigned int i = 0; i < points; i++)
+          {
+            values[i] = smoothedIntensity(x, y, scale, 0, i);
+          }
+
+          int direction0 = 0;
+          int direction1 = 0;
+          // now iterate through the long pairings
+          const LongPair* max = longPairs + noLongPairs;
+          for (const LongPair* iter = longPairs; iter < max; ++iter)
+          {
+            t1 = values[iter->i];
+            t2 = values[iter->j];
+            const int delta_t = (t1 - t2);
+            // update the direction:
+            const int tmp0 = delta_t * (iter->weighted_dx) / 1024;
+            const int tmp1 = delta_t * (iter->weighted_dy) / 1024;
+            direction0 += tmp0;
+            direction1 += tmp1;
+          }
+          kp.angle = (float)(atan2((float) direction1, (float) direction0) / CV_PI * 180.0);
+          if (kp.angle < 0)
+            kp.angle += 360.f;
+      }
+
+      if (!doDescriptors)
+        continue;
+
+      int theta;
+      if (kp.angle==-1)
+      {
+          // don't compute the gradient direction, just assign a rotation of 0°
+          theta = 0;
+      }
+      else
+      {
+          theta = (int) (n_rot * (kp.angle / (360.0)) + 0.5);
+          if (theta < 0)
+            theta += n_rot;
+          if (theta >= int(n_rot))
+            theta -= n_rot;
+      }
+
+      // now also extract the stuff for the actual direction:
+      // let us compute the smoothed values
+      int shifter = 0;
+
+      // get the gray values in the rotated pattern
+      for (unsigned int i = 0; i < points; i++)
+      {
+        values[i] = smoothedIntensity(x, y, scale, theta, i);
+      }
+
+      // now iterate through all the pairings
+      unsigned int* ptr2 = (unsigned int*) descriptors->ptr((int)k);
+      const ShortPair* max = shortPairs + noShortPairs;
+      for (const ShortPair* iter = shortPairs; iter < max; ++iter)
+      {
+        t1 = values[iter->i];
+        t2 = values[iter->j];
+        if (t1 > t2)
+        {
+          *ptr2 |= ((1) << shifter);
+
+        } // else already initialized with zero
+        // take care of the iterators:
+        ++shifter;
+        if (shifter == 32)
+        {
+          shifter = 0;
+          ++ptr2;
+        }
+      }
+    }
+  }
+
+private:
+  int
+  smoothedIntensity(float key_x, float key_y, unsigned int scale, unsigned int rot, unsigned int point) const
+  {
+    const PatternPoint& briskPoint = patternPoints[scale * n_rot * points + rot * points + point];
+    return briskSmoothedIntensity(*image, *integral, briskPoint.x + key_x, briskPoint.y + key_y, briskPoint.sigma);
+  }
+
+  const PatternPoint* patternPoints;
+  unsigned int points;
+  unsigned int n_rot;
+  const ShortPair* shortPairs;
+  unsigned int noShortPairs;
+  const LongPair* longPairs;
+  unsigned int noLongPairs;
+  const Mat* image;
+  const Mat* integral;
+  std::vector<KeyPoint>* keypoints;
+  const std::vector<int>* kscales;
+  Mat* descriptors;
+  bool doDescriptors;
+  bool doOrientation;
+};
+
 // computes the descriptor
 void
 BRISK::operator()( InputArray _image, InputArray _mask, std::vector<KeyPoint>& keypoints,
@@ -554,9 +709,8 @@ BRISK::computeDescriptorsAndOrOrientation(InputArray _image, InputArray _mask, s
   kscales.resize(ksize);
   static const float log2 = 0.693147180559945f;
   static const float lb_scalerange = (float)(std::log(scalerange_) / (log2));
-  std::vector<cv::KeyPoint>::iterator beginning = keypoints.begin();
-  std::vector<int>::iterator beginningkscales = kscales.begin();
   static const float basicSize06 = basicSize_ * 0.6f;
+  size_t kept = 0;
   for (size_t k = 0; k < ksize; k++)
   {
     unsigned int scale;
@@ -564,31 +718,26 @@ BRISK::computeDescriptorsAndOrOrientation(InputArray _image, InputArray _mask, s
       // saturate
       if (scale >= scales_)
         scale = scales_ - 1;
-      kscales[k] = scale;
     const int border = sizeList_[scale];
     const int border_x = image.cols - border;
     const int border_y = image.rows - border;
-    if (RoiPredicate((float)border, (float)border, (float)border_x, (float)border_y, keypoints[k]))
+    // the kept keypoints are compacted in place, keeping their order
+    if (!RoiPredicate((float)border, (float)border, (float)border_x, (float)border_y, keypoints[k]))
     {
-      keypoints.erase(beginning + k);
-      kscales.erase(beginningkscales + k);
-      if (k == 0)
-      {
-        beginning = keypoints.begin();
-        beginningkscales = kscales.begin();
-      }
-      ksize--;
-      k--;
+      keypoints[kept] = keypoints[k];
+      kscales[kept] = scale;
+      kept++;
     }
   }
+  ksize = kept;
+  keypoints.resize(ksize);
+  kscales.resize(ksize);
 
   // first, calculate the integral image over the whole image:
   // current integral image
   cv::Mat _integral; // the integral image
   cv::integral(image, _integral);
 
-  int* _values = new int[points_]; // for temporary use
-
   // resize the descriptors:
   cv::Mat descriptors;
   if (doDescriptors)
@@ -598,106 +747,12 @@ BRISK::computeDescriptorsAndOrOrientation(InputArray _image, InputArray _mask, s
     descriptors.setTo(0);
   }
 
-  // now do the extraction for all keypoints:
-
-  // temporary variables containing gray values at sample points:
-  int t1;
-  int t2;
-
-  // the feature orientation
-  uchar* ptr = descriptors.data;
-  for (size_t k = 0; k < ksize; k++)
-  {
-    cv::KeyPoint& kp = keypoints[k];
-    const int& scale = kscales[k];
-    int* pvalues = _values;
-    const float& x = kp.pt.x;
-    const float& y = kp.pt.y;
-
-    if (doOrientation)
-    {
-        // get the gray values in the unrotated pattern
-        for (unsigned int i = 0; i < points_; i++)
-        {
-          *(pvalues++) = smoothedIntensity(image, _integral, x, y, scale, 0, i);
-        }
-
-        int direction0 = 0;
-        int direction1 = 0;
-        // now iterate through the long pairings
-        const BriskLongPair* max = longPairs_ + noLongPairs_;
-        for (BriskLongPair* iter = longPairs_; iter < max; ++iter)
-        {
-          t1 = *(_values + iter->i);
-          t2 = *(_values + iter->j);
-          const int delta_t = (t1 - t2);
-          // update the direction:
-          const int tmp0 = delta_t * (iter->weighted_dx) / 1024;
-          const int tmp1 = delta_t * (iter->weighted_dy) / 1024;
-          direction0 += tmp0;
-          direction1 += tmp1;
-        }
-        kp.angle = (float)(atan2((float) direction1, (float) direction0) / CV_PI * 180.0);
-        if (kp.angle < 0)
-          kp.angle += 360.f;
-    }
-
-    if (!doDescriptors)
-      continue;
-
-    int theta;
-    if (kp.angle==-1)
-    {
-        // don't compute the gradient direction, just assign a rotation of 0°
-        theta = 0;
-    }
-    else
-    {
-        theta = (int) (n_rot_ * (kp.angle / (360.0)) + 0.5);
-        if (theta < 0)
-          theta += n_rot_;
-        if (theta >= int(n_rot_))
-          theta -= n_rot_;
-    }
-
-    // now also extract the stuff for the actual direction:
-    // let us compute the smoothed values
-    int shifter = 0;
-
-    //unsigned int mean=0;
-    pvalues = _values;
-    // get the gray values in the rotated pattern
-    for (unsigned int i = 0; i < points_; i++)
-    {
-      *(pvalues++) = smoothedIntensity(image, _integral, x, y, scale, theta, i);
-    }
-
-    // now iterate through all the pairings
-    unsigned int* ptr2 = (unsigned int*) ptr;
-    const BriskShortPair* max = shortPairs_ + noShortPairs_;
-    for (BriskShortPair* iter = shortPairs_; iter < max; ++iter)
-    {
-      t1 = *(_values + iter->i);
-      t2 = *(_values + iter->j);
-      if (t1 > t2)
-      {
-        *ptr2 |= ((1) << shifter);
-
-      } // else already initialized with zero
-      // take care of the iterators:
-      ++shifter;
-      if (shifter == 32)
-      {
-        shifter = 0;
-        ++ptr2;
-      }
-    }
-
-    ptr += strings_;
-  }
-
-  // clean-up
-  delete[] _values;
+  // now do the extraction for all keypoints, the keypoints are independent from each other
+  int nchunks = (int)((ksize + BRISK_DESCRIPTOR_CHUNK_SIZE - 1) / BRISK_DESCRIPTOR_CHUNK_SIZE);
+  parallel_for_(Range(0, nchunks),
+                BriskDescriptorInvoker<BriskPatternPoint, BriskShortPair, BriskLongPair>(
+                    patternPoints_, points_, n_rot_, shortPairs_, noShortPairs_, longPairs_, noLongPairs_,
+                    image, _integral, keypoints, kscales, descriptors, doDescriptors, doOrientation));
 }
 
 int
@@ -712,6 +767,12 @@ BRISK::descriptorType() const
   return CV_8U;
 }
 
+bool
+BRISK::isThreadSafe() const
+{
+  return true;
+}
+
 BRISK::~BRISK()
 {
   delete[] patternPoints_;
@@ -756,6 +817,73 @@ BRISK::computeImpl( const Mat& image, std::vector<KeyPoint>& keypoints, Mat& des
     (*this)(image, Mat(), keypoints, descriptors, true);
 }
 
+// builds the chain of the octaves (chain 0) or the intra-octaves (chain 1) of the scale space
+class BriskPyramidInvoker : public ParallelLoopBody
+{
+public:
+  BriskPyramidInvoker(const BriskLayer& _base, int _layers, std::vector<BriskLayer>* _chains)
+  {
+    base = &_base;
+    layers = _layers;
+    chains = _chains;
+  }
+
+  void
+  operator()(const Range& range) const
+  {
+    for (int c = range.start; c < range.end; c++)
+    {
+      std::vector<BriskLayer>& chain = chains[c];
+      // the octaves start from the half-sampled base layer, the intra-octaves from the 2/3-sampled one
+      chain.reserve(layers / 2);
+      if (c == 0)
+      {
+        for (int i = 2; i < layers; i += 2)
+          chain.push_back(BriskLayer(i == 2 ? *base : chain.back(), BriskLayer::CommonParams::HALFSAMPLE));
+      }
+      else
+      {
+        chain.push_back(BriskLayer(*base, BriskLayer::CommonParams::TWOTHIRDSAMPLE));
+        for (int i = 3; i < layers; i += 2)
+          chain.push_back(BriskLayer(chain.back(), BriskLayer::CommonParams::HALFSAMPLE));
+      }
+    }
+  }
+
+private:
+  const BriskLayer* base;
+  int layers;
+  std::vector<BriskLayer>* chains;
+};
+
+// runs the AGAST detection on the layers of the scale space
+class BriskAgastInvoker : public ParallelLoopBody
+{
+public:
+  BriskAgastInvoker(std::vector<BriskLayer>& _pyramid, int _threshold,
+                    std::vector<std::vector<cv::KeyPoint> >& _agastPoints)
+  {
+    pyramid = &_pyramid;
+    threshold = _threshold;
+    agastPoints = &_agastPoints;
+  }
+
+  void
+  operator()(const Range& range) const
+  {
+    for (int i = range.start; i < range.end; i++)
+    {
+      // call OAST16_9 without nms
+      (*pyramid)[i].getAgastPoints(threshold, (*agastPoints)[i]);
+    }
+  }
+
+private:
+  std::vector<BriskLayer>* pyramid;
+  int threshold;
+  std::vector<std::vector<cv::KeyPoint> >* agastPoints;
+};
+
 // construct telling the octaves number:
 BriskScaleSpace::BriskScaleSpace(int _octaves)
 {
@@ -778,16 +906,19 @@ BriskScaleSpace::constructPyramid(const cv::Mat& image)
 
   // fill the pyramid:
   pyramid_.push_back(BriskLayer(image.clone()));
-  if (layers_ > 1)
-  {
-    pyramid_.push_back(BriskLayer(pyramid_.back(), BriskLayer::CommonParams::TWOTHIRDSAMPLE));
-  }
-  const int octaves2 = layers_;
+  if (layers_ == 1)
+    return;
 
-  for (uchar i = 2; i < octaves2; i += 2)
+  // the octaves and the intra-octaves are two independent chains of half-sampled layers,
+  // they are built in parallel and then interleaved
+  std::vector<BriskLayer> chains[2];
+  parallel_for_(Range(0, 2), BriskPyramidInvoker(pyramid_[0], layers_, chains));
+
+  for (size_t i = 0; i < chains[1].size(); i++)
   {
-    pyramid_.push_back(BriskLayer(pyramid_[i - 2], BriskLayer::CommonParams::HALFSAMPLE));
-    pyramid_.push_back(BriskLayer(pyramid_[i - 1], BriskLayer::CommonParams::HALFSAMPLE));
+    if (i > 0)
+      pyramid_.push_back(chains[0][i - 1]);
+    pyramid_.push_back(chains[1][i]);
   }
 }
 
@@ -803,13 +934,12 @@ BriskScaleSpace::getKeypoints(const int threshold_, std::vector<cv::KeyPoint>& k
   std::vector<std::vector<cv::KeyPoint> > agastPoints;
   agastPoints.resize(layers_);
 
-  // go through the octaves and intra layers and calculate fast corner scores:
-  for (int i = 0; i < layers_; i++)
-  {
-    // call OAST16_9 without nms
-    BriskLayer& l = pyramid_[i];
-    l.getAgastPoints(safeThreshold_, agastPoints[i]);
-  }
+  // go through the octaves and intra layers and calculate fast corner scores,
+  // every layer writes only its own score map, so the layers are processed in parallel
+  parallel_for_(Range(0, layers_), BriskAgastInvoker(pyramid_, safeThreshold_, agastPoints));
+
+  // the refinement below stays serial: it lazily fills the score maps of the neighbouring layers
+  // with the thresholds of the current candidate, so the results depend on the processing order
 
   if (layers_ == 1)
   {
@@ -68,12 +68,39 @@ void DescriptorExtractor::compute( const Mat& image, std::vector<KeyPoint>& keyp
     computeImpl( image, keypoints, descriptors );
 }
 
+class DescriptorCollectionInvoker : public ParallelLoopBody
+{
+public:
+    DescriptorCollectionInvoker( const DescriptorExtractor* _extractor, const std::vector<Mat>& _images,
+                                 std::vector<std::vector<KeyPoint> >& _keypoints, std::vector<Mat>& _descriptors ) :
+        extractor(_extractor), images(&_images), keypoints(&_keypoints), descriptors(&_descriptors)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        for( int i = range.start; i < range.end; i++ )
+            extractor->compute( (*images)[i], (*keypoints)[i], (*descriptors)[i] );
+    }
+
+private:
+    const DescriptorExtractor* extractor;
+    const std::vector<Mat>* images;
+    std::vector<std::vector<KeyPoint> >* keypoints;
+    std::vector<Mat>* descriptors;
+};
+
 void DescriptorExtractor::compute( const std::vector<Mat>& imageCollection, std::vector<std::vector<KeyPoint> >& pointCollection, std::vector<Mat>& descCollection ) const
 {
     CV_Assert( imageCollection.size() == pointCollection.size() );
     descCollection.resize( imageCollection.size() );
-    for( size_t i = 0; i < imageCollection.size(); i++ )
-        compute( imageCollection[i], pointCollection[i], descCollection[i] );
+
+    DescriptorCollectionInvoker invoker( this, imageCollection, pointCollection, descCollection );
+    Range range( 0, (int)imageCollection.size() );
+    if( isThreadSafe() && range.size() > 1 )
+        parallel_for_( range, invoker );
+    else
+        invoker( range );
 }
 
 /*void DescriptorExtractor::read( const FileNode& )
@@ -87,6 +114,11 @@ bool DescriptorExtractor::empty() const
     return false;
 }
 
+bool DescriptorExtractor::isThreadSafe() const
+{
+    return false;
+}
+
 void DescriptorExtractor::removeBorderKeypoints( std::vector<KeyPoint>& keypoints,
                                                  Size imageSize, int borderSize )
 {
@@ -106,6 +138,11 @@ Ptr<DescriptorExtractor> DescriptorExtractor::create(const String& descriptorExt
 }
 
 
+bool Feature2D::isThreadSafe() const
+{
+    return false;
+}
+
 CV_WRAP void Feature2D::compute( const Mat& image, CV_OUT CV_IN_OUT std::vector<KeyPoint>& keypoints, CV_OUT Mat& descriptors ) const
 {
    DescriptorExtractor::compute(image, keypoints, descriptors);
@@ -134,17 +171,21 @@ static void convertBGRImageToOpponentColorSpace( const Mat& bgrImage, std::vecto
     opponentChannels[2] = cv::Mat(bgrImage.size(), CV_8UC1); // R+G+B
 
     for(int y = 0; y < bgrImage.rows; ++y)
-        for(int x = 0; x < bgrImage.cols; ++x)
+    {
+        const uchar* src = bgrImage.ptr<uchar>(y);
+        uchar* dst0 = opponentChannels[0].ptr<uchar>(y);
+        uchar* dst1 = opponentChannels[1].ptr<uchar>(y);
+        uchar* dst2 = opponentChannels[2].ptr<uchar>(y);
+
+        for(int x = 0; x < bgrImage.cols; ++x, src += 3)
         {
-            Vec3b v = bgrImage.at<Vec3b>(y, x);
-            uchar& b = v[0];
-            uchar& g = v[1];
-            uchar& r = v[2];
-
-            opponentChannels[0].at<uchar>(y, x) = saturate_cast<uchar>(0.5f    * (255 + g - r));       // (R - G)/sqrt(2), but converted to the destination data type
-            opponentChannels[1].at<uchar>(y, x) = saturate_cast<uchar>(0.25f   * (510 + r + g - 2*b)); // (R + G - 2B)/sqrt(6), but converted to the destination data type
-            opponentChannels[2].at<uchar>(y, x) = saturate_cast<uchar>(1.f/3.f * (r + g + b));         // (R + G + B)/sqrt(3), but converted to the destination data type
+            int b = src[0], g = src[1], r = src[2];
+
+            dst0[x] = saturate_cast<uchar>(0.5f    * (255 + g - r));       // (R - G)/sqrt(2), but converted to the destination data type
+            dst1[x] = saturate_cast<uchar>(0.25f   * (510 + r + g - 2*b)); // (R + G - 2B)/sqrt(6), but converted to the destination data type
+            dst2[x] = saturate_cast<uchar>(1.f/3.f * (r + g + b));         // (R + G + B)/sqrt(3), but converted to the destination data type
         }
+    }
 }
 
 struct KP_LessThan
@@ -163,20 +204,24 @@ void OpponentColorDescriptorExtractor::computeImpl( const Mat& bgrImage, std::ve
     convertBGRImageToOpponentColorSpace( bgrImage, opponentChannels );
 
     const int N = 3; // channels count
-    std::vector<KeyPoint> channelKeypoints[N];
-    Mat channelDescriptors[N];
+    std::vector<std::vector<KeyPoint> > channelKeypoints( N );
+    std::vector<Mat> channelDescriptors( N );
     std::vector<int> idxs[N];
 
-    // Compute descriptors three times, once for each Opponent channel to concatenate into a single color descriptor
-    int maxKeypointsCount = 0;
     for( int ci = 0; ci < N; ci++ )
     {
         channelKeypoints[ci].insert( channelKeypoints[ci].begin(), keypoints.begin(), keypoints.end() );
         // Use class_id member to get indices into initial keypoints vector
         for( size_t ki = 0; ki < channelKeypoints[ci].size(); ki++ )
             channelKeypoints[ci][ki].class_id = (int)ki;
+    }
 
-        descriptorExtractor->compute( opponentChannels[ci], channelKeypoints[ci], channelDescriptors[ci] );
+    // Compute descriptors three times, once for each Opponent channel to concatenate into a single color descriptor
+    descriptorExtractor->compute( opponentChannels, channelKeypoints, channelDescriptors );
+
+    int maxKeypointsCount = 0;
+    for( int ci = 0; ci < N; ci++ )
+    {
         idxs[ci].resize( channelKeypoints[ci].size() );
         for( size_t ki = 0; ki < channelKeypoints[ci].size(); ki++ )
         {
@@ -252,4 +297,9 @@ bool OpponentColorDescriptorExtractor::empty() const
     return !descriptorExtractor || descriptorExtractor->empty();
 }
 
+bool OpponentColorDescriptorExtractor::isThreadSafe() const
+{
+    return descriptorExtractor->isThreadSafe();
+}
+
 }
@@ -81,6 +81,11 @@ bool FeatureDetector::empty() const
     return false;
 }
 
+bool FeatureDetector::isThreadSafe() const
+{
+    return false;
+}
+
 void FeatureDetector::removeInvalidPoints( const Mat& mask, std::vector<KeyPoint>& keypoints )
 {
     KeyPointsFilter::runByPixelsMask( keypoints, mask );
@@ -125,6 +130,11 @@ GFTTDetector::GFTTDetector( int _nfeatures, double _qualityLevel,
 {
 }
 
+bool GFTTDetector::isThreadSafe() const
+{
+    return true;
+}
+
 void GFTTDetector::detectImpl( const Mat& image, std::vector<KeyPoint>& keypoints, const Mat& mask) const
 {
     Mat grayImage = image;
@@ -156,6 +166,10 @@ DenseFeatureDetector::DenseFeatureDetector( float _initFeatureScale, int _featur
     varyXyStepWithScale(_varyXyStepWithScale), varyImgBoundWithScale(_varyImgBoundWithScale)
 {}
 
+bool DenseFeatureDetector::isThreadSafe() const
+{
+    return true;
+}
 
 void DenseFeatureDetector::detectImpl( const Mat& image, std::vector<KeyPoint>& keypoints, const Mat& mask ) const
 {
@@ -201,38 +215,43 @@ struct ResponseComparator
     }
 };
 
-static void keepStrongest( int N, std::vector<KeyPoint>& keypoints )
+// Moves the N strongest keypoints to the front and drops the others unless erase is false.
+static void keepStrongest( int N, std::vector<KeyPoint>& keypoints, bool erase = true )
 {
     if( (int)keypoints.size() > N )
     {
         std::vector<KeyPoint>::iterator nth = keypoints.begin() + N;
         std::nth_element( keypoints.begin(), nth, keypoints.end(), ResponseComparator() );
-        keypoints.erase( nth, keypoints.end() );
+        if( erase )
+            keypoints.erase( nth, keypoints.end() );
     }
 }
 
+bool GridAdaptedFeatureDetector::isThreadSafe() const
+{
+    return detector && detector->isThreadSafe();
+}
+
 namespace {
 class GridAdaptedFeatureDetectorInvoker : public ParallelLoopBody
 {
 private:
     int gridRows_, gridCols_;
-    int maxPerCell_;
-    std::vector<KeyPoint>& keypoints_;
+    int maxPerCell_, maxTotal_;
+    std::vector<std::vector<KeyPoint> >& cellKeypoints_;
     const Mat& image_;
     const Mat& mask_;
     const Ptr<FeatureDetector>& detector_;
-    Mutex* kptLock_;
 
     GridAdaptedFeatureDetectorInvoker& operator=(const GridAdaptedFeatureDetectorInvoker&); // to quiet MSVC
 
 public:
 
     GridAdaptedFeatureDetectorInvoker(const Ptr<FeatureDetector>& detector, const Mat& image, const Mat& mask,
-                                      std::vector<KeyPoint>& keypoints, int maxPerCell, int gridRows, int gridCols,
-                                      cv::Mutex* kptLock)
-        : gridRows_(gridRows), gridCols_(gridCols), maxPerCell_(maxPerCell),
-          keypoints_(keypoints), image_(image), mask_(mask), detector_(detector),
-          kptLock_(kptLock)
+                                      std::vector<std::vector<KeyPoint> >& cellKeypoints, int maxPerCell, int maxTotal,
+                                      int gridRows, int gridCols)
+        : gridRows_(gridRows), gridCols_(gridCols), maxPerCell_(maxPerCell), maxTotal_(maxTotal),
+          cellKeypoints_(cellKeypoints), image_(image), mask_(mask), detector_(detector)
     {
     }
 
@@ -246,15 +265,18 @@ public:
             Range row_range((celly*image_.rows)/gridRows_, ((celly+1)*image_.rows)/gridRows_);
             Range col_range((cellx*image_.cols)/gridCols_, ((cellx+1)*image_.cols)/gridCols_);
 
+            // the cells are views of the image, no data is copied
             Mat sub_image = image_(row_range, col_range);
             Mat sub_mask;
             if (!mask_.empty()) sub_mask = mask_(row_range, col_range);
 
-            std::vector<KeyPoint> sub_keypoints;
-            sub_keypoints.reserve(maxPerCell_);
-
+            std::vector<KeyPoint>& sub_keypoints = cellKeypoints_[i];
             detector_->detect( sub_image, sub_keypoints, sub_mask );
-            keepStrongest( maxPerCell_, sub_keypoints );
+
+            // more than maxTotal keypoints of one cell can never be kept; of the rest,
+            // the maxPerCell strongest ones go first
+            keepStrongest( maxTotal_, sub_keypoints );
+            keepStrongest( maxPerCell_, sub_keypoints, false );
 
             std::vector<cv::KeyPoint>::iterator it = sub_keypoints.begin(),
                                                 end = sub_keypoints.end();
@@ -263,9 +285,6 @@ public:
                 it->pt.x += col_range.start;
                 it->pt.y += row_range.start;
             }
-
-            cv::AutoLock join_keypoints(*kptLock_);
-            keypoints_.insert( keypoints_.end(), sub_keypoints.begin(), sub_keypoints.end() );
         }
     }
 };
@@ -281,9 +300,28 @@ void GridAdaptedFeatureDetector::detectImpl( const Mat& image, std::vector<KeyPo
     keypoints.reserve(maxTotalKeypoints);
     int maxPerCell = maxTotalKeypoints / (gridRows * gridCols);
 
-    cv::Mutex kptLock;
-    cv::parallel_for_(cv::Range(0, gridRows * gridCols),
-        GridAdaptedFeatureDetectorInvoker(detector, image, mask, keypoints, maxPerCell, gridRows, gridCols, &kptLock));
+    std::vector<std::vector<KeyPoint> > cellKeypoints(gridRows * gridCols);
+    GridAdaptedFeatureDetectorInvoker invoker(detector, image, mask, cellKeypoints, maxPerCell, maxTotalKeypoints,
+                                              gridRows, gridCols);
+    Range range(0, gridRows * gridCols);
+    if( detector->isThreadSafe() )
+        parallel_for_( range, invoker );
+    else
+        invoker( range );
+
+    // Every cell keeps its maxPerCell strongest keypoints, and the budget left by sparse cells
+    // goes to the strongest of the remaining keypoints, wherever they are. The cells are merged
+    // in order, so the result does not depend on the scheduling of the cells.
+    std::vector<KeyPoint> rest;
+    for( size_t i = 0; i < cellKeypoints.size(); i++ )
+    {
+        const std::vector<KeyPoint>& cell = cellKeypoints[i];
+        size_t n = std::min( cell.size(), (size_t)maxPerCell );
+        keypoints.insert( keypoints.end(), cell.begin(), cell.begin() + n );
+        rest.insert( rest.end(), cell.begin() + n, cell.end() );
+    }
+    keepStrongest( maxTotalKeypoints - (int)keypoints.size(), rest );
+    keypoints.insert( keypoints.end(), rest.begin(), rest.end() );
 }
 
 /*
@@ -298,10 +336,57 @@ bool PyramidAdaptedFeatureDetector::empty() const
     return !detector || detector->empty();
 }
 
+bool PyramidAdaptedFeatureDetector::isThreadSafe() const
+{
+    return detector && detector->isThreadSafe();
+}
+
+namespace {
+class PyramidAdaptedFeatureDetectorInvoker : public ParallelLoopBody
+{
+private:
+    const std::vector<Mat>& pyramid_;
+    const std::vector<Mat>& masks_;
+    std::vector<std::vector<KeyPoint> >& levelKeypoints_;
+    const Ptr<FeatureDetector>& detector_;
+
+    PyramidAdaptedFeatureDetectorInvoker& operator=(const PyramidAdaptedFeatureDetectorInvoker&); // to quiet MSVC
+
+public:
+
+    PyramidAdaptedFeatureDetectorInvoker(const Ptr<FeatureDetector>& detector, const std::vector<Mat>& pyramid,
+                                         const std::vector<Mat>& masks, std::vector<std::vector<KeyPoint> >& levelKeypoints)
+        : pyramid_(pyramid), masks_(masks), levelKeypoints_(levelKeypoints), detector_(detector)
+    {
+    }
+
+    void operator() (const Range& range) const
+    {
+        for (int l = range.start; l < range.end; ++l)
+        {
+            // Detect on current level of the pyramid
+            std::vector<KeyPoint>& new_pts = levelKeypoints_[l];
+            detector_->detect( pyramid_[l], new_pts, masks_[l] );
+
+            int multiplier = 1 << l;
+            std::vector<KeyPoint>::iterator it = new_pts.begin(),
+                                       end = new_pts.end();
+            for( ; it != end; ++it)
+            {
+                it->pt.x *= multiplier;
+                it->pt.y *= multiplier;
+                it->size *= multiplier;
+                it->octave = l;
+            }
+        }
+    }
+};
+} // namespace
+
 void PyramidAdaptedFeatureDetector::detectImpl( const Mat& image, std::vector<KeyPoint>& keypoints, const Mat& mask ) const
 {
-    Mat src = image;
-    Mat src_mask = mask;
+    if( maxLevel < 0 )
+        return;
 
     Mat dilated_mask;
     if( !mask.empty() )
@@ -312,37 +397,30 @@ void PyramidAdaptedFeatureDetector::detectImpl( const Mat& image, std::vector<Ke
         dilated_mask = mask255;
     }
 
-    for( int l = 0, multiplier = 1; l <= maxLevel; ++l, multiplier *= 2 )
+    // The pyramid is built first, so that the levels can be searched concurrently
+    std::vector<Mat> pyramid(maxLevel + 1), masks(maxLevel + 1);
+    pyramid[0] = image;
+    masks[0] = mask;
+    for( int l = 1; l <= maxLevel; ++l )
     {
-        // Detect on current level of the pyramid
-        std::vector<KeyPoint> new_pts;
-        detector->detect( src, new_pts, src_mask );
-        std::vector<KeyPoint>::iterator it = new_pts.begin(),
-                                   end = new_pts.end();
-        for( ; it != end; ++it)
-        {
-            it->pt.x *= multiplier;
-            it->pt.y *= multiplier;
-            it->size *= multiplier;
-            it->octave = l;
-        }
-        keypoints.insert( keypoints.end(), new_pts.begin(), new_pts.end() );
+        pyrDown( pyramid[l-1], pyramid[l] );
+        if( !mask.empty() )
+            resize( dilated_mask, masks[l], pyramid[l].size(), 0, 0, INTER_AREA );
+    }
 
-        // Downsample
-        if( l < maxLevel )
-        {
-            Mat dst;
-            pyrDown( src, dst );
-            src = dst;
+    std::vector<std::vector<KeyPoint> > levelKeypoints(maxLevel + 1);
+    PyramidAdaptedFeatureDetectorInvoker invoker(detector, pyramid, masks, levelKeypoints);
+    Range range(0, maxLevel + 1);
+    if( detector->isThreadSafe() )
+        parallel_for_( range, invoker );
+    else
+        invoker( range );
 
-            if( !mask.empty() )
-                resize( dilated_mask, src_mask, src.size(), 0, 0, INTER_AREA );
-        }
-    }
+    for( int l = 0; l <= maxLevel; ++l )
+        keypoints.insert( keypoints.end(), levelKeypoints[l].begin(), levelKeypoints[l].end() );
 
     if( !mask.empty() )
         KeyPointsFilter::runByPixelsMask( keypoints, mask );
 }
 
-
 }
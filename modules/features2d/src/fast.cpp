@@ -51,202 +51,352 @@ The references are:
 namespace cv
 {
 
+// The AVX2 segment test is compiled either when AVX2 is enabled for the whole build,
+// or, with GCC, as a separate function for the AVX2 target, which is dispatched at runtime.
+#if CV_AVX2
+#  define CV_FAST_AVX2 1
+#  define CV_FAST_AVX2_TARGET
+#elif (defined __GNUC__ && !defined __clang__ && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) && \
+    (defined __x86_64__ || defined __i386__)
+#  include <immintrin.h>
+#  define CV_FAST_AVX2 1
+#  define CV_FAST_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#  define CV_FAST_AVX2 0
+#endif
+
+#if CV_FAST_AVX2
+// 32-pixel version of the SSE2 segment test below, for the 9_16 pattern only
+static CV_FAST_AVX2_TARGET int FAST_row_AVX2(const uchar* ptr, int j, int jend, const int* pixel,
+                                             int threshold, bool nonmax_suppression,
+                                             uchar* curr, int* cornerpos, int& ncorners)
+{
+    const int patternSize = 16, K = 8, N = patternSize + K + 1;
+    const __m256i delta = _mm256_set1_epi8(-128), t = _mm256_set1_epi8((char)threshold), K32 = _mm256_set1_epi8((char)K);
+
+    for(; j < jend - 32; j += 32, ptr += 32)
+    {
+        __m256i m0, m1;
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)ptr);
+        __m256i v1 = _mm256_xor_si256(_mm256_subs_epu8(v0, t), delta);
+        v0 = _mm256_xor_si256(_mm256_adds_epu8(v0, t), delta);
+
+        __m256i x0 = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*)(ptr + pixel[0])), delta);
+        __m256i x1 = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*)(ptr + pixel[4])), delta);
+        __m256i x2 = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*)(ptr + pixel[8])), delta);
+        __m256i x3 = _mm256_sub_epi8(_mm256_loadu_si256((const __m256i*)(ptr + pixel[12])), delta);
+        m0 = _mm256_and_si256(_mm256_cmpgt_epi8(x0, v0), _mm256_cmpgt_epi8(x1, v0));
+        m1 = _mm256_and_si256(_mm256_cmpgt_epi8(v1, x0), _mm256_cmpgt_epi8(v1, x1));
+        m0 = _mm256_or_si256(m0, _mm256_and_si256(_mm256_cmpgt_epi8(x1, v0), _mm256_cmpgt_epi8(x2, v0)));
+        m1 = _mm256_or_si256(m1, _mm256_and_si256(_mm256_cmpgt_epi8(v1, x1), _mm256_cmpgt_epi8(v1, x2)));
+        m0 = _mm256_or_si256(m0, _mm256_and_si256(_mm256_cmpgt_epi8(x2, v0), _mm256_cmpgt_epi8(x3, v0)));
+        m1 = _mm256_or_si256(m1, _mm256_and_si256(_mm256_cmpgt_epi8(v1, x2), _mm256_cmpgt_epi8(v1, x3)));
+        m0 = _mm256_or_si256(m0, _mm256_and_si256(_mm256_cmpgt_epi8(x3, v0), _mm256_cmpgt_epi8(x0, v0)));
+        m1 = _mm256_or_si256(m1, _mm256_and_si256(_mm256_cmpgt_epi8(v1, x3), _mm256_cmpgt_epi8(v1, x0)));
+        m0 = _mm256_or_si256(m0, m1);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(m0);
+        if( mask == 0 )
+            continue;
+        if( (mask & 0xffff) == 0 )
+        {
+            j -= 16;
+            ptr -= 16;
+            continue;
+        }
+
+        __m256i c0 = _mm256_setzero_si256(), c1 = c0, max0 = c0, max1 = c0;
+        for( int k = 0; k < N; k++ )
+        {
+            __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(ptr + pixel[k])), delta);
+            m0 = _mm256_cmpgt_epi8(x, v0);
+            m1 = _mm256_cmpgt_epi8(v1, x);
+
+            c0 = _mm256_and_si256(_mm256_sub_epi8(c0, m0), m0);
+            c1 = _mm256_and_si256(_mm256_sub_epi8(c1, m1), m1);
+
+            max0 = _mm256_max_epu8(max0, c0);
+            max1 = _mm256_max_epu8(max1, c1);
+        }
+
+        max0 = _mm256_max_epu8(max0, max1);
+        unsigned m = (unsigned)_mm256_movemask_epi8(_mm256_cmpgt_epi8(max0, K32));
+
+        for( int k = 0; m != 0 && k < 32; k++, m >>= 1 )
+            if(m & 1)
+            {
+                cornerpos[ncorners++] = j+k;
+                if(nonmax_suppression)
+                    curr[j+k] = (uchar)cornerScore<patternSize>(ptr+k, pixel, threshold);
+            }
+    }
+    _mm256_zeroupper();
+    return j;
+}
+#endif
+
+// Runs the segment test on the i-th image row, stores the corner positions to cornerpos
+// (their number to cornerpos[-1]) and, if needed, the corner scores to curr.
 template<int patternSize>
-void FAST_t(InputArray _img, std::vector<KeyPoint>& keypoints, int threshold, bool nonmax_suppression)
+static void FAST_row(const Mat& img, int i, const int* pixel, const uchar* threshold_tab,
+                     int threshold, bool nonmax_suppression, uchar* curr, int* cornerpos)
 {
-    Mat img = _img.getMat();
     const int K = patternSize/2, N = patternSize + K + 1;
-#if CV_SSE2
-    const int quarterPatternSize = patternSize/4;
-    (void)quarterPatternSize;
-#endif
-    int i, j, k, pixel[25];
-    makeOffsets(pixel, (int)img.step, patternSize);
+    int j, k, ncorners = 0;
+    memset(curr, 0, img.cols);
 
-    keypoints.clear();
+    if( i < 3 || i >= img.rows - 3 )
+    {
+        cornerpos[-1] = 0;
+        return;
+    }
 
-    threshold = std::min(std::max(threshold, 0), 255);
+    const uchar* ptr = img.ptr<uchar>(i) + 3;
+    j = 3;
 
-#if CV_SSE2
-    __m128i delta = _mm_set1_epi8(-128), t = _mm_set1_epi8((char)threshold), K16 = _mm_set1_epi8((char)K);
-    (void)K16;
-    (void)delta;
-    (void)t;
+#if CV_FAST_AVX2
+    if( patternSize == 16 && checkHardwareSupport(CV_CPU_AVX2) )
+    {
+        int j0 = j;
+        j = FAST_row_AVX2(ptr, j, img.cols - 3, pixel, threshold, nonmax_suppression, curr, cornerpos, ncorners);
+        ptr += j - j0;
+    }
 #endif
-    uchar threshold_tab[512];
-    for( i = -255; i <= 255; i++ )
-        threshold_tab[i+255] = (uchar)(i < -threshold ? 1 : i > threshold ? 2 : 0);
-
-    AutoBuffer<uchar> _buf((img.cols+16)*3*(sizeof(int) + sizeof(uchar)) + 128);
-    uchar* buf[3];
-    buf[0] = _buf; buf[1] = buf[0] + img.cols; buf[2] = buf[1] + img.cols;
-    int* cpbuf[3];
-    cpbuf[0] = (int*)alignPtr(buf[2] + img.cols, sizeof(int)) + 1;
-    cpbuf[1] = cpbuf[0] + img.cols + 1;
-    cpbuf[2] = cpbuf[1] + img.cols + 1;
-    memset(buf[0], 0, img.cols*3);
-
-    for(i = 3; i < img.rows-2; i++)
+#if CV_SSE2
+    if( patternSize == 16 && checkHardwareSupport(CV_CPU_SSE2) )
     {
-        const uchar* ptr = img.ptr<uchar>(i) + 3;
-        uchar* curr = buf[(i - 3)%3];
-        int* cornerpos = cpbuf[(i - 3)%3];
-        memset(curr, 0, img.cols);
-        int ncorners = 0;
+        const int quarterPatternSize = patternSize/4;
+        __m128i delta = _mm_set1_epi8(-128), t = _mm_set1_epi8((char)threshold), K16 = _mm_set1_epi8((char)K);
 
-        if( i < img.rows - 3 )
+        for(; j < img.cols - 16 - 3; j += 16, ptr += 16)
         {
-            j = 3;
-    #if CV_SSE2
-            if( patternSize == 16 )
+            __m128i m0, m1;
+            __m128i v0 = _mm_loadu_si128((const __m128i*)ptr);
+            __m128i v1 = _mm_xor_si128(_mm_subs_epu8(v0, t), delta);
+            v0 = _mm_xor_si128(_mm_adds_epu8(v0, t), delta);
+
+            __m128i x0 = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(ptr + pixel[0])), delta);
+            __m128i x1 = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(ptr + pixel[quarterPatternSize])), delta);
+            __m128i x2 = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(ptr + pixel[2*quarterPatternSize])), delta);
+            __m128i x3 = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(ptr + pixel[3*quarterPatternSize])), delta);
+            m0 = _mm_and_si128(_mm_cmpgt_epi8(x0, v0), _mm_cmpgt_epi8(x1, v0));
+            m1 = _mm_and_si128(_mm_cmpgt_epi8(v1, x0), _mm_cmpgt_epi8(v1, x1));
+            m0 = _mm_or_si128(m0, _mm_and_si128(_mm_cmpgt_epi8(x1, v0), _mm_cmpgt_epi8(x2, v0)));
+            m1 = _mm_or_si128(m1, _mm_and_si128(_mm_cmpgt_epi8(v1, x1), _mm_cmpgt_epi8(v1, x2)));
+            m0 = _mm_or_si128(m0, _mm_and_si128(_mm_cmpgt_epi8(x2, v0), _mm_cmpgt_epi8(x3, v0)));
+            m1 = _mm_or_si128(m1, _mm_and_si128(_mm_cmpgt_epi8(v1, x2), _mm_cmpgt_epi8(v1, x3)));
+            m0 = _mm_or_si128(m0, _mm_and_si128(_mm_cmpgt_epi8(x3, v0), _mm_cmpgt_epi8(x0, v0)));
+            m1 = _mm_or_si128(m1, _mm_and_si128(_mm_cmpgt_epi8(v1, x3), _mm_cmpgt_epi8(v1, x0)));
+            m0 = _mm_or_si128(m0, m1);
+            int mask = _mm_movemask_epi8(m0);
+            if( mask == 0 )
+                continue;
+            if( (mask & 255) == 0 )
             {
-                for(; j < img.cols - 16 - 3; j += 16, ptr += 16)
-                {
-                    __m128i m0, m1;
-                    __m128i v0 = _mm_loadu_si128((const __m128i*)ptr);
-                    __m128i v1 = _mm_xor_si128(_mm_subs_epu8(v0, t), delta);
-                    v0 = _mm_xor_si128(_mm_adds_epu8(v0, t), delta);
-
-                    __m128i x0 = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(ptr + pixel[0])), delta);
-                    __m128i x1 = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(ptr + pixel[quarterPatternSize])), delta);
-                    __m128i x2 = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(ptr + pixel[2*quarterPatternSize])), delta);
-                    __m128i x3 = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)(ptr + pixel[3*quarterPatternSize])), delta);
-                    m0 = _mm_and_si128(_mm_cmpgt_epi8(x0, v0), _mm_cmpgt_epi8(x1, v0));
-                    m1 = _mm_and_si128(_mm_cmpgt_epi8(v1, x0), _mm_cmpgt_epi8(v1, x1));
-                    m0 = _mm_or_si128(m0, _mm_and_si128(_mm_cmpgt_epi8(x1, v0), _mm_cmpgt_epi8(x2, v0)));
-                    m1 = _mm_or_si128(m1, _mm_and_si128(_mm_cmpgt_epi8(v1, x1), _mm_cmpgt_epi8(v1, x2)));
-                    m0 = _mm_or_si128(m0, _mm_and_si128(_mm_cmpgt_epi8(x2, v0), _mm_cmpgt_epi8(x3, v0)));
-                    m1 = _mm_or_si128(m1, _mm_and_si128(_mm_cmpgt_epi8(v1, x2), _mm_cmpgt_epi8(v1, x3)));
-                    m0 = _mm_or_si128(m0, _mm_and_si128(_mm_cmpgt_epi8(x3, v0), _mm_cmpgt_epi8(x0, v0)));
-                    m1 = _mm_or_si128(m1, _mm_and_si128(_mm_cmpgt_epi8(v1, x3), _mm_cmpgt_epi8(v1, x0)));
-                    m0 = _mm_or_si128(m0, m1);
-                    int mask = _mm_movemask_epi8(m0);
-                    if( mask == 0 )
-                        continue;
-                    if( (mask & 255) == 0 )
-                    {
-                        j -= 8;
-                        ptr -= 8;
-                        continue;
-                    }
+                j -= 8;
+                ptr -= 8;
+                continue;
+            }
 
-                    __m128i c0 = _mm_setzero_si128(), c1 = c0, max0 = c0, max1 = c0;
-                    for( k = 0; k < N; k++ )
-                    {
-                        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(ptr + pixel[k])), delta);
-                        m0 = _mm_cmpgt_epi8(x, v0);
-                        m1 = _mm_cmpgt_epi8(v1, x);
+            __m128i c0 = _mm_setzero_si128(), c1 = c0, max0 = c0, max1 = c0;
+            for( k = 0; k < N; k++ )
+            {
+                __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(ptr + pixel[k])), delta);
+                m0 = _mm_cmpgt_epi8(x, v0);
+                m1 = _mm_cmpgt_epi8(v1, x);
 
-                        c0 = _mm_and_si128(_mm_sub_epi8(c0, m0), m0);
-                        c1 = _mm_and_si128(_mm_sub_epi8(c1, m1), m1);
+                c0 = _mm_and_si128(_mm_sub_epi8(c0, m0), m0);
+                c1 = _mm_and_si128(_mm_sub_epi8(c1, m1), m1);
 
-                        max0 = _mm_max_epu8(max0, c0);
-                        max1 = _mm_max_epu8(max1, c1);
-                    }
+                max0 = _mm_max_epu8(max0, c0);
+                max1 = _mm_max_epu8(max1, c1);
+            }
 
-                    max0 = _mm_max_epu8(max0, max1);
-                    int m = _mm_movemask_epi8(_mm_cmpgt_epi8(max0, K16));
+            max0 = _mm_max_epu8(max0, max1);
+            int m = _mm_movemask_epi8(_mm_cmpgt_epi8(max0, K16));
 
-                    for( k = 0; m > 0 && k < 16; k++, m >>= 1 )
-                        if(m & 1)
-                        {
-                            cornerpos[ncorners++] = j+k;
-                            if(nonmax_suppression)
-                                curr[j+k] = (uchar)cornerScore<patternSize>(ptr+k, pixel, threshold);
-                        }
+            for( k = 0; m > 0 && k < 16; k++, m >>= 1 )
+                if(m & 1)
+                {
+                    cornerpos[ncorners++] = j+k;
+                    if(nonmax_suppression)
+                        curr[j+k] = (uchar)cornerScore<patternSize>(ptr+k, pixel, threshold);
                 }
-            }
-    #endif
-            for( ; j < img.cols - 3; j++, ptr++ )
-            {
-                int v = ptr[0];
-                const uchar* tab = &threshold_tab[0] - v + 255;
-                int d = tab[ptr[pixel[0]]] | tab[ptr[pixel[8]]];
+        }
+    }
+#endif
+    for( ; j < img.cols - 3; j++, ptr++ )
+    {
+        int v = ptr[0];
+        const uchar* tab = &threshold_tab[0] - v + 255;
+        int d = tab[ptr[pixel[0]]] | tab[ptr[pixel[8]]];
 
-                if( d == 0 )
-                    continue;
+        if( d == 0 )
+            continue;
 
-                d &= tab[ptr[pixel[2]]] | tab[ptr[pixel[10]]];
-                d &= tab[ptr[pixel[4]]] | tab[ptr[pixel[12]]];
-                d &= tab[ptr[pixel[6]]] | tab[ptr[pixel[14]]];
+        d &= tab[ptr[pixel[2]]] | tab[ptr[pixel[10]]];
+        d &= tab[ptr[pixel[4]]] | tab[ptr[pixel[12]]];
+        d &= tab[ptr[pixel[6]]] | tab[ptr[pixel[14]]];
 
-                if( d == 0 )
-                    continue;
+        if( d == 0 )
+            continue;
 
-                d &= tab[ptr[pixel[1]]] | tab[ptr[pixel[9]]];
-                d &= tab[ptr[pixel[3]]] | tab[ptr[pixel[11]]];
-                d &= tab[ptr[pixel[5]]] | tab[ptr[pixel[13]]];
-                d &= tab[ptr[pixel[7]]] | tab[ptr[pixel[15]]];
+        d &= tab[ptr[pixel[1]]] | tab[ptr[pixel[9]]];
+        d &= tab[ptr[pixel[3]]] | tab[ptr[pixel[11]]];
+        d &= tab[ptr[pixel[5]]] | tab[ptr[pixel[13]]];
+        d &= tab[ptr[pixel[7]]] | tab[ptr[pixel[15]]];
 
-                if( d & 1 )
-                {
-                    int vt = v - threshold, count = 0;
+        if( d & 1 )
+        {
+            int vt = v - threshold, count = 0;
 
-                    for( k = 0; k < N; k++ )
+            for( k = 0; k < N; k++ )
+            {
+                int x = ptr[pixel[k]];
+                if(x < vt)
+                {
+                    if( ++count > K )
                     {
-                        int x = ptr[pixel[k]];
-                        if(x < vt)
-                        {
-                            if( ++count > K )
-                            {
-                                cornerpos[ncorners++] = j;
-                                if(nonmax_suppression)
-                                    curr[j] = (uchar)cornerScore<patternSize>(ptr, pixel, threshold);
-                                break;
-                            }
-                        }
-                        else
-                            count = 0;
+                        cornerpos[ncorners++] = j;
+                        if(nonmax_suppression)
+                            curr[j] = (uchar)cornerScore<patternSize>(ptr, pixel, threshold);
+                        break;
                     }
                 }
+                else
+                    count = 0;
+            }
+        }
 
-                if( d & 2 )
-                {
-                    int vt = v + threshold, count = 0;
+        if( d & 2 )
+        {
+            int vt = v + threshold, count = 0;
 
-                    for( k = 0; k < N; k++ )
+            for( k = 0; k < N; k++ )
+            {
+                int x = ptr[pixel[k]];
+                if(x > vt)
+                {
+                    if( ++count > K )
                     {
-                        int x = ptr[pixel[k]];
-                        if(x > vt)
-                        {
-                            if( ++count > K )
-                            {
-                                cornerpos[ncorners++] = j;
-                                if(nonmax_suppression)
-                                    curr[j] = (uchar)cornerScore<patternSize>(ptr, pixel, threshold);
-                                break;
-                            }
-                        }
-                        else
-                            count = 0;
+                        cornerpos[ncorners++] = j;
+                        if(nonmax_suppression)
+                            curr[j] = (uchar)cornerScore<patternSize>(ptr, pixel, threshold);
+                        break;
                     }
                 }
+                else
+                    count = 0;
             }
         }
+    }
 
-        cornerpos[-1] = ncorners;
-
-        if( i == 3 )
-            continue;
+    cornerpos[-1] = ncorners;
+}
 
-        const uchar* prev = buf[(i - 4 + 3)%3];
-        const uchar* pprev = buf[(i - 5 + 3)%3];
-        cornerpos = cpbuf[(i - 4 + 3)%3];
-        ncorners = cornerpos[-1];
+// Detects the corners in a stripe of rows. Every stripe runs the segment test on its rows
+// and on the adjacent rows it needs for the non-maximum suppression, which is done as soon
+// as the next row is ready. The keypoints of every stripe are stored separately
+// and concatenated in the stripe order, so the result does not depend on the threads.
+template<int patternSize>
+class FAST_Invoker : public ParallelLoopBody
+{
+public:
+    FAST_Invoker(const Mat& _img, std::vector<std::vector<KeyPoint> >& _stripeKeypoints,
+                 int _stripeSize, int _threshold, bool _nonmax_suppression)
+    {
+        img = &_img;
+        stripeKeypoints = &_stripeKeypoints;
+        stripeSize = _stripeSize;
+        threshold = _threshold;
+        nonmax_suppression = _nonmax_suppression;
+        makeOffsets(pixel, (int)img->step, patternSize);
+        for( int i = -255; i <= 255; i++ )
+            threshold_tab[i+255] = (uchar)(i < -threshold ? 1 : i > threshold ? 2 : 0);
+    }
 
-        for( k = 0; k < ncorners; k++ )
+    void operator()(const Range& range) const
+    {
+        int cols = img->cols;
+        AutoBuffer<uchar> _buf((cols+16)*3*(sizeof(int) + sizeof(uchar)) + 128);
+        uchar* buf[3];
+        buf[0] = _buf; buf[1] = buf[0] + cols; buf[2] = buf[1] + cols;
+        int* cpbuf[3];
+        cpbuf[0] = (int*)alignPtr(buf[2] + cols, sizeof(int)) + 1;
+        cpbuf[1] = cpbuf[0] + cols + 1;
+        cpbuf[2] = cpbuf[1] + cols + 1;
+
+        for( int stripe = range.start; stripe < range.end; stripe++ )
         {
-            j = cornerpos[k];
-            int score = prev[j];
-            if( !nonmax_suppression ||
-               (score > prev[j+1] && score > prev[j-1] &&
-                score > pprev[j-1] && score > pprev[j] && score > pprev[j+1] &&
-                score > curr[j-1] && score > curr[j] && score > curr[j+1]) )
+            // the corners are searched for in the rows [3, img->rows - 3)
+            int y0 = 3 + stripe*stripeSize, y1 = std::min(y0 + stripeSize, img->rows - 3);
+            std::vector<KeyPoint>& keypoints = (*stripeKeypoints)[stripe];
+            keypoints.clear();
+
+            for( int i = y0 - 1; i <= y1; i++ )
             {
-                keypoints.push_back(KeyPoint((float)j, (float)(i-1), 7.f, -1, (float)score));
+                int idx = (i - y0 + 1) % 3;
+                FAST_row<patternSize>(*img, i, pixel, threshold_tab, threshold, nonmax_suppression,
+                                      buf[idx], cpbuf[idx]);
+                if( i < y0 + 1 )
+                    continue;
+
+                const uchar* curr = buf[idx];
+                const uchar* prev = buf[(idx + 2) % 3];
+                const uchar* pprev = buf[(idx + 1) % 3];
+                const int* cornerpos = cpbuf[(idx + 2) % 3];
+                int ncorners = cornerpos[-1];
+
+                for( int k = 0; k < ncorners; k++ )
+                {
+                    int j = cornerpos[k];
+                    int score = prev[j];
+                    if( !nonmax_suppression ||
+                       (score > prev[j+1] && score > prev[j-1] &&
+                        score > pprev[j-1] && score > pprev[j] && score > pprev[j+1] &&
+                        score > curr[j-1] && score > curr[j] && score > curr[j+1]) )
+                    {
+                        keypoints.push_back(KeyPoint((float)j, (float)(i-1), 7.f, -1, (float)score));
+                    }
+                }
             }
         }
     }
+
+private:
+    const Mat* img;
+    std::vector<std::vector<KeyPoint> >* stripeKeypoints;
+    int stripeSize;
+    int threshold;
+    bool nonmax_suppression;
+    int pixel[25];
+    uchar threshold_tab[512];
+};
+
+template<int patternSize>
+void FAST_t(InputArray _img, std::vector<KeyPoint>& keypoints, int threshold, bool nonmax_suppression)
+{
+    Mat img = _img.getMat();
+    keypoints.clear();
+
+    threshold = std::min(std::max(threshold, 0), 255);
+
+    if( img.rows < 7 || img.cols < 7 )
+        return;
+
+    // every stripe also processes the two adjacent rows, so the stripes should not be too small
+    const int stripeSize = 64;
+    int nstripes = (img.rows - 6 + stripeSize - 1)/stripeSize;
+    std::vector<std::vector<KeyPoint> > stripeKeypoints(nstripes);
+
+    parallel_for_(Range(0, nstripes),
+                  FAST_Invoker<patternSize>(img, stripeKeypoints, stripeSize, threshold, nonmax_suppression));
+
+    size_t total = 0;
+    for( int i = 0; i < nstripes; i++ )
+        total += stripeKeypoints[i].size();
+    keypoints.reserve(total);
+    for( int i = 0; i < nstripes; i++ )
+        keypoints.insert(keypoints.end(), stripeKeypoints[i].begin(), stripeKeypoints[i].end());
 }
 
 void FAST(InputArray _img, std::vector<KeyPoint>& keypoints, int threshold, bool nonmax_suppression, int type)
@@ -283,6 +433,11 @@ FastFeatureDetector::FastFeatureDetector( int _threshold, bool _nonmaxSuppressio
 : threshold(_threshold), nonmaxSuppression(_nonmaxSuppression), type((short)_type)
 {}
 
+bool FastFeatureDetector::isThreadSafe() const
+{
+    return true;
+}
+
 void FastFeatureDetector::detectImpl( const Mat& image, std::vector<KeyPoint>& keypoints, const Mat& mask ) const
 {
     Mat grayImage = image;
@@ -215,6 +215,241 @@ void FREAK::buildPattern()
     }
 }
 
+static Mutex freakPatternMutex;
+
+// simply take average on a square patch around the (xf, yf) position of a pattern point,
+// not even gaussian approx
+static uchar freakMeanIntensity( const cv::Mat& image, const cv::Mat& integral,
+                                 const float xf, const float yf, const float radius ) {
+    const int x = int(xf);
+    const int y = int(yf);
+    const int& imagecols = image.cols;
+
+    // calculate output:
+    if( radius < 0.5 ) {
+        // interpolation multipliers:
+        const int r_x = static_cast<int>((xf-x)*1024);
+        const int r_y = static_cast<int>((yf-y)*1024);
+        const int r_x_1 = (1024-r_x);
+        const int r_y_1 = (1024-r_y);
+        uchar* ptr = image.data+x+y*imagecols;
+        unsigned int ret_val;
+        // linear interpolation:
+        ret_val = (r_x_1*r_y_1*int(*ptr));
+        ptr++;
+        ret_val += (r_x*r_y_1*int(*ptr));
+        ptr += imagecols;
+        ret_val += (r_x*r_y*int(*ptr));
+        ptr--;
+        ret_val += (r_x_1*r_y*int(*ptr));
+        //return the rounded mean
+        ret_val += 2 * 1024 * 1024;
+        return static_cast<uchar>(ret_val / (4 * 1024 * 1024));
+    }
+
+    // expected case:
+
+    // calculate borders
+    const int x_left = int(xf-radius+0.5);
+    const int y_top = int(yf-radius+0.5);
+    const int x_right = int(xf+radius+1.5);//integral image is 1px wider
+    const int y_bottom = int(yf+radius+1.5);//integral image is 1px higher
+    int ret_val;
+
+    ret_val = integral.at<int>(y_bottom,x_right);//bottom right corner
+    ret_val -= integral.at<int>(y_bottom,x_left);
+    ret_val += integral.at<int>(y_top,x_left);
+    ret_val -= integral.at<int>(y_top,x_right);
+    ret_val = ret_val/( (x_right-x_left)* (y_bottom-y_top) );
+    //~ std::cout<<integral.step[1]<<std::endl;
+    return static_cast<uchar>(ret_val);
+}
+
+enum { FREAK_DESCRIPTOR_BLOCK_SIZE = 64 };
+
+// estimates the orientation and extracts the descriptor of a block of keypoints;
+// the pattern tables are passed by the FREAK instance that owns them
+template<typename PatternPoint, typename DescriptionPair, typename OrientationPair>
+class FreakDescriptorInvoker : public ParallelLoopBody
+{
+public:
+    FreakDescriptorInvoker( const PatternPoint* _patternLookup, const DescriptionPair* _descriptionPairs,
+                            const OrientationPair* _orientationPairs, bool _orientationNormalized, bool _extAll,
+                            const Mat& _image, const Mat& _imgIntegral,
+                            std::vector<KeyPoint>& _keypoints, const std::vector<int>& _kpScaleIdx, Mat& _descriptors ) :
+        patternLookup(_patternLookup), descriptionPairs(_descriptionPairs), orientationPairs(_orientationPairs),
+        orientationNormalized(_orientationNormalized), extAll(_extAll),
+        image(&_image), imgIntegral(&_imgIntegral), keypoints(&_keypoints),
+        kpScaleIdx(&_kpScaleIdx), descriptors(&_descriptors)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        int k0 = range.start*FREAK_DESCRIPTOR_BLOCK_SIZE;
+        int k1 = std::min(range.end*FREAK_DESCRIPTOR_BLOCK_SIZE, (int)keypoints->size());
+        for( int k = k0; k < k1; k++ )
+        {
+            int thetaIdx = estimateOrientation( (*keypoints)[k], (*kpScaleIdx)[k] );
+            if( extAll )
+                extractAllPairs( (*keypoints)[k], (*kpScaleIdx)[k], thetaIdx, descriptors->ptr(k) );
+            else
+                extractBestPairs( (*keypoints)[k], (*kpScaleIdx)[k], thetaIdx, descriptors->ptr(k) );
+        }
+    }
+
+private:
+    uchar meanIntensity( const KeyPoint& kp, int scaleIdx, int thetaIdx, int point ) const
+    {
+        const PatternPoint& FreakPoint = patternLookup[(scaleIdx*FREAK_NB_ORIENTATION + thetaIdx)*FREAK_NB_POINTS + point];
+        return freakMeanIntensity(*image, *imgIntegral, FreakPoint.x+kp.pt.x, FreakPoint.y+kp.pt.y, FreakPoint.sigma);
+    }
+
+    int estimateOrientation( KeyPoint& kp, int scaleIdx ) const
+    {
+        if( !orientationNormalized ) {
+            kp.angle = 0.0; // assign 0° to all keypoints
+            return 0;
+        }
+
+        // get the points intensity value in the un-rotated pattern
+        uchar pointsValue[FREAK_NB_POINTS];
+        for( int i = FREAK_NB_POINTS; i--; ) {
+            pointsValue[i] = meanIntensity(kp, scaleIdx, 0, i);
+        }
+        int direction0 = 0;
+        int direction1 = 0;
+        for( int m = 45; m--; ) {
+            //iterate through the orientation pairs
+            const int delta = (pointsValue[ orientationPairs[m].i ]-pointsValue[ orientationPairs[m].j ]);
+            direction0 += delta*(orientationPairs[m].weight_dx)/2048;
+            direction1 += delta*(orientationPairs[m].weight_dy)/2048;
+        }
+
+        kp.angle = static_cast<float>(atan2((float)direction1,(float)direction0)*(180.0/CV_PI));//estimate orientation
+        int thetaIdx = int(FREAK_NB_ORIENTATION*kp.angle*(1/360.0)+0.5);
+        if( thetaIdx < 0 )
+            thetaIdx += FREAK_NB_ORIENTATION;
+
+        if( thetaIdx >= FREAK_NB_ORIENTATION )
+            thetaIdx -= FREAK_NB_ORIENTATION;
+        return thetaIdx;
+    }
+
+    // extract the best comparisons only
+    void extractBestPairs( const KeyPoint& kp, int scaleIdx, int thetaIdx, uchar* desc ) const
+    {
+        uchar pointsValue[FREAK_NB_POINTS];
+
+        // extract descriptor at the computed orientation
+        for( int i = FREAK_NB_POINTS; i--; ) {
+            pointsValue[i] = meanIntensity(kp, scaleIdx, thetaIdx, i);
+        }
+#if CV_SSE2
+        __m128i* ptr = (__m128i*)desc;
+        // note that comparisons order is modified in each block (but first 128 comparisons remain globally the same-->does not affect the 128,384 bits segmanted matching strategy)
+        int cnt = 0;
+        for( int n = FREAK_NB_PAIRS/128; n-- ; )
+        {
+            __m128i result128 = _mm_setzero_si128();
+            for( int m = 128/16; m--; cnt += 16 )
+            {
+                __m128i operand1 = _mm_set_epi8(
+                    pointsValue[descriptionPairs[cnt+0].i],
+                    pointsValue[descriptionPairs[cnt+1].i],
+                    pointsValue[descriptionPairs[cnt+2].i],
+                    pointsValue[descriptionPairs[cnt+3].i],
+                    pointsValue[descriptionPairs[cnt+4].i],
+                    pointsValue[descriptionPairs[cnt+5].i],
+                    pointsValue[descriptionPairs[cnt+6].i],
+                    pointsValue[descriptionPairs[cnt+7].i],
+                    pointsValue[descriptionPairs[cnt+8].i],
+                    pointsValue[descriptionPairs[cnt+9].i],
+                    pointsValue[descriptionPairs[cnt+10].i],
+                    pointsValue[descriptionPairs[cnt+11].i],
+                    pointsValue[descriptionPairs[cnt+12].i],
+                    pointsValue[descriptionPairs[cnt+13].i],
+                    pointsValue[descriptionPairs[cnt+14].i],
+                    pointsValue[descriptionPairs[cnt+15].i]);
+
+                __m128i operand2 = _mm_set_epi8(
+                    pointsValue[descriptionPairs[cnt+0].j],
+                    pointsValue[descriptionPairs[cnt+1].j],
+                    pointsValue[descriptionPairs[cnt+2].j],
+                    pointsValue[descriptionPairs[cnt+3].j],
+                    pointsValue[descriptionPairs[cnt+4].j],
+                    pointsValue[descriptionPairs[cnt+5].j],
+                    pointsValue[descriptionPairs[cnt+6].j],
+                    pointsValue[descriptionPairs[cnt+7].j],
+                    pointsValue[descriptionPairs[cnt+8].j],
+                    pointsValue[descriptionPairs[cnt+9].j],
+                    pointsValue[descriptionPairs[cnt+10].j],
+                    pointsValue[descriptionPairs[cnt+11].j],
+                    pointsValue[descriptionPairs[cnt+12].j],
+                    pointsValue[descriptionPairs[cnt+13].j],
+                    pointsValue[descriptionPairs[cnt+14].j],
+                    pointsValue[descriptionPairs[cnt+15].j]);
+
+                __m128i workReg = _mm_min_epu8(operand1, operand2); // emulated "not less than" for 8-bit UNSIGNED integers
+                workReg = _mm_cmpeq_epi8(workReg, operand2);        // emulated "not less than" for 8-bit UNSIGNED integers
+
+                workReg = _mm_and_si128(_mm_set1_epi16(short(0x8080 >> m)), workReg); // merge the last 16 bits with the 128bits std::vector until full
+                result128 = _mm_or_si128(result128, workReg);
+            }
+            (*ptr) = result128;
+            ++ptr;
+        }
+#else
+        std::bitset<FREAK_NB_PAIRS>* ptr = (std::bitset<FREAK_NB_PAIRS>*)desc;
+        // extracting descriptor preserving the order of SSE version
+        int cnt = 0;
+        for( int n = 7; n < FREAK_NB_PAIRS; n += 128)
+        {
+            for( int m = 8; m--; )
+            {
+                int nm = n-m;
+                for(int kk = nm+15*8; kk >= nm; kk-=8, ++cnt)
+                {
+                    ptr->set(kk, pointsValue[descriptionPairs[cnt].i] >= pointsValue[descriptionPairs[cnt].j]);
+                }
+            }
+        }
+#endif
+    }
+
+    // extract all possible comparisons for selection
+    void extractAllPairs( const KeyPoint& kp, int scaleIdx, int thetaIdx, uchar* desc ) const
+    {
+        std::bitset<1024>* ptr = (std::bitset<1024>*)desc;
+        uchar pointsValue[FREAK_NB_POINTS];
+
+        // get the points intensity value in the rotated pattern
+        for( int i = FREAK_NB_POINTS; i--; ) {
+            pointsValue[i] = meanIntensity(kp, scaleIdx, thetaIdx, i);
+        }
+
+        int cnt(0);
+        for( int i = 1; i < FREAK_NB_POINTS; ++i ) {
+            //(generate all the pairs)
+            for( int j = 0; j < i; ++j ) {
+                ptr->set(cnt, pointsValue[i] >= pointsValue[j] );
+                ++cnt;
+            }
+        }
+    }
+
+    const PatternPoint* patternLookup;
+    const DescriptionPair* descriptionPairs;
+    const OrientationPair* orientationPairs;
+    bool orientationNormalized;
+    bool extAll;
+    const Mat* image;
+    const Mat* imgIntegral;
+    std::vector<KeyPoint>* keypoints;
+    const std::vector<int>* kpScaleIdx;
+    Mat* descriptors;
+};
+
 void FREAK::computeImpl( const Mat& image, std::vector<KeyPoint>& keypoints, Mat& descriptors ) const {
 
     if( image.empty() )
@@ -222,7 +457,11 @@ void FREAK::computeImpl( const Mat& image, std::vector<KeyPoint>& keypoints, Mat
     if( keypoints.empty() )
         return;
 
-    ((FREAK*)this)->buildPattern();
+    {
+        // the pattern is built lazily; concurrent compute() calls must not rebuild it at the same time
+        AutoLock lock(freakPatternMutex);
+        ((FREAK*)this)->buildPattern();
+    }
 
     Mat imgIntegral;
     integral(image, imgIntegral);
@@ -230,10 +469,6 @@ void FREAK::computeImpl( const Mat& image, std::vector<KeyPoint>& keypoints, Mat
     const std::vector<int>::iterator ScaleIdxBegin = kpScaleIdx.begin(); // used in std::vector erase function
     const std::vector<cv::KeyPoint>::iterator kpBegin = keypoints.begin(); // used in std::vector erase function
     const float sizeCst = static_cast<float>(FREAK_NB_SCALES/(FREAK_LOG2* nOctaves));
-    uchar pointsValue[FREAK_NB_POINTS];
-    int thetaIdx = 0;
-    int direction0;
-    int direction1;
 
     // compute the scale index corresponding to the keypoint size and remove keypoints close to the border
     if( scaleNormalized ) {
@@ -272,171 +507,15 @@ void FREAK::computeImpl( const Mat& image, std::vector<KeyPoint>& keypoints, Mat
     }
 
     // allocate descriptor memory, estimate orientations, extract descriptors
-    if( !extAll ) {
-        // extract the best comparisons only
-        descriptors = cv::Mat::zeros((int)keypoints.size(), FREAK_NB_PAIRS/8, CV_8U);
-#if CV_SSE2
-        __m128i* ptr= (__m128i*) (descriptors.data+(keypoints.size()-1)*descriptors.step[0]);
-#else
-        std::bitset<FREAK_NB_PAIRS>* ptr = (std::bitset<FREAK_NB_PAIRS>*) (descriptors.data+(keypoints.size()-1)*descriptors.step[0]);
-#endif
-        for( size_t k = keypoints.size(); k--; ) {
-            // estimate orientation (gradient)
-            if( !orientationNormalized ) {
-                thetaIdx = 0; // assign 0° to all keypoints
-                keypoints[k].angle = 0.0;
-            }
-            else {
-                // get the points intensity value in the un-rotated pattern
-                for( int i = FREAK_NB_POINTS; i--; ) {
-                    pointsValue[i] = meanIntensity(image, imgIntegral, keypoints[k].pt.x,keypoints[k].pt.y, kpScaleIdx[k], 0, i);
-                }
-                direction0 = 0;
-                direction1 = 0;
-                for( int m = 45; m--; ) {
-                    //iterate through the orientation pairs
-                    const int delta = (pointsValue[ orientationPairs[m].i ]-pointsValue[ orientationPairs[m].j ]);
-                    direction0 += delta*(orientationPairs[m].weight_dx)/2048;
-                    direction1 += delta*(orientationPairs[m].weight_dy)/2048;
-                }
-
-                keypoints[k].angle = static_cast<float>(atan2((float)direction1,(float)direction0)*(180.0/CV_PI));//estimate orientation
-                thetaIdx = int(FREAK_NB_ORIENTATION*keypoints[k].angle*(1/360.0)+0.5);
-                if( thetaIdx < 0 )
-                    thetaIdx += FREAK_NB_ORIENTATION;
-
-                if( thetaIdx >= FREAK_NB_ORIENTATION )
-                    thetaIdx -= FREAK_NB_ORIENTATION;
-            }
-            // extract descriptor at the computed orientation
-            for( int i = FREAK_NB_POINTS; i--; ) {
-                pointsValue[i] = meanIntensity(image, imgIntegral, keypoints[k].pt.x,keypoints[k].pt.y, kpScaleIdx[k], thetaIdx, i);
-            }
-#if CV_SSE2
-            // note that comparisons order is modified in each block (but first 128 comparisons remain globally the same-->does not affect the 128,384 bits segmanted matching strategy)
-            int cnt = 0;
-            for( int n = FREAK_NB_PAIRS/128; n-- ; )
-            {
-                __m128i result128 = _mm_setzero_si128();
-                for( int m = 128/16; m--; cnt += 16 )
-                {
-                    __m128i operand1 = _mm_set_epi8(
-                        pointsValue[descriptionPairs[cnt+0].i],
-                        pointsValue[descriptionPairs[cnt+1].i],
-                        pointsValue[descriptionPairs[cnt+2].i],
-                        pointsValue[descriptionPairs[cnt+3].i],
-                        pointsValue[descriptionPairs[cnt+4].i],
-                        pointsValue[descriptionPairs[cnt+5].i],
-                        pointsValue[descriptionPairs[cnt+6].i],
-                        pointsValue[descriptionPairs[cnt+7].i],
-                        pointsValue[descriptionPairs[cnt+8].i],
-                        pointsValue[descriptionPairs[cnt+9].i],
-                        pointsValue[descriptionPairs[cnt+10].i],
-                        pointsValue[descriptionPairs[cnt+11].i],
-                        pointsValue[descriptionPairs[cnt+12].i],
-                        pointsValue[descriptionPairs[cnt+13].i],
-                        pointsValue[descriptionPairs[cnt+14].i],
-                        pointsValue[descriptionPairs[cnt+15].i]);
-
-                    __m128i operand2 = _mm_set_epi8(
-                        pointsValue[descriptionPairs[cnt+0].j],
-                        pointsValue[descriptionPairs[cnt+1].j],
-                        pointsValue[descriptionPairs[cnt+2].j],
-                        pointsValue[descriptionPairs[cnt+3].j],
-                        pointsValue[descriptionPairs[cnt+4].j],
-                        pointsValue[descriptionPairs[cnt+5].j],
-                        pointsValue[descriptionPairs[cnt+6].j],
-                        pointsValue[descriptionPairs[cnt+7].j],
-                        pointsValue[descriptionPairs[cnt+8].j],
-                        pointsValue[descriptionPairs[cnt+9].j],
-                        pointsValue[descriptionPairs[cnt+10].j],
-                        pointsValue[descriptionPairs[cnt+11].j],
-                        pointsValue[descriptionPairs[cnt+12].j],
-                        pointsValue[descriptionPairs[cnt+13].j],
-                        pointsValue[descriptionPairs[cnt+14].j],
-                        pointsValue[descriptionPairs[cnt+15].j]);
-
-                    __m128i workReg = _mm_min_epu8(operand1, operand2); // emulated "not less than" for 8-bit UNSIGNED integers
-                    workReg = _mm_cmpeq_epi8(workReg, operand2);        // emulated "not less than" for 8-bit UNSIGNED integers
-
-                    workReg = _mm_and_si128(_mm_set1_epi16(short(0x8080 >> m)), workReg); // merge the last 16 bits with the 128bits std::vector until full
-                    result128 = _mm_or_si128(result128, workReg);
-                }
-                (*ptr) = result128;
-                ++ptr;
-            }
-            ptr -= 8;
-#else
-            // extracting descriptor preserving the order of SSE version
-            int cnt = 0;
-            for( int n = 7; n < FREAK_NB_PAIRS; n += 128)
-            {
-                for( int m = 8; m--; )
-                {
-                    int nm = n-m;
-                    for(int kk = nm+15*8; kk >= nm; kk-=8, ++cnt)
-                    {
-                        ptr->set(kk, pointsValue[descriptionPairs[cnt].i] >= pointsValue[descriptionPairs[cnt].j]);
-                    }
-                }
-            }
-            --ptr;
-#endif
-        }
-    }
-    else { // extract all possible comparisons for selection
-        descriptors = cv::Mat::zeros((int)keypoints.size(), 128, CV_8U);
-        std::bitset<1024>* ptr = (std::bitset<1024>*) (descriptors.data+(keypoints.size()-1)*descriptors.step[0]);
-
-        for( size_t k = keypoints.size(); k--; ) {
-            //estimate orientation (gradient)
-            if( !orientationNormalized ) {
-                thetaIdx = 0;//assign 0° to all keypoints
-                keypoints[k].angle = 0.0;
-            }
-            else {
-                //get the points intensity value in the un-rotated pattern
-                for( int i = FREAK_NB_POINTS;i--; )
-                    pointsValue[i] = meanIntensity(image, imgIntegral, keypoints[k].pt.x,keypoints[k].pt.y, kpScaleIdx[k], 0, i);
-
-                direction0 = 0;
-                direction1 = 0;
-                for( int m = 45; m--; ) {
-                    //iterate through the orientation pairs
-                    const int delta = (pointsValue[ orientationPairs[m].i ]-pointsValue[ orientationPairs[m].j ]);
-                    direction0 += delta*(orientationPairs[m].weight_dx)/2048;
-                    direction1 += delta*(orientationPairs[m].weight_dy)/2048;
-                }
-
-                keypoints[k].angle = static_cast<float>(atan2((float)direction1,(float)direction0)*(180.0/CV_PI)); //estimate orientation
-                thetaIdx = int(FREAK_NB_ORIENTATION*keypoints[k].angle*(1/360.0)+0.5);
-
-                if( thetaIdx < 0 )
-                    thetaIdx += FREAK_NB_ORIENTATION;
+    descriptors = cv::Mat::zeros((int)keypoints.size(), extAll ? 128 : FREAK_NB_PAIRS/8, CV_8U);
 
-                if( thetaIdx >= FREAK_NB_ORIENTATION )
-                    thetaIdx -= FREAK_NB_ORIENTATION;
-            }
-            // get the points intensity value in the rotated pattern
-            for( int i = FREAK_NB_POINTS; i--; ) {
-                pointsValue[i] = meanIntensity(image, imgIntegral, keypoints[k].pt.x,
-                                             keypoints[k].pt.y, kpScaleIdx[k], thetaIdx, i);
-            }
-
-            int cnt(0);
-            for( int i = 1; i < FREAK_NB_POINTS; ++i ) {
-                //(generate all the pairs)
-                for( int j = 0; j < i; ++j ) {
-                    ptr->set(cnt, pointsValue[i] >= pointsValue[j] );
-                    ++cnt;
-                }
-            }
-            --ptr;
-        }
-    }
+    int nblocks = ((int)keypoints.size() + FREAK_DESCRIPTOR_BLOCK_SIZE - 1)/FREAK_DESCRIPTOR_BLOCK_SIZE;
+    parallel_for_(Range(0, nblocks),
+                  FreakDescriptorInvoker<PatternPoint, DescriptionPair, OrientationPair>(
+                      &patternLookup[0], descriptionPairs, orientationPairs, orientationNormalized, extAll,
+                      image, imgIntegral, keypoints, kpScaleIdx, descriptors));
 }
 
-// simply take average on a square patch, not even gaussian approx
 uchar FREAK::meanIntensity( const cv::Mat& image, const cv::Mat& integral,
                             const float kp_x,
                             const float kp_y,
@@ -445,53 +524,7 @@ uchar FREAK::meanIntensity( const cv::Mat& image, const cv::Mat& integral,
                             const unsigned int point) const {
     // get point position in image
     const PatternPoint& FreakPoint = patternLookup[scale*FREAK_NB_ORIENTATION*FREAK_NB_POINTS + rot*FREAK_NB_POINTS + point];
-    const float xf = FreakPoint.x+kp_x;
-    const float yf = FreakPoint.y+kp_y;
-    const int x = int(xf);
-    const int y = int(yf);
-    const int& imagecols = image.cols;
-
-    // get the sigma:
-    const float radius = FreakPoint.sigma;
-
-    // calculate output:
-    if( radius < 0.5 ) {
-        // interpolation multipliers:
-        const int r_x = static_cast<int>((xf-x)*1024);
-        const int r_y = static_cast<int>((yf-y)*1024);
-        const int r_x_1 = (1024-r_x);
-        const int r_y_1 = (1024-r_y);
-        uchar* ptr = image.data+x+y*imagecols;
-        unsigned int ret_val;
-        // linear interpolation:
-        ret_val = (r_x_1*r_y_1*int(*ptr));
-        ptr++;
-        ret_val += (r_x*r_y_1*int(*ptr));
-        ptr += imagecols;
-        ret_val += (r_x*r_y*int(*ptr));
-        ptr--;
-        ret_val += (r_x_1*r_y*int(*ptr));
-        //return the rounded mean
-        ret_val += 2 * 1024 * 1024;
-        return static_cast<uchar>(ret_val / (4 * 1024 * 1024));
-    }
-
-    // expected case:
-
-    // calculate borders
-    const int x_left = int(xf-radius+0.5);
-    const int y_top = int(yf-radius+0.5);
-    const int x_right = int(xf+radius+1.5);//integral image is 1px wider
-    const int y_bottom = int(yf+radius+1.5);//integral image is 1px higher
-    int ret_val;
-
-    ret_val = integral.at<int>(y_bottom,x_right);//bottom right corner
-    ret_val -= integral.at<int>(y_bottom,x_left);
-    ret_val += integral.at<int>(y_top,x_left);
-    ret_val -= integral.at<int>(y_top,x_right);
-    ret_val = ret_val/( (x_right-x_left)* (y_bottom-y_top) );
-    //~ std::cout<<integral.step[1]<<std::endl;
-    return static_cast<uchar>(ret_val);
+    return freakMeanIntensity(image, integral, FreakPoint.x+kp_x, FreakPoint.y+kp_y, FreakPoint.sigma);
 }
 
 // pair selection algorithm from a set of training images and corresponding keypoints
@@ -623,4 +656,8 @@ int FREAK::descriptorType() const {
     return CV_8U;
 }
 
+bool FREAK::isThreadSafe() const {
+    return true;
+}
+
 } // END NAMESPACE CV
@@ -132,6 +132,26 @@ void DescriptorMatcher::DescriptorCollection::set( const std::vector<Mat>& descr
     }
 }
 
+void DescriptorMatcher::DescriptorCollection::append( const std::vector<Mat>& descriptors )
+{
+    if( startIdxs.empty() )
+    {
+        set( descriptors );
+        return;
+    }
+
+    for( size_t i = 0; i < descriptors.size(); i++ )
+    {
+        startIdxs.push_back( mergedDescriptors.rows );
+        if( !descriptors[i].empty() )
+        {
+            CV_Assert( mergedDescriptors.empty() ||
+                       (descriptors[i].cols == mergedDescriptors.cols && descriptors[i].type() == mergedDescriptors.type()) );
+            mergedDescriptors.push_back( descriptors[i] );
+        }
+    }
+}
+
 void DescriptorMatcher::DescriptorCollection::clear()
 {
     startIdxs.clear();
@@ -172,6 +192,11 @@ int DescriptorMatcher::DescriptorCollection::size() const
     return mergedDescriptors.rows;
 }
 
+int DescriptorMatcher::DescriptorCollection::imageCount() const
+{
+    return (int)startIdxs.size();
+}
+
 /*
  * DescriptorMatcher
  */
@@ -337,20 +362,21 @@ Ptr<DescriptorMatcher> BFMatcher::clone( bool emptyTrainData ) const
 }
 
 
-void BFMatcher::knnMatchImpl( const Mat& queryDescriptors, std::vector<std::vector<DMatch> >& matches, int knn,
-                              const std::vector<Mat>& masks, bool compactResult )
+void BFMatcher::knnMatchCollection( const Mat& queryDescriptors, Mat& trainIdx, Mat& imgIdx, Mat& distance, int knn,
+                                    const std::vector<Mat>& masks )
 {
     const int IMGIDX_SHIFT = 18;
     const int IMGIDX_ONE = (1 << IMGIDX_SHIFT);
 
     if( queryDescriptors.empty() || trainDescCollection.empty() )
     {
-        matches.clear();
+        trainIdx.release();
+        imgIdx.release();
+        distance.release();
         return;
     }
     CV_Assert( queryDescriptors.type() == trainDescCollection[0].type() );
-
-    matches.reserve(queryDescriptors.rows);
+    CV_Assert( knn > 0 );
 
     Mat dist, nidx;
 
@@ -369,27 +395,55 @@ void BFMatcher::knnMatchImpl( const Mat& queryDescriptors, std::vector<std::vect
     }
 
     if( dtype == CV_32S )
+        dist.convertTo(distance, CV_32F);
+    else
+        distance = dist;
+
+    trainIdx.create(nidx.size(), CV_32S);
+    imgIdx.create(nidx.size(), CV_32S);
+
+    for( int qIdx = 0; qIdx < nidx.rows; qIdx++ )
     {
-        Mat temp;
-        dist.convertTo(temp, CV_32F);
-        dist = temp;
+        const int* nidxptr = nidx.ptr<int>(qIdx);
+        int* trainIdxptr = trainIdx.ptr<int>(qIdx);
+        int* imgIdxptr = imgIdx.ptr<int>(qIdx);
+
+        for( int k = 0; k < nidx.cols; k++ )
+        {
+            int idx = nidxptr[k];
+            trainIdxptr[k] = idx < 0 ? -1 : idx & (IMGIDX_ONE - 1);
+            imgIdxptr[k] = idx < 0 ? -1 : idx >> IMGIDX_SHIFT;
+        }
     }
+}
 
-    for( int qIdx = 0; qIdx < queryDescriptors.rows; qIdx++ )
+void BFMatcher::knnMatchConvert( const Mat& trainIdx, const Mat& imgIdx, const Mat& distance,
+                                 std::vector<std::vector<DMatch> >& matches, bool compactResult )
+{
+    matches.clear();
+    if( trainIdx.empty() )
+        return;
+
+    CV_Assert( trainIdx.type() == CV_32SC1 && imgIdx.type() == CV_32SC1 && distance.type() == CV_32FC1 );
+    CV_Assert( imgIdx.size() == trainIdx.size() && distance.size() == trainIdx.size() );
+
+    matches.reserve(trainIdx.rows);
+
+    for( int qIdx = 0; qIdx < trainIdx.rows; qIdx++ )
     {
-        const float* distptr = dist.ptr<float>(qIdx);
-        const int* nidxptr = nidx.ptr<int>(qIdx);
+        const int* trainIdxptr = trainIdx.ptr<int>(qIdx);
+        const int* imgIdxptr = imgIdx.ptr<int>(qIdx);
+        const float* distptr = distance.ptr<float>(qIdx);
 
         matches.push_back( std::vector<DMatch>() );
         std::vector<DMatch>& mq = matches.back();
-        mq.reserve(knn);
+        mq.reserve(trainIdx.cols);
 
-        for( int k = 0; k < nidx.cols; k++ )
+        for( int k = 0; k < trainIdx.cols; k++ )
         {
-            if( nidxptr[k] < 0 )
+            if( trainIdxptr[k] < 0 )
                 break;
-            mq.push_back( DMatch(qIdx, nidxptr[k] & (IMGIDX_ONE - 1),
-                          nidxptr[k] >> IMGIDX_SHIFT, distptr[k]) );
+            mq.push_back( DMatch(qIdx, trainIdxptr[k], imgIdxptr[k], distptr[k]) );
         }
 
         if( mq.empty() && compactResult )
@@ -397,6 +451,14 @@ void BFMatcher::knnMatchImpl( const Mat& queryDescriptors, std::vector<std::vect
     }
 }
 
+void BFMatcher::knnMatchImpl( const Mat& queryDescriptors, std::vector<std::vector<DMatch> >& matches, int knn,
+                              const std::vector<Mat>& masks, bool compactResult )
+{
+    Mat trainIdx, imgIdx, distance;
+    knnMatchCollection( queryDescriptors, trainIdx, imgIdx, distance, knn, masks );
+    knnMatchConvert( trainIdx, imgIdx, distance, matches, compactResult );
+}
+
 
 void BFMatcher::radiusMatchImpl( const Mat& queryDescriptors, std::vector<std::vector<DMatch> >& matches,
                                  float maxDistance, const std::vector<Mat>& masks, bool compactResult )
@@ -524,9 +586,41 @@ void FlannBasedMatcher::train()
 {
     if( !flannIndex || mergedDescriptors.size() < addedDescCount )
     {
-        mergedDescriptors.set( trainDescCollection );
-        flannIndex = makePtr<flann::Index>( mergedDescriptors.getDescriptors(), *indexParams );
+        if( flannIndex && mergedDescriptors.size() > 0 &&
+            mergedDescriptors.imageCount() <= (int)trainDescCollection.size() )
+        {
+            // only new images have been added since the index was built,
+            // so their descriptors are inserted into the existing index
+            std::vector<Mat> newDescriptors( trainDescCollection.begin() + mergedDescriptors.imageCount(),
+                                             trainDescCollection.end() );
+            mergedDescriptors.append( newDescriptors );
+            flannIndex->addPoints( mergedDescriptors.getDescriptors() );
+        }
+        else
+        {
+            mergedDescriptors.set( trainDescCollection );
+            flannIndex = makePtr<flann::Index>( mergedDescriptors.getDescriptors(), *indexParams );
+        }
+    }
+}
+
+void FlannBasedMatcher::saveIndex( const String& filename ) const
+{
+    if( !flannIndex )
+        CV_Error( Error::StsError, "the matcher has not been trained" );
+    flannIndex->save( filename );
+}
+
+bool FlannBasedMatcher::loadIndex( const String& filename )
+{
+    mergedDescriptors.set( trainDescCollection );
+    flannIndex = makePtr<flann::Index>();
+    if( !flannIndex->load( mergedDescriptors.getDescriptors(), filename ) )
+    {
+        flannIndex.release();
+        return false;
     }
+    return true;
 }
 
 void FlannBasedMatcher::read( const FileNode& fn)
@@ -779,13 +873,7 @@ void FlannBasedMatcher::radiusMatchImpl( const Mat& queryDescriptors, std::vecto
     const int count = mergedDescriptors.size(); // TODO do count as param?
     Mat indices( queryDescriptors.rows, count, CV_32SC1, Scalar::all(-1) );
     Mat dists( queryDescriptors.rows, count, CV_32FC1, Scalar::all(-1) );
-    for( int qIdx = 0; qIdx < queryDescriptors.rows; qIdx++ )
-    {
-        Mat queryDescriptorsRow = queryDescriptors.row(qIdx);
-        Mat indicesRow = indices.row(qIdx);
-        Mat distsRow = dists.row(qIdx);
-        flannIndex->radiusSearch( queryDescriptorsRow, indicesRow, distsRow, maxDistance*maxDistance, count, *searchParams );
-    }
+    flannIndex->radiusSearch( queryDescriptors, indices, dists, maxDistance*maxDistance, count, *searchParams );
 
     convertToDMatches( mergedDescriptors, indices, dists, matches );
 }
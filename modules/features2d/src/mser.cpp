@@ -396,8 +396,11 @@ static CvContour* MSERToContour( MSERConnectedComp* comp, CvMemStorage* storage
 static int* preprocessMSER_8UC1( CvMat* img,
             int*** heap_cur,
             CvMat* src,
-            CvMat* mask )
+            CvMat* mask,
+            bool invert )
 {
+    // the source image is not modified, so both passes can run at the same time
+    const int xorval = invert ? 0xff : 0;
     int srccpt = src->step-src->cols;
     int cpt_1 = img->cols-src->cols-1;
     int* imgptr = img->data.i;
@@ -428,9 +431,9 @@ static int* preprocessMSER_8UC1( CvMat* img,
                 {
                     if ( !startptr )
                         startptr = imgptr;
-                    *srcptr = 0xff-*srcptr;
-                    level_size[*srcptr]++;
-                    *imgptr = ((*srcptr>>5)<<8)|(*srcptr);
+                    int val = *srcptr^xorval;
+                    level_size[val]++;
+                    *imgptr = ((val>>5)<<8)|val;
                 } else {
                     *imgptr = -1;
                 }
@@ -451,9 +454,9 @@ static int* preprocessMSER_8UC1( CvMat* img,
             imgptr++;
             for ( int j = 0; j < src->cols; j++ )
             {
-                *srcptr = 0xff-*srcptr;
-                level_size[*srcptr]++;
-                *imgptr = ((*srcptr>>5)<<8)|(*srcptr);
+                int val = *srcptr^xorval;
+                level_size[val]++;
+                *imgptr = ((val>>5)<<8)|val;
                 imgptr++;
                 srcptr++;
             }
@@ -635,48 +638,137 @@ static void extractMSER_8UC1_Pass( int* ioptr,
     }
 }
 
+// the working buffers of one pass of the grey MSER
+struct MSERPassBuffers
+{
+    void swap( MSERPassBuffers& b )
+    {
+        std::swap(img, b.img);
+        heap.swap(b.heap);
+        pts.swap(b.pts);
+        history.swap(b.history);
+    }
+
+    Mat img;
+    std::vector<int*> heap;
+    std::vector<LinkedPoint> pts;
+    std::vector<MSERGrowHistory> history;
+};
+
+// The buffers of an MSER instance are kept between the calls, so the consecutive frames
+// do not reallocate them. A call takes the buffers and gives them back at the end,
+// the concurrent calls on the same instance just allocate their own ones.
+struct MSERBuffers
+{
+    Mutex mutex;
+    MSERPassBuffers pass[2];
+};
+
+// darker to brighter (MSER-, pass 0) and brighter to darker (MSER+, pass 1) are independent,
+// every pass has its own buffers and its own contour storage
+class MSER_8UC1_Invoker : public ParallelLoopBody
+{
+public:
+    MSER_8UC1_Invoker( CvMat* _src, CvMat* _mask, MSERPassBuffers* _buffers,
+                       CvSeq** _contours, CvMemStorage** _storages, const MSERParams& _params )
+        : src(_src), mask(_mask), buffers(_buffers), contours(_contours), storages(_storages), params(_params)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        int step = 8;
+        int stepgap = 3;
+        while ( step < src->step+2 )
+        {
+            step <<= 1;
+            stepgap++;
+        }
+        int stepmask = step-1;
+
+        for ( int pass = range.start; pass < range.end; pass++ )
+        {
+            MSERPassBuffers& buf = buffers[pass];
+
+            // to speedup the process, make the width to be 2^N
+            buf.img.create( src->rows+2, step, CV_32SC1 );
+            CvMat img = buf.img;
+            int* ioptr = img.data.i+step+1;
+
+            // pre-allocate boundary heap, linked point and grow history
+            size_t npixels = (size_t)src->rows*src->cols;
+            if ( buf.heap.size() < npixels+256 )
+                buf.heap.resize(npixels+256);
+            if ( buf.pts.size() < npixels )
+                buf.pts.resize(npixels);
+            if ( buf.history.size() < npixels )
+                buf.history.resize(npixels);
+            int** heap_start[256];
+            heap_start[0] = &buf.heap[0];
+            MSERConnectedComp comp[257];
+
+            int* imgptr = preprocessMSER_8UC1( &img, heap_start, src, mask, pass == 0 );
+            extractMSER_8UC1_Pass( ioptr, imgptr, heap_start, &buf.pts[0], &buf.history[0], comp,
+                                   step, stepmask, stepgap, params, pass == 0 ? -1 : 1,
+                                   contours[pass], storages[pass] );
+        }
+    }
+
+private:
+    CvMat* src;
+    CvMat* mask;
+    MSERPassBuffers* buffers;
+    CvSeq** contours;
+    CvMemStorage** storages;
+    MSERParams params;
+};
+
 static void extractMSER_8UC1( CvMat* src,
              CvMat* mask,
              CvSeq* contours,
              CvMemStorage* storage,
-             MSERParams params )
+             MSERParams params,
+             MSERBuffers& instanceBuffers )
 {
-    int step = 8;
-    int stepgap = 3;
-    while ( step < src->step+2 )
+    MSERPassBuffers buffers[2];
+    {
+        AutoLock lock(instanceBuffers.mutex);
+        for ( int pass = 0; pass < 2; pass++ )
+            buffers[pass].swap(instanceBuffers.pass[pass]);
+    }
+
+    MemStorage passStorage[2];
+    CvMemStorage* storages[2];
+    CvSeq* passContours[2];
+    for ( int pass = 0; pass < 2; pass++ )
     {
-        step <<= 1;
-        stepgap++;
+        passStorage[pass] = MemStorage(cvCreateMemStorage(0));
+        storages[pass] = passStorage[pass];
+        passContours[pass] = cvCreateSeq( 0, sizeof(CvSeq), sizeof(CvSeq*), storages[pass] );
+    }
+
+    parallel_for_( Range(0, 2), MSER_8UC1_Invoker(src, mask, buffers, passContours, storages, params) );
+
+    // MSER- regions go first, then MSER+ ones
+    for ( int pass = 0; pass < 2; pass++ )
+    {
+        SeqIterator<CvSeq*> it = Seq<CvSeq*>(passContours[pass]).begin();
+        for ( int i = 0; i < passContours[pass]->total; i++, ++it )
+        {
+            CvContour* src_contour = (CvContour*)*it;
+            CvContour* contour = (CvContour*)cvCloneSeq( (CvSeq*)src_contour, storage );
+            contour->rect = src_contour->rect;
+            contour->color = src_contour->color;
+            cvSeqPush( contours, &contour );
+        }
+    }
+
+    AutoLock lock(instanceBuffers.mutex);
+    if ( instanceBuffers.pass[0].img.empty() )
+    {
+        for ( int pass = 0; pass < 2; pass++ )
+            buffers[pass].swap(instanceBuffers.pass[pass]);
     }
-    int stepmask = step-1;
-
-    // to speedup the process, make the width to be 2^N
-    CvMat* img = cvCreateMat( src->rows+2, step, CV_32SC1 );
-    int* ioptr = img->data.i+step+1;
-    int* imgptr;
-
-    // pre-allocate boundary heap
-    int** heap = (int**)cvAlloc( (src->rows*src->cols+256)*sizeof(heap[0]) );
-    int** heap_start[256];
-    heap_start[0] = heap;
-
-    // pre-allocate linked point and grow history
-    LinkedPoint* pts = (LinkedPoint*)cvAlloc( src->rows*src->cols*sizeof(pts[0]) );
-    MSERGrowHistory* history = (MSERGrowHistory*)cvAlloc( src->rows*src->cols*sizeof(history[0]) );
-    MSERConnectedComp comp[257];
-
-    // darker to brighter (MSER-)
-    imgptr = preprocessMSER_8UC1( img, heap_start, src, mask );
-    extractMSER_8UC1_Pass( ioptr, imgptr, heap_start, pts, history, comp, step, stepmask, stepgap, params, -1, contours, storage );
-    // brighter to darker (MSER+)
-    imgptr = preprocessMSER_8UC1( img, heap_start, src, mask );
-    extractMSER_8UC1_Pass( ioptr, imgptr, heap_start, pts, history, comp, step, stepmask, stepgap, params, 1, contours, storage );
-
-    // clean up
-    cvFree( &history );
-    cvFree( &heap );
-    cvFree( &pts );
-    cvReleaseMat( &img );
 }
 
 struct MSCRNode;
@@ -732,6 +824,38 @@ static void initMSCRNode( MSCRNode* node )
     node->prev = node->next = node->shortcut = node;
 }
 
+// computes the horizontal and the vertical chi-squared distances of the rows
+class MSCRChiInvoker : public ParallelLoopBody
+{
+public:
+    MSCRChiInvoker( CvMat* _src, CvMat* _dx, CvMat* _dy ) : src(_src), dx(_dx), dy(_dy) {}
+
+    void operator()( const Range& range ) const
+    {
+        for ( int i = range.start; i < range.end; i++ )
+        {
+            uchar* srcptr = src->data.ptr + i*src->step;
+            uchar* lastptr = srcptr+3;
+            double* dxptr = (double*)(dx->data.ptr + i*dx->step);
+            for ( int j = 0; j < src->cols-1; j++, srcptr += 3, lastptr += 3 )
+                dxptr[j] = ChiSquaredDistance( srcptr, lastptr );
+
+            if ( i == src->rows-1 )
+                continue;
+            srcptr = src->data.ptr + i*src->step;
+            lastptr = srcptr+src->step;
+            double* dyptr = (double*)(dy->data.ptr + i*dy->step);
+            for ( int j = 0; j < src->cols; j++, srcptr += 3, lastptr += 3 )
+                dyptr[j] = ChiSquaredDistance( srcptr, lastptr );
+        }
+    }
+
+private:
+    CvMat* src;
+    CvMat* dx;
+    CvMat* dy;
+};
+
 // the preprocess to get the edge list with proper gaussian blur
 static int preprocessMSER_8UC3( MSCRNode* node,
             MSCREdge* edge,
@@ -743,45 +867,15 @@ static int preprocessMSER_8UC3( MSCRNode* node,
             int Ne,
             int edgeBlurSize )
 {
-    int srccpt = src->step-src->cols*3;
-    uchar* srcptr = src->data.ptr;
-    uchar* lastptr = src->data.ptr+3;
-    double* dxptr = dx->data.db;
-    for ( int i = 0; i < src->rows; i++ )
-    {
-        for ( int j = 0; j < src->cols-1; j++ )
-        {
-            *dxptr = ChiSquaredDistance( srcptr, lastptr );
-            dxptr++;
-            srcptr += 3;
-            lastptr += 3;
-        }
-        srcptr += srccpt+3;
-        lastptr += srccpt+3;
-    }
-    srcptr = src->data.ptr;
-    lastptr = src->data.ptr+src->step;
-    double* dyptr = dy->data.db;
-    for ( int i = 0; i < src->rows-1; i++ )
-    {
-        for ( int j = 0; j < src->cols; j++ )
-        {
-            *dyptr = ChiSquaredDistance( srcptr, lastptr );
-            dyptr++;
-            srcptr += 3;
-            lastptr += 3;
-        }
-        srcptr += srccpt;
-        lastptr += srccpt;
-    }
+    parallel_for_( Range(0, src->rows), MSCRChiInvoker(src, dx, dy) );
     // get dx and dy and blur it
     if ( edgeBlurSize >= 1 )
     {
         cvSmooth( dx, dx, CV_GAUSSIAN, edgeBlurSize, edgeBlurSize );
         cvSmooth( dy, dy, CV_GAUSSIAN, edgeBlurSize, edgeBlurSize );
     }
-    dxptr = dx->data.db;
-    dyptr = dy->data.db;
+    double* dxptr = dx->data.db;
+    double* dyptr = dy->data.db;
     // assian dx, dy to proper edge list and initialize mscr node
     // the nasty code here intended to avoid extra loops
     if ( mask )
@@ -1227,7 +1321,8 @@ extractMSER( CvArr* _img,
            CvArr* _mask,
            CvSeq** _contours,
            CvMemStorage* storage,
-           MSERParams params )
+           MSERParams params,
+           MSERBuffers& buffers )
 {
     CvMat srchdr, *src = cvGetMat( _img, &srchdr );
     CvMat maskhdr, *mask = _mask ? cvGetMat( _mask, &maskhdr ) : 0;
@@ -1246,7 +1341,7 @@ extractMSER( CvArr* _img,
     switch ( CV_MAT_TYPE(src->type) )
     {
         case CV_8UC1:
-            extractMSER_8UC1( src, mask, contours, storage, params );
+            extractMSER_8UC1( src, mask, contours, storage, params, buffers );
             break;
         case CV_8UC3:
             extractMSER_8UC3( src, mask, contours, storage, params );
@@ -1262,7 +1357,7 @@ MSER::MSER( int _delta, int _min_area, int _max_area,
     : delta(_delta), minArea(_min_area), maxArea(_max_area),
     maxVariation(_max_variation), minDiversity(_min_diversity),
     maxEvolution(_max_evolution), areaThreshold(_area_threshold),
-    minMargin(_min_margin), edgeBlurSize(_edge_blur_size)
+    minMargin(_min_margin), edgeBlurSize(_edge_blur_size), buffers(makePtr<MSERBuffers>())
 {
 }
 
@@ -1275,7 +1370,7 @@ void MSER::operator()( const Mat& image, std::vector<std::vector<Point> >& dstco
     Seq<CvSeq*> contours;
     extractMSER( &_image, pmask, &contours.seq, storage,
                  MSERParams(delta, minArea, maxArea, maxVariation, minDiversity,
-                            maxEvolution, areaThreshold, minMargin, edgeBlurSize));
+                            maxEvolution, areaThreshold, minMargin, edgeBlurSize), *buffers);
     SeqIterator<CvSeq*> it = contours.begin();
     size_t i, ncontours = contours.size();
     dstcontours.resize(ncontours);
@@ -1284,6 +1379,11 @@ void MSER::operator()( const Mat& image, std::vector<std::vector<Point> >& dstco
 }
 
 
+bool MSER::isThreadSafe() const
+{
+    return true;
+}
+
 void MserFeatureDetector::detectImpl( const Mat& image, std::vector<KeyPoint>& keypoints, const Mat& mask ) const
 {
     std::vector<std::vector<Point> > msers;
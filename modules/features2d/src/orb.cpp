@@ -45,6 +45,15 @@ namespace cv
 const float HARRIS_K = 0.04f;
 const int DESCRIPTOR_SIZE = 32;
 
+// The scale pyramid buffers of an ORB instance are kept between the calls, so the consecutive
+// frames of the same size do not reallocate them. A call takes the buffers and gives them back
+// at the end, the concurrent calls on the same instance just allocate their own ones.
+struct ORBPyramidBuffers
+{
+    Mutex mutex;
+    Mat image, mask;
+};
+
 /**
  * Function that computes the Harris responses in a
  * blockSize x blockSize patch at given points in an image
@@ -70,6 +79,15 @@ HarrisResponses(const Mat& img, std::vector<KeyPoint>& pts, int blockSize, float
         for( int j = 0; j < blockSize; j++ )
             ofs[i*blockSize + j] = (int)(i*step + j);
 
+#if CV_SSE2
+    // the block rows are processed by 8 pixels, the pixels beyond the block are masked out
+    bool haveSSE2 = checkHardwareSupport(CV_CPU_SSE2) && blockSize <= 8;
+    uchar CV_DECL_ALIGNED(16) maskbuf[16] = {0};
+    for( int j = 0; j < blockSize; j++ )
+        maskbuf[j*2] = maskbuf[j*2 + 1] = 0xff;
+    const __m128i blockMask = _mm_load_si128((const __m128i*)maskbuf);
+#endif
+
     for( ptidx = 0; ptidx < ptsize; ptidx++ )
     {
         int x0 = cvRound(pts[ptidx].pt.x - r);
@@ -78,6 +96,43 @@ HarrisResponses(const Mat& img, std::vector<KeyPoint>& pts, int blockSize, float
         const uchar* ptr0 = ptr00 + y0*step + x0;
         int a = 0, b = 0, c = 0;
 
+#if CV_SSE2
+        if( haveSSE2 )
+        {
+            const __m128i z = _mm_setzero_si128();
+            __m128i va = z, vb = z, vc = z;
+
+            for( int i = 0; i < blockSize; i++ )
+            {
+                const uchar* ptr = ptr0 + i*step;
+                #define LOAD8(p) _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(p)), z)
+                __m128i t_m = LOAD8(ptr - step - 1), t_p = LOAD8(ptr - step + 1), t_c = LOAD8(ptr - step);
+                __m128i m_m = LOAD8(ptr - 1), m_p = LOAD8(ptr + 1);
+                __m128i b_m = LOAD8(ptr + step - 1), b_p = LOAD8(ptr + step + 1), b_c = LOAD8(ptr + step);
+                #undef LOAD8
+
+                __m128i Ix = _mm_add_epi16(_mm_slli_epi16(_mm_sub_epi16(m_p, m_m), 1),
+                                           _mm_add_epi16(_mm_sub_epi16(t_p, t_m), _mm_sub_epi16(b_p, b_m)));
+                __m128i Iy = _mm_add_epi16(_mm_slli_epi16(_mm_sub_epi16(b_c, t_c), 1),
+                                           _mm_add_epi16(_mm_sub_epi16(b_m, t_m), _mm_sub_epi16(b_p, t_p)));
+                Ix = _mm_and_si128(Ix, blockMask);
+                Iy = _mm_and_si128(Iy, blockMask);
+
+                va = _mm_add_epi32(va, _mm_madd_epi16(Ix, Ix));
+                vb = _mm_add_epi32(vb, _mm_madd_epi16(Iy, Iy));
+                vc = _mm_add_epi32(vc, _mm_madd_epi16(Ix, Iy));
+            }
+
+            int CV_DECL_ALIGNED(16) buf[12];
+            _mm_store_si128((__m128i*)buf, va);
+            _mm_store_si128((__m128i*)(buf + 4), vb);
+            _mm_store_si128((__m128i*)(buf + 8), vc);
+            a = buf[0] + buf[1] + buf[2] + buf[3];
+            b = buf[4] + buf[5] + buf[6] + buf[7];
+            c = buf[8] + buf[9] + buf[10] + buf[11];
+        }
+        else
+#endif
         for( int k = 0; k < blockSize*blockSize; k++ )
         {
             const uchar* ptr = ptr0 + ofs[k];
@@ -107,12 +162,38 @@ static float IC_Angle(const Mat& image, const int half_k, Point2f pt,
 
     // Go line by line in the circular patch
     int step = (int)image.step1();
+#if CV_SSE2
+    bool haveSSE2 = checkHardwareSupport(CV_CPU_SSE2);
+    const __m128i z = _mm_setzero_si128(), ones = _mm_set1_epi16(1);
+    const __m128i uofs = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+#endif
     for (int v = 1; v <= half_k; ++v)
     {
         // Proceed over the two lines
         int v_sum = 0;
         int d = u_max[v];
-        for (int u = -d; u <= d; ++u)
+        int u = -d;
+#if CV_SSE2
+        if( haveSSE2 )
+        {
+            // the sums of the 16-bit products are exact, so the moments are the same as the scalar ones
+            __m128i vsum4 = z, m10sum4 = z;
+            for( ; u <= d - 7; u += 8 )
+            {
+                __m128i plus = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(center + u + v*step)), z);
+                __m128i minus = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(center + u - v*step)), z);
+                __m128i uvec = _mm_add_epi16(_mm_set1_epi16((short)u), uofs);
+                vsum4 = _mm_add_epi32(vsum4, _mm_madd_epi16(_mm_sub_epi16(plus, minus), ones));
+                m10sum4 = _mm_add_epi32(m10sum4, _mm_madd_epi16(_mm_add_epi16(plus, minus), uvec));
+            }
+            int CV_DECL_ALIGNED(16) buf[8];
+            _mm_store_si128((__m128i*)buf, vsum4);
+            _mm_store_si128((__m128i*)(buf + 4), m10sum4);
+            v_sum += buf[0] + buf[1] + buf[2] + buf[3];
+            m_10 += buf[4] + buf[5] + buf[6] + buf[7];
+        }
+#endif
+        for ( ; u <= d; ++u)
         {
             int val_plus = center[u + v*step], val_minus = center[u - v*step];
             v_sum += (val_plus - val_minus);
@@ -558,7 +639,7 @@ ORB::ORB(int _nfeatures, float _scaleFactor, int _nlevels, int _edgeThreshold,
          int _firstLevel, int _WTA_K, int _scoreType, int _patchSize) :
     nfeatures(_nfeatures), scaleFactor(_scaleFactor), nlevels(_nlevels),
     edgeThreshold(_edgeThreshold), firstLevel(_firstLevel), WTA_K(_WTA_K),
-    scoreType(_scoreType), patchSize(_patchSize)
+    scoreType(_scoreType), patchSize(_patchSize), pyramidBuffers(makePtr<ORBPyramidBuffers>())
 {}
 
 
@@ -572,6 +653,11 @@ int ORB::descriptorType() const
     return CV_8U;
 }
 
+bool ORB::isThreadSafe() const
+{
+    return true;
+}
+
 /** Compute the ORB features and descriptors on an image
  * @param img the image to compute the features and descriptors on
  * @param mask the mask to apply
@@ -601,6 +687,83 @@ static void computeOrientation(const Mat& image, std::vector<KeyPoint>& keypoint
 }
 
 
+class ORBKeyPointsInvoker : public ParallelLoopBody
+{
+public:
+    ORBKeyPointsInvoker(const std::vector<Mat>& _imagePyramid, const std::vector<Mat>& _maskPyramid,
+                        std::vector<std::vector<KeyPoint> >& _allKeypoints,
+                        const std::vector<int>& _nfeaturesPerLevel, const std::vector<int>& _umax,
+                        int _firstLevel, double _scaleFactor, int _edgeThreshold,
+                        int _patchSize, int _scoreType)
+    {
+        imagePyramid = &_imagePyramid;
+        maskPyramid = &_maskPyramid;
+        allKeypoints = &_allKeypoints;
+        nfeaturesPerLevel = &_nfeaturesPerLevel;
+        umax = &_umax;
+        firstLevel = _firstLevel;
+        scaleFactor = _scaleFactor;
+        edgeThreshold = _edgeThreshold;
+        patchSize = _patchSize;
+        scoreType = _scoreType;
+    }
+
+    void operator()(const Range& range) const
+    {
+        for (int level = range.start; level < range.end; ++level)
+        {
+            const Mat& img = (*imagePyramid)[level];
+            int featuresNum = (*nfeaturesPerLevel)[level];
+            std::vector<KeyPoint> & keypoints = (*allKeypoints)[level];
+            keypoints.reserve(featuresNum*2);
+
+            // Detect FAST features, 20 is a good threshold
+            FastFeatureDetector fd(20, true);
+            fd.detect(img, keypoints, (*maskPyramid)[level]);
+
+            // Remove keypoints very close to the border
+            KeyPointsFilter::runByImageBorder(keypoints, img.size(), edgeThreshold);
+
+            if( scoreType == ORB::HARRIS_SCORE )
+            {
+                // Keep more points than necessary as FAST does not give amazing corners
+                KeyPointsFilter::retainBest(keypoints, 2 * featuresNum);
+
+                // Compute the Harris cornerness (better scoring than FAST)
+                HarrisResponses(img, keypoints, 7, HARRIS_K);
+            }
+
+            //cull to the final desired level, using the new Harris scores or the original FAST scores.
+            KeyPointsFilter::retainBest(keypoints, featuresNum);
+
+            float sf = getScale(level, firstLevel, scaleFactor);
+
+            // Set the level of the coordinates
+            for (std::vector<KeyPoint>::iterator keypoint = keypoints.begin(),
+                 keypointEnd = keypoints.end(); keypoint != keypointEnd; ++keypoint)
+            {
+                keypoint->octave = level;
+                keypoint->size = patchSize*sf;
+            }
+
+            computeOrientation(img, keypoints, patchSize / 2, *umax);
+        }
+    }
+
+private:
+    const std::vector<Mat>* imagePyramid;
+    const std::vector<Mat>* maskPyramid;
+    std::vector<std::vector<KeyPoint> >* allKeypoints;
+    const std::vector<int>* nfeaturesPerLevel;
+    const std::vector<int>* umax;
+    int firstLevel;
+    double scaleFactor;
+    int edgeThreshold;
+    int patchSize;
+    int scoreType;
+};
+
+
 /** Compute the ORB keypoints on an image
  * @param image_pyramid the image pyramid to compute the features and descriptors on
  * @param mask_pyramid the masks to apply at every level
@@ -651,65 +814,89 @@ static void computeKeyPoints(const std::vector<Mat>& imagePyramid,
 
     allKeypoints.resize(nlevels);
 
-    for (int level = 0; level < nlevels; ++level)
-    {
-        int featuresNum = nfeaturesPerLevel[level];
-        allKeypoints[level].reserve(featuresNum*2);
+    // the levels are independent from each other, so they are processed in parallel
+    parallel_for_(Range(0, nlevels),
+                  ORBKeyPointsInvoker(imagePyramid, maskPyramid, allKeypoints, nfeaturesPerLevel, umax,
+                                      firstLevel, scaleFactor, edgeThreshold, patchSize, scoreType));
+}
 
-        std::vector<KeyPoint> & keypoints = allKeypoints[level];
 
-        // Detect FAST features, 20 is a good threshold
-        FastFeatureDetector fd(20, true);
-        fd.detect(imagePyramid[level], keypoints, maskPyramid[level]);
+/** Compute the ORB descriptors of the keypoints of all the levels.
+ * The keypoints of all the levels are split into blocks of the same size,
+ * so the work is balanced even if most of the keypoints are on one level.
+ */
+class ORBDescriptorsInvoker : public ParallelLoopBody
+{
+public:
+    enum { BLOCK_SIZE = 64 };
 
-        // Remove keypoints very close to the border
-        KeyPointsFilter::runByImageBorder(keypoints, imagePyramid[level].size(), edgeThreshold);
+    ORBDescriptorsInvoker(const std::vector<Mat>& _imagePyramid,
+                          const std::vector<std::vector<KeyPoint> >& _allKeypoints,
+                          const std::vector<int>& _levelOfs, Mat& _descriptors,
+                          const std::vector<Point>& _pattern, int _dsize, int _WTA_K)
+    {
+        imagePyramid = &_imagePyramid;
+        allKeypoints = &_allKeypoints;
+        levelOfs = &_levelOfs;
+        descriptors = &_descriptors;
+        pattern = &_pattern;
+        dsize = _dsize;
+        WTA_K = _WTA_K;
+    }
 
-        if( scoreType == ORB::HARRIS_SCORE )
-        {
-            // Keep more points than necessary as FAST does not give amazing corners
-            KeyPointsFilter::retainBest(keypoints, 2 * featuresNum);
+    void operator()(const Range& range) const
+    {
+        const std::vector<int>& ofs = *levelOfs;
+        int nlevels = (int)allKeypoints->size();
+        int i = range.start*BLOCK_SIZE, iend = std::min(range.end*BLOCK_SIZE, ofs[nlevels]);
+        int level = (int)(std::upper_bound(ofs.begin(), ofs.end(), i) - ofs.begin()) - 1;
 
-            // Compute the Harris cornerness (better scoring than FAST)
-            HarrisResponses(imagePyramid[level], keypoints, 7, HARRIS_K);
+        for( ; i < iend; i++ )
+        {
+            while( i >= ofs[level+1] )
+                level++;
+            computeOrbDescriptor((*allKeypoints)[level][i - ofs[level]], (*imagePyramid)[level],
+                                 &(*pattern)[0], descriptors->ptr(i), dsize, WTA_K);
         }
+    }
 
-        //cull to the final desired level, using the new Harris scores or the original FAST scores.
-        KeyPointsFilter::retainBest(keypoints, featuresNum);
+private:
+    const std::vector<Mat>* imagePyramid;
+    const std::vector<std::vector<KeyPoint> >* allKeypoints;
+    const std::vector<int>* levelOfs;
+    Mat* descriptors;
+    const std::vector<Point>* pattern;
+    int dsize;
+    int WTA_K;
+};
 
-        float sf = getScale(level, firstLevel, scaleFactor);
 
-        // Set the level of the coordinates
-        for (std::vector<KeyPoint>::iterator keypoint = keypoints.begin(),
-             keypointEnd = keypoints.end(); keypoint != keypointEnd; ++keypoint)
+class ORBBlurInvoker : public ParallelLoopBody
+{
+public:
+    ORBBlurInvoker(std::vector<Mat>& _imagePyramid, const std::vector<std::vector<KeyPoint> >& _allKeypoints)
+    {
+        imagePyramid = &_imagePyramid;
+        allKeypoints = &_allKeypoints;
+    }
+
+    void operator()(const Range& range) const
+    {
+        for (int level = range.start; level < range.end; ++level)
         {
-            keypoint->octave = level;
-            keypoint->size = patchSize*sf;
+            // preprocess the resized image, the levels without keypoints are not needed
+            if( (*allKeypoints)[level].empty() )
+                continue;
+            Mat& workingMat = (*imagePyramid)[level];
+            //boxFilter(working_mat, working_mat, working_mat.depth(), Size(5,5), Point(-1,-1), true, BORDER_REFLECT_101);
+            GaussianBlur(workingMat, workingMat, Size(7, 7), 2, 2, BORDER_REFLECT_101);
         }
-
-        computeOrientation(imagePyramid[level], keypoints, halfPatchSize, umax);
     }
-}
 
-
-/** Compute the ORB decriptors
- * @param image the image to compute the features and descriptors on
- * @param integral_image the integral image of the image (can be empty, but the computation will be slower)
- * @param level the scale at which we compute the orientation
- * @param keypoints the keypoints to use
- * @param descriptors the resulting descriptors
- */
-static void computeDescriptors(const Mat& image, std::vector<KeyPoint>& keypoints, Mat& descriptors,
-                               const std::vector<Point>& pattern, int dsize, int WTA_K)
-{
-    //convert to grayscale if more than one color
-    CV_Assert(image.type() == CV_8UC1);
-    //create the descriptor mat, keypoints.size() rows, BYTES cols
-    descriptors = Mat::zeros((int)keypoints.size(), dsize, CV_8UC1);
-
-    for (size_t i = 0; i < keypoints.size(); i++)
-        computeOrbDescriptor(keypoints[i], image, &pattern[0], descriptors.ptr((int)i), dsize, WTA_K);
-}
+private:
+    std::vector<Mat>* imagePyramid;
+    const std::vector<std::vector<KeyPoint> >* allKeypoints;
+};
 
 
 /** Compute the ORB features and descriptors on an image
@@ -759,19 +946,41 @@ void ORB::operator()( InputArray _image, InputArray _mask, std::vector<KeyPoint>
         levelsNum++;
     }
 
-    // Pre-compute the scale pyramids
-    std::vector<Mat> imagePyramid(levelsNum), maskPyramid(levelsNum);
+    // All the pyramid levels (with their borders) are stacked in one buffer
+    std::vector<Size> levelSizes(levelsNum);
+    int bufRows = 0, bufCols = 0;
     for (int level = 0; level < levelsNum; ++level)
     {
         float scale = 1/getScale(level, firstLevel, scaleFactor);
-        Size sz(cvRound(image.cols*scale), cvRound(image.rows*scale));
-        Size wholeSize(sz.width + border*2, sz.height + border*2);
-        Mat temp(wholeSize, image.type()), masktemp;
+        levelSizes[level] = Size(cvRound(image.cols*scale), cvRound(image.rows*scale));
+        bufRows += levelSizes[level].height + border*2;
+        bufCols = std::max(bufCols, levelSizes[level].width + border*2);
+    }
+
+    Mat imageBuf, maskBuf;
+    {
+        AutoLock lock(pyramidBuffers->mutex);
+        std::swap(imageBuf, pyramidBuffers->image);
+        std::swap(maskBuf, pyramidBuffers->mask);
+    }
+    if( imageBuf.rows < bufRows || imageBuf.cols < bufCols || imageBuf.type() != image.type() )
+        imageBuf.create(bufRows, bufCols, image.type());
+    if( !mask.empty() && (maskBuf.rows < bufRows || maskBuf.cols < bufCols || maskBuf.type() != mask.type()) )
+        maskBuf.create(bufRows, bufCols, mask.type());
+
+    // Pre-compute the scale pyramids
+    std::vector<Mat> imagePyramid(levelsNum), maskPyramid(levelsNum);
+    for (int level = 0, y = 0; level < levelsNum; ++level)
+    {
+        Size sz = levelSizes[level];
+        Rect wholeRect(0, y, sz.width + border*2, sz.height + border*2);
+        y += wholeRect.height;
+        Mat temp = imageBuf(wholeRect), masktemp;
         imagePyramid[level] = temp(Rect(border, border, sz.width, sz.height));
 
         if( !mask.empty() )
         {
-            masktemp = Mat(wholeSize, mask.type());
+            masktemp = maskBuf(wholeRect);
             maskPyramid[level] = masktemp(Rect(border, border, sz.width, sz.height));
         }
 
@@ -897,30 +1106,25 @@ void ORB::operator()( InputArray _image, InputArray _mask, std::vector<KeyPoint>
         }
     }
 
+    // Compute the descriptors
+    if( do_descriptors && !descriptors.empty() )
+    {
+        std::vector<int> levelOfs(levelsNum + 1, 0);
+        for (int level = 0; level < levelsNum; ++level)
+            levelOfs[level + 1] = levelOfs[level] + (int)allKeypoints[level].size();
+
+        parallel_for_(Range(0, levelsNum), ORBBlurInvoker(imagePyramid, allKeypoints));
+
+        int nblocks = (descriptors.rows + ORBDescriptorsInvoker::BLOCK_SIZE - 1)/ORBDescriptorsInvoker::BLOCK_SIZE;
+        parallel_for_(Range(0, nblocks),
+                      ORBDescriptorsInvoker(imagePyramid, allKeypoints, levelOfs, descriptors,
+                                            pattern, descriptorSize(), WTA_K));
+    }
+
     _keypoints.clear();
-    int offset = 0;
     for (int level = 0; level < levelsNum; ++level)
     {
-        // Get the features and compute their orientation
         std::vector<KeyPoint>& keypoints = allKeypoints[level];
-        int nkeypoints = (int)keypoints.size();
-
-        // Compute the descriptors
-        if (do_descriptors)
-        {
-            Mat desc;
-            if (!descriptors.empty())
-            {
-                desc = descriptors.rowRange(offset, offset + nkeypoints);
-            }
-
-            offset += nkeypoints;
-            // preprocess the resized image
-            Mat& workingMat = imagePyramid[level];
-            //boxFilter(working_mat, working_mat, working_mat.depth(), Size(5,5), Point(-1,-1), true, BORDER_REFLECT_101);
-            GaussianBlur(workingMat, workingMat, Size(7, 7), 2, 2, BORDER_REFLECT_101);
-            computeDescriptors(workingMat, keypoints, desc, pattern, descriptorSize(), WTA_K);
-        }
 
         // Copy to the output data
         if (level != firstLevel)
@@ -933,6 +1137,13 @@ void ORB::operator()( InputArray _image, InputArray _mask, std::vector<KeyPoint>
         // And add the keypoints to the output
         _keypoints.insert(_keypoints.end(), keypoints.begin(), keypoints.end());
     }
+
+    AutoLock lock(pyramidBuffers->mutex);
+    if( pyramidBuffers->image.empty() )
+    {
+        std::swap(imageBuf, pyramidBuffers->image);
+        std::swap(maskBuf, pyramidBuffers->mask);
+    }
 }
 
 void ORB::detectImpl( const Mat& image, std::vector<KeyPoint>& keypoints, const Mat& mask) const
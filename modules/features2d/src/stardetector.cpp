@@ -426,6 +426,11 @@ StarDetector::StarDetector(int _maxSize, int _responseThreshold,
 {}
 
 
+bool StarDetector::isThreadSafe() const
+{
+    return true;
+}
+
 void StarDetector::detectImpl( const Mat& image, std::vector<KeyPoint>& keypoints, const Mat& mask ) const
 {
     Mat grayImage = image;
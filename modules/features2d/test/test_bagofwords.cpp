@@ -0,0 +1,162 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+// Copyright (C) 2009, Willow Garage Inc., all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "test_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+
+// Descriptors scattered tightly around a few distant centers, split into several "images".
+static void makeClusteredDescriptors( const Mat& trueCenters, int imageCount, int rowsPerImage, vector<Mat>& descriptors )
+{
+    RNG& rng = theRNG();
+    descriptors.resize(imageCount);
+    for( int i = 0; i < imageCount; i++ )
+    {
+        Mat& desc = descriptors[i];
+        desc.create( rowsPerImage, trueCenters.cols, CV_32F );
+        rng.fill( desc, RNG::NORMAL, 0, 0.1 );
+        for( int j = 0; j < rowsPerImage; j++ )
+            desc.row(j) += trueCenters.row(rng.uniform(0, trueCenters.rows));
+    }
+}
+
+static double maxDistanceToVocabulary( const Mat& trueCenters, const Mat& vocabulary )
+{
+    double maxDist = 0;
+    for( int i = 0; i < trueCenters.rows; i++ )
+    {
+        double minDist = DBL_MAX;
+        for( int k = 0; k < vocabulary.rows; k++ )
+            minDist = std::min( minDist, norm(trueCenters.row(i), vocabulary.row(k), NORM_L2) );
+        maxDist = std::max( maxDist, minDist );
+    }
+    return maxDist;
+}
+
+TEST(Features2d_BOWMiniBatchKMeansTrainer, findsClusters)
+{
+    const int clusterCount = 5, dims = 16;
+    Mat trueCenters( clusterCount, dims, CV_32F );
+    for( int i = 0; i < clusterCount; i++ )
+    {
+        trueCenters.row(i).setTo(Scalar::all(0));
+        trueCenters.at<float>(i, i) = 10.f;
+    }
+
+    vector<Mat> descriptors;
+    makeClusteredDescriptors( trueCenters, 20, 200, descriptors );
+
+    BOWMiniBatchKMeansTrainer trainer( clusterCount, 200 );
+    for( size_t i = 0; i < descriptors.size(); i++ )
+        trainer.add( descriptors[i] );
+
+    Mat vocabulary = trainer.cluster();
+    ASSERT_EQ( clusterCount, vocabulary.rows );
+    ASSERT_EQ( dims, vocabulary.cols );
+    EXPECT_LT( maxDistanceToVocabulary(trueCenters, vocabulary), 0.5 );
+
+    // streamed descriptors are not kept by the trainer
+    BOWMiniBatchKMeansTrainer streamingTrainer( clusterCount, 200 );
+    EXPECT_TRUE( streamingTrainer.getVocabulary().empty() );
+    for( size_t i = 0; i < descriptors.size(); i++ )
+        streamingTrainer.update( descriptors[i] );
+    EXPECT_EQ( 0, streamingTrainer.descripotorsCount() );
+
+    vocabulary = streamingTrainer.getVocabulary();
+    ASSERT_EQ( clusterCount, vocabulary.rows );
+    EXPECT_LT( maxDistanceToVocabulary(trueCenters, vocabulary), 0.5 );
+}
+
+TEST(Features2d_BOWImgDescriptorExtractor, batchMatchesSingleImage)
+{
+    Mat vocabulary( 50, 32, CV_32F );
+    randu( vocabulary, 0, 1 );
+
+    vector<Mat> descriptors( 8 );
+    for( size_t i = 0; i < descriptors.size(); i++ )
+    {
+        if( i == 3 )
+            continue; // an image without keypoints
+        descriptors[i].create( 100 + 20*(int)i, vocabulary.cols, CV_32F );
+        randu( descriptors[i], 0, 1 );
+    }
+
+    Ptr<DescriptorMatcher> matchers[] =
+    {
+        makePtr<BFMatcher>((int)NORM_L2),
+        makePtr<FlannBasedMatcher>(makePtr<flann::KDTreeIndexParams>(1),
+                                   makePtr<flann::SearchParams>((int)cvflann::FLANN_CHECKS_UNLIMITED))
+    };
+
+    for( size_t m = 0; m < sizeof(matchers)/sizeof(matchers[0]); m++ )
+    {
+        BOWImgDescriptorExtractor bow( Ptr<DescriptorExtractor>(), matchers[m] );
+        bow.setVocabulary( vocabulary );
+
+        vector<Mat> imgDescriptors;
+        bow.compute( descriptors, imgDescriptors );
+        ASSERT_EQ( descriptors.size(), imgDescriptors.size() );
+
+        for( size_t i = 0; i < descriptors.size(); i++ )
+        {
+            Mat expected;
+            vector<vector<int> > pointIdxsOfClusters;
+            bow.compute( descriptors[i], expected, &pointIdxsOfClusters );
+            if( descriptors[i].empty() )
+            {
+                EXPECT_TRUE( expected.empty() );
+                EXPECT_TRUE( imgDescriptors[i].empty() );
+                continue;
+            }
+
+            ASSERT_EQ( bow.descriptorSize(), imgDescriptors[i].cols );
+            EXPECT_EQ( 0, norm(expected, imgDescriptors[i], NORM_INF) ) << "matcher " << m << ", image " << i;
+            EXPECT_NEAR( 1., sum(imgDescriptors[i])[0], 1e-5 );
+
+            size_t assigned = 0;
+            for( size_t k = 0; k < pointIdxsOfClusters.size(); k++ )
+                assigned += pointIdxsOfClusters[k].size();
+            EXPECT_EQ( (size_t)descriptors[i].rows, assigned );
+        }
+    }
+}
@@ -93,3 +93,28 @@ void CV_BRISKTest::run( int )
 }
 
 TEST(Features2d_BRISK, regression) { CV_BRISKTest test; test.safe_run(); }
+
+TEST(Features2d_BRISK, descriptorsDoNotDependOnOtherKeypoints)
+{
+  RNG rng(0x4321);
+  Mat small(48, 64, CV_8UC1), image;
+  rng.fill(small, RNG::UNIFORM, 0, 256);
+  resize(small, image, Size(640, 480), 0, 0, INTER_LINEAR);
+
+  BRISK brisk(20, 3);
+  vector<KeyPoint> keypoints;
+  Mat descriptors;
+  brisk(image, noArray(), keypoints, descriptors);
+  ASSERT_GT((int)keypoints.size(), 100);
+  ASSERT_EQ((int)keypoints.size(), descriptors.rows);
+
+  // the descriptors are computed by chunks of keypoints, every one must be the same as computed alone
+  for (size_t i = 0; i < keypoints.size(); i += 7)
+  {
+    vector<KeyPoint> single(1, keypoints[i]);
+    Mat descriptor;
+    brisk.compute(image, single, descriptor);
+    ASSERT_EQ(1, descriptor.rows);
+    ASSERT_EQ(0, norm(descriptor, descriptors.row((int)i), NORM_HAMMING)) << "keypoint " << i;
+  }
+}
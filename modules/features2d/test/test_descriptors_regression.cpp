@@ -341,3 +341,82 @@ TEST( Features2d_DescriptorExtractor_OpponentBRIEF, regression )
                                                DescriptorExtractor::create("OpponentBRIEF") );
     test.safe_run();
 }
+
+static Mat makeDescriptorsTestImage( int type )
+{
+    Mat image( 240, 320, type, Scalar::all(0) );
+    RNG rng( 12345 );
+    for( int i = 0; i < 60; i++ )
+    {
+        Point center( rng.uniform(0, image.cols), rng.uniform(0, image.rows) );
+        rectangle( image, center, center + Point(rng.uniform(5, 40), rng.uniform(5, 40)),
+                   Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256)), -1 );
+    }
+    return image;
+}
+
+TEST( Features2d_DescriptorExtractor_BRIEF, precomputedIntegral )
+{
+    Mat image = makeDescriptorsTestImage( CV_8UC1 );
+    vector<KeyPoint> keypoints;
+    FastFeatureDetector( 10 ).detect( image, keypoints );
+    ASSERT_FALSE( keypoints.empty() );
+
+    BriefDescriptorExtractor brief( 32 );
+    vector<KeyPoint> keypoints1 = keypoints, keypoints2 = keypoints;
+    Mat descriptors1, descriptors2, sum;
+    brief.compute( image, keypoints1, descriptors1 );
+
+    integral( image, sum, CV_32S );
+    brief.compute( sum, keypoints2, descriptors2 );
+
+    ASSERT_EQ( keypoints1.size(), keypoints2.size() );
+    ASSERT_FALSE( descriptors1.empty() );
+    EXPECT_EQ( 0, norm(descriptors1, descriptors2, NORM_INF) );
+}
+
+TEST( Features2d_DescriptorExtractor, collectionMatchesSingleImage )
+{
+    const char* names[] = { "BRIEF", "FREAK", "ORB", "BRISK", "OpponentBRIEF" };
+    Mat gray = makeDescriptorsTestImage( CV_8UC1 ), color = makeDescriptorsTestImage( CV_8UC3 );
+
+    for( size_t n = 0; n < sizeof(names)/sizeof(names[0]); n++ )
+    {
+        Ptr<DescriptorExtractor> extractor = DescriptorExtractor::create( names[n] );
+        ASSERT_FALSE( extractor.empty() );
+        const Mat& image = String(names[n]).find("Opponent") == 0 ? color : gray;
+
+        vector<Mat> images;
+        vector<vector<KeyPoint> > keypoints;
+        for( int i = 0; i < 4; i++ )
+        {
+            Mat img;
+            if( i == 0 )
+                img = image;
+            else
+                flip( image, img, i - 2 );
+            images.push_back( img );
+            keypoints.push_back( vector<KeyPoint>() );
+            FastFeatureDetector( 10 ).detect( img, keypoints.back() );
+            for( size_t k = 0; k < keypoints.back().size(); k++ )
+                keypoints.back()[k].size = 20.f;
+        }
+
+        vector<vector<KeyPoint> > batchKeypoints = keypoints;
+        vector<Mat> batchDescriptors;
+        extractor->compute( images, batchKeypoints, batchDescriptors );
+        ASSERT_EQ( images.size(), batchDescriptors.size() );
+
+        for( size_t i = 0; i < images.size(); i++ )
+        {
+            Mat descriptors;
+            extractor->compute( images[i], keypoints[i], descriptors );
+            ASSERT_EQ( keypoints[i].size(), batchKeypoints[i].size() ) << names[n];
+            ASSERT_EQ( descriptors.size(), batchDescriptors[i].size() ) << names[n];
+            if( !descriptors.empty() )
+            {
+                EXPECT_EQ( 0, norm(descriptors, batchDescriptors[i], NORM_INF) ) << names[n];
+            }
+        }
+    }
+}
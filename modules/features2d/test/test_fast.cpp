@@ -135,3 +135,36 @@ void CV_FastTest::run( int )
 }
 
 TEST(Features2d_FAST, regression) { CV_FastTest test; test.safe_run(); }
+
+TEST(Features2d_FAST, sameResultsWithAndWithoutOptimization)
+{
+    RNG rng(0x1234);
+    Mat small(60, 80, CV_8UC1), image, noise(483, 641, CV_8UC1);
+    rng.fill(small, RNG::UNIFORM, 0, 256);
+    resize(small, image, noise.size(), 0, 0, INTER_NEAREST);
+    rng.fill(noise, RNG::UNIFORM, 0, 24);
+    image += noise;
+
+    bool useOpt = useOptimized();
+    for( int type = 0; type <= 2; type++ )
+        for( int nonmax = 0; nonmax <= 1; nonmax++ )
+        {
+            vector<KeyPoint> keypoints0, keypoints1;
+            setUseOptimized(false);
+            FAST(image, keypoints0, 20, nonmax != 0, type);
+            setUseOptimized(true);
+            FAST(image, keypoints1, 20, nonmax != 0, type);
+
+            if( type == FastFeatureDetector::TYPE_9_16 )
+            {
+                ASSERT_FALSE(keypoints0.empty());
+            }
+            ASSERT_EQ(keypoints0.size(), keypoints1.size());
+            for( size_t i = 0; i < keypoints0.size(); i++ )
+            {
+                ASSERT_EQ(keypoints0[i].pt, keypoints1[i].pt);
+                ASSERT_EQ(keypoints0[i].response, keypoints1[i].response);
+            }
+        }
+    setUseOptimized(useOpt);
+}
@@ -166,3 +166,102 @@ TEST(Features2d_Detector_Keypoints_Dense, validation)
     CV_FeatureDetectorKeypointsTest test(Algorithm::create<FeatureDetector>("Feature2D.Dense"));
     test.safe_run();
 }
+
+/****************************************************************************************\
+*                          Tests for the grid and pyramid adapters                       *
+\****************************************************************************************/
+
+// Forwards to FAST, but does not claim to be thread-safe, so the adapters take the serial path
+class SerialFastDetector : public FeatureDetector
+{
+protected:
+    void detectImpl( const Mat& image, vector<KeyPoint>& keypoints, const Mat& mask ) const
+    {
+        FastFeatureDetector(20).detect( image, keypoints, mask );
+    }
+};
+
+static Mat makeHalfTexturedImage()
+{
+    // corners on the left half only
+    Mat image( 480, 640, CV_8U, Scalar::all(0) );
+    Mat left = image.colRange( 0, image.cols/2 );
+    randu( left, Scalar::all(0), Scalar::all(256) );
+    return image;
+}
+
+static bool sameKeypoints( const vector<KeyPoint>& a, const vector<KeyPoint>& b )
+{
+    if( a.size() != b.size() )
+        return false;
+    for( size_t i = 0; i < a.size(); i++ )
+        if( a[i].pt != b[i].pt || a[i].response != b[i].response || a[i].size != b[i].size || a[i].octave != b[i].octave )
+            return false;
+    return true;
+}
+
+TEST(Features2d_GridAdaptedFeatureDetector, fillsBudgetLeftBySparseCells)
+{
+    Mat image = makeHalfTexturedImage();
+    const int maxTotal = 400, gridRows = 2, gridCols = 2;
+
+    Ptr<FeatureDetector> fast = makePtr<FastFeatureDetector>(20);
+    GridAdaptedFeatureDetector grid( fast, maxTotal, gridRows, gridCols );
+    EXPECT_TRUE( grid.isThreadSafe() );
+
+    vector<KeyPoint> keypoints;
+    grid.detect( image, keypoints );
+    ASSERT_EQ( maxTotal, (int)keypoints.size() );
+
+    // every textured cell gets at least its quota, the blank ones nothing
+    int cellCount[gridRows*gridCols] = {0};
+    for( size_t i = 0; i < keypoints.size(); i++ )
+    {
+        int cx = (int)keypoints[i].pt.x * gridCols / image.cols;
+        int cy = (int)keypoints[i].pt.y * gridRows / image.rows;
+        cellCount[cy*gridCols + cx]++;
+    }
+    for( int cy = 0; cy < gridRows; cy++ )
+    {
+        EXPECT_LE( maxTotal/(gridRows*gridCols), cellCount[cy*gridCols] );
+        EXPECT_EQ( 0, cellCount[cy*gridCols + 1] );
+    }
+
+    vector<KeyPoint> serialKeypoints;
+    GridAdaptedFeatureDetector( makePtr<SerialFastDetector>(), maxTotal, gridRows, gridCols ).detect( image, serialKeypoints );
+    EXPECT_TRUE( sameKeypoints(keypoints, serialKeypoints) );
+}
+
+TEST(Features2d_PyramidAdaptedFeatureDetector, matchesLevelByLevelDetection)
+{
+    Mat image = makeHalfTexturedImage();
+    GaussianBlur( image, image, Size(3, 3), 0 );
+    const int maxLevel = 2;
+
+    Ptr<FeatureDetector> fast = makePtr<FastFeatureDetector>(20);
+    vector<KeyPoint> keypoints;
+    PyramidAdaptedFeatureDetector( fast, maxLevel ).detect( image, keypoints );
+
+    vector<KeyPoint> expected;
+    Mat level = image;
+    for( int l = 0; l <= maxLevel; l++ )
+    {
+        vector<KeyPoint> levelKeypoints;
+        fast->detect( level, levelKeypoints );
+        for( size_t i = 0; i < levelKeypoints.size(); i++ )
+        {
+            KeyPoint kp = levelKeypoints[i];
+            kp.pt *= (float)(1 << l);
+            kp.size *= (float)(1 << l);
+            kp.octave = l;
+            expected.push_back( kp );
+        }
+        pyrDown( level, level );
+    }
+    ASSERT_FALSE( expected.empty() );
+    EXPECT_TRUE( sameKeypoints(expected, keypoints) );
+
+    vector<KeyPoint> serialKeypoints;
+    PyramidAdaptedFeatureDetector( makePtr<SerialFastDetector>(), maxLevel ).detect( image, serialKeypoints );
+    EXPECT_TRUE( sameKeypoints(keypoints, serialKeypoints) );
+}
@@ -541,3 +541,174 @@ TEST( Features2d_DescriptorMatcher_FlannBased, regression )
     CV_DescriptorMatcherTest test( "descriptor-matcher-flann-based", Algorithm::create<DescriptorMatcher>("DescriptorMatcher.FlannBasedMatcher"), 0.04f );
     test.safe_run();
 }
+
+static void bruteForceKnnReference( const Mat& query, const std::vector<Mat>& train, int normType, int k,
+                                    std::vector<std::vector<DMatch> >& matches )
+{
+    matches.resize(query.rows);
+    for( int qIdx = 0; qIdx < query.rows; qIdx++ )
+    {
+        std::vector<DMatch> all;
+        for( int iIdx = 0; iIdx < (int)train.size(); iIdx++ )
+            for( int tIdx = 0; tIdx < train[iIdx].rows; tIdx++ )
+                all.push_back( DMatch(qIdx, tIdx, iIdx, (float)norm(query.row(qIdx), train[iIdx].row(tIdx), normType)) );
+        // the first match of equal distances is kept, as in the matcher
+        std::stable_sort( all.begin(), all.end() );
+        matches[qIdx].assign( all.begin(), all.begin() + std::min(k, (int)all.size()) );
+    }
+}
+
+TEST( Features2d_BFMatcher, knnMatchCollection )
+{
+    RNG& rng = theRNG();
+    const int k = 3;
+
+    for( int normIdx = 0; normIdx < 3; normIdx++ )
+    {
+        int normType = normIdx == 0 ? NORM_HAMMING : normIdx == 1 ? NORM_L2 : NORM_L1;
+        int type = normType == NORM_HAMMING ? CV_8U : CV_32F;
+        // the train sets are larger than the block of train descriptors matched at once
+        int cols = normType == NORM_HAMMING ? 32 : 64;
+        int trainRows = normType == NORM_HAMMING ? 3000 : 700;
+
+        Mat query(50, cols, type);
+        std::vector<Mat> train(2);
+        train[0].create(trainRows, cols, type);
+        train[1].create(trainRows / 2, cols, type);
+        if( type == CV_8U )
+        {
+            rng.fill(query, RNG::UNIFORM, 0, 256);
+            rng.fill(train[0], RNG::UNIFORM, 0, 256);
+            rng.fill(train[1], RNG::UNIFORM, 0, 256);
+        }
+        else
+        {
+            rng.fill(query, RNG::UNIFORM, 0, 1);
+            rng.fill(train[0], RNG::UNIFORM, 0, 1);
+            rng.fill(train[1], RNG::UNIFORM, 0, 1);
+        }
+
+        BFMatcher matcher(normType);
+        matcher.add(train);
+
+        Mat trainIdx, imgIdx, distance;
+        matcher.knnMatchCollection(query, trainIdx, imgIdx, distance, k);
+        ASSERT_EQ(query.rows, trainIdx.rows);
+        ASSERT_EQ(k, trainIdx.cols);
+
+        std::vector<std::vector<DMatch> > matches, converted, expected;
+        matcher.knnMatch(query, matches, k);
+        BFMatcher::knnMatchConvert(trainIdx, imgIdx, distance, converted);
+        bruteForceKnnReference(query, train, normType, k, expected);
+
+        ASSERT_EQ(expected.size(), matches.size());
+        ASSERT_EQ(expected.size(), converted.size());
+        for( size_t i = 0; i < expected.size(); i++ )
+        {
+            ASSERT_EQ(expected[i].size(), matches[i].size());
+            ASSERT_EQ(expected[i].size(), converted[i].size());
+            for( size_t j = 0; j < expected[i].size(); j++ )
+            {
+                EXPECT_EQ(expected[i][j].trainIdx, matches[i][j].trainIdx) << "norm " << normType;
+                EXPECT_EQ(expected[i][j].imgIdx, matches[i][j].imgIdx) << "norm " << normType;
+                EXPECT_NEAR(expected[i][j].distance, matches[i][j].distance, 1e-3);
+                EXPECT_EQ(matches[i][j].trainIdx, converted[i][j].trainIdx);
+                EXPECT_EQ(matches[i][j].imgIdx, converted[i][j].imgIdx);
+                EXPECT_EQ(matches[i][j].distance, converted[i][j].distance);
+            }
+        }
+    }
+}
+
+static void checkSelfMatches( DescriptorMatcher& matcher, const std::vector<Mat>& train )
+{
+    for( size_t i = 0; i < train.size(); i++ )
+    {
+        std::vector<DMatch> matches;
+        matcher.match( train[i], matches );
+        ASSERT_EQ( (size_t)train[i].rows, matches.size() );
+        for( size_t j = 0; j < matches.size(); j++ )
+        {
+            EXPECT_EQ( 0.f, matches[j].distance );
+            if( matches[j].distance == 0.f )
+            {
+                EXPECT_EQ( 0, norm(train[i].row((int)j), train[matches[j].imgIdx].row(matches[j].trainIdx), NORM_L1) );
+            }
+        }
+    }
+}
+
+TEST( Features2d_FlannBasedMatcher, incrementalAdd )
+{
+    RNG rng( 17 );
+    std::vector<Mat> train( 6 ), binaryTrain( 6 );
+    for( size_t i = 0; i < train.size(); i++ )
+    {
+        train[i].create( 300 + 50*(int)i, 16, CV_32F );
+        rng.fill( train[i], RNG::UNIFORM, 0, 1 );
+        binaryTrain[i].create( 300 + 50*(int)i, 32, CV_8U );
+        rng.fill( binaryTrain[i], RNG::UNIFORM, 0, 256 );
+    }
+    Mat query( 100, 16, CV_32F );
+    rng.fill( query, RNG::UNIFORM, 0, 1 );
+
+    // a single kd-tree searched exhaustively finds the exact nearest neighbours
+    FlannBasedMatcher exactMatcher( makePtr<flann::KDTreeIndexParams>(1),
+                                    makePtr<flann::SearchParams>((int)cvflann::FLANN_CHECKS_UNLIMITED) );
+    BFMatcher bfMatcher( NORM_L2 );
+    for( size_t i = 0; i < train.size(); i++ )
+    {
+        exactMatcher.add( std::vector<Mat>(1, train[i]) );
+        exactMatcher.train();
+        bfMatcher.add( std::vector<Mat>(1, train[i]) );
+
+        std::vector<DMatch> matches, expected;
+        exactMatcher.match( query, matches );
+        bfMatcher.match( query, expected );
+        ASSERT_EQ( expected.size(), matches.size() );
+        for( size_t j = 0; j < matches.size(); j++ )
+        {
+            EXPECT_EQ( expected[j].imgIdx, matches[j].imgIdx );
+            EXPECT_EQ( expected[j].trainIdx, matches[j].trainIdx );
+            EXPECT_NEAR( expected[j].distance, matches[j].distance, 1e-4 );
+        }
+    }
+
+    FlannBasedMatcher kdtreeMatcher( makePtr<flann::KDTreeIndexParams>(4), makePtr<flann::SearchParams>(64) );
+    FlannBasedMatcher hierarchicalMatcher( makePtr<flann::HierarchicalClusteringIndexParams>(8, cvflann::FLANN_CENTERS_RANDOM, 2, 50),
+                                           makePtr<flann::SearchParams>(64) );
+    FlannBasedMatcher lshMatcher( makePtr<flann::LshIndexParams>(8, 12, 0) );
+    for( size_t i = 0; i < train.size(); i += 2 )
+    {
+        std::vector<Mat> batch( train.begin() + i, train.begin() + i + 2 );
+        std::vector<Mat> binaryBatch( binaryTrain.begin() + i, binaryTrain.begin() + i + 2 );
+        kdtreeMatcher.add( batch );
+        hierarchicalMatcher.add( batch );
+        lshMatcher.add( binaryBatch );
+        kdtreeMatcher.train();
+        hierarchicalMatcher.train();
+        lshMatcher.train();
+    }
+    checkSelfMatches( kdtreeMatcher, train );
+    checkSelfMatches( hierarchicalMatcher, train );
+    checkSelfMatches( lshMatcher, binaryTrain );
+
+    // the saved index is reloaded for the same descriptors without training
+    string filename = tempfile( ".flann" );
+    hierarchicalMatcher.saveIndex( filename );
+    FlannBasedMatcher loadedMatcher( makePtr<flann::HierarchicalClusteringIndexParams>(8, cvflann::FLANN_CENTERS_RANDOM, 2, 50),
+                                     makePtr<flann::SearchParams>(64) );
+    loadedMatcher.add( train );
+    ASSERT_TRUE( loadedMatcher.loadIndex( filename ) );
+    std::vector<DMatch> loadedMatches, matches;
+    loadedMatcher.match( query, loadedMatches );
+    hierarchicalMatcher.match( query, matches );
+    ASSERT_EQ( matches.size(), loadedMatches.size() );
+    for( size_t j = 0; j < matches.size(); j++ )
+    {
+        EXPECT_EQ( matches[j].imgIdx, loadedMatches[j].imgIdx );
+        EXPECT_EQ( matches[j].trainIdx, loadedMatches[j].trainIdx );
+    }
+    checkSelfMatches( loadedMatcher, train );
+    remove( filename.c_str() );
+}
@@ -205,3 +205,30 @@ void CV_MserTest::run(int)
 }
 
 TEST(Features2d_MSER, DISABLED_regression) { CV_MserTest test; test.safe_run(); }
+
+TEST(Features2d_MSER, keptBuffersDoNotAffectResults)
+{
+    RNG rng(0x7777);
+    Mat small(12, 16, CV_8UC1), image0, image1;
+    rng.fill(small, RNG::UNIFORM, 0, 256);
+    resize(small, image0, Size(320, 240), 0, 0, INTER_LINEAR);
+    resize(small, image1, Size(160, 200), 0, 0, INTER_NEAREST);
+    Mat copy0 = image0.clone();
+
+    MSER mser(5, 30, 5000);
+    vector<vector<Point> > regions0, regions1, regions;
+    mser(image0, regions0);
+    EXPECT_EQ(0, norm(image0, copy0, NORM_INF));
+    mser(image1, regions1);
+    ASSERT_FALSE(regions0.empty());
+    ASSERT_FALSE(regions1.empty());
+
+    // the buffers left by the previous calls must not affect the results
+    for ( int iter = 0; iter < 2; iter++ )
+    {
+        mser(image0, regions);
+        EXPECT_TRUE(regions == regions0);
+        mser(image1, regions);
+        EXPECT_TRUE(regions == regions1);
+    }
+}
@@ -297,7 +297,7 @@ int CV_FlannTest::radiusSearch( Mat& points, Mat& neighbors )
     float radius = 10.0f;
     int j;
 
-    // radiusSearch can only search one feature at a time for range search
+    // search the features one by one, see Features2d_FLANN.batchSearchMatchesSingleQueries for batches
     for( int i = 0; i < points.rows; i++ )
     {
         // 1st way
@@ -411,3 +411,285 @@ TEST(Features2d_FLANN_KDTree, regression) { CV_FlannKDTreeIndexTest test; test.s
 TEST(Features2d_FLANN_Composite, regression) { CV_FlannCompositeIndexTest test; test.safe_run(); }
 TEST(Features2d_FLANN_Auto, regression) { CV_FlannAutotunedIndexTest test; test.safe_run(); }
 TEST(Features2d_FLANN_Saved, regression) { CV_FlannSavedIndexTest test; test.safe_run(); }
+
+// The rows of a batch are searched in parallel; each of them must get exactly the result of a
+// search for that row alone, whichever index type is used.
+TEST(Features2d_FLANN, batchSearchMatchesSingleQueries)
+{
+    const int knn = 5;
+    Mat data( 2000, 16, CV_32F ), queries( 300, 16, CV_32F );
+    randu( data, 0, 100 );
+    randu( queries, 0, 100 );
+
+    Mat binaryData( 2000, 32, CV_8U ), binaryQueries( 300, 32, CV_8U );
+    randu( binaryData, 0, 256 );
+    randu( binaryQueries, 0, 256 );
+
+    Ptr<IndexParams> params[] =
+    {
+        makePtr<KDTreeIndexParams>(4),
+        makePtr<KMeansIndexParams>(),
+        makePtr<HierarchicalClusteringIndexParams>(),
+        makePtr<LshIndexParams>(8, 16, 2)
+    };
+
+    for( size_t p = 0; p < sizeof(params)/sizeof(params[0]); p++ )
+    {
+        bool binary = p == 3;
+        const Mat& d = binary ? binaryData : data;
+        const Mat& q = binary ? binaryQueries : queries;
+        Index index( d, *params[p], binary ? cvflann::FLANN_DIST_HAMMING : cvflann::FLANN_DIST_L2 );
+
+        Mat indices, dists;
+        index.knnSearch( q, indices, dists, knn, SearchParams(64) );
+        ASSERT_EQ( q.rows, indices.rows );
+
+        for( int i = 0; i < q.rows; i++ )
+        {
+            Mat rowIndices, rowDists;
+            index.knnSearch( q.row(i), rowIndices, rowDists, knn, SearchParams(64) );
+            ASSERT_EQ( 0, norm(rowIndices, indices.row(i), NORM_INF) ) << "index " << p << ", query " << i;
+            ASSERT_EQ( 0, norm(rowDists, dists.row(i), NORM_INF) ) << "index " << p << ", query " << i;
+        }
+
+        if( binary )
+            continue; // no radius search with LSH
+
+        const int maxResults = 20;
+        const double radius = 12000; // squared L2 distance
+        Mat radiusIndices( q.rows, maxResults, CV_32S, Scalar::all(-1) ), radiusDists( q.rows, maxResults, CV_32F, Scalar::all(-1) );
+        int total = index.radiusSearch( q, radiusIndices, radiusDists, radius, maxResults, SearchParams(64) );
+
+        int expectedTotal = 0;
+        for( int i = 0; i < q.rows; i++ )
+        {
+            Mat rowIndices( 1, maxResults, CV_32S, Scalar::all(-1) ), rowDists( 1, maxResults, CV_32F, Scalar::all(-1) );
+            expectedTotal += index.radiusSearch( q.row(i), rowIndices, rowDists, radius, maxResults, SearchParams(64) );
+            ASSERT_EQ( 0, norm(rowIndices, radiusIndices.row(i), NORM_INF) ) << "index " << p << ", query " << i;
+            ASSERT_EQ( 0, norm(rowDists, radiusDists.row(i), NORM_INF) ) << "index " << p << ", query " << i;
+        }
+        EXPECT_EQ( expectedTotal, total );
+        EXPECT_GT( total, 0 );
+    }
+}
+
+// An index saved together with its dataset is loaded without the dataset being passed back in;
+// the searches must then give the same results as on the original index.
+TEST(Features2d_FLANN, savedDatasetIsMappedOnLoad)
+{
+    const int knn = 5;
+    Mat data( 3000, 24, CV_32F ), queries( 200, 24, CV_32F );
+    randu( data, 0, 100 );
+    randu( queries, 0, 100 );
+
+    Mat binaryData( 3000, 32, CV_8U ), binaryQueries( 200, 32, CV_8U );
+    randu( binaryData, 0, 256 );
+    randu( binaryQueries, 0, 256 );
+
+    Ptr<IndexParams> params[] =
+    {
+        makePtr<KDTreeIndexParams>(4),
+        makePtr<KMeansIndexParams>(),
+        makePtr<HierarchicalClusteringIndexParams>()
+    };
+
+    for( size_t p = 0; p < sizeof(params)/sizeof(params[0]); p++ )
+    {
+        bool binary = p == 2; // no LSH: it draws new random hash tables on load
+        const Mat& d = binary ? binaryData : data;
+        const Mat& q = binary ? binaryQueries : queries;
+        cvflann::flann_distance_t distType = binary ? cvflann::FLANN_DIST_HAMMING : cvflann::FLANN_DIST_L2;
+        Index index( d, *params[p], distType );
+
+        string filename = tempfile();
+        index.save( filename, d );
+
+        Index mapped;
+        ASSERT_TRUE( mapped.load( filename ) ) << "index " << p;
+        EXPECT_EQ( distType, mapped.getDistance() );
+
+        // a file with the dataset can still be loaded over a dataset that is passed in
+        Index loaded;
+        ASSERT_TRUE( loaded.load( d, filename ) ) << "index " << p;
+
+        Mat indices, dists, mappedIndices, mappedDists, loadedIndices, loadedDists;
+        index.knnSearch( q, indices, dists, knn, SearchParams(64) );
+        mapped.knnSearch( q, mappedIndices, mappedDists, knn, SearchParams(64) );
+        loaded.knnSearch( q, loadedIndices, loadedDists, knn, SearchParams(64) );
+
+        EXPECT_EQ( 0, norm(indices, mappedIndices, NORM_INF) ) << "index " << p;
+        EXPECT_EQ( 0, norm(dists, mappedDists, NORM_INF) ) << "index " << p;
+        EXPECT_EQ( 0, norm(indices, loadedIndices, NORM_INF) ) << "index " << p;
+        EXPECT_EQ( 0, norm(dists, loadedDists, NORM_INF) ) << "index " << p;
+
+        mapped.release();
+        loaded.release();
+        remove( filename.c_str() );
+
+        // a file without the dataset can not be loaded on its own
+        index.save( filename );
+        EXPECT_FALSE( mapped.load( filename ) ) << "index " << p;
+        remove( filename.c_str() );
+    }
+}
+
+// The trees are built by parallel tasks with their own random seeds, so given the state of
+// the random generator, the index must not depend on the number of threads.
+TEST(Features2d_FLANN, parallelBuildDoesNotDependOnThreads)
+{
+    const int knn = 5;
+    Mat data( 20000, 16, CV_32F ), queries( 200, 16, CV_32F );
+    randu( data, 0, 100 );
+    randu( queries, 0, 100 );
+
+    Ptr<IndexParams> params[] =
+    {
+        makePtr<KDTreeIndexParams>(4),
+        makePtr<KMeansIndexParams>(16, 5),
+        makePtr<HierarchicalClusteringIndexParams>(16)
+    };
+
+    const int parallelThreads = 4;
+    int threads = getNumThreads();
+    setNumThreads( parallelThreads );
+    if( getNumThreads() < 2 )
+    {
+        setNumThreads( threads );
+        printf( "There is no parallel backend, the test is skipped\n" );
+        return;
+    }
+
+    for( size_t p = 0; p < sizeof(params)/sizeof(params[0]); p++ )
+    {
+        Mat indices[2], dists[2];
+        for( int k = 0; k < 2; k++ )
+        {
+            setNumThreads( k == 0 ? 1 : parallelThreads );
+            theRNG() = RNG(12345);
+            Index index( data, *params[p] );
+            index.knnSearch( queries, indices[k], dists[k], knn, SearchParams(32) );
+        }
+        setNumThreads( threads );
+
+        EXPECT_EQ( 0, norm(indices[0], indices[1], NORM_INF) ) << "index " << p;
+        EXPECT_EQ( 0, norm(dists[0], dists[1], NORM_INF) ) << "index " << p;
+    }
+}
+
+// Flattening the kd-trees only changes where the nodes are stored, so the searches must give
+// exactly the results of the pointer-linked trees, also after adding points or a save and load.
+TEST(Features2d_FLANN, compactKDTreeMatchesPointerTrees)
+{
+    const int knn = 5;
+    Mat data( 6000, 16, CV_32F ), queries( 200, 16, CV_32F );
+    randu( data, 0, 100 );
+    randu( queries, 0, 100 );
+    Mat initial = data.rowRange( 0, 5000 );
+
+    KDTreeIndexParams compactParams( 4 ), pointerParams( 4 );
+    pointerParams.setBool( "compact", false );
+
+    theRNG() = RNG(7);
+    Index compact( initial, compactParams );
+    theRNG() = RNG(7);
+    Index pointer( initial, pointerParams );
+
+    for( int stage = 0; stage < 3; stage++ )
+    {
+        if( stage == 1 )
+        {
+            compact.addPoints( data, 0 );
+            pointer.addPoints( data, 0 );
+        }
+        else if( stage == 2 )
+        {
+            string filename = tempfile();
+            pointer.save( filename );
+            ASSERT_TRUE( compact.load( data, filename ) );
+            remove( filename.c_str() );
+        }
+
+        Mat indices[2], dists[2];
+        compact.knnSearch( queries, indices[0], dists[0], knn, SearchParams(64) );
+        pointer.knnSearch( queries, indices[1], dists[1], knn, SearchParams(64) );
+        EXPECT_EQ( 0, norm(indices[0], indices[1], NORM_INF) ) << "stage " << stage;
+        EXPECT_EQ( 0, norm(dists[0], dists[1], NORM_INF) ) << "stage " << stage;
+    }
+}
+
+// Every query is a dataset row with a little noise, in a dataset of well separated clusters,
+// so its row must be found among its nearest neighbours in spite of the quantization.
+static double pqRecall( const Mat& indices, const std::vector<int>& rows, int knn )
+{
+    int found = 0;
+    for( int i = 0; i < indices.rows; i++ )
+        for( int j = 0; j < knn; j++ )
+            found += indices.at<int>(i, j) == rows[i];
+    return (double)found / indices.rows;
+}
+
+TEST(Features2d_FLANN, productQuantizationIndex)
+{
+    RNG& rng = theRNG();
+    rng = RNG(3);
+    Mat centers( 50, 32, CV_32F ), data( 5000, 32, CV_32F ), queries( 300, 32, CV_32F ), noise( 1, 32, CV_32F );
+    rng.fill( centers, RNG::UNIFORM, 0, 100 );
+    for( int i = 0; i < data.rows; i++ )
+    {
+        rng.fill( noise, RNG::NORMAL, 0, 5 );
+        data.row(i) = centers.row(rng.uniform(0, centers.rows)) + noise;
+    }
+    std::vector<int> rows( queries.rows );
+    for( int i = 0; i < queries.rows; i++ )
+    {
+        rows[i] = rng.uniform( 0, data.rows );
+        rng.fill( noise, RNG::NORMAL, 0, 0.5 );
+        queries.row(i) = data.row(rows[i]) + noise;
+    }
+
+    const int knn = 10, allLists = cvflann::FLANN_CHECKS_UNLIMITED;
+    Mat indices, dists;
+    Index codes( data, PQIndexParams(16, 8) );
+    codes.knnSearch( queries, indices, dists, knn, SearchParams(allLists) );
+    EXPECT_GE( pqRecall(indices, rows, knn), 0.9 );
+
+    // re-ranking returns the exact distances of the best candidates
+    Index reranked( data, PQIndexParams(16, 8, 20) );
+    reranked.knnSearch( queries, indices, dists, 1, SearchParams(allLists) );
+    EXPECT_GE( pqRecall(indices, rows, 1), 0.95 );
+    for( int i = 0; i < queries.rows; i++ )
+        ASSERT_NEAR( norm(queries.row(i), data.row(indices.at<int>(i)), NORM_L2SQR), dists.at<float>(i), 1e-2 );
+
+    // probing fewer lists still finds most rows
+    reranked.knnSearch( queries, indices, dists, 1, SearchParams(1000) );
+    EXPECT_GE( pqRecall(indices, rows, 1), 0.8 );
+
+    // the lists and codes are saved with the index
+    string filename = tempfile();
+    reranked.save( filename );
+    Index loaded;
+    ASSERT_TRUE( loaded.load( data, filename ) );
+    remove( filename.c_str() );
+    Mat loadedIndices, loadedDists;
+    reranked.knnSearch( queries, indices, dists, knn, SearchParams(64) );
+    loaded.knnSearch( queries, loadedIndices, loadedDists, knn, SearchParams(64) );
+    EXPECT_EQ( 0, norm(indices, loadedIndices, NORM_INF) );
+    EXPECT_EQ( 0, norm(dists, loadedDists, NORM_INF) );
+
+    // the appended rows are encoded with the quantizers trained on the first ones
+    Index extended( data.rowRange(0, 3000), PQIndexParams(16, 8, 20) );
+    extended.addPoints( data, 0 );
+    extended.knnSearch( queries, indices, dists, 1, SearchParams(allLists) );
+    EXPECT_GE( pqRecall(indices, rows, 1), 0.95 );
+
+    // and the index can be used by the matcher
+    FlannBasedMatcher matcher( makePtr<PQIndexParams>(16, 8, 20), makePtr<SearchParams>(allLists) );
+    matcher.add( std::vector<Mat>(1, data) );
+    std::vector<DMatch> matches;
+    matcher.match( queries, matches );
+    ASSERT_EQ( (size_t)queries.rows, matches.size() );
+    int correct = 0;
+    for( size_t i = 0; i < matches.size(); i++ )
+        correct += matches[i].trainIdx == rows[matches[i].queryIdx];
+    EXPECT_GE( correct, 0.95 * queries.rows );
+}
@@ -91,3 +91,76 @@ TEST(Features2D_ORB, _1996)
 
     ASSERT_EQ(0, roiViolations);
 }
+
+static Mat makeOrbTestImage(Size size, uint64 seed)
+{
+    RNG rng(seed);
+    Mat image(size, CV_8UC1, Scalar(128));
+    for( int i = 0; i < 300; i++ )
+    {
+        Point center(rng.uniform(0, size.width), rng.uniform(0, size.height));
+        Size axes(rng.uniform(5, 40), rng.uniform(5, 40));
+        ellipse(image, center, axes, rng.uniform(0, 180), 0, 360, Scalar(rng.uniform(0, 256)), -1);
+        rectangle(image, Rect(rng.uniform(0, size.width), rng.uniform(0, size.height), rng.uniform(5, 50), rng.uniform(5, 50)),
+                  Scalar(rng.uniform(0, 256)), -1);
+    }
+    return image;
+}
+
+TEST(Features2D_ORB, sameResultsWithAndWithoutOptimization)
+{
+    Mat image = makeOrbTestImage(Size(640, 480), 1);
+    Mat mask(image.size(), CV_8UC1, Scalar(255));
+    mask(Rect(0, 0, 200, 150)).setTo(Scalar(0));
+
+    ORB orb(1000, 1.2f, 8, 31, 0, 2, ORB::HARRIS_SCORE);
+    bool useOpt = useOptimized();
+
+    std::vector<KeyPoint> keypoints0, keypoints1;
+    Mat descriptors0, descriptors1;
+
+    setUseOptimized(false);
+    orb(image, mask, keypoints0, descriptors0);
+    setUseOptimized(true);
+    orb(image, mask, keypoints1, descriptors1);
+    setUseOptimized(useOpt);
+
+    ASSERT_FALSE(keypoints0.empty());
+    ASSERT_EQ(keypoints0.size(), keypoints1.size());
+    for( size_t i = 0; i < keypoints0.size(); i++ )
+    {
+        EXPECT_EQ(keypoints0[i].pt, keypoints1[i].pt);
+        EXPECT_EQ(keypoints0[i].angle, keypoints1[i].angle);
+        EXPECT_EQ(keypoints0[i].response, keypoints1[i].response);
+        EXPECT_EQ(keypoints0[i].octave, keypoints1[i].octave);
+    }
+    EXPECT_EQ(0, norm(descriptors0, descriptors1, NORM_INF));
+}
+
+TEST(Features2D_ORB, reusesPyramidBetweenCalls)
+{
+    Mat image0 = makeOrbTestImage(Size(640, 480), 2);
+    Mat image1 = makeOrbTestImage(Size(320, 240), 3);
+
+    ORB orb(500, 1.2f, 8, 31, 0, 2, ORB::FAST_SCORE);
+
+    std::vector<KeyPoint> keypoints0, keypoints1, keypoints;
+    Mat descriptors0, descriptors1, descriptors;
+
+    orb(image0, noArray(), keypoints0, descriptors0);
+    orb(image1, noArray(), keypoints1, descriptors1);
+    ASSERT_FALSE(keypoints0.empty());
+    ASSERT_FALSE(keypoints1.empty());
+
+    // the buffers left by the previous calls must not affect the results
+    for( int iter = 0; iter < 2; iter++ )
+    {
+        orb(image0, noArray(), keypoints, descriptors);
+        ASSERT_EQ(keypoints0.size(), keypoints.size());
+        EXPECT_EQ(0, norm(descriptors0, descriptors, NORM_INF));
+
+        orb(image1, noArray(), keypoints, descriptors);
+        ASSERT_EQ(keypoints1.size(), keypoints.size());
+        EXPECT_EQ(0, norm(descriptors1, descriptors, NORM_INF));
+    }
+}
@@ -181,6 +181,35 @@ public:
         return mem;
     }
 
+    /**
+     * Takes over the memory of another pool, which is left empty. This lets
+     * several pools be filled concurrently and then owned by a single one.
+     */
+    void merge(PooledAllocator& other)
+    {
+        if (other.base == NULL) {
+            return;
+        }
+
+        /* Chain the blocks of this pool behind the oldest block of the other one,
+            and carry on allocating from the current block of the other one. */
+        void* oldest = other.base;
+        while (*((void**) oldest) != NULL) {
+            oldest = *((void**) oldest);
+        }
+        *((void**) oldest) = base;
+        base = other.base;
+        loc = other.loc;
+        wastedMemory += remaining + other.wastedMemory;
+        remaining = other.remaining;
+        usedMemory += other.usedMemory;
+
+        other.base = NULL;
+        other.remaining = 0;
+        other.usedMemory = 0;
+        other.wastedMemory = 0;
+    }
+
 };
 
 }
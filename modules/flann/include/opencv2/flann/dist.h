@@ -42,6 +42,7 @@ typedef unsigned __int64 uint64_t;
 #endif
 
 #include "defines.h"
+#include "opencv2/core/cvdef.h"
 
 #if (defined WIN32 || defined _WIN32) && defined(_M_ARM)
 # include <Intrin.h>
@@ -93,6 +94,206 @@ class False
 };
 
 
+/*
+ * Kernels of the L2 and L1 functors. The generic versions work with any pair of iterators;
+ * the overloads for contiguous float and unsigned char data are vectorized with SSE2.
+ * All of them return the partial sum as soon as it exceeds worst_dist (if positive), the
+ * generic ones check it every 4 elements, the vectorized ones every 64.
+ */
+
+template <typename T>
+struct ConstPointer { typedef T Type; };
+template <typename T>
+struct ConstPointer<T*> { typedef const T* Type; };
+
+template <typename Iterator1, typename Iterator2, typename ResultType>
+inline ResultType l2_sqr_dist(Iterator1 a, Iterator2 b, size_t size, ResultType worst_dist)
+{
+    ResultType result = ResultType();
+    ResultType diff0, diff1, diff2, diff3;
+    Iterator1 last = a + size;
+    Iterator1 lastgroup = last - 3;
+
+    /* Process 4 items with each loop for efficiency. */
+    while (a < lastgroup) {
+        diff0 = (ResultType)(a[0] - b[0]);
+        diff1 = (ResultType)(a[1] - b[1]);
+        diff2 = (ResultType)(a[2] - b[2]);
+        diff3 = (ResultType)(a[3] - b[3]);
+        result += diff0 * diff0 + diff1 * diff1 + diff2 * diff2 + diff3 * diff3;
+        a += 4;
+        b += 4;
+
+        if ((worst_dist>0)&&(result>worst_dist)) {
+            return result;
+        }
+    }
+    /* Process last 0-3 pixels.  Not needed for standard vector lengths. */
+    while (a < last) {
+        diff0 = (ResultType)(*a++ - *b++);
+        result += diff0 * diff0;
+    }
+    return result;
+}
+
+template <typename Iterator1, typename Iterator2, typename ResultType>
+inline ResultType l1_dist(Iterator1 a, Iterator2 b, size_t size, ResultType worst_dist)
+{
+    ResultType result = ResultType();
+    ResultType diff0, diff1, diff2, diff3;
+    Iterator1 last = a + size;
+    Iterator1 lastgroup = last - 3;
+
+    /* Process 4 items with each loop for efficiency. */
+    while (a < lastgroup) {
+        diff0 = (ResultType)abs(a[0] - b[0]);
+        diff1 = (ResultType)abs(a[1] - b[1]);
+        diff2 = (ResultType)abs(a[2] - b[2]);
+        diff3 = (ResultType)abs(a[3] - b[3]);
+        result += diff0 + diff1 + diff2 + diff3;
+        a += 4;
+        b += 4;
+
+        if ((worst_dist>0)&&(result>worst_dist)) {
+            return result;
+        }
+    }
+    /* Process last 0-3 pixels.  Not needed for standard vector lengths. */
+    while (a < last) {
+        diff0 = (ResultType)abs(*a++ - *b++);
+        result += diff0;
+    }
+    return result;
+}
+
+#if CV_SSE2
+
+inline float sum_ps(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+inline int sum_epi32(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+inline float l2_sqr_dist(const float* a, const float* b, size_t size, float worst_dist)
+{
+    float result = 0;
+    size_t i = 0;
+    // 64-element blocks (e.g. SURF and SIFT descriptors are 1 and 2 blocks) with 4 accumulators
+    for (; i + 64 <= size; i += 64) {
+        __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+        for (size_t j = i; j < i + 64; j += 16) {
+            __m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + j), _mm_loadu_ps(b + j));
+            __m128 d1 = _mm_sub_ps(_mm_loadu_ps(a + j + 4), _mm_loadu_ps(b + j + 4));
+            __m128 d2 = _mm_sub_ps(_mm_loadu_ps(a + j + 8), _mm_loadu_ps(b + j + 8));
+            __m128 d3 = _mm_sub_ps(_mm_loadu_ps(a + j + 12), _mm_loadu_ps(b + j + 12));
+            s0 = _mm_add_ps(s0, _mm_mul_ps(d0, d0));
+            s1 = _mm_add_ps(s1, _mm_mul_ps(d1, d1));
+            s2 = _mm_add_ps(s2, _mm_mul_ps(d2, d2));
+            s3 = _mm_add_ps(s3, _mm_mul_ps(d3, d3));
+        }
+        result += sum_ps(_mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3)));
+        if ((worst_dist>0)&&(result>worst_dist)) {
+            return result;
+        }
+    }
+    __m128 s = _mm_setzero_ps();
+    for (; i + 4 <= size; i += 4) {
+        __m128 d = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        s = _mm_add_ps(s, _mm_mul_ps(d, d));
+    }
+    result += sum_ps(s);
+    for (; i < size; ++i) {
+        float d = a[i] - b[i];
+        result += d * d;
+    }
+    return result;
+}
+
+inline float l1_dist(const float* a, const float* b, size_t size, float worst_dist)
+{
+    const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    float result = 0;
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+        for (size_t j = i; j < i + 64; j += 16) {
+            s0 = _mm_add_ps(s0, _mm_and_ps(absmask, _mm_sub_ps(_mm_loadu_ps(a + j), _mm_loadu_ps(b + j))));
+            s1 = _mm_add_ps(s1, _mm_and_ps(absmask, _mm_sub_ps(_mm_loadu_ps(a + j + 4), _mm_loadu_ps(b + j + 4))));
+            s2 = _mm_add_ps(s2, _mm_and_ps(absmask, _mm_sub_ps(_mm_loadu_ps(a + j + 8), _mm_loadu_ps(b + j + 8))));
+            s3 = _mm_add_ps(s3, _mm_and_ps(absmask, _mm_sub_ps(_mm_loadu_ps(a + j + 12), _mm_loadu_ps(b + j + 12))));
+        }
+        result += sum_ps(_mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3)));
+        if ((worst_dist>0)&&(result>worst_dist)) {
+            return result;
+        }
+    }
+    __m128 s = _mm_setzero_ps();
+    for (; i + 4 <= size; i += 4)
+        s = _mm_add_ps(s, _mm_and_ps(absmask, _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i))));
+    result += sum_ps(s);
+    for (; i < size; ++i)
+        result += std::abs(a[i] - b[i]);
+    return result;
+}
+
+inline float l2_sqr_dist(const unsigned char* a, const unsigned char* b, size_t size, float worst_dist)
+{
+    const __m128i z = _mm_setzero_si128();
+    float result = 0;
+    size_t i = 0;
+    // the squares are summed exactly in 32-bit integers within a block
+    for (; i + 64 <= size; i += 64) {
+        __m128i s = _mm_setzero_si128();
+        for (size_t j = i; j < i + 64; j += 16) {
+            __m128i va = _mm_loadu_si128((const __m128i*)(a + j)), vb = _mm_loadu_si128((const __m128i*)(b + j));
+            __m128i d0 = _mm_sub_epi16(_mm_unpacklo_epi8(va, z), _mm_unpacklo_epi8(vb, z));
+            __m128i d1 = _mm_sub_epi16(_mm_unpackhi_epi8(va, z), _mm_unpackhi_epi8(vb, z));
+            s = _mm_add_epi32(s, _mm_add_epi32(_mm_madd_epi16(d0, d0), _mm_madd_epi16(d1, d1)));
+        }
+        result += (float)sum_epi32(s);
+        if ((worst_dist>0)&&(result>worst_dist)) {
+            return result;
+        }
+    }
+    int tail = 0;
+    for (; i < size; ++i) {
+        int d = a[i] - b[i];
+        tail += d * d;
+    }
+    return result + (float)tail;
+}
+
+inline float l1_dist(const unsigned char* a, const unsigned char* b, size_t size, float worst_dist)
+{
+    float result = 0;
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        __m128i s = _mm_setzero_si128();
+        for (size_t j = i; j < i + 64; j += 16)
+            s = _mm_add_epi64(s, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(a + j)),
+                                              _mm_loadu_si128((const __m128i*)(b + j))));
+        result += (float)(_mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(s, s)));
+        if ((worst_dist>0)&&(result>worst_dist)) {
+            return result;
+        }
+    }
+    int tail = 0;
+    for (; i < size; ++i)
+        tail += std::abs(a[i] - b[i]);
+    return result + (float)tail;
+}
+
+#endif
+
+
 /**
  * Squared Euclidean distance functor.
  *
@@ -153,31 +354,8 @@ struct L2
     template <typename Iterator1, typename Iterator2>
     ResultType operator()(Iterator1 a, Iterator2 b, size_t size, ResultType worst_dist = -1) const
     {
-        ResultType result = ResultType();
-        ResultType diff0, diff1, diff2, diff3;
-        Iterator1 last = a + size;
-        Iterator1 lastgroup = last - 3;
-
-        /* Process 4 items with each loop for efficiency. */
-        while (a < lastgroup) {
-            diff0 = (ResultType)(a[0] - b[0]);
-            diff1 = (ResultType)(a[1] - b[1]);
-            diff2 = (ResultType)(a[2] - b[2]);
-            diff3 = (ResultType)(a[3] - b[3]);
-            result += diff0 * diff0 + diff1 * diff1 + diff2 * diff2 + diff3 * diff3;
-            a += 4;
-            b += 4;
-
-            if ((worst_dist>0)&&(result>worst_dist)) {
-                return result;
-            }
-        }
-        /* Process last 0-3 pixels.  Not needed for standard vector lengths. */
-        while (a < last) {
-            diff0 = (ResultType)(*a++ - *b++);
-            result += diff0 * diff0;
-        }
-        return result;
+        return l2_sqr_dist(typename ConstPointer<Iterator1>::Type(a), typename ConstPointer<Iterator2>::Type(b),
+                           size, worst_dist);
     }
 
     /**
@@ -215,31 +393,8 @@ struct L1
     template <typename Iterator1, typename Iterator2>
     ResultType operator()(Iterator1 a, Iterator2 b, size_t size, ResultType worst_dist = -1) const
     {
-        ResultType result = ResultType();
-        ResultType diff0, diff1, diff2, diff3;
-        Iterator1 last = a + size;
-        Iterator1 lastgroup = last - 3;
-
-        /* Process 4 items with each loop for efficiency. */
-        while (a < lastgroup) {
-            diff0 = (ResultType)abs(a[0] - b[0]);
-            diff1 = (ResultType)abs(a[1] - b[1]);
-            diff2 = (ResultType)abs(a[2] - b[2]);
-            diff3 = (ResultType)abs(a[3] - b[3]);
-            result += diff0 + diff1 + diff2 + diff3;
-            a += 4;
-            b += 4;
-
-            if ((worst_dist>0)&&(result>worst_dist)) {
-                return result;
-            }
-        }
-        /* Process last 0-3 pixels.  Not needed for standard vector lengths. */
-        while (a < last) {
-            diff0 = (ResultType)abs(*a++ - *b++);
-            result += diff0;
-        }
-        return result;
+        return l1_dist(typename ConstPointer<Iterator1>::Type(a), typename ConstPointer<Iterator2>::Type(b),
+                       size, worst_dist);
     }
 
     /**
@@ -407,6 +562,16 @@ struct HammingLUT
     }
 };
 
+#if CV_SSE2
+
+/**
+ * Counts the bits set in a ^ b with the widest SIMD instructions the CPU supports
+ * (AVX2, SSSE3 or SSE2), which are chosen at runtime.
+ */
+CV_EXPORTS int hamming_dist(const unsigned char* a, const unsigned char* b, size_t size);
+
+#endif
+
 /**
  * Hamming distance functor (pop count between two binary vectors, i.e. xor them and count the number of bits set)
  * That code was taken from brief.cpp in OpenCV
@@ -441,6 +606,9 @@ struct Hamming
             result = vgetq_lane_s32 (vreinterpretq_s32_u64(bitSet2),0);
             result += vgetq_lane_s32 (vreinterpretq_s32_u64(bitSet2),2);
         }
+#elif CV_SSE2
+        result = hamming_dist(reinterpret_cast<const unsigned char*> (a),
+                              reinterpret_cast<const unsigned char*> (b), size);
 #elif __GNUC__
         {
             //for portability just use unsigned long -- and use the __builtin_popcountll (see docs for __builtin_popcountll)
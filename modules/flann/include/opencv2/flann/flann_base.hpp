@@ -104,7 +104,7 @@ public:
     typedef typename Distance::ResultType DistanceType;
 
     Index(const Matrix<ElementType>& features, const IndexParams& params, Distance distance = Distance() )
-        : index_params_(params)
+        : index_params_(params), distance_(distance), size_at_build_(features.rows)
     {
         flann_algorithm_t index_type = get_param<flann_algorithm_t>(params,"algorithm");
         loaded_ = false;
@@ -133,6 +133,30 @@ public:
         }
     }
 
+    /**
+     * \brief Extends the index to points appended to its dataset
+     * \param features The dataset of the index with the new points appended as its last rows.
+     *                 The rows that are already indexed must not have changed, but they may
+     *                 have been moved to a different memory location.
+     * \param rebuild_threshold The index is rebuilt from scratch instead when the dataset has
+     *                 grown by this factor since the index was last built, which keeps the trees
+     *                 balanced. A value of 1 or less disables the rebuilds.
+     *
+     * Index types that do not support incremental updates are always rebuilt.
+     */
+    void addPoints(const Matrix<ElementType>& features, float rebuild_threshold = 2)
+    {
+        assert(features.rows >= size() && features.cols == veclen());
+        if ((rebuild_threshold > 1 && features.rows > size_at_build_*rebuild_threshold) ||
+            !nnIndex_->addPoints(features)) {
+            NNIndex<Distance>* nnIndex = create_index_by_type<Distance>(features, nnIndex_->getParameters(), distance_);
+            nnIndex->buildIndex();
+            delete nnIndex_;
+            nnIndex_ = nnIndex;
+            size_at_build_ = features.rows;
+        }
+    }
+
     void save(cv::String filename)
     {
         FILE* fout = fopen(filename.c_str(), "wb");
@@ -262,6 +286,10 @@ private:
     bool loaded_;
     /** Parameters passed to the index */
     IndexParams index_params_;
+    /** Distance used by the index */
+    Distance distance_;
+    /** Number of features when the index was last built */
+    size_t size_at_build_;
 };
 
 /**
@@ -73,7 +73,10 @@ public:
     Heap(int sz)
     {
         length = sz;
-        heap.reserve(length);
+        // The searches create a heap per query with the dataset size as the capacity, but
+        // rarely fill more than a few hundred entries; reserving the whole capacity would
+        // allocate (and with many threads, contend for) a dataset-sized block per query.
+        heap.reserve(std::min(length, 256));
         count = 0;
     }
 
@@ -348,14 +348,65 @@ public:
         if (branching_<2) {
             throw FLANNException("Branching factor must be at least 2");
         }
+        std::vector<BuildTask> roots(trees_);
         for (int i=0; i<trees_; ++i) {
             indices[i] = new int[size_];
             for (size_t j=0; j<size_; ++j) {
                 indices[i][j] = (int)j;
             }
             root[i] = pool.allocate<Node>();
-            computeClustering(root[i], indices[i], (int)size_, branching_,0);
+            BuildTask task = { root[i], indices[i], (int)size_, 0, rand_seed() };
+            roots[i] = task;
         }
+        build_trees(this, roots, pool);
+    }
+
+    /**
+     * Assigns the points appended to the dataset to the leaves of the existing
+     * trees, descending to the closest cluster center at each level. Leaves that
+     * reach the leaf size are clustered further.
+     */
+    bool addPoints(const Matrix<ElementType>& new_dataset)
+    {
+        if (size_ == 0) {
+            return false;
+        }
+        assert(new_dataset.rows >= size_ && new_dataset.cols == veclen_);
+
+        size_t old_size = size_;
+        dataset = new_dataset;
+        size_ = dataset.rows;
+
+        for (int i=0; i<trees_; ++i) {
+            std::map<NodePtr, std::vector<int> > added;
+            for (size_t j=old_size; j<size_; ++j) {
+                NodePtr node = root[i];
+                ElementType* point = dataset[j];
+                while (node->childs!=NULL) {
+                    node->size++;
+                    int best_index = 0;
+                    DistanceType best_dist = distance(point, dataset[node->childs[0]->pivot], veclen_);
+                    for (int k=1; k<branching_; ++k) {
+                        DistanceType dist = distance(point, dataset[node->childs[k]->pivot], veclen_);
+                        if (dist<best_dist) {
+                            best_dist = dist;
+                            best_index = k;
+                        }
+                    }
+                    node = node->childs[best_index];
+                }
+                added[node].push_back((int)j);
+            }
+
+            // the leaves keep their points in a single array per tree (this is
+            // what saveIndex() relies on), so the array is laid out again
+            int* new_indices = new int[size_];
+            int offset = 0;
+            relayoutTree(root[i], added, new_indices, offset);
+            delete[] indices[i];
+            indices[i] = new_indices;
+        }
+        return true;
     }
 
 
@@ -473,6 +524,24 @@ private:
     };
     typedef Node* NodePtr;
 
+    /**
+     * A subtree to build: the points dsindices[0..size-1] are clustered below node.
+     */
+    struct BuildTask
+    {
+        NodePtr node;
+        int* dsindices;
+        int size;
+        int level;
+        uint64 seed;
+    };
+
+    friend class BuildTaskInvoker<HierarchicalClusteringIndex, BuildTask>;
+
+    void buildSubtree(const BuildTask& task, PooledAllocator& allocator, std::vector<BuildTask>* deferred)
+    {
+        computeClustering(task.node, task.dsindices, task.size, branching_, task.level, allocator, deferred);
+    }
 
 
     /**
@@ -517,6 +586,29 @@ private:
 
 
 
+    void relayoutTree(NodePtr node, const std::map<NodePtr, std::vector<int> >& added, int* new_indices, int& offset)
+    {
+        if (node->childs!=NULL) {
+            for (int i=0; i<branching_; ++i) {
+                relayoutTree(node->childs[i], added, new_indices, offset);
+            }
+            return;
+        }
+
+        int* leaf_indices = new_indices + offset;
+        std::copy(node->indices, node->indices + node->size, leaf_indices);
+        node->indices = leaf_indices;
+        offset += node->size;
+
+        typename std::map<NodePtr, std::vector<int> >::const_iterator it = added.find(node);
+        if (it!=added.end()) {
+            std::copy(it->second.begin(), it->second.end(), leaf_indices + node->size);
+            offset += (int)it->second.size();
+            computeClustering(node, leaf_indices, node->size + (int)it->second.size(), branching_, node->level, pool);
+        }
+    }
+
+
     void computeLabels(int* dsindices, int indices_length,  int* centers, int centers_length, int* labels, DistanceType& cost)
     {
         cost = 0;
@@ -543,11 +635,21 @@ private:
      *     node = the node to cluster
      *     indices = indices of the points belonging to the current node
      *     branching = the branching factor to use in the clustering
+     *     allocator = the pool the new nodes are allocated from
+     *     deferred = when not NULL, the nodes of up to build_task_size() points are not
+     *                clustered but appended to it, to be built as separate tasks
      *
      * TODO: for 1-sized clusters don't store a cluster center (it's the same as the single cluster point)
      */
-    void computeClustering(NodePtr node, int* dsindices, int indices_length, int branching, int level)
+    void computeClustering(NodePtr node, int* dsindices, int indices_length, int branching, int level,
+                           PooledAllocator& allocator, std::vector<BuildTask>* deferred = NULL)
     {
+        if ((deferred != NULL) && (indices_length <= (int)build_task_size(size_))) {
+            BuildTask task = { node, dsindices, indices_length, level, rand_seed() };
+            deferred->push_back(task);
+            return;
+        }
+
         node->size = indices_length;
         node->level = level;
 
@@ -576,7 +678,7 @@ private:
         DistanceType cost;
         computeLabels(dsindices, indices_length, &centers[0], centers_length, &labels[0], cost);
 
-        node->childs = pool.allocate<NodePtr>(branching);
+        node->childs = allocator.allocate<NodePtr>(branching);
         int start = 0;
         int end = start;
         for (int i=0; i<branching; ++i) {
@@ -588,10 +690,10 @@ private:
                 }
             }
 
-            node->childs[i] = pool.allocate<Node>();
+            node->childs[i] = allocator.allocate<Node>();
             node->childs[i]->pivot = centers[i];
             node->childs[i]->indices = NULL;
-            computeClustering(node->childs[i],dsindices+start, end-start, branching, level+1);
+            computeClustering(node->childs[i],dsindices+start, end-start, branching, level+1, allocator, deferred);
             start=end;
         }
     }
@@ -654,7 +756,7 @@ private:
     /**
      * The dataset used by this index
      */
-    const Matrix<ElementType> dataset;
+    Matrix<ElementType> dataset;
 
     /**
      * Parameters used by this index
@@ -89,6 +89,7 @@ public:
         veclen_ = dataset_.cols;
 
         trees_ = get_param(index_params_,"trees",4);
+        compact_ = get_param(index_params_,"compact",true);
         tree_roots_ = new NodePtr[trees_];
 
         // Create a permutable array of indices to the input vectors.
@@ -96,9 +97,6 @@ public:
         for (size_t i = 0; i < size_; ++i) {
             vind_[i] = int(i);
         }
-
-        mean_ = new DistanceType[veclen_];
-        var_ = new DistanceType[veclen_];
     }
 
 
@@ -113,8 +111,6 @@ public:
         if (tree_roots_!=NULL) {
             delete[] tree_roots_;
         }
-        delete[] mean_;
-        delete[] var_;
     }
 
     /**
@@ -122,12 +118,53 @@ public:
      */
     void buildIndex()
     {
-        /* Construct the randomized trees. */
+        /* Construct the randomized trees. They are built concurrently, so each
+            one divides its own permutation of the vectors. */
+        std::vector<int> ind(trees_*size_);
+        std::vector<BuildTask> roots(trees_);
         for (int i = 0; i < trees_; i++) {
-            /* Randomize the order of vectors to allow for unbiased sampling. */
-            std::random_shuffle(vind_.begin(), vind_.end());
-            tree_roots_[i] = divideTree(&vind_[0], int(size_) );
+            roots[i].node = &tree_roots_[i];
+            roots[i].ind = &ind[i*size_];
+            roots[i].count = int(size_);
+            roots[i].seed = rand_seed();
+        }
+        if (compact_) {
+            PooledAllocator pool;
+            build_trees(this, roots, pool);
+            flattenTrees();
+        }
+        else {
+            build_trees(this, roots, pool_);
+        }
+    }
+
+    /**
+     * Inserts the points appended to the dataset into the existing trees.
+     * Each new point splits the leaf it falls into, so the trees are not
+     * rebalanced; rebuild the index once the dataset has grown considerably.
+     */
+    bool addPoints(const Matrix<ElementType>& dataset)
+    {
+        if (size_ == 0) {
+            return false;
         }
+        assert(dataset.rows >= size_ && dataset.cols == veclen_);
+
+        size_t old_size = size_;
+        dataset_ = dataset;
+        size_ = dataset_.rows;
+        for (size_t i = old_size; i < size_; ++i) {
+            vind_.push_back(int(i));
+            for (int j = 0; j < trees_; ++j) {
+                if (compact_) {
+                    addPointToFlatTree(flat_roots_[j], int(i));
+                }
+                else {
+                    addPointToTree(tree_roots_[j], int(i));
+                }
+            }
+        }
+        return true;
     }
 
 
@@ -141,7 +178,12 @@ public:
     {
         save_value(stream, trees_);
         for (int i=0; i<trees_; ++i) {
-            save_tree(stream, tree_roots_[i]);
+            if (compact_) {
+                save_flat_tree(stream, flat_roots_[i]);
+            }
+            else {
+                save_tree(stream, tree_roots_[i]);
+            }
         }
     }
 
@@ -154,12 +196,16 @@ public:
             delete[] tree_roots_;
         }
         tree_roots_ = new NodePtr[trees_];
+        PooledAllocator pool;
         for (int i=0; i<trees_; ++i) {
-            load_tree(stream,tree_roots_[i]);
+            load_tree(stream, tree_roots_[i], compact_ ? pool : pool_);
+        }
+        if (compact_) {
+            flattenTrees();
         }
 
         index_params_["algorithm"] = getType();
-        index_params_["trees"] = tree_roots_;
+        index_params_["trees"] = trees_;
     }
 
     /**
@@ -184,7 +230,8 @@ public:
      */
     int usedMemory() const
     {
-        return int(pool_.usedMemory+pool_.wastedMemory+dataset_.rows*sizeof(int));  // pool memory and vind array memory
+        return int(pool_.usedMemory+pool_.wastedMemory+flat_nodes_.capacity()*sizeof(FlatNode)+
+                   dataset_.rows*sizeof(int));  // node memory and vind array memory
     }
 
     /**
@@ -234,8 +281,81 @@ private:
         Node* child1, * child2;
     };
     typedef Node* NodePtr;
-    typedef BranchStruct<NodePtr, DistanceType> BranchSt;
-    typedef BranchSt* Branch;
+
+    /**
+     * A node of the trees once they are laid out in a single array by
+     * flattenTrees(). The children are referred to by 32-bit indices.
+     */
+    struct FlatNode
+    {
+        /**
+         * Dimension used for subdivision, or the index of the vector for a leaf.
+         */
+        int divfeat;
+        /**
+         * The value used for subdivision.
+         */
+        DistanceType divval;
+        /**
+         * Indices of the child nodes in flat_nodes_, -1 for a leaf.
+         */
+        int child1, child2;
+    };
+
+    static bool isLeaf(const Node* node)
+    {
+        return (node->child1 == NULL)&&(node->child2 == NULL);
+    }
+
+    static bool isLeaf(const FlatNode* node)
+    {
+        return node->child1 < 0;
+    }
+
+    const Node* child(const Node* node, bool second) const
+    {
+        return second ? node->child2 : node->child1;
+    }
+
+    const FlatNode* child(const FlatNode* node, bool second) const
+    {
+        return &flat_nodes_[second ? node->child2 : node->child1];
+    }
+
+    const Node* root(int tree, const Node*) const
+    {
+        return tree_roots_[tree];
+    }
+
+    const FlatNode* root(int tree, const FlatNode*) const
+    {
+        return &flat_nodes_[flat_roots_[tree]];
+    }
+
+    /**
+     * A subtree to build: the vectors ind[0..count-1] are divided below *node.
+     */
+    struct BuildTask
+    {
+        NodePtr* node;
+        int* ind;
+        int count;
+        uint64 seed;
+    };
+
+    friend class BuildTaskInvoker<KDTreeIndex, BuildTask>;
+
+    void buildSubtree(const BuildTask& task, PooledAllocator& pool, std::vector<BuildTask>* deferred)
+    {
+        if (deferred != NULL) {
+            /* A whole tree: randomize the order of vectors to allow for unbiased sampling. */
+            std::copy(vind_.begin(), vind_.end(), task.ind);
+            RandomIndex random_index;
+            std::random_shuffle(task.ind, task.ind+task.count, random_index);
+        }
+        std::vector<DistanceType> mean(veclen_), var(veclen_);
+        divideTree(*task.node, task.ind, task.count, pool, &mean[0], &var[0], deferred);
+    }
 
 
 
@@ -251,15 +371,111 @@ private:
     }
 
 
-    void load_tree(FILE* stream, NodePtr& tree)
+    /**
+     * Saves a flattened tree in the format of save_tree(), so that the file does
+     * not depend on the layout. load_tree() only checks whether the children are NULL.
+     */
+    void save_flat_tree(FILE* stream, int index)
     {
-        tree = pool_.allocate<Node>();
+        const FlatNode& flat = flat_nodes_[index];
+        Node node;
+        memset(&node, 0, sizeof(node));
+        node.divfeat = flat.divfeat;
+        node.divval = flat.divval;
+        if (flat.child1 >= 0) {
+            node.child1 = node.child2 = &node;
+        }
+        save_value(stream, node);
+        if (flat.child1 >= 0) {
+            save_flat_tree(stream, flat.child1);
+            save_flat_tree(stream, flat.child2);
+        }
+    }
+
+
+    void load_tree(FILE* stream, NodePtr& tree, PooledAllocator& pool)
+    {
+        tree = pool.allocate<Node>();
         load_value(stream, *tree);
         if (tree->child1!=NULL) {
-            load_tree(stream, tree->child1);
+            load_tree(stream, tree->child1, pool);
         }
         if (tree->child2!=NULL) {
-            load_tree(stream, tree->child2);
+            load_tree(stream, tree->child2, pool);
+        }
+    }
+
+
+    /**
+     * Lays the trees out in flat_nodes_ in van Emde Boas order: the top half of
+     * the levels of a tree is laid out first, recursively, followed by each of
+     * the subtrees below it. Any descent then crosses O(log(depth)) cache lines
+     * whatever the cache line size, and the nodes take less memory than the
+     * pointer-linked ones, which are no longer used afterwards.
+     */
+    void flattenTrees()
+    {
+        flat_nodes_.clear();
+        flat_roots_.resize(trees_);
+        std::vector<NodePtr> order;
+        for (int i = 0; i < trees_; ++i) {
+            flat_roots_[i] = (int)order.size();
+            layoutTree(tree_roots_[i], treeHeight(tree_roots_[i]), order);
+        }
+
+        /* The nodes of the pointer-linked trees are dropped afterwards, so their
+            divfeat can hold their position once it is copied. */
+        flat_nodes_.resize(order.size());
+        for (size_t k = 0; k < order.size(); ++k) {
+            flat_nodes_[k].divfeat = order[k]->divfeat;
+            flat_nodes_[k].divval = order[k]->divval;
+            order[k]->divfeat = (int)k;
+        }
+        for (size_t k = 0; k < order.size(); ++k) {
+            bool leaf = isLeaf(order[k]);
+            flat_nodes_[k].child1 = leaf ? -1 : order[k]->child1->divfeat;
+            flat_nodes_[k].child2 = leaf ? -1 : order[k]->child2->divfeat;
+        }
+        for (int i = 0; i < trees_; ++i) {
+            tree_roots_[i] = NULL;
+        }
+    }
+
+    int treeHeight(NodePtr node)
+    {
+        return isLeaf(node) ? 1 : 1 + std::max(treeHeight(node->child1), treeHeight(node->child2));
+    }
+
+    /**
+     * Appends the nodes of the top height levels of the subtree at node to
+     * order, in van Emde Boas order.
+     */
+    void layoutTree(NodePtr node, int height, std::vector<NodePtr>& order)
+    {
+        if ((height == 1) || isLeaf(node)) {
+            order.push_back(node);
+            return;
+        }
+        int top = height/2;
+        layoutTree(node, top, order);
+        std::vector<NodePtr> bottom;
+        collectSubtrees(node, top, bottom);
+        for (size_t i = 0; i < bottom.size(); ++i) {
+            layoutTree(bottom[i], height-top, order);
+        }
+    }
+
+    /**
+     * Appends the nodes depth levels below node to subtrees, from left to right.
+     */
+    void collectSubtrees(NodePtr node, int depth, std::vector<NodePtr>& subtrees)
+    {
+        if (depth == 0) {
+            subtrees.push_back(node);
+        }
+        else if (!isLeaf(node)) {
+            collectSubtrees(node->child1, depth-1, subtrees);
+            collectSubtrees(node->child2, depth-1, subtrees);
         }
     }
 
@@ -272,10 +488,20 @@ private:
      * Params: pTree = the new node to create
      *                  first = index of the first vector
      *                  last = index of the last vector
+     *
+     * When deferred is not NULL, the subtrees of up to build_task_size() vectors
+     * are not divided but appended to it, to be built as separate tasks.
      */
-    NodePtr divideTree(int* ind, int count)
+    void divideTree(NodePtr& node, int* ind, int count, PooledAllocator& pool,
+                    DistanceType* mean, DistanceType* var, std::vector<BuildTask>* deferred)
     {
-        NodePtr node = pool_.allocate<Node>(); // allocate memory
+        if ((deferred != NULL) && (count <= (int)build_task_size(size_))) {
+            BuildTask task = { &node, ind, count, rand_seed() };
+            deferred->push_back(task);
+            return;
+        }
+
+        node = pool.allocate<Node>(); // allocate memory
 
         /* If too few exemplars remain, then make this a leaf node. */
         if ( count == 1) {
@@ -286,27 +512,112 @@ private:
             int idx;
             int cutfeat;
             DistanceType cutval;
-            meanSplit(ind, count, idx, cutfeat, cutval);
+            meanSplit(ind, count, idx, cutfeat, cutval, mean, var);
 
             node->divfeat = cutfeat;
             node->divval = cutval;
-            node->child1 = divideTree(ind, idx);
-            node->child2 = divideTree(ind+idx, count-idx);
+            divideTree(node->child1, ind, idx, pool, mean, var, deferred);
+            divideTree(node->child2, ind+idx, count-idx, pool, mean, var, deferred);
+        }
+    }
+
+
+    /**
+     * Descends to the leaf the point falls into and replaces the leaf by a node
+     * that separates the point from the one stored in the leaf along the
+     * dimension in which they differ most.
+     */
+    void addPointToTree(NodePtr node, int ind)
+    {
+        ElementType* point = dataset_[ind];
+        while ((node->child1 != NULL)||(node->child2 != NULL)) {
+            DistanceType diff = point[node->divfeat] - node->divval;
+            node = (diff < 0) ? node->child1 : node->child2;
+        }
+
+        int div_feat;
+        DistanceType div_val;
+        bool point_left;
+        splitLeaf(node->divfeat, ind, div_feat, div_val, point_left);
+
+        NodePtr left = pool_.allocate<Node>();
+        NodePtr right = pool_.allocate<Node>();
+        left->child1 = left->child2 = NULL;
+        right->child1 = right->child2 = NULL;
+        left->divfeat = point_left ? ind : node->divfeat;
+        right->divfeat = point_left ? node->divfeat : ind;
+        node->divfeat = div_feat;
+        node->divval = div_val;
+        node->child1 = left;
+        node->child2 = right;
+    }
+
+    /**
+     * Same as addPointToTree() for a flattened tree. The two new leaves are
+     * appended to flat_nodes_.
+     */
+    void addPointToFlatTree(int index, int ind)
+    {
+        ElementType* point = dataset_[ind];
+        while (flat_nodes_[index].child1 >= 0) {
+            DistanceType diff = point[flat_nodes_[index].divfeat] - flat_nodes_[index].divval;
+            index = (diff < 0) ? flat_nodes_[index].child1 : flat_nodes_[index].child2;
         }
 
-        return node;
+        int leaf_ind = flat_nodes_[index].divfeat;
+        int div_feat;
+        DistanceType div_val;
+        bool point_left;
+        splitLeaf(leaf_ind, ind, div_feat, div_val, point_left);
+
+        FlatNode left, right;
+        left.divfeat = point_left ? ind : leaf_ind;
+        right.divfeat = point_left ? leaf_ind : ind;
+        left.divval = right.divval = 0;
+        left.child1 = left.child2 = -1;
+        right.child1 = right.child2 = -1;
+
+        FlatNode& node = flat_nodes_[index];
+        node.divfeat = div_feat;
+        node.divval = div_val;
+        node.child1 = (int)flat_nodes_.size();
+        node.child2 = node.child1 + 1;
+        flat_nodes_.push_back(left);
+        flat_nodes_.push_back(right);
+    }
+
+    /**
+     * Separates the point ind from the point leaf_ind of a leaf along the
+     * dimension in which they differ most, halfway between them.
+     */
+    void splitLeaf(int leaf_ind, int ind, int& div_feat, DistanceType& div_val, bool& point_left)
+    {
+        ElementType* point = dataset_[ind];
+        ElementType* leaf_point = dataset_[leaf_ind];
+        DistanceType max_span = 0;
+        div_feat = 0;
+        for (size_t k = 0; k < veclen_; ++k) {
+            DistanceType span = (point[k] > leaf_point[k]) ? DistanceType(point[k] - leaf_point[k]) : DistanceType(leaf_point[k] - point[k]);
+            if (span > max_span) {
+                max_span = span;
+                div_feat = int(k);
+            }
+        }
+        div_val = (DistanceType(point[div_feat]) + DistanceType(leaf_point[div_feat]))/2;
+        point_left = point[div_feat] < leaf_point[div_feat];
     }
 
 
     /**
      * Choose which feature to use in order to subdivide this set of vectors.
      * Make a random choice among those with the highest variance, and use
-     * its variance as the threshold value.
+     * its variance as the threshold value. mean and var are buffers of veclen_ values.
      */
-    void meanSplit(int* ind, int count, int& index, int& cutfeat, DistanceType& cutval)
+    void meanSplit(int* ind, int count, int& index, int& cutfeat, DistanceType& cutval,
+                   DistanceType* mean, DistanceType* var)
     {
-        memset(mean_,0,veclen_*sizeof(DistanceType));
-        memset(var_,0,veclen_*sizeof(DistanceType));
+        memset(mean,0,veclen_*sizeof(DistanceType));
+        memset(var,0,veclen_*sizeof(DistanceType));
 
         /* Compute mean values.  Only the first SAMPLE_MEAN values need to be
             sampled to get a good estimate.
@@ -315,24 +626,24 @@ private:
         for (int j = 0; j < cnt; ++j) {
             ElementType* v = dataset_[ind[j]];
             for (size_t k=0; k<veclen_; ++k) {
-                mean_[k] += v[k];
+                mean[k] += v[k];
             }
         }
         for (size_t k=0; k<veclen_; ++k) {
-            mean_[k] /= cnt;
+            mean[k] /= cnt;
         }
 
         /* Compute variances (no need to divide by count). */
         for (int j = 0; j < cnt; ++j) {
             ElementType* v = dataset_[ind[j]];
             for (size_t k=0; k<veclen_; ++k) {
-                DistanceType dist = v[k] - mean_[k];
-                var_[k] += dist * dist;
+                DistanceType dist = v[k] - mean[k];
+                var[k] += dist * dist;
             }
         }
         /* Select one of the highest variance indices at random. */
-        cutfeat = selectDivision(var_);
-        cutval = mean_[cutfeat];
+        cutfeat = selectDivision(var);
+        cutval = mean[cutfeat];
 
         int lim1, lim2;
         planeSplit(ind, count, cutfeat, cutval, lim1, lim2);
@@ -424,7 +735,12 @@ private:
             fprintf(stderr,"It doesn't make any sense to use more than one tree for exact search");
         }
         if (trees_>0) {
-            searchLevelExact(result, vec, tree_roots_[0], 0.0, epsError);
+            if (compact_) {
+                searchLevelExact(result, vec, root(0, (const FlatNode*)NULL), 0.0, epsError);
+            }
+            else {
+                searchLevelExact(result, vec, root(0, (const Node*)NULL), 0.0, epsError);
+            }
         }
         assert(result.full());
     }
@@ -436,6 +752,21 @@ private:
      */
     void getNeighbors(ResultSet<DistanceType>& result, const ElementType* vec, int maxCheck, float epsError)
     {
+        if (compact_) {
+            getNeighbors(result, vec, maxCheck, epsError, (const FlatNode*)NULL);
+        }
+        else {
+            getNeighbors(result, vec, maxCheck, epsError, (const Node*)NULL);
+        }
+    }
+
+    /**
+     * The approximate search in the trees of either layout; the last argument only selects it.
+     */
+    template <typename NodeType>
+    void getNeighbors(ResultSet<DistanceType>& result, const ElementType* vec, int maxCheck, float epsError, const NodeType*)
+    {
+        typedef BranchStruct<const NodeType*, DistanceType> BranchSt;
         int i;
         BranchSt branch;
 
@@ -445,7 +776,7 @@ private:
 
         /* Search once through each tree down to root. */
         for (i = 0; i < trees_; ++i) {
-            searchLevel(result, vec, tree_roots_[i], 0, checkCount, maxCheck, epsError, heap, checked);
+            searchLevel(result, vec, root(i, (const NodeType*)NULL), 0, checkCount, maxCheck, epsError, heap, checked);
         }
 
         /* Keep searching other branches from heap until finished. */
@@ -464,8 +795,9 @@ private:
      *  higher levels, all exemplars below this level must have a distance of
      *  at least "mindistsq".
      */
-    void searchLevel(ResultSet<DistanceType>& result_set, const ElementType* vec, NodePtr node, DistanceType mindist, int& checkCount, int maxCheck,
-                     float epsError, Heap<BranchSt>* heap, DynamicBitset& checked)
+    template <typename NodeType>
+    void searchLevel(ResultSet<DistanceType>& result_set, const ElementType* vec, const NodeType* node, DistanceType mindist, int& checkCount, int maxCheck,
+                     float epsError, Heap<BranchStruct<const NodeType*, DistanceType> >* heap, DynamicBitset& checked)
     {
         if (result_set.worstDist()<mindist) {
             //			printf("Ignoring branch, too far\n");
@@ -473,7 +805,7 @@ private:
         }
 
         /* If this is a leaf node, then do check and return. */
-        if ((node->child1 == NULL)&&(node->child2 == NULL)) {
+        if (isLeaf(node)) {
             /*  Do not check same node more than once when searching multiple trees.
                 Once a vector is checked, we set its location in vind to the
                 current checkID.
@@ -492,8 +824,8 @@ private:
         /* Which child branch should be taken first? */
         ElementType val = vec[node->divfeat];
         DistanceType diff = val - node->divval;
-        NodePtr bestChild = (diff < 0) ? node->child1 : node->child2;
-        NodePtr otherChild = (diff < 0) ? node->child2 : node->child1;
+        const NodeType* bestChild = child(node, diff >= 0);
+        const NodeType* otherChild = child(node, diff < 0);
 
         /* Create a branch record for the branch not taken.  Add distance
             of this feature boundary (we don't attempt to correct for any
@@ -506,7 +838,7 @@ private:
         DistanceType new_distsq = mindist + distance_.accum_dist(val, node->divval, node->divfeat);
         //		if (2 * checkCount < maxCheck  ||  !result.full()) {
         if ((new_distsq*epsError < result_set.worstDist())||  !result_set.full()) {
-            heap->insert( BranchSt(otherChild, new_distsq) );
+            heap->insert( BranchStruct<const NodeType*, DistanceType>(otherChild, new_distsq) );
         }
 
         /* Call recursively to search next level down. */
@@ -516,10 +848,11 @@ private:
     /**
      * Performs an exact search in the tree starting from a node.
      */
-    void searchLevelExact(ResultSet<DistanceType>& result_set, const ElementType* vec, const NodePtr node, DistanceType mindist, const float epsError)
+    template <typename NodeType>
+    void searchLevelExact(ResultSet<DistanceType>& result_set, const ElementType* vec, const NodeType* node, DistanceType mindist, const float epsError)
     {
         /* If this is a leaf node, then do check and return. */
-        if ((node->child1 == NULL)&&(node->child2 == NULL)) {
+        if (isLeaf(node)) {
             int index = node->divfeat;
             DistanceType dist = distance_(dataset_[index], vec, veclen_);
             result_set.addPoint(dist,index);
@@ -529,8 +862,8 @@ private:
         /* Which child branch should be taken first? */
         ElementType val = vec[node->divfeat];
         DistanceType diff = val - node->divval;
-        NodePtr bestChild = (diff < 0) ? node->child1 : node->child2;
-        NodePtr otherChild = (diff < 0) ? node->child2 : node->child1;
+        const NodeType* bestChild = child(node, diff >= 0);
+        const NodeType* otherChild = child(node, diff < 0);
 
         /* Create a branch record for the branch not taken.  Add distance
             of this feature boundary (we don't attempt to correct for any
@@ -585,7 +918,7 @@ private:
     /**
      * The dataset used by this index
      */
-    const Matrix<ElementType> dataset_;
+    Matrix<ElementType> dataset_;
 
     IndexParams index_params_;
 
@@ -593,15 +926,22 @@ private:
     size_t veclen_;
 
 
-    DistanceType* mean_;
-    DistanceType* var_;
-
-
     /**
      * Array of k-d trees used to find neighbours.
      */
     NodePtr* tree_roots_;
 
+    /**
+     * Whether the trees are flattened after they are built or loaded.
+     */
+    bool compact_;
+
+    /**
+     * The nodes of the flattened trees, and the index of the root of each tree.
+     */
+    std::vector<FlatNode> flat_nodes_;
+    std::vector<int> flat_roots_;
+
     /**
      * Pooled memory allocator.
      *
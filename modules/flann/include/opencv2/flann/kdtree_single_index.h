@@ -217,11 +217,7 @@ public:
         assert(int(indices.cols) >= knn);
         assert(int(dists.cols) >= knn);
 
-        KNNSimpleResultSet<DistanceType> resultSet(knn);
-        for (size_t i = 0; i < queries.rows; i++) {
-            resultSet.init(indices[i], dists[i]);
-            findNeighbors(resultSet, queries[i], params);
-        }
+        cv::parallel_for_(cv::Range(0, (int)queries.rows), KNNSearchInvoker(this, queries, indices, dists, knn, params));
     }
 
     IndexParams getParameters() const
@@ -249,6 +245,39 @@ public:
 
 private:
 
+    /**
+     * Searches a range of query rows with a result set that writes directly to the output rows.
+     * findNeighbors() is reentrant, so the ranges can be searched concurrently.
+     */
+    class KNNSearchInvoker : public cv::ParallelLoopBody
+    {
+    public:
+        KNNSearchInvoker(KDTreeSingleIndex* index, const Matrix<ElementType>& queries, Matrix<int>& indices,
+                         Matrix<DistanceType>& dists, int knn, const SearchParams& params) :
+            index_(index), queries_(queries), indices_(indices), dists_(dists), knn_(knn), params_(params)
+        {
+        }
+
+        void operator()(const cv::Range& range) const
+        {
+            KNNSimpleResultSet<DistanceType> resultSet(knn_);
+            for (int i = range.start; i < range.end; i++) {
+                resultSet.init(indices_[i], dists_[i]);
+                index_->findNeighbors(resultSet, queries_[i], params_);
+            }
+        }
+
+    private:
+        KDTreeSingleIndex* index_;
+        const Matrix<ElementType>& queries_;
+        Matrix<int>& indices_;
+        Matrix<DistanceType>& dists_;
+        int knn_;
+        const SearchParams& params_;
+
+        KNNSearchInvoker& operator=(const KNNSearchInvoker&);
+    };
+
 
     /*--------------------- Internal Data Structures --------------------------*/
     struct Node
@@ -370,7 +370,10 @@ public:
 
         root_ = pool_.allocate<KMeansNode>();
         computeNodeStatistics(root_, indices_, (int)size_);
-        computeClustering(root_, indices_, (int)size_, branching_,0);
+        std::vector<BuildTask> roots(1);
+        BuildTask task = { root_, indices_, (int)size_, 0, rand_seed() };
+        roots[0] = task;
+        build_trees(this, roots, pool_);
     }
 
 
@@ -532,7 +535,82 @@ private:
      */
     typedef BranchStruct<KMeansNodePtr, DistanceType> BranchSt;
 
+    /**
+     * A subtree to build: the points indices[0..size-1] are clustered below node.
+     */
+    struct BuildTask
+    {
+        KMeansNodePtr node;
+        int* indices;
+        int size;
+        int level;
+        uint64 seed;
+    };
+
+    friend class BuildTaskInvoker<KMeansIndex, BuildTask>;
 
+    void buildSubtree(const BuildTask& task, PooledAllocator& allocator, std::vector<BuildTask>* deferred)
+    {
+        computeClustering(task.node, task.indices, task.size, branching_, task.level, allocator, deferred);
+    }
+
+    /**
+     * Finds the closest of the cluster centers to a range of points, see assignPoints().
+     */
+    class AssignPointsInvoker : public cv::ParallelLoopBody
+    {
+    public:
+        AssignPointsInvoker(const KMeansIndex* index, const int* indices, const Matrix<double>& dcenters,
+                            int branching, int* labels, DistanceType* dists) :
+            index_(index), indices_(indices), dcenters_(dcenters), branching_(branching), labels_(labels), dists_(dists)
+        {
+        }
+
+        void operator()(const cv::Range& range) const
+        {
+            for (int i = range.start; i < range.end; ++i) {
+                const ElementType* point = index_->dataset_[indices_[i]];
+                DistanceType sq_dist = index_->distance_(point, dcenters_[0], index_->veclen_);
+                int label = 0;
+                for (int j=1; j<branching_; ++j) {
+                    DistanceType new_sq_dist = index_->distance_(point, dcenters_[j], index_->veclen_);
+                    if (sq_dist>new_sq_dist) {
+                        label = j;
+                        sq_dist = new_sq_dist;
+                    }
+                }
+                labels_[i] = label;
+                dists_[i] = sq_dist;
+            }
+        }
+
+    private:
+        const KMeansIndex* index_;
+        const int* indices_;
+        const Matrix<double>& dcenters_;
+        int branching_;
+        int* labels_;
+        DistanceType* dists_;
+
+        AssignPointsInvoker& operator=(const AssignPointsInvoker&);
+    };
+
+    /**
+     * Finds the closest cluster center to each of the points. The points are split
+     * between threads when parallel is set, which is done for the top levels of the
+     * tree, where there are too few subtrees to keep the threads busy.
+     */
+    void assignPoints(const int* indices, int indices_length, const Matrix<double>& dcenters, int branching,
+                      int* labels, DistanceType* dists, bool parallel)
+    {
+        AssignPointsInvoker invoker(this, indices, dcenters, branching, labels, dists);
+        if (parallel) {
+            cv::parallel_for_(cv::Range(0, indices_length), invoker);
+        }
+        else {
+            invoker(cv::Range(0, indices_length));
+        }
+    }
 
 
     void save_tree(FILE* stream, KMeansNodePtr node)
@@ -636,11 +714,21 @@ private:
      *     node = the node to cluster
      *     indices = indices of the points belonging to the current node
      *     branching = the branching factor to use in the clustering
+     *     allocator = the pool the new nodes are allocated from
+     *     deferred = when not NULL, the nodes of up to build_task_size() points are not
+     *                clustered but appended to it, to be built as separate tasks
      *
      * TODO: for 1-sized clusters don't store a cluster center (it's the same as the single cluster point)
      */
-    void computeClustering(KMeansNodePtr node, int* indices, int indices_length, int branching, int level)
+    void computeClustering(KMeansNodePtr node, int* indices, int indices_length, int branching, int level,
+                           PooledAllocator& allocator, std::vector<BuildTask>* deferred)
     {
+        if ((deferred != NULL) && (indices_length <= (int)build_task_size(size_))) {
+            BuildTask task = { node, indices, indices_length, level, rand_seed() };
+            deferred->push_back(task);
+            return;
+        }
+
         node->size = indices_length;
         node->level = level;
 
@@ -681,18 +769,13 @@ private:
         }
 
         //	assign points to clusters
+        bool parallel = deferred != NULL;
         int* belongs_to = new int[indices_length];
+        std::vector<int> labels(indices_length);
+        std::vector<DistanceType> sq_dists(indices_length);
+        assignPoints(indices, indices_length, dcenters, branching, belongs_to, &sq_dists[0], parallel);
         for (int i=0; i<indices_length; ++i) {
-
-            DistanceType sq_dist = distance_(dataset_[indices[i]], dcenters[0], veclen_);
-            belongs_to[i] = 0;
-            for (int j=1; j<branching; ++j) {
-                DistanceType new_sq_dist = distance_(dataset_[indices[i]], dcenters[j], veclen_);
-                if (sq_dist>new_sq_dist) {
-                    belongs_to[i] = j;
-                    sq_dist = new_sq_dist;
-                }
-            }
+            DistanceType sq_dist = sq_dists[i];
             if (sq_dist>radiuses[belongs_to[i]]) {
                 radiuses[belongs_to[i]] = sq_dist;
             }
@@ -725,16 +808,10 @@ private:
             }
 
             // reassign points to clusters
+            assignPoints(indices, indices_length, dcenters, branching, &labels[0], &sq_dists[0], parallel);
             for (int i=0; i<indices_length; ++i) {
-                DistanceType sq_dist = distance_(dataset_[indices[i]], dcenters[0], veclen_);
-                int new_centroid = 0;
-                for (int j=1; j<branching; ++j) {
-                    DistanceType new_sq_dist = distance_(dataset_[indices[i]], dcenters[j], veclen_);
-                    if (sq_dist>new_sq_dist) {
-                        new_centroid = j;
-                        sq_dist = new_sq_dist;
-                    }
-                }
+                DistanceType sq_dist = sq_dists[i];
+                int new_centroid = labels[i];
                 if (sq_dist>radiuses[new_centroid]) {
                     radiuses[new_centroid] = sq_dist;
                 }
@@ -774,7 +851,7 @@ private:
 
         for (int i=0; i<branching; ++i) {
             centers[i] = new DistanceType[veclen_];
-            memoryCounter_ += (int)(veclen_*sizeof(DistanceType));
+            CV_XADD(&memoryCounter_, (int)(veclen_*sizeof(DistanceType)));
             for (size_t k=0; k<veclen_; ++k) {
                 centers[i][k] = (DistanceType)dcenters[i][k];
             }
@@ -782,7 +859,7 @@ private:
 
 
         // compute kmeans clustering for each of the resulting clusters
-        node->childs = pool_.allocate<KMeansNodePtr>(branching);
+        node->childs = allocator.allocate<KMeansNodePtr>(branching);
         int start = 0;
         int end = start;
         for (int c=0; c<branching; ++c) {
@@ -804,13 +881,13 @@ private:
             mean_radius /= s;
             variance -= distance_(centers[c], ZeroIterator<ElementType>(), veclen_);
 
-            node->childs[c] = pool_.allocate<KMeansNode>();
+            node->childs[c] = allocator.allocate<KMeansNode>();
             node->childs[c]->radius = radiuses[c];
             node->childs[c]->pivot = centers[c];
             node->childs[c]->variance = variance;
             node->childs[c]->mean_radius = mean_radius;
             node->childs[c]->indices = NULL;
-            computeClustering(node->childs[c],indices+start, end-start, branching, level+1);
+            computeClustering(node->childs[c],indices+start, end-start, branching, level+1, allocator, deferred);
             start=end;
         }
 
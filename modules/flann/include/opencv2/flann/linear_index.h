@@ -90,6 +90,12 @@ public:
         /* nothing to do here for linear search */
     }
 
+    bool addPoints(const Matrix<ElementType>& dataset)
+    {
+        dataset_ = dataset;
+        return true;
+    }
+
     void saveIndex(FILE*)
     {
         /* nothing to do here for linear search */
@@ -119,7 +125,7 @@ public:
 
 private:
     /** The dataset */
-    const Matrix<ElementType> dataset_;
+    Matrix<ElementType> dataset_;
     /** Index parameters */
     IndexParams index_params_;
     /** Index distance */
@@ -113,10 +113,26 @@ public:
         for (unsigned int i = 0; i < table_number_; ++i) {
             lsh::LshTable<ElementType>& table = tables_[i];
             table = lsh::LshTable<ElementType>(feature_size_, key_size_);
+        }
+
+        // Add the features to the tables
+        cv::parallel_for_(cv::Range(0, (int)table_number_), AddPointsInvoker(this, 0));
+    }
 
-            // Add the features to the table
-            table.add(dataset_);
+    /**
+     * Adds the points appended to the dataset to the hash tables
+     */
+    bool addPoints(const Matrix<ElementType>& dataset)
+    {
+        if (tables_.empty()) {
+            return false;
         }
+        assert(dataset.rows >= dataset_.rows && dataset.cols == dataset_.cols);
+
+        unsigned int first = (unsigned int)dataset_.rows;
+        dataset_ = dataset;
+        cv::parallel_for_(cv::Range(0, (int)table_number_), AddPointsInvoker(this, first));
+        return true;
     }
 
     flann_algorithm_t getType() const
@@ -139,6 +155,9 @@ public:
         load_value(stream, key_size_);
         load_value(stream, multi_probe_level_);
         load_value(stream, dataset_);
+        // the masks were built for the key size passed to the constructor
+        xor_masks_.clear();
+        fill_xor_mask(0, key_size_, multi_probe_level_, xor_masks_);
         // Building the index is so fast we can afford not storing it
         buildIndex();
 
@@ -170,7 +189,9 @@ public:
      */
     int usedMemory() const
     {
-        return (int)(dataset_.rows * sizeof(int));
+        size_t memory = 0;
+        for (size_t i = 0; i < tables_.size(); ++i) memory += tables_[i].usedMemory();
+        return (int)memory;
     }
 
 
@@ -179,35 +200,6 @@ public:
         return index_params_;
     }
 
-    /**
-     * \brief Perform k-nearest neighbor search
-     * \param[in] queries The query points for which to find the nearest neighbors
-     * \param[out] indices The indices of the nearest neighbors found
-     * \param[out] dists Distances to the nearest neighbors found
-     * \param[in] knn Number of nearest neighbors to return
-     * \param[in] params Search parameters
-     */
-    virtual void knnSearch(const Matrix<ElementType>& queries, Matrix<int>& indices, Matrix<DistanceType>& dists, int knn, const SearchParams& params)
-    {
-        assert(queries.cols == veclen());
-        assert(indices.rows >= queries.rows);
-        assert(dists.rows >= queries.rows);
-        assert(int(indices.cols) >= knn);
-        assert(int(dists.cols) >= knn);
-
-
-        KNNUniqueResultSet<DistanceType> resultSet(knn);
-        for (size_t i = 0; i < queries.rows; i++) {
-            resultSet.clear();
-            std::fill_n(indices[i], knn, -1);
-            std::fill_n(dists[i], knn, std::numeric_limits<DistanceType>::max());
-            findNeighbors(resultSet, queries[i], params);
-            if (get_param(params,"sorted",true)) resultSet.sortAndCopy(indices[i], dists[i], knn);
-            else resultSet.copy(indices[i], dists[i], knn);
-        }
-    }
-
-
     /**
      * Find set of nearest neighbors to vec. Their indices are stored inside
      * the result object.
@@ -223,15 +215,27 @@ public:
     }
 
 private:
-    /** Defines the comparator on score and index
+    /**
+     * Adds the rows of the dataset from a given one to a range of the hash tables. The
+     * masks of the tables are drawn beforehand, so the tables do not depend on the threads.
      */
-    typedef std::pair<float, unsigned int> ScoreIndexPair;
-    struct SortScoreIndexPairOnSecond
+    class AddPointsInvoker : public cv::ParallelLoopBody
     {
-        bool operator()(const ScoreIndexPair& left, const ScoreIndexPair& right) const
+    public:
+        AddPointsInvoker(LshIndex* index, unsigned int first) : index_(index), first_(first)
         {
-            return left.second < right.second;
         }
+
+        void operator()(const cv::Range& range) const
+        {
+            for (int i = range.start; i < range.end; ++i) {
+                index_->tables_[i].add(index_->dataset_, first_);
+            }
+        }
+
+    private:
+        LshIndex* index_;
+        unsigned int first_;
     };
 
     /** Fills the different xor masks to use when getting the neighbors in multi-probe LSH
@@ -253,117 +257,49 @@ private:
     }
 
     /** Performs the approximate nearest-neighbor search.
+     * The query is hashed with all the tables and the probed buckets are gathered first, then
+     * the candidates are copied to one array, and their distances computed in a single loop
+     * that fetches the rows a few candidates ahead.
      * @param vec the feature to analyze
-     * @param do_radius flag indicating if we check the radius too
-     * @param radius the radius if it is a radius search
-     * @param do_k flag indicating if we limit the number of nn
-     * @param k_nn the number of nearest neighbors
-     * @param checked_average used for debugging
      */
-    void getNeighbors(const ElementType* vec, bool /*do_radius*/, float radius, bool do_k, unsigned int k_nn,
-                      float& /*checked_average*/)
+    void getNeighbors(const ElementType* vec, ResultSet<DistanceType>& result)
     {
-        static std::vector<ScoreIndexPair> score_index_heap;
-
-        if (do_k) {
-            unsigned int worst_score = std::numeric_limits<unsigned int>::max();
-            typename std::vector<lsh::LshTable<ElementType> >::const_iterator table = tables_.begin();
-            typename std::vector<lsh::LshTable<ElementType> >::const_iterator table_end = tables_.end();
-            for (; table != table_end; ++table) {
-                size_t key = table->getKey(vec);
-                std::vector<lsh::BucketKey>::const_iterator xor_mask = xor_masks_.begin();
-                std::vector<lsh::BucketKey>::const_iterator xor_mask_end = xor_masks_.end();
-                for (; xor_mask != xor_mask_end; ++xor_mask) {
-                    size_t sub_key = key ^ (*xor_mask);
-                    const lsh::Bucket* bucket = table->getBucketFromKey(sub_key);
-                    if (bucket == 0) continue;
-
-                    // Go over each descriptor index
-                    std::vector<lsh::FeatureIndex>::const_iterator training_index = bucket->begin();
-                    std::vector<lsh::FeatureIndex>::const_iterator last_training_index = bucket->end();
-                    DistanceType hamming_distance;
-
-                    // Process the rest of the candidates
-                    for (; training_index < last_training_index; ++training_index) {
-                        hamming_distance = distance_(vec, dataset_[*training_index], dataset_.cols);
-
-                        if (hamming_distance < worst_score) {
-                            // Insert the new element
-                            score_index_heap.push_back(ScoreIndexPair(hamming_distance, training_index));
-                            std::push_heap(score_index_heap.begin(), score_index_heap.end());
-
-                            if (score_index_heap.size() > (unsigned int)k_nn) {
-                                // Remove the highest distance value as we have too many elements
-                                std::pop_heap(score_index_heap.begin(), score_index_heap.end());
-                                score_index_heap.pop_back();
-                                // Keep track of the worst score
-                                worst_score = score_index_heap.front().first;
-                            }
-                        }
-                    }
-                }
+        const size_t n_masks = xor_masks_.size();
+        cv::AutoBuffer<lsh::Bucket> buckets(tables_.size() * n_masks);
+        size_t n_buckets = 0, n_candidates = 0;
+        for (size_t i = 0; i < tables_.size(); ++i) {
+            size_t key = tables_[i].getKey(vec);
+            for (size_t j = 0; j < n_masks; ++j) {
+                lsh::Bucket bucket = tables_[i].getBucketFromKey((lsh::BucketKey)(key ^ xor_masks_[j]));
+                if (bucket.empty()) continue;
+                buckets[n_buckets++] = bucket;
+                n_candidates += bucket.size();
             }
         }
-        else {
-            typename std::vector<lsh::LshTable<ElementType> >::const_iterator table = tables_.begin();
-            typename std::vector<lsh::LshTable<ElementType> >::const_iterator table_end = tables_.end();
-            for (; table != table_end; ++table) {
-                size_t key = table->getKey(vec);
-                std::vector<lsh::BucketKey>::const_iterator xor_mask = xor_masks_.begin();
-                std::vector<lsh::BucketKey>::const_iterator xor_mask_end = xor_masks_.end();
-                for (; xor_mask != xor_mask_end; ++xor_mask) {
-                    size_t sub_key = key ^ (*xor_mask);
-                    const lsh::Bucket* bucket = table->getBucketFromKey(sub_key);
-                    if (bucket == 0) continue;
-
-                    // Go over each descriptor index
-                    std::vector<lsh::FeatureIndex>::const_iterator training_index = bucket->begin();
-                    std::vector<lsh::FeatureIndex>::const_iterator last_training_index = bucket->end();
-                    DistanceType hamming_distance;
-
-                    // Process the rest of the candidates
-                    for (; training_index < last_training_index; ++training_index) {
-                        // Compute the Hamming distance
-                        hamming_distance = distance_(vec, dataset_[*training_index], dataset_.cols);
-                        if (hamming_distance < radius) score_index_heap.push_back(ScoreIndexPair(hamming_distance, training_index));
-                    }
-                }
-            }
+
+        cv::AutoBuffer<lsh::FeatureIndex> candidates(n_candidates);
+        lsh::FeatureIndex* candidate = candidates;
+        for (size_t i = 0; i < n_buckets; ++i) {
+            candidate = std::copy(buckets[i].begin(), buckets[i].end(), candidate);
         }
-    }
 
-    /** Performs the approximate nearest-neighbor search.
-     * This is a slower version than the above as it uses the ResultSet
-     * @param vec the feature to analyze
-     */
-    void getNeighbors(const ElementType* vec, ResultSet<DistanceType>& result)
-    {
-        typename std::vector<lsh::LshTable<ElementType> >::const_iterator table = tables_.begin();
-        typename std::vector<lsh::LshTable<ElementType> >::const_iterator table_end = tables_.end();
-        for (; table != table_end; ++table) {
-            size_t key = table->getKey(vec);
-            std::vector<lsh::BucketKey>::const_iterator xor_mask = xor_masks_.begin();
-            std::vector<lsh::BucketKey>::const_iterator xor_mask_end = xor_masks_.end();
-            for (; xor_mask != xor_mask_end; ++xor_mask) {
-                size_t sub_key = key ^ (*xor_mask);
-                const lsh::Bucket* bucket = table->getBucketFromKey((lsh::BucketKey)sub_key);
-                if (bucket == 0) continue;
-
-                // Go over each descriptor index
-                std::vector<lsh::FeatureIndex>::const_iterator training_index = bucket->begin();
-                std::vector<lsh::FeatureIndex>::const_iterator last_training_index = bucket->end();
-                DistanceType hamming_distance;
-
-                // Process the rest of the candidates
-                for (; training_index < last_training_index; ++training_index) {
-                    // Compute the Hamming distance
-                    hamming_distance = distance_(vec, dataset_[*training_index], (int)dataset_.cols);
-                    result.addPoint(hamming_distance, *training_index);
-                }
+        for (size_t i = 0; i < n_candidates; ++i) {
+#if CV_SSE
+            if (i + kPrefetchDistance < n_candidates) {
+                const char* row = reinterpret_cast<const char*>(dataset_[candidates[i + kPrefetchDistance]]);
+                _mm_prefetch(row, _MM_HINT_T0);
+                _mm_prefetch(row + dataset_.cols * sizeof(ElementType) - 1, _MM_HINT_T0);
             }
+#endif
+            // Compute the Hamming distance
+            DistanceType hamming_distance = distance_(vec, dataset_[candidates[i]], (int)dataset_.cols);
+            result.addPoint(hamming_distance, candidates[i]);
         }
     }
 
+    /** How many candidates ahead the rows are fetched */
+    enum { kPrefetchDistance = 8 };
+
     /** The different hash tables */
     std::vector<lsh::LshTable<ElementType> > tables_;
 
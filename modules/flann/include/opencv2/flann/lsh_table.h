@@ -39,21 +39,10 @@
 #include <iostream>
 #include <iomanip>
 #include <limits.h>
-// TODO as soon as we use C++0x, use the code in USE_UNORDERED_MAP
-#ifdef __GXX_EXPERIMENTAL_CXX0X__
-#  define USE_UNORDERED_MAP 1
-#else
-#  define USE_UNORDERED_MAP 0
-#endif
-#if USE_UNORDERED_MAP
-#include <unordered_map>
-#else
-#include <map>
-#endif
 #include <math.h>
 #include <stddef.h>
+#include <vector>
 
-#include "dynamic_bitset.h"
 #include "matrix.h"
 
 namespace cvflann
@@ -71,9 +60,43 @@ typedef uint32_t FeatureIndex;
  */
 typedef unsigned int BucketKey;
 
-/** A bucket in an LSH table
+/** A bucket in an LSH table: the range of the table's feature indices stored under a key
  */
-typedef std::vector<FeatureIndex> Bucket;
+class Bucket
+{
+public:
+    Bucket() : begin_(0), end_(0)
+    {
+    }
+
+    Bucket(const FeatureIndex* first, const FeatureIndex* last) : begin_(first), end_(last)
+    {
+    }
+
+    const FeatureIndex* begin() const
+    {
+        return begin_;
+    }
+
+    const FeatureIndex* end() const
+    {
+        return end_;
+    }
+
+    size_t size() const
+    {
+        return end_ - begin_;
+    }
+
+    bool empty() const
+    {
+        return begin_ == end_;
+    }
+
+private:
+    const FeatureIndex* begin_;
+    const FeatureIndex* end_;
+};
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -125,23 +148,15 @@ inline std::ostream& operator <<(std::ostream& out, const LshStats& stats)
  * the size of it is pretty small, we keep it as a continuous memory array.
  * The value is an index in the corpus of features (we keep it as an unsigned
  * int for pure memory reasons, it could be a size_t)
+ *
+ * All the feature indices are stored in a single array, grouped by key; a bucket is a range
+ * of that array. The ranges are found either directly from the key, when more than half
+ * of the keys are used, or through an open-addressing hash table with linear probing.
  */
 template<typename ElementType>
 class LshTable
 {
 public:
-    /** A container of all the feature indices. Optimized for space
-     */
-#if USE_UNORDERED_MAP
-    typedef std::unordered_map<BucketKey, Bucket> BucketsSpace;
-#else
-    typedef std::map<BucketKey, Bucket> BucketsSpace;
-#endif
-
-    /** A container of all the feature indices. Optimized for speed
-     */
-    typedef std::vector<Bucket> BucketsSpeed;
-
     /** Default constructor
      */
     LshTable()
@@ -159,77 +174,62 @@ public:
         assert(0);
     }
 
-    /** Add a feature to the table
-     * @param value the value to store for that feature
-     * @param feature the feature itself
+    /** Add a set of features to the table
+     * @param dataset the values to store
+     * @param first the first row of dataset to add; the rows before it are already in the table
      */
-    void add(unsigned int value, const ElementType* feature)
+    void add(Matrix<ElementType> dataset, unsigned int first = 0)
     {
-        // Add the value to the corresponding bucket
-        BucketKey key = (lsh::BucketKey)getKey(feature);
-
-        switch (speed_level_) {
-        case kArray:
-            // That means we get the buckets from an array
-            buckets_speed_[key].push_back(value);
-            break;
-        case kBitsetHash:
-            // That means we can check the bitset for the presence of a key
-            key_bitset_.set(key);
-            buckets_space_[key].push_back(value);
-            break;
-        case kHash:
-        {
-            // That means we have to check for the hash table for the presence of a key
-            buckets_space_[key].push_back(value);
-            break;
+        // Gather the (key, index) pairs of the features already in the table and of the new
+        // ones, with the key in the upper 32 bits, and lay the buckets out again
+        std::vector<uint64_t> entries;
+        entries.reserve(features_.size() + dataset.rows - first);
+        if (speed_level_ == kArray) {
+            for (size_t key = 0; key + 1 < offsets_.size(); ++key) {
+                for (FeatureIndex i = offsets_[key]; i < offsets_[key + 1]; ++i) {
+                    entries.push_back(((uint64_t)key << 32) | features_[i]);
+                }
+            }
+        }
+        else {
+            for (size_t i = 0; i < slots_.size(); ++i) {
+                const Slot& slot = slots_[i];
+                for (FeatureIndex j = slot.begin; j < slot.begin + slot.size; ++j) {
+                    entries.push_back(((uint64_t)slot.key << 32) | features_[j]);
+                }
+            }
         }
+        for (size_t i = first; i < dataset.rows; ++i) {
+            entries.push_back(((uint64_t)getKey(dataset[i]) << 32) | i);
         }
-    }
 
-    /** Add a set of features to the table
-     * @param dataset the values to store
-     */
-    void add(Matrix<ElementType> dataset)
-    {
-#if USE_UNORDERED_MAP
-        buckets_space_.rehash((buckets_space_.size() + dataset.rows) * 1.2);
-#endif
-        // Add the features to the table
-        for (unsigned int i = 0; i < dataset.rows; ++i) add(i, dataset[i]);
-        // Now that the table is full, optimize it for speed/space
-        optimize();
+        sortByKey(entries);
+        layout(entries);
     }
 
     /** Get a bucket given the key
      * @param key
-     * @return
+     * @return the bucket, empty if no feature has that key
      */
-    inline const Bucket* getBucketFromKey(BucketKey key) const
+    inline Bucket getBucketFromKey(BucketKey key) const
     {
-        // Generate other buckets
-        switch (speed_level_) {
-        case kArray:
+        if (speed_level_ == kArray) {
             // That means we get the buckets from an array
-            return &buckets_speed_[key];
-            break;
-        case kBitsetHash:
-            // That means we can check the bitset for the presence of a key
-            if (key_bitset_.test(key)) return &buckets_space_.find(key)->second;
-            else return 0;
-            break;
-        case kHash:
-        {
-            // That means we have to check for the hash table for the presence of a key
-            BucketsSpace::const_iterator bucket_it, bucket_end = buckets_space_.end();
-            bucket_it = buckets_space_.find(key);
-            // Stop here if that bucket does not exist
-            if (bucket_it == bucket_end) return 0;
-            else return &bucket_it->second;
-            break;
+            const FeatureIndex* features = &features_[0];
+            return Bucket(features + offsets_[key], features + offsets_[key + 1]);
         }
+
+        // That means we have to look for the key in the hash table
+        const size_t mask = slots_.size() - 1;
+        for (size_t i = hashKey(key); ; i = (i + 1) & mask) {
+            const Slot& slot = slots_[i];
+            // Stop here if that bucket does not exist
+            if (slot.size == 0) return Bucket();
+            if (slot.key == key) {
+                const FeatureIndex* features = &features_[slot.begin];
+                return Bucket(features, features + slot.size);
+            }
         }
-        return 0;
     }
 
     /** Compute the sub-signature of a feature
@@ -246,15 +246,35 @@ public:
      */
     LshStats getStats() const;
 
+    /** Computes the memory used by the table
+     */
+    size_t usedMemory() const
+    {
+        return features_.size() * sizeof(FeatureIndex) + offsets_.size() * sizeof(FeatureIndex) +
+               slots_.size() * sizeof(Slot) + mask_.size() * sizeof(size_t);
+    }
+
 private:
     /** defines the speed fo the implementation
-     * kArray uses a vector for storing data
-     * kBitsetHash uses a hash map but checks for the validity of a key with a bitset
-     * kHash uses a hash map only
+     * kArray uses an array of offsets indexed by the key
+     * kHash uses an open-addressing hash table
      */
     enum SpeedLevel
     {
-        kArray, kBitsetHash, kHash
+        kArray, kHash
+    };
+
+    /** An entry of the hash table; the entries with no feature are free
+     */
+    struct Slot
+    {
+        Slot() : key(0), begin(0), size(0)
+        {
+        }
+
+        BucketKey key;
+        FeatureIndex begin;
+        FeatureIndex size;
     };
 
     /** Initialize some variables
@@ -271,58 +291,94 @@ private:
 
         speed_level_ = kHash;
         key_size_ = (unsigned)key_size;
+        slots_.assign(2, Slot());
+        slot_shift_ = 31;
+    }
+
+    /** The first slot to look at for a key (Fibonacci hashing)
+     */
+    inline size_t hashKey(BucketKey key) const
+    {
+        return (uint32_t)(key * 2654435761U) >> slot_shift_;
     }
 
-    /** Optimize the table for speed/space
+    /** Sorts the (key, index) pairs on their key, 16 bits at a time; the sort is stable so
+     * the indices of a bucket stay in the order they were added
      */
-    void optimize()
+    void sortByKey(std::vector<uint64_t>& entries) const
     {
-        // If we are already using the fast storage, no need to do anything
-        if (speed_level_ == kArray) return;
+        std::vector<uint64_t> sorted(entries.size());
+        std::vector<size_t> offsets;
+        for (unsigned int shift = 32; shift < 32 + key_size_; shift += 16) {
+            const uint64_t digit_mask = (uint64_t(1) << std::min(16U, 32 + key_size_ - shift)) - 1;
+            offsets.assign((size_t)digit_mask + 2, 0);
+            for (size_t i = 0; i < entries.size(); ++i) ++offsets[(size_t)((entries[i] >> shift) & digit_mask) + 1];
+            for (size_t i = 1; i < offsets.size(); ++i) offsets[i] += offsets[i - 1];
+            for (size_t i = 0; i < entries.size(); ++i) sorted[offsets[(size_t)((entries[i] >> shift) & digit_mask)]++] = entries[i];
+            entries.swap(sorted);
+        }
+    }
+
+    /** Stores the sorted (key, index) pairs and indexes the buckets for speed/space
+     */
+    void layout(const std::vector<uint64_t>& entries)
+    {
+        size_t n_keys = 0;
+        features_.resize(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            features_[i] = (FeatureIndex)entries[i];
+            if (i == 0 || (entries[i] >> 32) != (entries[i - 1] >> 32)) ++n_keys;
+        }
 
         // Use an array if it will be more than half full
-        if (buckets_space_.size() > ((size_t(1) << key_size_) / 2)) {
+        if (n_keys > ((size_t(1) << key_size_) / 2)) {
             speed_level_ = kArray;
-            // Fill the array version of it
-            buckets_speed_.resize(size_t(1) << key_size_);
-            for (BucketsSpace::const_iterator key_bucket = buckets_space_.begin(); key_bucket != buckets_space_.end(); ++key_bucket) buckets_speed_[key_bucket->first] = key_bucket->second;
-
-            // Empty the hash table
-            buckets_space_.clear();
+            offsets_.assign((size_t(1) << key_size_) + 1, 0);
+            for (size_t i = 0; i < entries.size(); ++i) ++offsets_[(size_t)(entries[i] >> 32) + 1];
+            for (size_t key = 1; key < offsets_.size(); ++key) offsets_[key] += offsets_[key - 1];
+            std::vector<Slot>().swap(slots_);
             return;
         }
 
-        // If the bitset is going to use less than 10% of the RAM of the hash map (at least 1 size_t for the key and two
-        // for the vector) or less than 512MB (key_size_ <= 30)
-        if (((std::max(buckets_space_.size(), buckets_speed_.size()) * CHAR_BIT * 3 * sizeof(BucketKey)) / 10
-             >= (size_t(1) << key_size_)) || (key_size_ <= 32)) {
-            speed_level_ = kBitsetHash;
-            key_bitset_.resize(size_t(1) << key_size_);
-            key_bitset_.reset();
-            // Try with the BucketsSpace
-            for (BucketsSpace::const_iterator key_bucket = buckets_space_.begin(); key_bucket != buckets_space_.end(); ++key_bucket) key_bitset_.set(key_bucket->first);
-        }
-        else {
-            speed_level_ = kHash;
-            key_bitset_.clear();
+        // Keep the hash table at most half full so that the probing sequences stay short
+        speed_level_ = kHash;
+        std::vector<FeatureIndex>().swap(offsets_);
+        unsigned int slot_bits = 1;
+        while ((size_t(1) << slot_bits) < 2 * n_keys) ++slot_bits;
+        slots_.assign(size_t(1) << slot_bits, Slot());
+        slot_shift_ = 32 - slot_bits;
+
+        const size_t mask = slots_.size() - 1;
+        for (size_t begin = 0, end; begin < entries.size(); begin = end) {
+            BucketKey key = (BucketKey)(entries[begin] >> 32);
+            for (end = begin + 1; end < entries.size() && (BucketKey)(entries[end] >> 32) == key; ++end) ;
+
+            size_t i = hashKey(key);
+            while (slots_[i].size != 0) i = (i + 1) & mask;
+            slots_[i].key = key;
+            slots_[i].begin = (FeatureIndex)begin;
+            slots_[i].size = (FeatureIndex)(end - begin);
         }
     }
 
-    /** The vector of all the buckets if they are held for speed
+    /** The indices of all the features, sorted by key
      */
-    BucketsSpeed buckets_speed_;
+    std::vector<FeatureIndex> features_;
 
-    /** The hash table of all the buckets in case we cannot use the speed version
+    /** The beginning of the bucket of each key in features_, if the buckets are held for speed
      */
-    BucketsSpace buckets_space_;
+    std::vector<FeatureIndex> offsets_;
 
-    /** What is used to store the data */
-    SpeedLevel speed_level_;
+    /** The hash table of the buckets in case we cannot use the speed version
+     */
+    std::vector<Slot> slots_;
 
-    /** If the subkey is small enough, it will keep track of which subkeys are set through that bitset
-     * That is just a speedup so that we don't look in the hash table (which can be mush slower that checking a bitset)
+    /** The hash of a key is its product with 2^32/phi, shifted right by that amount
      */
-    DynamicBitset key_bitset_;
+    unsigned int slot_shift_;
+
+    /** What is used to store the data */
+    SpeedLevel speed_level_;
 
     /** The size of the sub-signature in bits
      */
@@ -412,12 +468,12 @@ inline size_t LshTable<unsigned char>::getKey(const unsigned char* feature) cons
     return subsignature;
 }
 
-template<>
-inline LshStats LshTable<unsigned char>::getStats() const
+template<typename ElementType>
+inline LshStats LshTable<ElementType>::getStats() const
 {
     LshStats stats;
     stats.bucket_size_mean_ = 0;
-    if ((buckets_speed_.empty()) && (buckets_space_.empty())) {
+    if (features_.empty()) {
         stats.n_buckets_ = 0;
         stats.bucket_size_median_ = 0;
         stats.bucket_size_min_ = 0;
@@ -425,22 +481,18 @@ inline LshStats LshTable<unsigned char>::getStats() const
         return stats;
     }
 
-    if (!buckets_speed_.empty()) {
-        for (BucketsSpeed::const_iterator pbucket = buckets_speed_.begin(); pbucket != buckets_speed_.end(); ++pbucket) {
-            stats.bucket_sizes_.push_back((lsh::FeatureIndex)pbucket->size());
-            stats.bucket_size_mean_ += pbucket->size();
+    if (speed_level_ == kArray) {
+        for (size_t key = 0; key + 1 < offsets_.size(); ++key) {
+            stats.bucket_sizes_.push_back(offsets_[key + 1] - offsets_[key]);
         }
-        stats.bucket_size_mean_ /= buckets_speed_.size();
-        stats.n_buckets_ = buckets_speed_.size();
     }
     else {
-        for (BucketsSpace::const_iterator x = buckets_space_.begin(); x != buckets_space_.end(); ++x) {
-            stats.bucket_sizes_.push_back((lsh::FeatureIndex)x->second.size());
-            stats.bucket_size_mean_ += x->second.size();
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            if (slots_[i].size != 0) stats.bucket_sizes_.push_back(slots_[i].size);
         }
-        stats.bucket_size_mean_ /= buckets_space_.size();
-        stats.n_buckets_ = buckets_space_.size();
     }
+    stats.n_buckets_ = stats.bucket_sizes_.size();
+    stats.bucket_size_mean_ = features_.size() / stats.n_buckets_;
 
     std::sort(stats.bucket_sizes_.begin(), stats.bucket_sizes_.end());
 
@@ -115,6 +115,12 @@ struct CV_EXPORTS LshIndexParams : public IndexParams
     LshIndexParams(int table_number, int key_size, int multi_probe_level);
 };
 
+struct CV_EXPORTS PQIndexParams : public IndexParams
+{
+    PQIndexParams(int lists = 256, int code_size = 16, int rerank = 0,
+                  int training_samples = 100000, int iterations = 10);
+};
+
 struct CV_EXPORTS SavedIndexParams : public IndexParams
 {
     SavedIndexParams(const String& filename);
@@ -125,6 +131,8 @@ struct CV_EXPORTS SearchParams : public IndexParams
     SearchParams( int checks = 32, float eps = 0, bool sorted = true );
 };
 
+struct MappedIndexFile;
+
 class CV_EXPORTS_W Index
 {
 public:
@@ -133,6 +141,7 @@ public:
     virtual ~Index();
 
     CV_WRAP virtual void build(InputArray features, const IndexParams& params, cvflann::flann_distance_t distType=cvflann::FLANN_DIST_L2);
+    CV_WRAP virtual void addPoints(InputArray features, float rebuildThreshold=2);
     CV_WRAP virtual void knnSearch(InputArray query, OutputArray indices,
                    OutputArray dists, int knn, const SearchParams& params=SearchParams());
 
@@ -141,7 +150,9 @@ public:
                              const SearchParams& params=SearchParams());
 
     CV_WRAP virtual void save(const String& filename) const;
+    CV_WRAP virtual void save(const String& filename, InputArray features) const;
     CV_WRAP virtual bool load(InputArray features, const String& filename);
+    CV_WRAP virtual bool load(const String& filename);
     CV_WRAP virtual void release();
     CV_WRAP cvflann::flann_distance_t getDistance() const;
     CV_WRAP cvflann::flann_algorithm_t getAlgorithm() const;
@@ -151,6 +162,7 @@ protected:
     cvflann::flann_algorithm_t algo;
     int featureType;
     void* index;
+    Ptr<MappedIndexFile> mappedFile;
 };
 
 } } // namespace cv::flann
@@ -35,10 +35,187 @@
 #include "matrix.h"
 #include "result_set.h"
 #include "params.h"
+#include "allocator.h"
+#include "random.h"
+#include "opencv2/core/utility.hpp"
 
 namespace cvflann
 {
 
+template <typename Distance> class NNIndex;
+
+/**
+ * Searches the k nearest neighbours of a range of query rows. findNeighbors() keeps its
+ * search state (heaps, checked flags) on the stack and every range has its own result set,
+ * so the ranges can be searched concurrently, and each row gets the same result whichever
+ * way the rows are split between threads.
+ */
+template <typename Distance>
+class KNNSearchInvoker : public cv::ParallelLoopBody
+{
+    typedef typename Distance::ElementType ElementType;
+    typedef typename Distance::ResultType DistanceType;
+
+public:
+    KNNSearchInvoker(NNIndex<Distance>* index, const Matrix<ElementType>& queries, Matrix<int>& indices,
+                     Matrix<DistanceType>& dists, int knn, const SearchParams& params) :
+        index_(index), queries_(queries), indices_(indices), dists_(dists), knn_(knn), params_(params),
+        sorted_(get_param(params,"sorted",true))
+    {
+    }
+
+    void operator()(const cv::Range& range) const
+    {
+        KNNUniqueResultSet<DistanceType> resultSet(knn_);
+        for (int i = range.start; i < range.end; i++) {
+            resultSet.clear();
+            std::fill_n(indices_[i], knn_, -1);
+            std::fill_n(dists_[i], knn_, std::numeric_limits<DistanceType>::max());
+            index_->findNeighbors(resultSet, queries_[i], params_);
+            if (sorted_) resultSet.sortAndCopy(indices_[i], dists_[i], knn_);
+            else resultSet.copy(indices_[i], dists_[i], knn_);
+        }
+    }
+
+private:
+    NNIndex<Distance>* index_;
+    const Matrix<ElementType>& queries_;
+    Matrix<int>& indices_;
+    Matrix<DistanceType>& dists_;
+    int knn_;
+    const SearchParams& params_;
+    bool sorted_;
+
+    KNNSearchInvoker& operator=(const KNNSearchInvoker&);
+};
+
+/**
+ * Searches the neighbours within a radius of a range of query rows, see KNNSearchInvoker.
+ * The number of neighbours found for row i is stored in counts[i].
+ */
+template <typename Distance>
+class RadiusSearchInvoker : public cv::ParallelLoopBody
+{
+    typedef typename Distance::ElementType ElementType;
+    typedef typename Distance::ResultType DistanceType;
+
+public:
+    RadiusSearchInvoker(NNIndex<Distance>* index, const Matrix<ElementType>& queries, Matrix<int>& indices,
+                        Matrix<DistanceType>& dists, float radius, const SearchParams& params, int* counts) :
+        index_(index), queries_(queries), indices_(indices), dists_(dists), radius_(radius), params_(params),
+        sorted_(get_param(params,"sorted",true)), counts_(counts)
+    {
+    }
+
+    void operator()(const cv::Range& range) const
+    {
+        int n = (int)indices_.cols;
+        RadiusUniqueResultSet<DistanceType> resultSet((DistanceType)radius_);
+        for (int i = range.start; i < range.end; i++) {
+            resultSet.clear();
+            index_->findNeighbors(resultSet, queries_[i], params_);
+            if (n>0) {
+                if (sorted_) resultSet.sortAndCopy(indices_[i], dists_[i], n);
+                else resultSet.copy(indices_[i], dists_[i], n);
+            }
+            counts_[i] = (int)resultSet.size();
+        }
+    }
+
+private:
+    NNIndex<Distance>* index_;
+    const Matrix<ElementType>& queries_;
+    Matrix<int>& indices_;
+    Matrix<DistanceType>& dists_;
+    float radius_;
+    const SearchParams& params_;
+    bool sorted_;
+    int* counts_;
+
+    RadiusSearchInvoker& operator=(const RadiusSearchInvoker&);
+};
+
+/**
+ * The number of points up to which the subtrees of an index of the given size
+ * are built as separate tasks. It does not depend on the number of threads, so
+ * neither do the random choices made while building.
+ */
+inline size_t build_task_size(size_t size)
+{
+    return std::max(size/64, (size_t)1024);
+}
+
+/**
+ * Runs construction tasks of an index by calling index->buildSubtree(task, pool, deferred)
+ * for each of them. Every task allocates its nodes from its own pool and draws its random
+ * numbers from its own seed, so the tasks can run concurrently. When deferred is not NULL,
+ * task i appends the subtrees it leaves to be built later to deferred[i].
+ */
+template <typename Index, typename Task>
+class BuildTaskInvoker : public cv::ParallelLoopBody
+{
+public:
+    BuildTaskInvoker(Index* index, const std::vector<Task>& tasks, PooledAllocator* pools, std::vector<Task>* deferred) :
+        index_(index), tasks_(tasks), pools_(pools), deferred_(deferred)
+    {
+    }
+
+    void operator()(const cv::Range& range) const
+    {
+        for (int i = range.start; i < range.end; i++) {
+            RandomSeedScope seed(tasks_[i].seed);
+            index_->buildSubtree(tasks_[i], pools_[i], deferred_ ? &deferred_[i] : NULL);
+        }
+    }
+
+private:
+    Index* index_;
+    const std::vector<Task>& tasks_;
+    PooledAllocator* pools_;
+    std::vector<Task>* deferred_;
+
+    BuildTaskInvoker& operator=(const BuildTaskInvoker&);
+};
+
+template <typename Index, typename Task>
+void run_build_tasks(Index* index, const std::vector<Task>& tasks, std::vector<Task>* deferred, PooledAllocator& pool)
+{
+    if (tasks.empty()) {
+        return;
+    }
+    PooledAllocator* pools = new PooledAllocator[tasks.size()];
+    try {
+        cv::parallel_for_(cv::Range(0, (int)tasks.size()), BuildTaskInvoker<Index, Task>(index, tasks, pools, deferred));
+    }
+    catch (...) {
+        delete[] pools;
+        throw;
+    }
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        pool.merge(pools[i]);
+    }
+    delete[] pools;
+}
+
+/**
+ * Builds the trees of an index from one task per tree. The tasks of the trees run in
+ * parallel and divide the top levels, down to subtrees of build_task_size() points,
+ * which are then built in parallel too. The nodes end up in pool. The trees are the
+ * same whatever the number of threads, given the seeds of the root tasks.
+ */
+template <typename Index, typename Task>
+void build_trees(Index* index, const std::vector<Task>& roots, PooledAllocator& pool)
+{
+    std::vector<std::vector<Task> > deferred(roots.size());
+    run_build_tasks(index, roots, &deferred[0], pool);
+
+    std::vector<Task> subtrees;
+    for (size_t i = 0; i < deferred.size(); ++i) {
+        subtrees.insert(subtrees.end(), deferred[i].begin(), deferred[i].end());
+    }
+    run_build_tasks(index, subtrees, (std::vector<Task>*)NULL, pool);
+}
+
 /**
  * Nearest-neighbour index base class
  */
@@ -57,6 +234,18 @@ public:
      */
     virtual void buildIndex() = 0;
 
+    /**
+     * \brief Extends the index to points appended to its dataset
+     * \param dataset The dataset the index was built on, with the new points appended as its
+     *                last rows. The rows that are already indexed must not have changed, but
+     *                they may have been moved to a different memory location.
+     * \returns false if the index does not support incremental updates and has to be rebuilt
+     */
+    virtual bool addPoints(const Matrix<ElementType>& /*dataset*/)
+    {
+        return false;
+    }
+
     /**
      * \brief Perform k-nearest neighbor search
      * \param[in] queries The query points for which to find the nearest neighbors
@@ -73,59 +262,33 @@ public:
         assert(int(indices.cols) >= knn);
         assert(int(dists.cols) >= knn);
 
-#if 0
-        KNNResultSet<DistanceType> resultSet(knn);
-        for (size_t i = 0; i < queries.rows; i++) {
-            resultSet.init(indices[i], dists[i]);
-            findNeighbors(resultSet, queries[i], params);
-        }
-#else
-        KNNUniqueResultSet<DistanceType> resultSet(knn);
-        for (size_t i = 0; i < queries.rows; i++) {
-            resultSet.clear();
-            findNeighbors(resultSet, queries[i], params);
-            if (get_param(params,"sorted",true)) resultSet.sortAndCopy(indices[i], dists[i], knn);
-            else resultSet.copy(indices[i], dists[i], knn);
-        }
-#endif
+        // The rows are searched in parallel; neighbours that are not found are reported as -1
+        KNNSearchInvoker<Distance> invoker(this, queries, indices, dists, knn, params);
+        cv::parallel_for_(cv::Range(0, (int)queries.rows), invoker);
     }
 
     /**
      * \brief Perform radius search
-     * \param[in] query The query point
-     * \param[out] indices The indinces of the neighbors found within the given radius
+     * \param[in] query The query points; every row is searched separately, in parallel
+     * \param[out] indices The indinces of the neighbors found within the given radius, one row per query
      * \param[out] dists The distances to the nearest neighbors found
      * \param[in] radius The radius used for search
      * \param[in] params Search parameters
-     * \returns Number of neighbors found
+     * \returns Number of neighbors found, summed over all the queries
      */
     virtual int radiusSearch(const Matrix<ElementType>& query, Matrix<int>& indices, Matrix<DistanceType>& dists, float radius, const SearchParams& params)
     {
-        if (query.rows != 1) {
-            fprintf(stderr, "I can only search one feature at a time for range search\n");
-            return -1;
-        }
         assert(query.cols == veclen());
         assert(indices.cols == dists.cols);
+        assert(indices.cols == 0 || (indices.rows >= query.rows && dists.rows >= query.rows));
 
-        int n = 0;
-        int* indices_ptr = NULL;
-        DistanceType* dists_ptr = NULL;
-        if (indices.cols > 0) {
-            n = (int)indices.cols;
-            indices_ptr = indices[0];
-            dists_ptr = dists[0];
-        }
-
-        RadiusUniqueResultSet<DistanceType> resultSet((DistanceType)radius);
-        resultSet.clear();
-        findNeighbors(resultSet, query[0], params);
-        if (n>0) {
-            if (get_param(params,"sorted",true)) resultSet.sortAndCopy(indices_ptr, dists_ptr, n);
-            else resultSet.copy(indices_ptr, dists_ptr, n);
-        }
+        std::vector<int> counts(query.rows);
+        RadiusSearchInvoker<Distance> invoker(this, query, indices, dists, radius, params, counts.empty() ? 0 : &counts[0]);
+        cv::parallel_for_(cv::Range(0, (int)query.rows), invoker);
 
-        return (int)resultSet.size();
+        int total = 0;
+        for (size_t i = 0; i < counts.size(); ++i) total += counts[i];
+        return total;
     }
 
     /**
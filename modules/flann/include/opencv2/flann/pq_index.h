@@ -0,0 +1,517 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+// Copyright (C) 2009, Willow Garage Inc., all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#ifndef OPENCV_FLANN_PQ_INDEX_H_
+#define OPENCV_FLANN_PQ_INDEX_H_
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "opencv2/core.hpp"
+#include "general.h"
+#include "nn_index.h"
+#include "dist.h"
+#include "matrix.h"
+#include "result_set.h"
+#include "random.h"
+#include "saving.h"
+
+namespace cvflann
+{
+
+struct PQIndexParams : public IndexParams
+{
+    PQIndexParams(int lists = 256, int code_size = 16, int rerank = 0, int training_samples = 100000, int iterations = 10)
+    {
+        (*this)["algorithm"] = FLANN_INDEX_PQ;
+        // The number of coarse clusters (inverted lists) the points are distributed into
+        (*this)["lists"] = lists;
+        // The number of sub-quantizers, i.e. the number of bytes of the code of a point
+        (*this)["code_size"] = code_size;
+        // The number of best candidates compared with the dataset rows (0 to return the code distances)
+        (*this)["rerank"] = rerank;
+        // The number of dataset rows the quantizers are trained on
+        (*this)["training_samples"] = training_samples;
+        // The number of k-means iterations used to train the quantizers
+        (*this)["iterations"] = iterations;
+    }
+};
+
+
+/**
+ * Computes the distances of count codes of code_size bytes from the distance table of
+ * the sub-quantizers, which has stride entries per sub-quantizer.
+ */
+template <typename DistanceType>
+inline void pq_code_distances(const DistanceType* table, int stride, const unsigned char* codes, int code_size,
+                              size_t count, DistanceType* dists)
+{
+    for (size_t i = 0; i < count; ++i, codes += code_size) {
+        // the sums of four tables are independent, which hides the latency of the loads
+        const DistanceType* t = table;
+        DistanceType dist = 0;
+        int j = 0;
+        for (; j + 4 <= code_size; j += 4, t += 4 * stride) {
+            dist += (t[codes[j]] + t[stride + codes[j + 1]]) + (t[2 * stride + codes[j + 2]] + t[3 * stride + codes[j + 3]]);
+        }
+        for (; j < code_size; ++j, t += stride) {
+            dist += t[codes[j]];
+        }
+        dists[i] = dist;
+    }
+}
+
+/**
+ * The float version gathers the table entries of eight codes at a time with AVX2 when the CPU
+ * supports it; the sums are done in the same order, so the distances are the same.
+ */
+CV_EXPORTS void pq_code_distances(const float* table, int stride, const unsigned char* codes, int code_size,
+                                  size_t count, float* dists);
+
+
+/**
+ * Inverted file index with product quantization (IVF+PQ)
+ *
+ * A coarse k-means quantizer distributes the points into inverted lists. The residual of
+ * a point (the point minus the center of its list) is split into code_size sub-vectors,
+ * and each sub-vector is replaced by the index of the nearest of 256 centroids, so a point
+ * takes code_size bytes plus its index. Both quantizers are trained on a random sample
+ * of the dataset.
+ *
+ * A search probes the lists with the nearest centers, until "checks" points have been
+ * compared. For each list, the distances between the query residual and all the centroids
+ * are put in a table, and the distance to a point is the sum of code_size table entries
+ * (asymmetric distance computation). The distance must be a sum over the dimensions, as
+ * the squared L2 distance is. When rerank is not zero, that many best points are compared
+ * again with their dataset rows, and the exact distances are returned; otherwise the rows
+ * are only read when the index is built or extended.
+ */
+template <typename Distance>
+class PQIndex : public NNIndex<Distance>
+{
+public:
+    typedef typename Distance::ElementType ElementType;
+    typedef typename Distance::ResultType DistanceType;
+
+    /**
+     * Index constructor
+     *
+     * Params:
+     *          inputData = dataset with the input features
+     *          params = parameters passed to the IVF+PQ algorithm
+     */
+    PQIndex(const Matrix<ElementType>& inputData, const IndexParams& params = PQIndexParams(),
+            Distance d = Distance()) :
+        dataset_(inputData), index_params_(params), distance_(d), size_(0), sub_centroids_(0)
+    {
+        veclen_ = dataset_.cols;
+        lists_ = get_param(index_params_, "lists", 256);
+        code_size_ = get_param(index_params_, "code_size", 16);
+        rerank_ = get_param(index_params_, "rerank", 0);
+        training_samples_ = get_param(index_params_, "training_samples", 100000);
+        iterations_ = get_param(index_params_, "iterations", 10);
+    }
+
+    PQIndex(const PQIndex&);
+    PQIndex& operator=(const PQIndex&);
+
+    flann_algorithm_t getType() const
+    {
+        return FLANN_INDEX_PQ;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    size_t veclen() const
+    {
+        return veclen_;
+    }
+
+    /**
+     * Computes the index memory usage
+     * Returns: memory used by the index
+     */
+    int usedMemory() const
+    {
+        size_t memory = (coarse_centers_.size() + codebooks_.size()) * sizeof(float);
+        for (size_t i = 0; i < list_indices_.size(); ++i) {
+            memory += list_indices_[i].size() * sizeof(int) + list_codes_[i].size();
+        }
+        return (int)memory;
+    }
+
+    /**
+     * Trains the quantizers and encodes the dataset
+     */
+    void buildIndex()
+    {
+        if (code_size_ < 1 || code_size_ > (int)veclen_) {
+            CV_Error(cv::Error::StsBadArg, cv::format("Invalid code_size (=%d). Valid values are 1 <= code_size <= %d.", code_size_, (int)veclen_));
+        }
+        if (lists_ < 1 || dataset_.rows == 0) {
+            CV_Error(cv::Error::StsBadArg, "The index needs at least one list and one point");
+        }
+
+        // Draw the training sample
+        int n_train = (int)std::min(dataset_.rows, (size_t)std::max(training_samples_, 1));
+        cv::Mat train(n_train, (int)veclen_, CV_32F);
+        UniqueRandom random((int)dataset_.rows);
+        for (int i = 0; i < n_train; ++i) {
+            const ElementType* row = dataset_[n_train == (int)dataset_.rows ? i : random.next()];
+            std::copy(row, row + veclen_, train.ptr<float>(i));
+        }
+
+        // The coarse quantizer, then the sub-quantizers of the residuals
+        cv::TermCriteria criteria(cv::TermCriteria::COUNT, std::max(iterations_, 1), 0);
+        cv::Mat labels, centers;
+        lists_ = std::min(lists_, n_train);
+        cv::kmeans(train, lists_, labels, criteria, 1, cv::KMEANS_PP_CENTERS, centers);
+        coarse_centers_.assign(centers.ptr<float>(), centers.ptr<float>() + lists_ * veclen_);
+        for (int i = 0; i < n_train; ++i) {
+            train.row(i) -= centers.row(labels.at<int>(i));
+        }
+
+        sub_centroids_ = std::min(256, n_train);
+        codebooks_.resize(sub_centroids_ * veclen_);
+        for (int j = 0; j < code_size_; ++j) {
+            int begin = (int)subBegin(j), end = (int)subBegin(j + 1);
+            cv::Mat sub = train.colRange(begin, end).clone(), sub_labels, sub_centers;
+            cv::kmeans(sub, sub_centroids_, sub_labels, criteria, 1, cv::KMEANS_PP_CENTERS, sub_centers);
+            std::copy(sub_centers.ptr<float>(), sub_centers.ptr<float>() + sub_centroids_ * (end - begin),
+                      &codebooks_[sub_centroids_ * begin]);
+        }
+
+        list_indices_.assign(lists_, std::vector<int>());
+        list_codes_.assign(lists_, std::vector<uchar>());
+        size_ = 0;
+        encodeRows(dataset_.rows);
+    }
+
+    /**
+     * Encodes the points appended to the dataset with the trained quantizers
+     */
+    bool addPoints(const Matrix<ElementType>& dataset)
+    {
+        if (coarse_centers_.empty()) {
+            return false;
+        }
+        CV_Assert(dataset.rows >= size_ && dataset.cols == veclen_);
+
+        dataset_ = dataset;
+        encodeRows(dataset_.rows);
+        return true;
+    }
+
+    void saveIndex(FILE* stream)
+    {
+        save_value(stream, lists_);
+        save_value(stream, code_size_);
+        save_value(stream, rerank_);
+        save_value(stream, sub_centroids_);
+        save_value(stream, size_);
+        save_value(stream, coarse_centers_);
+        save_value(stream, codebooks_);
+        for (int i = 0; i < lists_; ++i) {
+            save_value(stream, list_indices_[i]);
+            save_value(stream, list_codes_[i]);
+        }
+    }
+
+    void loadIndex(FILE* stream)
+    {
+        load_value(stream, lists_);
+        load_value(stream, code_size_);
+        load_value(stream, rerank_);
+        load_value(stream, sub_centroids_);
+        load_value(stream, size_);
+        load_value(stream, coarse_centers_);
+        load_value(stream, codebooks_);
+        list_indices_.resize(lists_);
+        list_codes_.resize(lists_);
+        for (int i = 0; i < lists_; ++i) {
+            load_value(stream, list_indices_[i]);
+            load_value(stream, list_codes_[i]);
+        }
+
+        index_params_["algorithm"] = getType();
+        index_params_["lists"] = lists_;
+        index_params_["code_size"] = code_size_;
+        index_params_["rerank"] = rerank_;
+    }
+
+    /**
+     * Find set of nearest neighbors to vec. Their indices are stored inside
+     * the result object.
+     *
+     * Params:
+     *     result = the result object in which the indices of the nearest-neighbors are stored
+     *     vec = the vector for which to search the nearest neighbors
+     *     searchParams = parameters that influence the search algorithm (checks)
+     */
+    void findNeighbors(ResultSet<DistanceType>& result, const ElementType* vec, const SearchParams& searchParams)
+    {
+        int checks = get_param(searchParams, "checks", 32);
+
+        cv::AutoBuffer<float> query(veclen_), residual(veclen_);
+        std::copy(vec, vec + veclen_, (float*)query);
+
+        // The lists are probed from the one with the nearest center
+        std::vector<CenterDist> centers(lists_);
+        for (int i = 0; i < lists_; ++i) {
+            centers[i] = CenterDist(distance_((const float*)query, &coarse_centers_[i * veclen_], veclen_), i);
+        }
+        std::make_heap(centers.begin(), centers.end(), std::greater<CenterDist>());
+
+        // When re-ranking, the codes select the candidates that are compared with the dataset rows
+        int n_candidates = std::max(rerank_, 1);
+        cv::AutoBuffer<int> candidate_indices(n_candidates);
+        cv::AutoBuffer<DistanceType> candidate_dists(n_candidates);
+        KNNSimpleResultSet<DistanceType> candidates(n_candidates);
+        candidates.init(candidate_indices, candidate_dists);
+        ResultSet<DistanceType>& code_result = rerank_ > 0 ? static_cast<ResultSet<DistanceType>&>(candidates) : result;
+
+        cv::AutoBuffer<DistanceType> table(sub_centroids_ * code_size_);
+        int checked = 0;
+        for (int probed = 0; !centers.empty() && (probed == 0 || checks < 0 || checked < checks); ++probed) {
+            std::pop_heap(centers.begin(), centers.end(), std::greater<CenterDist>());
+            int list = centers.back().second;
+            centers.pop_back();
+
+            const float* center = &coarse_centers_[list * veclen_];
+            for (size_t i = 0; i < veclen_; ++i) residual[i] = query[i] - center[i];
+            computeDistanceTable(residual, table);
+            scanList(list, table, code_result);
+            checked += (int)list_indices_[list].size();
+        }
+
+        for (size_t i = 0; rerank_ > 0 && i < candidates.size(); ++i) {
+            int index = candidate_indices[i];
+            result.addPoint(distance_(vec, dataset_[index], veclen_), index);
+        }
+    }
+
+    IndexParams getParameters() const
+    {
+        return index_params_;
+    }
+
+private:
+    typedef std::pair<DistanceType, int> CenterDist;
+
+    /**
+     * Encodes a range of the rows to add, see encodeRows().
+     */
+    class EncodeInvoker : public cv::ParallelLoopBody
+    {
+    public:
+        EncodeInvoker(const PQIndex* index, size_t first, int* labels, uchar* codes) :
+            index_(index), first_(first), labels_(labels), codes_(codes)
+        {
+        }
+
+        void operator()(const cv::Range& range) const
+        {
+            cv::AutoBuffer<float> residual(index_->veclen_);
+            for (int i = range.start; i < range.end; ++i) {
+                labels_[i] = index_->encode(index_->dataset_[first_ + i], residual, codes_ + (size_t)i * index_->code_size_);
+            }
+        }
+
+    private:
+        const PQIndex* index_;
+        size_t first_;
+        int* labels_;
+        uchar* codes_;
+
+        EncodeInvoker& operator=(const EncodeInvoker&);
+    };
+
+    /**
+     * The first dimension of a sub-vector. When code_size does not divide the feature
+     * length, the lengths of the sub-vectors differ by one.
+     */
+    size_t subBegin(int j) const
+    {
+        return j * veclen_ / code_size_;
+    }
+
+    /**
+     * Finds the list of a point, and the code of its residual
+     * @param point the point to encode
+     * @param residual a buffer of veclen_ floats
+     * @param code the code_size_ bytes of the code
+     * @return the list of the point
+     */
+    int encode(const ElementType* point, float* residual, uchar* code) const
+    {
+        std::copy(point, point + veclen_, residual);
+        int list = 0;
+        DistanceType best_dist = distance_((const float*)residual, &coarse_centers_[0], veclen_);
+        for (int i = 1; i < lists_; ++i) {
+            DistanceType dist = distance_((const float*)residual, &coarse_centers_[i * veclen_], veclen_);
+            if (dist < best_dist) {
+                best_dist = dist;
+                list = i;
+            }
+        }
+
+        const float* center = &coarse_centers_[list * veclen_];
+        for (size_t i = 0; i < veclen_; ++i) residual[i] -= center[i];
+        for (int j = 0; j < code_size_; ++j) {
+            size_t begin = subBegin(j), length = subBegin(j + 1) - begin;
+            const float* centroid = &codebooks_[sub_centroids_ * begin];
+            int best = 0;
+            best_dist = distance_((const float*)residual + begin, centroid, length);
+            for (int k = 1; k < sub_centroids_; ++k) {
+                DistanceType dist = distance_((const float*)residual + begin, centroid + k * length, length);
+                if (dist < best_dist) {
+                    best_dist = dist;
+                    best = k;
+                }
+            }
+            code[j] = (uchar)best;
+        }
+        return list;
+    }
+
+    /**
+     * Encodes the rows of the dataset from size_ to end and appends them to their lists.
+     * The rows are encoded in parallel but added in order, so the lists do not depend on
+     * the threads.
+     */
+    void encodeRows(size_t end)
+    {
+        size_t first = size_;
+        if (end <= first) return;
+        std::vector<int> labels(end - first);
+        std::vector<uchar> codes((end - first) * code_size_);
+        cv::parallel_for_(cv::Range(0, (int)(end - first)), EncodeInvoker(this, first, &labels[0], &codes[0]));
+
+        for (size_t i = 0; i < labels.size(); ++i) {
+            list_indices_[labels[i]].push_back((int)(first + i));
+            const uchar* code = &codes[i * code_size_];
+            list_codes_[labels[i]].insert(list_codes_[labels[i]].end(), code, code + code_size_);
+        }
+        size_ = end;
+    }
+
+    /**
+     * Computes the distances between the sub-vectors of a residual and the centroids
+     * of their sub-quantizer; the table has sub_centroids_ entries per sub-quantizer.
+     */
+    void computeDistanceTable(const float* residual, DistanceType* table) const
+    {
+        for (int j = 0; j < code_size_; ++j, table += sub_centroids_) {
+            size_t begin = subBegin(j), length = subBegin(j + 1) - begin;
+            const float* centroid = &codebooks_[sub_centroids_ * begin];
+            for (int k = 0; k < sub_centroids_; ++k, centroid += length) {
+                table[k] = distance_(residual + begin, centroid, length);
+            }
+        }
+    }
+
+    /**
+     * Adds the points of a list to the result set, with the distances of their codes;
+     * the distances are computed by blocks of points
+     */
+    void scanList(int list, const DistanceType* table, ResultSet<DistanceType>& result) const
+    {
+        const std::vector<int>& indices = list_indices_[list];
+        const size_t block_size = 256;
+        DistanceType dists[block_size];
+        for (size_t i = 0; i < indices.size(); i += block_size) {
+            size_t count = std::min(block_size, indices.size() - i);
+            pq_code_distances(table, sub_centroids_, &list_codes_[list][i * code_size_], code_size_, count, dists);
+            for (size_t k = 0; k < count; ++k) {
+                result.addPoint(dists[k], indices[i + k]);
+            }
+        }
+    }
+
+    /** The dataset; its rows are only read to encode them and to re-rank */
+    Matrix<ElementType> dataset_;
+
+    IndexParams index_params_;
+
+    Distance distance_;
+
+    /** The number of encoded points */
+    size_t size_;
+
+    /** The length of the features */
+    size_t veclen_;
+
+    /** The number of inverted lists */
+    int lists_;
+
+    /** The number of sub-quantizers, i.e. bytes per code */
+    int code_size_;
+
+    /** The number of candidates compared with the dataset rows */
+    int rerank_;
+
+    /** The training parameters */
+    int training_samples_;
+    int iterations_;
+
+    /** The number of centroids of each sub-quantizer (at most 256) */
+    int sub_centroids_;
+
+    /** The centers of the lists, lists_ x veclen_ */
+    std::vector<float> coarse_centers_;
+
+    /** The centroids of the sub-quantizers; those of sub-vector j start at
+     * sub_centroids_ * subBegin(j) */
+    std::vector<float> codebooks_;
+
+    /** The indices and the codes of the points of each list */
+    std::vector<std::vector<int> > list_indices_;
+    std::vector<std::vector<uchar> > list_codes_;
+};
+
+}
+
+#endif //OPENCV_FLANN_PQ_INDEX_H_
@@ -47,6 +47,7 @@ namespace cvflann
 inline void seed_random(unsigned int seed)
 {
     srand(seed);
+    cv::theRNG() = cv::RNG(seed);
 }
 
 /*
@@ -60,7 +61,7 @@ inline void seed_random(unsigned int seed)
  */
 inline double rand_double(double high = 1.0, double low = 0)
 {
-    return low + ((high-low) * (std::rand() / (RAND_MAX + 1.0)));
+    return low + ((high-low) * (double)cv::theRNG());
 }
 
 /**
@@ -71,9 +72,57 @@ inline double rand_double(double high = 1.0, double low = 0)
  */
 inline int rand_int(int high = RAND_MAX, int low = 0)
 {
-    return low + (int) ( double(high-low) * (std::rand() / (RAND_MAX + 1.0)));
+    return low + (int) ( double(high-low) * (double)cv::theRNG());
 }
 
+/**
+ * Random index generator for std::random_shuffle, drawing from the same
+ * generator as rand_int().
+ */
+struct RandomIndex
+{
+    ptrdiff_t operator()(ptrdiff_t n) const
+    {
+        return rand_int((int)n);
+    }
+};
+
+/**
+ * Generates a seed for the random numbers of a construction task.
+ */
+inline uint64 rand_seed()
+{
+    cv::RNG& rng = cv::theRNG();
+    uint64 seed = rng.next();
+    return (seed << 32) | rng.next();
+}
+
+/**
+ * Makes the random numbers drawn by the calling thread come from the given
+ * seed while the object is alive. The random generator is per thread, so the
+ * tasks of a parallel index construction draw the same numbers however they
+ * are distributed between threads.
+ */
+class RandomSeedScope
+{
+public:
+    explicit RandomSeedScope(uint64 seed) : saved_(cv::theRNG())
+    {
+        cv::theRNG() = cv::RNG(seed);
+    }
+
+    ~RandomSeedScope()
+    {
+        cv::theRNG() = saved_;
+    }
+
+private:
+    RandomSeedScope(const RandomSeedScope&);
+    RandomSeedScope& operator=(const RandomSeedScope&);
+
+    cv::RNG saved_;
+};
+
 /**
  * Random number generator that returns a distinct number from
  * the [0,n) interval each time.
@@ -107,7 +156,8 @@ public:
         for (int i = 0; i < size_; ++i) vals_[i] = i;
 
         // shuffle the elements in the array
-        std::random_shuffle(vals_.begin(), vals_.end());
+        RandomIndex random_index;
+        std::random_shuffle(vals_.begin(), vals_.end(), random_index);
 
         counter_ = 0;
     }
@@ -39,6 +39,10 @@
 #undef FLANN_SIGNATURE_
 #endif
 #define FLANN_SIGNATURE_ "FLANN_INDEX"
+#ifdef FLANN_MAPPED_SIGNATURE_
+#undef FLANN_MAPPED_SIGNATURE_
+#endif
+#define FLANN_MAPPED_SIGNATURE_ "FLANN_INDEX_MAP"
 
 namespace cvflann
 {
@@ -81,13 +85,14 @@ struct IndexHeader
  *
  * @param stream - Stream to save to
  * @param index - The index to save
+ * @param signature - FLANN_SIGNATURE_, or FLANN_MAPPED_SIGNATURE_ for files that embed the dataset
  */
 template<typename Distance>
-void save_header(FILE* stream, const NNIndex<Distance>& index)
+void save_header(FILE* stream, const NNIndex<Distance>& index, const char* signature = FLANN_SIGNATURE_)
 {
     IndexHeader header;
     memset(header.signature, 0, sizeof(header.signature));
-    strcpy(header.signature, FLANN_SIGNATURE_);
+    strcpy(header.signature, signature);
     memset(header.version, 0, sizeof(header.version));
     strcpy(header.version, FLANN_VERSION_);
     header.data_type = Datatype<typename Distance::ElementType>::type();
@@ -102,9 +107,10 @@ void save_header(FILE* stream, const NNIndex<Distance>& index)
 /**
  *
  * @param stream - Stream to load from
+ * @param accept_mapped - Whether files that embed the dataset are accepted
  * @return Index header
  */
-inline IndexHeader load_header(FILE* stream)
+inline IndexHeader load_header(FILE* stream, bool accept_mapped = false)
 {
     IndexHeader header;
     size_t read_size = fread(&header,sizeof(header),1,stream);
@@ -113,7 +119,8 @@ inline IndexHeader load_header(FILE* stream)
         throw FLANNException("Invalid index file, cannot read");
     }
 
-    if (strcmp(header.signature,FLANN_SIGNATURE_)!=0) {
+    if (strcmp(header.signature,FLANN_SIGNATURE_)!=0 &&
+        !(accept_mapped && strcmp(header.signature,FLANN_MAPPED_SIGNATURE_)==0)) {
         throw FLANNException("Invalid index file, wrong signature");
     }
 
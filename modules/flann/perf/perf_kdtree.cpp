@@ -0,0 +1,41 @@
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace perf;
+using std::tr1::make_tuple;
+using std::tr1::get;
+
+typedef std::tr1::tuple<int, bool> Size_Compact_t;
+typedef perf::TestBaseWithParam<Size_Compact_t> Size_Compact;
+
+// The same kd-forest is searched with the pointer-linked nodes and with the
+// flattened node array in van Emde Boas order; the queries per second are the
+// number of query rows divided by the measured time.
+PERF_TEST_P(Size_Compact, kdtree_knnSearch,
+            testing::Combine(testing::Values(100000, 1000000),
+                             testing::Bool()
+                             )
+            )
+{
+    int size = get<0>(GetParam());
+    bool compact = get<1>(GetParam());
+
+    Mat data(size, 32, CV_32F), queries(10000, 32, CV_32F);
+    declare.in(data, queries, WARMUP_RNG);
+
+    flann::KDTreeIndexParams params(4);
+    params.setBool("compact", compact);
+    theRNG() = RNG(0);
+    flann::Index index(data, params);
+
+    Mat indices, dists;
+    declare.time(60);
+
+    TEST_CYCLE()
+    {
+        index.knnSearch(queries, indices, dists, 4, flann::SearchParams(64));
+    }
+
+    SANITY_CHECK(indices);
+}
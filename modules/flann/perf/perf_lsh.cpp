@@ -0,0 +1,36 @@
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace perf;
+
+typedef perf::TestBaseWithParam<int> DatasetSize;
+
+// ORB-sized binary descriptors; every query is a row of the dataset with a few of its
+// bits flipped, so that most queries have a near neighbour in the probed buckets.
+PERF_TEST_P(DatasetSize, lsh_knnSearch, testing::Values(100000, 1000000))
+{
+    int size = GetParam();
+
+    Mat data(size, 32, CV_8U), queries(1000, 32, CV_8U);
+    declare.in(data, WARMUP_RNG);
+    RNG& rng = theRNG();
+    for (int i = 0; i < queries.rows; i++)
+    {
+        data.row(rng.uniform(0, size)).copyTo(queries.row(i));
+        for (int j = 0; j < 8; j++)
+            queries.at<uchar>(i, rng.uniform(0, 32)) ^= (uchar)(1 << rng.uniform(0, 8));
+    }
+
+    flann::Index index(data, flann::LshIndexParams(12, 20, 2), cvflann::FLANN_DIST_HAMMING);
+
+    Mat indices, dists;
+    declare.time(60);
+
+    TEST_CYCLE()
+    {
+        index.knnSearch(queries, indices, dists, 2);
+    }
+
+    SANITY_CHECK(dists);
+}
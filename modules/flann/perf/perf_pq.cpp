@@ -0,0 +1,30 @@
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace perf;
+
+typedef perf::TestBaseWithParam<int> Rerank;
+
+// SIFT-sized float descriptors, stored as 16-byte codes in 256 lists; the codes alone,
+// or the 32 best candidates re-ranked with the dataset rows.
+PERF_TEST_P(Rerank, pq_knnSearch, testing::Values(0, 32))
+{
+    int rerank = GetParam();
+
+    Mat data(100000, 128, CV_32F), queries(1000, 128, CV_32F);
+    declare.in(data, queries, WARMUP_RNG);
+
+    theRNG() = RNG(0);
+    flann::Index index(data, flann::PQIndexParams(256, 16, rerank, 20000, 5));
+
+    Mat indices, dists;
+    declare.time(60);
+
+    TEST_CYCLE()
+    {
+        index.knnSearch(queries, indices, dists, 4, flann::SearchParams(4000));
+    }
+
+    SANITY_CHECK(indices);
+}
@@ -54,4 +54,163 @@ namespace cvflann
     }
 
     void dummyfunc() {}
+
+#if CV_SSE2
+
+// The AVX2 and SSSE3 versions are compiled either when they are enabled for the whole build,
+// or, with GCC, as separate functions for their targets, which are dispatched at runtime.
+#if (defined __GNUC__ && !defined __clang__ && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) && \
+    (defined __x86_64__ || defined __i386__)
+#  include <immintrin.h>
+#  define CV_FLANN_TARGET_ATTRIBUTES 1
+#else
+#  define CV_FLANN_TARGET_ATTRIBUTES 0
+#endif
+
+#if CV_AVX2
+#  define CV_FLANN_AVX2 1
+#  define CV_FLANN_AVX2_TARGET
+#elif CV_FLANN_TARGET_ATTRIBUTES
+#  define CV_FLANN_AVX2 1
+#  define CV_FLANN_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#  define CV_FLANN_AVX2 0
+#endif
+
+#if CV_SSSE3
+#  define CV_FLANN_SSSE3 1
+#  define CV_FLANN_SSSE3_TARGET
+#elif CV_FLANN_TARGET_ATTRIBUTES
+#  define CV_FLANN_SSSE3 1
+#  define CV_FLANN_SSSE3_TARGET __attribute__((target("ssse3")))
+#else
+#  define CV_FLANN_SSSE3 0
+#endif
+
+#if CV_FLANN_AVX2
+// 32 bytes at a time, the bytes are counted with a nibble lookup table in a shuffle
+static CV_FLANN_AVX2_TARGET size_t hammingAVX2(const unsigned char* a, const unsigned char* b, size_t size, int& result)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i s = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a + i)),
+                                     _mm256_loadu_si256((const __m256i*)(b + i)));
+        __m256i c = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(x, low_mask)),
+                                    _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask)));
+        s = _mm256_add_epi64(s, _mm256_sad_epu8(c, _mm256_setzero_si256()));
+    }
+    __m128i s2 = _mm_add_epi64(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+    result += _mm_cvtsi128_si32(s2) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(s2, s2));
+    return i;
+}
+#endif
+
+#if CV_FLANN_AVX2
+// The codes of eight points are gathered four bytes at a time, and each byte selects the table
+// entry of its sub-quantizer. The last points are left to the scalar loop, so that the gathers
+// never read past the codes.
+static CV_FLANN_AVX2_TARGET size_t pqCodeDistancesAVX2(const float* table, int stride, const unsigned char* codes,
+                                                       int code_size, size_t count, float* dists)
+{
+    const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(code_size));
+    const __m256i byte_mask = _mm256_set1_epi32(0xff);
+    const size_t total = count * code_size;
+    size_t i = 0;
+    for (; (i + 8) * code_size + 3 <= total; i += 8) {
+        const unsigned char* c = codes + i * code_size;
+        const float* t = table;
+        __m256 dist = _mm256_setzero_ps();
+        int j = 0;
+        for (; j + 4 <= code_size; j += 4, t += 4 * stride) {
+            __m256i b = _mm256_i32gather_epi32((const int*)(c + j), offsets, 1);
+            __m256 t0 = _mm256_i32gather_ps(t, _mm256_and_si256(b, byte_mask), 4);
+            __m256 t1 = _mm256_i32gather_ps(t + stride, _mm256_and_si256(_mm256_srli_epi32(b, 8), byte_mask), 4);
+            __m256 t2 = _mm256_i32gather_ps(t + 2 * stride, _mm256_and_si256(_mm256_srli_epi32(b, 16), byte_mask), 4);
+            __m256 t3 = _mm256_i32gather_ps(t + 3 * stride, _mm256_srli_epi32(b, 24), 4);
+            dist = _mm256_add_ps(dist, _mm256_add_ps(_mm256_add_ps(t0, t1), _mm256_add_ps(t2, t3)));
+        }
+        for (; j < code_size; ++j, t += stride) {
+            __m256i b = _mm256_i32gather_epi32((const int*)(c + j), offsets, 1);
+            dist = _mm256_add_ps(dist, _mm256_i32gather_ps(t, _mm256_and_si256(b, byte_mask), 4));
+        }
+        _mm256_storeu_ps(dists + i, dist);
+    }
+    return i;
+}
+#endif
+
+#if CV_FLANN_SSSE3
+// 16 bytes at a time, the bytes are counted with a nibble lookup table in a shuffle
+static CV_FLANN_SSSE3_TARGET size_t hammingSSSE3(const unsigned char* a, const unsigned char* b, size_t i, size_t size, int& result)
+{
+    const __m128i lookup = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i low_mask = _mm_set1_epi8(0x0f);
+    __m128i s = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+        __m128i c = _mm_add_epi8(_mm_shuffle_epi8(lookup, _mm_and_si128(x, low_mask)),
+                                 _mm_shuffle_epi8(lookup, _mm_and_si128(_mm_srli_epi16(x, 4), low_mask)));
+        s = _mm_add_epi64(s, _mm_sad_epu8(c, _mm_setzero_si128()));
+    }
+    result += _mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(s, s));
+    return i;
+}
+#endif
+
+// 16 bytes at a time, the bytes are counted with the additions of Hamming2::popcnt64
+static size_t hammingSSE2(const unsigned char* a, const unsigned char* b, size_t i, size_t size, int& result)
+{
+    const __m128i m1 = _mm_set1_epi8(0x55), m2 = _mm_set1_epi8(0x33), m4 = _mm_set1_epi8(0x0f);
+    __m128i s = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+        x = _mm_sub_epi8(x, _mm_and_si128(_mm_srli_epi16(x, 1), m1));
+        x = _mm_add_epi8(_mm_and_si128(x, m2), _mm_and_si128(_mm_srli_epi16(x, 2), m2));
+        x = _mm_and_si128(_mm_add_epi8(x, _mm_srli_epi16(x, 4)), m4);
+        s = _mm_add_epi64(s, _mm_sad_epu8(x, _mm_setzero_si128()));
+    }
+    result += _mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(s, s));
+    return i;
+}
+
+int hamming_dist(const unsigned char* a, const unsigned char* b, size_t size)
+{
+    int result = 0;
+    size_t i = 0;
+#if CV_FLANN_AVX2
+    static const bool haveAVX2 = cv::checkHardwareSupport(CV_CPU_AVX2);
+    if (haveAVX2)
+        i = hammingAVX2(a, b, size, result);
+#endif
+#if CV_FLANN_SSSE3
+    static const bool haveSSSE3 = cv::checkHardwareSupport(CV_CPU_SSSE3);
+    if (haveSSSE3)
+        i = hammingSSSE3(a, b, i, size, result);
+    else
+#endif
+        i = hammingSSE2(a, b, i, size, result);
+    if (i < size) {
+        HammingLUT lut;
+        result += lut(a + i, b + i, size - i);
+    }
+    return result;
+}
+
+#endif
+
+void pq_code_distances(const float* table, int stride, const unsigned char* codes, int code_size,
+                       size_t count, float* dists)
+{
+    size_t i = 0;
+#if CV_SSE2 && CV_FLANN_AVX2
+    static const bool haveAVX2 = cv::checkHardwareSupport(CV_CPU_AVX2);
+    if (haveAVX2)
+        i = pqCodeDistancesAVX2(table, stride, codes, code_size, count, dists);
+#endif
+    pq_code_distances<float>(table, stride, codes + i * code_size, code_size, count - i, dists + i);
+}
 }
@@ -1,5 +1,17 @@
 #include "precomp.hpp"
 
+#if defined WIN32 || defined _WIN32 || defined WINCE
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
 #define MINIFLANN_SUPPORT_EXOTIC_DISTANCE_TYPES 0
 
 static cvflann::IndexParams& get_params(const cv::flann::IndexParams& p)
@@ -20,6 +32,102 @@ namespace flann
 
 using namespace cvflann;
 
+// the dataset stored in an index file starts at a multiple of this, so that it can be used in place
+static const size_t MAPPED_DATA_ALIGN = 64;
+
+// 64-bit file positions, the mapped index files may be larger than 2GB
+static int64 tellIndexFile(FILE* f)
+{
+#if defined _MSC_VER
+    return _ftelli64(f);
+#else
+    return (int64)ftello(f);
+#endif
+}
+
+static int seekIndexFile(FILE* f, int64 pos)
+{
+#if defined _MSC_VER
+    return _fseeki64(f, pos, SEEK_SET);
+#else
+    return fseeko(f, (off_t)pos, SEEK_SET);
+#endif
+}
+
+// Read-only, shared mapping of a whole index file
+struct MappedIndexFile
+{
+    MappedIndexFile() : data(0), size(0)
+#if defined WIN32 || defined _WIN32 || defined WINCE
+        , file(INVALID_HANDLE_VALUE), mapping(0)
+#endif
+    {}
+
+    ~MappedIndexFile() { unmap(); }
+
+    bool map(const String& filename)
+    {
+        unmap();
+#if defined WIN32 || defined _WIN32 || defined WINCE
+        file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+        LARGE_INTEGER fileSize;
+        if( file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0 ||
+            !(mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0)) ||
+            !(data = (const uchar*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) )
+        {
+            unmap();
+            return false;
+        }
+        size = (size_t)fileSize.QuadPart;
+#else
+        int fd = open(filename.c_str(), O_RDONLY);
+        if( fd < 0 )
+            return false;
+        struct stat st;
+        void* ptr = MAP_FAILED;
+        if( fstat(fd, &st) == 0 && st.st_size > 0 )
+            ptr = mmap(0, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if( ptr == MAP_FAILED )
+            return false;
+        data = (const uchar*)ptr;
+        size = (size_t)st.st_size;
+#endif
+        return true;
+    }
+
+    void unmap()
+    {
+#if defined WIN32 || defined _WIN32 || defined WINCE
+        if( data )
+            UnmapViewOfFile(data);
+        if( mapping )
+            CloseHandle(mapping);
+        if( file != INVALID_HANDLE_VALUE )
+            CloseHandle(file);
+        mapping = 0;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if( data )
+            munmap((void*)data, size);
+#endif
+        data = 0;
+        size = 0;
+    }
+
+    const uchar* data;
+    size_t size;
+#if defined WIN32 || defined _WIN32 || defined WINCE
+    HANDLE file;
+    HANDLE mapping;
+#endif
+
+private:
+    MappedIndexFile(const MappedIndexFile&);
+    MappedIndexFile& operator=(const MappedIndexFile&);
+};
+
 IndexParams::IndexParams()
 {
     params = new ::cvflann::IndexParams();
@@ -285,6 +393,22 @@ LshIndexParams::LshIndexParams(int table_number, int key_size, int multi_probe_l
     p["multi_probe_level"] = multi_probe_level;
 }
 
+PQIndexParams::PQIndexParams(int lists, int code_size, int rerank, int training_samples, int iterations)
+{
+    ::cvflann::IndexParams& p = get_params(*this);
+    p["algorithm"] = FLANN_INDEX_PQ;
+    // The number of coarse clusters (inverted lists) the points are distributed into
+    p["lists"] = lists;
+    // The number of sub-quantizers, i.e. the number of bytes of the code of a point
+    p["code_size"] = code_size;
+    // The number of best candidates compared with the dataset rows (0 to return the code distances)
+    p["rerank"] = rerank;
+    // The number of dataset rows the quantizers are trained on
+    p["training_samples"] = training_samples;
+    // The number of k-means iterations used to train the quantizers
+    p["iterations"] = iterations;
+}
+
 SavedIndexParams::SavedIndexParams(const String& _filename)
 {
     String filename = _filename;
@@ -328,7 +452,7 @@ buildIndex(void*& index, const Mat& data, const IndexParams& params, const Dista
     buildIndex_<Distance, ::cvflann::Index<Distance> >(index, data, params, dist);
 }
 
-#if CV_NEON
+#if CV_NEON || CV_SSE2
 typedef ::cvflann::Hamming<uchar> HammingDistance;
 #else
 typedef ::cvflann::HammingLUT HammingDistance;
@@ -404,6 +528,66 @@ void Index::build(InputArray _data, const IndexParams& params, flann_distance_t
     }
 }
 
+template<typename Distance, typename IndexType> void
+addPoints_(void* index, const Mat& data, float rebuildThreshold)
+{
+    typedef typename Distance::ElementType ElementType;
+    if(DataType<ElementType>::type != data.type())
+        CV_Error_(Error::StsUnsupportedFormat, ("type=%d\n", data.type()));
+    if(!data.isContinuous())
+        CV_Error(Error::StsBadArg, "Only continuous arrays are supported");
+
+    IndexType* _index = (IndexType*)index;
+    CV_Assert( (size_t)data.rows >= _index->size() && (size_t)data.cols == _index->veclen() );
+
+    ::cvflann::Matrix<ElementType> dataset((ElementType*)data.data, data.rows, data.cols);
+    _index->addPoints(dataset, rebuildThreshold);
+}
+
+template<typename Distance> void
+addPoints(void* index, const Mat& data, float rebuildThreshold)
+{
+    addPoints_<Distance, ::cvflann::Index<Distance> >(index, data, rebuildThreshold);
+}
+
+void Index::addPoints(InputArray _data, float rebuildThreshold)
+{
+    CV_Assert( index != 0 );
+    Mat data = _data.getMat();
+
+    switch( distType )
+    {
+    case FLANN_DIST_HAMMING:
+        ::cv::flann::addPoints< HammingDistance >(index, data, rebuildThreshold);
+        break;
+    case FLANN_DIST_L2:
+        ::cv::flann::addPoints< ::cvflann::L2<float> >(index, data, rebuildThreshold);
+        break;
+    case FLANN_DIST_L1:
+        ::cv::flann::addPoints< ::cvflann::L1<float> >(index, data, rebuildThreshold);
+        break;
+#if MINIFLANN_SUPPORT_EXOTIC_DISTANCE_TYPES
+    case FLANN_DIST_MAX:
+        ::cv::flann::addPoints< ::cvflann::MaxDistance<float> >(index, data, rebuildThreshold);
+        break;
+    case FLANN_DIST_HIST_INTERSECT:
+        ::cv::flann::addPoints< ::cvflann::HistIntersectionDistance<float> >(index, data, rebuildThreshold);
+        break;
+    case FLANN_DIST_HELLINGER:
+        ::cv::flann::addPoints< ::cvflann::HellingerDistance<float> >(index, data, rebuildThreshold);
+        break;
+    case FLANN_DIST_CHI_SQUARE:
+        ::cv::flann::addPoints< ::cvflann::ChiSquareDistance<float> >(index, data, rebuildThreshold);
+        break;
+    case FLANN_DIST_KL:
+        ::cv::flann::addPoints< ::cvflann::KL_Divergence<float> >(index, data, rebuildThreshold);
+        break;
+#endif
+    default:
+        CV_Error(Error::StsBadArg, "Unknown/unsupported distance type");
+    }
+}
+
 template<typename IndexType> void deleteIndex_(void* index)
 {
     delete (IndexType*)index;
@@ -422,7 +606,10 @@ Index::~Index()
 void Index::release()
 {
     if( !index )
+    {
+        mappedFile.release();
         return;
+    }
 
     switch( distType )
     {
@@ -456,6 +643,8 @@ void Index::release()
             CV_Error(Error::StsBadArg, "Unknown/unsupported distance type");
     }
     index = 0;
+    // the dataset of an index loaded with load(filename) lives in the mapping
+    mappedFile.release();
 }
 
 template<typename Distance, typename IndexType>
@@ -638,24 +827,58 @@ flann_algorithm_t Index::getAlgorithm() const
     return algo;
 }
 
-template<typename IndexType> void saveIndex_(const Index* index0, const void* index, FILE* fout)
+template<typename IndexType> void saveIndex_(const Index* index0, const void* index, const Mat& data, FILE* fout)
 {
     IndexType* _index = (IndexType*)index;
-    ::cvflann::save_header(fout, *_index);
+    ::cvflann::save_header(fout, *_index, data.empty() ? FLANN_SIGNATURE_ : FLANN_MAPPED_SIGNATURE_);
     // some compilers may store short enumerations as bytes,
     // so make sure we always write integers (which are 4-byte values in any modern C compiler)
     int idistType = (int)index0->getDistance();
     ::cvflann::save_value<int>(fout, idistType);
+    if( data.empty() )
+    {
+        _index->saveIndex(fout);
+        return;
+    }
+
+    CV_Assert( (size_t)data.rows == _index->size() && (size_t)data.cols == _index->veclen() );
+
+    // the offset of the dataset is only known once the index structure is written
+    int64 offsetPos = tellIndexFile(fout);
+    int64 dataOffset = 0;
+    ::cvflann::save_value(fout, dataOffset);
     _index->saveIndex(fout);
+
+    int64 pos = tellIndexFile(fout);
+    CV_Assert( offsetPos >= 0 && pos >= 0 );
+    dataOffset = (pos + (int64)MAPPED_DATA_ALIGN - 1) & ~(int64)(MAPPED_DATA_ALIGN - 1);
+    for( ; pos < dataOffset; pos++ )
+        fputc(0, fout);
+    size_t rowSize = data.cols*data.elemSize();
+    for( int i = 0; i < data.rows; i++ )
+        fwrite(data.ptr(i), rowSize, 1, fout);
+
+    seekIndexFile(fout, offsetPos);
+    ::cvflann::save_value(fout, dataOffset);
 }
 
-template<typename Distance> void saveIndex(const Index* index0, const void* index, FILE* fout)
+template<typename Distance> void saveIndex(const Index* index0, const void* index, const Mat& data, FILE* fout)
 {
-    saveIndex_< ::cvflann::Index<Distance> >(index0, index, fout);
+    saveIndex_< ::cvflann::Index<Distance> >(index0, index, data, fout);
 }
 
 void Index::save(const String& filename) const
 {
+    save(filename, noArray());
+}
+
+void Index::save(const String& filename, InputArray _data) const
+{
+    CV_Assert( index != 0 );
+    Mat data = _data.getMat();
+    if( !data.empty() && data.type() != featureType )
+        CV_Error_(Error::StsUnsupportedFormat, ("type=%d\n", data.type()));
+
     FILE* fout = fopen(filename.c_str(), "wb");
     if (fout == NULL)
         CV_Error_( Error::StsError, ("Can not open file %s for writing FLANN index\n", filename.c_str()) );
@@ -663,29 +886,29 @@ void Index::save(const String& filename) const
     switch( distType )
     {
     case FLANN_DIST_HAMMING:
-        saveIndex< HammingDistance >(this, index, fout);
+        saveIndex< HammingDistance >(this, index, data, fout);
         break;
     case FLANN_DIST_L2:
-        saveIndex< ::cvflann::L2<float> >(this, index, fout);
+        saveIndex< ::cvflann::L2<float> >(this, index, data, fout);
         break;
     case FLANN_DIST_L1:
-        saveIndex< ::cvflann::L1<float> >(this, index, fout);
+        saveIndex< ::cvflann::L1<float> >(this, index, data, fout);
         break;
 #if MINIFLANN_SUPPORT_EXOTIC_DISTANCE_TYPES
     case FLANN_DIST_MAX:
-        saveIndex< ::cvflann::MaxDistance<float> >(this, index, fout);
+        saveIndex< ::cvflann::MaxDistance<float> >(this, index, data, fout);
         break;
     case FLANN_DIST_HIST_INTERSECT:
-        saveIndex< ::cvflann::HistIntersectionDistance<float> >(this, index, fout);
+        saveIndex< ::cvflann::HistIntersectionDistance<float> >(this, index, data, fout);
         break;
     case FLANN_DIST_HELLINGER:
-        saveIndex< ::cvflann::HellingerDistance<float> >(this, index, fout);
+        saveIndex< ::cvflann::HellingerDistance<float> >(this, index, data, fout);
         break;
     case FLANN_DIST_CHI_SQUARE:
-        saveIndex< ::cvflann::ChiSquareDistance<float> >(this, index, fout);
+        saveIndex< ::cvflann::ChiSquareDistance<float> >(this, index, data, fout);
         break;
     case FLANN_DIST_KL:
-        saveIndex< ::cvflann::KL_Divergence<float> >(this, index, fout);
+        saveIndex< ::cvflann::KL_Divergence<float> >(this, index, data, fout);
         break;
 #endif
     default:
@@ -720,6 +943,11 @@ bool loadIndex(Index* index0, void*& index, const Mat& data, FILE* fin, const Di
     return loadIndex_<Distance, ::cvflann::Index<Distance> >(index0, index, data, fin, dist);
 }
 
+bool Index::load(const String& filename)
+{
+    return load(noArray(), filename);
+}
+
 bool Index::load(InputArray _data, const String& filename)
 {
     Mat data = _data.getMat();
@@ -729,7 +957,7 @@ bool Index::load(InputArray _data, const String& filename)
     if (fin == NULL)
         return false;
 
-    ::cvflann::IndexHeader header = ::cvflann::load_header(fin);
+    ::cvflann::IndexHeader header = ::cvflann::load_header(fin, true);
     algo = header.index_type;
     featureType = header.data_type == FLANN_UINT8 ? CV_8U :
                   header.data_type == FLANN_INT8 ? CV_8S :
@@ -739,6 +967,30 @@ bool Index::load(InputArray _data, const String& filename)
                   header.data_type == FLANN_FLOAT32 ? CV_32F :
                   header.data_type == FLANN_FLOAT64 ? CV_64F : -1;
 
+    int idistType = 0;
+    ::cvflann::load_value(fin, idistType);
+    distType = (flann_distance_t)idistType;
+
+    int64 dataOffset = 0;
+    bool hasDataset = strcmp(header.signature, FLANN_MAPPED_SIGNATURE_) == 0;
+    if( hasDataset )
+        ::cvflann::load_value(fin, dataOffset);
+
+    // no dataset is passed, so use the copy stored in the file in place
+    Ptr<MappedIndexFile> file;
+    if( data.empty() && hasDataset && featureType >= 0 )
+    {
+        file = makePtr<MappedIndexFile>();
+        size_t dataSize = header.rows*header.cols*CV_ELEM_SIZE(featureType);
+        if( !file->map(filename) || dataOffset <= 0 || (size_t)dataOffset + dataSize > file->size )
+        {
+            fprintf(stderr, "Reading FLANN index error: can not map the dataset stored in %s\n", filename.c_str());
+            fclose(fin);
+            return false;
+        }
+        data = Mat((int)header.rows, (int)header.cols, featureType, (void*)(file->data + dataOffset));
+    }
+
     if( (int)header.rows != data.rows || (int)header.cols != data.cols ||
         featureType != data.type() )
     {
@@ -748,10 +1000,6 @@ bool Index::load(InputArray _data, const String& filename)
         return false;
     }
 
-    int idistType = 0;
-    ::cvflann::load_value(fin, idistType);
-    distType = (flann_distance_t)idistType;
-
     if( !((distType == FLANN_DIST_HAMMING && featureType == CV_8U) ||
           (distType != FLANN_DIST_HAMMING && featureType == CV_32F)) )
     {
@@ -795,6 +1043,8 @@ bool Index::load(InputArray _data, const String& filename)
 
     if( fin )
         fclose(fin);
+    if( ok )
+        mappedFile = file;
     return ok;
 }
 
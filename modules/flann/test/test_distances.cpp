@@ -0,0 +1,121 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                        Intel License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000, Intel Corporation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of Intel Corporation may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+
+#include "test_precomp.hpp"
+
+using namespace cv;
+
+// The L2 and L1 functors use vectorized kernels for contiguous data; compare them with
+// the generic kernels, which they use for other iterators.
+template <typename T>
+static void checkDistances(int maxValue, double relativeEps)
+{
+    RNG& rng = theRNG();
+    for( int size = 1; size <= 300; size += (size < 140 ? 1 : 37) )
+    {
+        Mat a( 1, size, DataType<T>::type ), b( 1, size, DataType<T>::type );
+        rng.fill( a, RNG::UNIFORM, 0, maxValue );
+        rng.fill( b, RNG::UNIFORM, 0, maxValue );
+        const T* pa = a.ptr<T>();
+        const T* pb = b.ptr<T>();
+        std::vector<T> va( pa, pa + size ), vb( pb, pb + size );
+
+        cvflann::L2<T> l2;
+        cvflann::L1<T> l1;
+        double l2Expected = cvflann::l2_sqr_dist( va.begin(), vb.begin(), size, -1.f );
+        double l1Expected = cvflann::l1_dist( va.begin(), vb.begin(), size, -1.f );
+        ASSERT_NEAR( l2Expected, l2(pa, pb, size), relativeEps*l2Expected ) << "size " << size;
+        ASSERT_NEAR( l1Expected, l1(pa, pb, size), relativeEps*l1Expected ) << "size " << size;
+
+        // a partial sum that already exceeds worst_dist may be returned
+        float worst = (float)l2Expected/4;
+        if( worst > 0 )
+        {
+            ASSERT_GT( l2(pa, pb, size, worst), worst ) << "size " << size;
+        }
+    }
+}
+
+TEST(Flann_Distance, vectorizedFloatMatchesGeneric) { checkDistances<float>(100, 1e-5); }
+TEST(Flann_Distance, vectorizedUcharMatchesGeneric) { checkDistances<uchar>(256, 1e-6); }
+
+// Hamming counts the bits with SIMD instructions where available; compare it with the lookup table.
+TEST(Flann_Distance, vectorizedHammingMatchesLUT)
+{
+    RNG& rng = theRNG();
+    cvflann::Hamming<uchar> hamming;
+    cvflann::HammingLUT lut;
+    for( int size = 1; size <= 300; size += (size < 140 ? 1 : 37) )
+    {
+        Mat a( 1, size, CV_8U ), b( 1, size, CV_8U );
+        rng.fill( a, RNG::UNIFORM, 0, 256 );
+        rng.fill( b, RNG::UNIFORM, 0, 256 );
+        ASSERT_EQ( lut(a.ptr(), b.ptr(), size), hamming(a.ptr(), b.ptr(), size) ) << "size " << size;
+        ASSERT_EQ( 0, hamming(a.ptr(), a.ptr(), size) ) << "size " << size;
+    }
+}
+
+// The product quantization code distances are gathered with AVX2 where available; they are summed
+// in the same order as in the generic version, so they must be exactly the same.
+TEST(Flann_Distance, vectorizedPQCodeDistancesMatchGeneric)
+{
+    RNG& rng = theRNG();
+    const int strides[] = { 256, 37 };
+    for( int s = 0; s < 2; s++ )
+    {
+        for( int codeSize = 1; codeSize <= 20; codeSize++ )
+        {
+            int stride = strides[s];
+            Mat table( codeSize, stride, CV_32F ), codes( 1, 300*codeSize, CV_8U );
+            rng.fill( table, RNG::UNIFORM, 0.f, 100.f );
+            rng.fill( codes, RNG::UNIFORM, 0, stride );
+
+            for( size_t count = 1; count <= 300; count += (count < 40 ? 1 : 29) )
+            {
+                std::vector<float> expected( count ), dists( count );
+                cvflann::pq_code_distances<float>( table.ptr<float>(), stride, codes.ptr(), codeSize, count, &expected[0] );
+                cvflann::pq_code_distances( table.ptr<float>(), stride, codes.ptr(), codeSize, count, &dists[0] );
+                ASSERT_TRUE( expected == dists ) << "stride " << stride << ", code size " << codeSize << ", count " << count;
+            }
+        }
+    }
+}
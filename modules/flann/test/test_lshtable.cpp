@@ -0,0 +1,86 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                        Intel License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000, Intel Corporation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of Intel Corporation may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+
+#include "test_precomp.hpp"
+
+#include <map>
+
+using namespace cv;
+
+// The buckets of a table must hold the features of their key, in the order they were added,
+// with either bucket layout and after features are appended to the table.
+static void checkBuckets(int keySize)
+{
+    Mat data( 2000, 32, CV_8U );
+    theRNG().fill( data, RNG::UNIFORM, 0, 256 );
+    cvflann::Matrix<uchar> dataset( data.ptr(), data.rows, data.cols );
+    cvflann::Matrix<uchar> firstRows( data.ptr(), 1500, data.cols );
+
+    cvflann::lsh::LshTable<uchar> table( data.cols, keySize );
+    table.add( firstRows );
+    table.add( dataset, firstRows.rows );
+
+    std::map<cvflann::lsh::BucketKey, std::vector<cvflann::lsh::FeatureIndex> > expected;
+    for( int i = 0; i < data.rows; i++ )
+        expected[(cvflann::lsh::BucketKey)table.getKey( data.ptr(i) )].push_back( i );
+
+    cvflann::lsh::BucketKey key = 0;
+    for( std::map<cvflann::lsh::BucketKey, std::vector<cvflann::lsh::FeatureIndex> >::const_iterator it = expected.begin();
+         it != expected.end(); ++it )
+    {
+        cvflann::lsh::Bucket bucket = table.getBucketFromKey( it->first );
+        ASSERT_EQ( it->second, std::vector<cvflann::lsh::FeatureIndex>( bucket.begin(), bucket.end() ) ) << "key " << it->first;
+
+        // the keys are sorted, so this finds the smallest key with no feature
+        if( it->first == key )
+            key++;
+    }
+    if( key < (1u << keySize) )
+    {
+        ASSERT_TRUE( table.getBucketFromKey( key ).empty() );
+    }
+    ASSERT_EQ( (size_t)data.rows, table.getStats().bucket_size_mean_ * table.getStats().n_buckets_ +
+                                  (size_t)data.rows % table.getStats().n_buckets_ );
+}
+
+TEST(Flann_LshTable, arrayBucketsHoldTheirFeatures) { checkBuckets(8); }
+TEST(Flann_LshTable, hashedBucketsHoldTheirFeatures) { checkBuckets(24); }
@@ -151,6 +151,12 @@ namespace
         void setTilesGridSize(cv::Size tileGridSize);
         cv::Size getTilesGridSize() const;
 
+        void setTemporalSmoothing(double smoothing);
+        double getTemporalSmoothing() const;
+
+        void setIncrementalUpdate(bool incremental);
+        bool getIncrementalUpdate() const;
+
         void collectGarbage();
 
     private:
@@ -248,6 +254,28 @@ namespace
         return cv::Size(tilesX_, tilesY_);
     }
 
+    void CLAHE_Impl::setTemporalSmoothing(double smoothing)
+    {
+        if (smoothing != 0.0)
+            CV_Error(cv::Error::StsNotImplemented, "Temporal smoothing is not supported");
+    }
+
+    double CLAHE_Impl::getTemporalSmoothing() const
+    {
+        return 0.0;
+    }
+
+    void CLAHE_Impl::setIncrementalUpdate(bool incremental)
+    {
+        if (incremental)
+            CV_Error(cv::Error::StsNotImplemented, "Incremental update is not supported");
+    }
+
+    bool CLAHE_Impl::getIncrementalUpdate() const
+    {
+        return false;
+    }
+
     void CLAHE_Impl::collectGarbage()
     {
         srcExt_.release();
@@ -806,6 +806,14 @@ public:
     CV_WRAP virtual void setTilesGridSize(Size tileGridSize) = 0;
     CV_WRAP virtual Size getTilesGridSize() const = 0;
 
+    //! weight of the LUTs of the previous frames in [0, 1), 0 disables the temporal smoothing
+    CV_WRAP virtual void setTemporalSmoothing(double smoothing) = 0;
+    CV_WRAP virtual double getTemporalSmoothing() const = 0;
+
+    //! updates the tile histograms with the pixels changed since the previous frame only
+    CV_WRAP virtual void setIncrementalUpdate(bool incremental) = 0;
+    CV_WRAP virtual bool getIncrementalUpdate() const = 0;
+
     CV_WRAP virtual void collectGarbage() = 0;
 };
 
@@ -1431,6 +1439,10 @@ CV_EXPORTS_W void findContours( InputOutputArray image, OutputArrayOfArrays cont
 CV_EXPORTS void findContours( InputOutputArray image, OutputArrayOfArrays contours,
                               int mode, int method, Point offset = Point());
 
+//! retrieves contours into a single point array; points of i-th contour are points[offsets[i]..offsets[i+1]).
+CV_EXPORTS void findContours( InputOutputArray image, OutputArray points, OutputArray offsets,
+                              OutputArray hierarchy, int mode, int method, Point offset = Point());
+
 //! approximates contour or a curve using Douglas-Peucker algorithm
 CV_EXPORTS_W void approxPolyDP( InputArray curve,
                                 OutputArray approxCurve,
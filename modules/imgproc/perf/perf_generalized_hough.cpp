@@ -0,0 +1,89 @@
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace perf;
+
+typedef perf::TestBaseWithParam<Size> Size_Only;
+
+static void prepareGeneralizedHoughImage(const Mat& templ, Size imageSize, bool addObjects, Mat& edges, Mat& dx, Mat& dy)
+{
+    Mat image(imageSize, CV_8UC1, Scalar::all(0));
+    templ.copyTo(image(Rect(50, 50, templ.cols, templ.rows)));
+
+    if (addObjects)
+    {
+        RNG rng(123456789);
+        const int objCount = rng.uniform(5, 15);
+        for (int i = 0; i < objCount; ++i)
+        {
+            double scale = rng.uniform(0.7, 1.3);
+            bool rotate = 1 == rng.uniform(0, 2);
+
+            Mat obj;
+            resize(templ, obj, Size(), scale, scale);
+            if (rotate)
+                obj = obj.t();
+
+            Point pos;
+
+            pos.x = rng.uniform(0, image.cols - obj.cols);
+            pos.y = rng.uniform(0, image.rows - obj.rows);
+
+            Mat roi = image(Rect(pos, obj.size()));
+            add(roi, obj, roi);
+        }
+    }
+
+    Canny(image, edges, 50, 100);
+    Sobel(image, dx, CV_32F, 1, 0);
+    Sobel(image, dy, CV_32F, 0, 1);
+}
+
+PERF_TEST_P(Size_Only, GeneralizedHoughBallard, testing::Values(sz720p, sz1080p))
+{
+    declare.time(10);
+
+    const Size imageSize = GetParam();
+
+    const Mat templ = imread(getDataPath("cv/shared/templ.png"), IMREAD_GRAYSCALE);
+    ASSERT_FALSE(templ.empty());
+
+    Mat edges, dx, dy;
+    prepareGeneralizedHoughImage(templ, imageSize, false, edges, dx, dy);
+
+    Ptr<GeneralizedHoughBallard> alg = createGeneralizedHoughBallard();
+
+    Mat positions;
+
+    alg->setTemplate(templ);
+
+    TEST_CYCLE() alg->detect(edges, dx, dy, positions);
+
+    SANITY_CHECK(positions);
+}
+
+PERF_TEST_P(Size_Only, GeneralizedHoughGuil, testing::Values(sz720p, sz1080p))
+{
+    declare.time(60);
+
+    const Size imageSize = GetParam();
+
+    const Mat templ = imread(getDataPath("cv/shared/templ.png"), IMREAD_GRAYSCALE);
+    ASSERT_FALSE(templ.empty());
+
+    Mat edges, dx, dy;
+    prepareGeneralizedHoughImage(templ, imageSize, true, edges, dx, dy);
+
+    Ptr<GeneralizedHoughGuil> alg = createGeneralizedHoughGuil();
+    alg->setMaxAngle(90.0);
+    alg->setAngleStep(2.0);
+
+    Mat positions;
+
+    alg->setTemplate(templ);
+
+    TEST_CYCLE() alg->detect(edges, dx, dy, positions);
+
+    SANITY_CHECK(positions);
+}
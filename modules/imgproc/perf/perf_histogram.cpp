@@ -137,3 +137,34 @@ PERF_TEST_P(Sz_ClipLimit, CLAHE,
 
     SANITY_CHECK(dst);
 }
+
+PERF_TEST_P(Sz_ClipLimit, CLAHE_incremental,
+            testing::Combine(testing::Values(::perf::szVGA, ::perf::sz720p, ::perf::sz1080p),
+                             testing::Values(0.0, 40.0))
+            )
+{
+    const Size size = get<0>(GetParam());
+    const double clipLimit = get<1>(GetParam());
+
+    Mat src(size, CV_8UC1);
+    declare.in(src, WARMUP_RNG);
+
+    // the next frame differs from the first one in a small region only
+    Mat nextFrame = src.clone();
+    Mat part = nextFrame(Rect(0, 0, size.width / 8, size.height / 8));
+    randu(part, Scalar::all(0), Scalar::all(256));
+
+    Ptr<CLAHE> clahe = createCLAHE(clipLimit);
+    clahe->setIncrementalUpdate(true);
+    Mat dst;
+
+    clahe->apply(src, dst);
+
+    TEST_CYCLE()
+    {
+        clahe->apply(nextFrame, dst);
+        clahe->apply(src, dst);
+    }
+
+    SANITY_CHECK(dst);
+}
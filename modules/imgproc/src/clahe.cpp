@@ -46,6 +46,117 @@
 
 namespace
 {
+    const int CLAHE_HIST_SIZE = 256;
+
+    // Computes the histogram of a tile. Four partial histograms are used to break
+    // the dependency between the consecutive increments of the same bin.
+    void calcTileHist(const cv::Mat& tile, int* tileHist)
+    {
+        int partialHist[4][CLAHE_HIST_SIZE];
+        memset(partialHist, 0, sizeof(partialHist));
+
+        for (int y = 0; y < tile.rows; ++y)
+        {
+            const uchar* ptr = tile.ptr<uchar>(y);
+
+            int x = 0;
+            for (; x <= tile.cols - 4; x += 4)
+            {
+                partialHist[0][ptr[x]]++;
+                partialHist[1][ptr[x+1]]++;
+                partialHist[2][ptr[x+2]]++;
+                partialHist[3][ptr[x+3]]++;
+            }
+
+            for (; x < tile.cols; ++x)
+                partialHist[0][ptr[x]]++;
+        }
+
+        for (int i = 0; i < CLAHE_HIST_SIZE; ++i)
+            tileHist[i] = partialHist[0][i] + partialHist[1][i] + partialHist[2][i] + partialHist[3][i];
+    }
+
+    // Updates the histogram of a tile with the pixels that differ from the previous frame,
+    // and stores the new tile in the previous frame buffer. Returns true if the tile has changed.
+    bool updateTileHist(const cv::Mat& tile, cv::Mat& prevTile, int* tileHist)
+    {
+        bool changed = false;
+
+#if CV_SSE2
+        const bool haveSSE2 = cv::checkHardwareSupport(CV_CPU_SSE2);
+#endif
+
+        for (int y = 0; y < tile.rows; ++y)
+        {
+            const uchar* ptr = tile.ptr<uchar>(y);
+            uchar* prevPtr = prevTile.ptr<uchar>(y);
+
+            int x = 0;
+#if CV_SSE2
+            if (haveSSE2)
+            {
+                for (; x <= tile.cols - 16; x += 16)
+                {
+                    __m128i cur = _mm_loadu_si128((const __m128i*)(ptr + x));
+                    __m128i prev = _mm_loadu_si128((const __m128i*)(prevPtr + x));
+                    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(cur, prev));
+                    if (mask == 0xFFFF)
+                        continue;
+
+                    for (int k = 0; k < 16; ++k)
+                    {
+                        if (!(mask & (1 << k)))
+                        {
+                            tileHist[prevPtr[x + k]]--;
+                            tileHist[ptr[x + k]]++;
+                        }
+                    }
+                    _mm_storeu_si128((__m128i*)(prevPtr + x), cur);
+                    changed = true;
+                }
+            }
+#endif
+            for (; x < tile.cols; ++x)
+            {
+                if (ptr[x] != prevPtr[x])
+                {
+                    tileHist[prevPtr[x]]--;
+                    tileHist[ptr[x]]++;
+                    prevPtr[x] = ptr[x];
+                    changed = true;
+                }
+            }
+        }
+
+        return changed;
+    }
+
+    void clipTileHist(int* tileHist, int clipLimit)
+    {
+        const int histSize = CLAHE_HIST_SIZE;
+
+        // how many pixels were clipped
+        int clipped = 0;
+        for (int i = 0; i < histSize; ++i)
+        {
+            if (tileHist[i] > clipLimit)
+            {
+                clipped += tileHist[i] - clipLimit;
+                tileHist[i] = clipLimit;
+            }
+        }
+
+        // redistribute clipped pixels
+        int redistBatch = clipped / histSize;
+        int residual = clipped - redistBatch * histSize;
+
+        for (int i = 0; i < histSize; ++i)
+            tileHist[i] += redistBatch;
+
+        for (int i = 0; i < residual; ++i)
+            tileHist[i]++;
+    }
+
     class CLAHE_CalcLut_Body : public cv::ParallelLoopBody
     {
     public:
@@ -69,7 +180,7 @@ namespace
 
     void CLAHE_CalcLut_Body::operator ()(const cv::Range& range) const
     {
-        const int histSize = 256;
+        const int histSize = CLAHE_HIST_SIZE;
 
         uchar* tileLut = lut_.ptr(range.start);
         const size_t lut_step = lut_.step;
@@ -91,59 +202,125 @@ namespace
 
             // calc histogram
 
-            int tileHist[histSize] = {0, };
+            int tileHist[histSize];
+            calcTileHist(tile, tileHist);
+
+            // clip histogram
+
+            if (clipLimit_ > 0)
+                clipTileHist(tileHist, clipLimit_);
+
+            // calc Lut
 
-            int height = tileROI.height;
-            const size_t sstep = tile.step;
-            for (const uchar* ptr = tile.ptr<uchar>(0); height--; ptr += sstep)
+            int sum = 0;
+            for (int i = 0; i < histSize; ++i)
             {
-                int x = 0;
-                for (; x <= tileROI.width - 4; x += 4)
-                {
-                    int t0 = ptr[x], t1 = ptr[x+1];
-                    tileHist[t0]++; tileHist[t1]++;
-                    t0 = ptr[x+2]; t1 = ptr[x+3];
-                    tileHist[t0]++; tileHist[t1]++;
-                }
+                sum += tileHist[i];
+                tileLut[i] = cv::saturate_cast<uchar>(sum * lutScale_);
+            }
+        }
+    }
 
-                for (; x < tileROI.width; ++x)
-                    tileHist[ptr[x]]++;
+    // Calculates the LUTs in the streaming mode: the raw tile histograms are kept between the frames
+    // and are either recomputed or updated with the changed pixels only, the LUTs are recomputed for
+    // the changed tiles and are blended with the LUTs of the previous frames.
+    class CLAHE_UpdateLut_Body : public cv::ParallelLoopBody
+    {
+    public:
+        CLAHE_UpdateLut_Body(const cv::Mat& src, cv::Mat& prevSrc, cv::Mat& hist, cv::Mat& lutTarget, cv::Mat& lutSmooth, cv::Mat& lut,
+                             cv::Size tileSize, int tilesX, int clipLimit, float lutScale,
+                             bool updateHist, bool storeFrame, bool recalcLut, float smoothing) :
+            src_(src), prevSrc_(prevSrc), hist_(hist), lutTarget_(lutTarget), lutSmooth_(lutSmooth), lut_(lut),
+            tileSize_(tileSize), tilesX_(tilesX), clipLimit_(clipLimit), lutScale_(lutScale),
+            updateHist_(updateHist), storeFrame_(storeFrame), recalcLut_(recalcLut), smoothing_(smoothing)
+        {
+        }
+
+        void operator ()(const cv::Range& range) const;
+
+    private:
+        cv::Mat src_;
+        mutable cv::Mat prevSrc_;
+        mutable cv::Mat hist_;
+        mutable cv::Mat lutTarget_;
+        mutable cv::Mat lutSmooth_;
+        mutable cv::Mat lut_;
+
+        cv::Size tileSize_;
+        int tilesX_;
+        int clipLimit_;
+        float lutScale_;
+        bool updateHist_;
+        bool storeFrame_;
+        bool recalcLut_;
+        float smoothing_;
+    };
+
+    void CLAHE_UpdateLut_Body::operator ()(const cv::Range& range) const
+    {
+        const int histSize = CLAHE_HIST_SIZE;
+
+        for (int k = range.start; k < range.end; ++k)
+        {
+            const int ty = k / tilesX_;
+            const int tx = k % tilesX_;
+
+            const cv::Rect tileROI(tx * tileSize_.width, ty * tileSize_.height, tileSize_.width, tileSize_.height);
+            const cv::Mat tile = src_(tileROI);
+
+            int* tileHist = hist_.ptr<int>(k);
+            float* tileLutTarget = lutTarget_.ptr<float>(k);
+            float* tileLutSmooth = lutSmooth_.ptr<float>(k);
+            uchar* tileLut = lut_.ptr(k);
+
+            // update histogram
+
+            bool changed = true;
+            if (updateHist_)
+            {
+                cv::Mat prevTile = prevSrc_(tileROI);
+                changed = updateTileHist(tile, prevTile, tileHist);
             }
+            else
+            {
+                calcTileHist(tile, tileHist);
 
-            // clip histogram
+                if (storeFrame_)
+                    tile.copyTo(prevSrc_(tileROI));
+            }
 
-            if (clipLimit_ > 0)
+            // calc Lut of the current frame
+
+            if (changed || recalcLut_)
             {
-                // how many pixels were clipped
-                int clipped = 0;
+                int clippedHist[histSize];
+                memcpy(clippedHist, tileHist, sizeof(clippedHist));
+
+                if (clipLimit_ > 0)
+                    clipTileHist(clippedHist, clipLimit_);
+
+                int sum = 0;
                 for (int i = 0; i < histSize; ++i)
                 {
-                    if (tileHist[i] > clipLimit_)
-                    {
-                        clipped += tileHist[i] - clipLimit_;
-                        tileHist[i] = clipLimit_;
-                    }
+                    sum += clippedHist[i];
+                    tileLutTarget[i] = sum * lutScale_;
                 }
+            }
 
-                // redistribute clipped pixels
-                int redistBatch = clipped / histSize;
-                int residual = clipped - redistBatch * histSize;
+            // blend it with the Lut of the previous frames
 
+            if (smoothing_ > 0)
+            {
                 for (int i = 0; i < histSize; ++i)
-                    tileHist[i] += redistBatch;
-
-                for (int i = 0; i < residual; ++i)
-                    tileHist[i]++;
+                    tileLutSmooth[i] = tileLutSmooth[i] * smoothing_ + tileLutTarget[i] * (1.0f - smoothing_);
             }
-
-            // calc Lut
-
-            int sum = 0;
-            for (int i = 0; i < histSize; ++i)
+            else
             {
-                sum += tileHist[i];
-                tileLut[i] = cv::saturate_cast<uchar>(sum * lutScale_);
+                memcpy(tileLutSmooth, tileLutTarget, histSize * sizeof(float));
             }
+
+            for (int i = 0; i < histSize; ++i)
+                tileLut[i] = cv::saturate_cast<uchar>(tileLutSmooth[i]);
         }
     }
 
@@ -171,6 +348,29 @@ namespace
     {
         const size_t lut_step = lut_.step;
 
+        // the column tiles and weights are the same for all the rows
+        cv::AutoBuffer<int> _ind(src_.cols * 2);
+        cv::AutoBuffer<float> _xa(src_.cols);
+        int* ind1_p = _ind;
+        int* ind2_p = ind1_p + src_.cols;
+        float* xa_p = _xa;
+
+        for (int x = 0; x < src_.cols; ++x)
+        {
+            const float txf = (static_cast<float>(x) / tileSize_.width) - 0.5f;
+
+            int tx1 = cvFloor(txf);
+            int tx2 = tx1 + 1;
+
+            xa_p[x] = txf - tx1;
+
+            tx1 = std::max(tx1, 0);
+            tx2 = std::min(tx2, tilesX_ - 1);
+
+            ind1_p[x] = static_cast<int>(tx1 * lut_step);
+            ind2_p[x] = static_cast<int>(tx2 * lut_step);
+        }
+
         for (int y = range.start; y < range.end; ++y)
         {
             const uchar* srcRow = src_.ptr<uchar>(y);
@@ -191,20 +391,12 @@ namespace
 
             for (int x = 0; x < src_.cols; ++x)
             {
-                const float txf = (static_cast<float>(x) / tileSize_.width) - 0.5f;
-
-                int tx1 = cvFloor(txf);
-                int tx2 = tx1 + 1;
-
-                const float xa = txf - tx1;
-
-                tx1 = std::max(tx1, 0);
-                tx2 = std::min(tx2, tilesX_ - 1);
+                const float xa = xa_p[x];
 
                 const int srcVal = srcRow[x];
 
-                const size_t ind1 = tx1 * lut_step + srcVal;
-                const size_t ind2 = tx2 * lut_step + srcVal;
+                const int ind1 = ind1_p[x] + srcVal;
+                const int ind2 = ind2_p[x] + srcVal;
 
                 float res = 0;
 
@@ -233,26 +425,50 @@ namespace
         void setTilesGridSize(cv::Size tileGridSize);
         cv::Size getTilesGridSize() const;
 
+        void setTemporalSmoothing(double smoothing);
+        double getTemporalSmoothing() const;
+
+        void setIncrementalUpdate(bool incremental);
+        bool getIncrementalUpdate() const;
+
         void collectGarbage();
 
     private:
+        void calcLutStreaming(const cv::Mat& srcForLut, cv::Size tileSize, int clipLimit, float lutScale);
+
         double clipLimit_;
         int tilesX_;
         int tilesY_;
+        double smoothing_;
+        bool incremental_;
 
         cv::Mat srcExt_;
         cv::Mat lut_;
+
+        // state of the streaming mode
+        cv::Mat prevSrc_;
+        cv::Mat hist_;
+        cv::Mat lutTarget_;
+        cv::Mat lutSmooth_;
+        cv::Size streamSize_;
+        cv::Size streamGrid_;
+        bool streamIncremental_;
+        int prevClipLimit_;
+        bool streamValid_;
     };
 
     CLAHE_Impl::CLAHE_Impl(double clipLimit, int tilesX, int tilesY) :
-        clipLimit_(clipLimit), tilesX_(tilesX), tilesY_(tilesY)
+        clipLimit_(clipLimit), tilesX_(tilesX), tilesY_(tilesY), smoothing_(0.0), incremental_(false),
+        streamIncremental_(false), prevClipLimit_(0), streamValid_(false)
     {
     }
 
     CV_INIT_ALGORITHM(CLAHE_Impl, "CLAHE",
         obj.info()->addParam(obj, "clipLimit", obj.clipLimit_);
         obj.info()->addParam(obj, "tilesX", obj.tilesX_);
-        obj.info()->addParam(obj, "tilesY", obj.tilesY_))
+        obj.info()->addParam(obj, "tilesY", obj.tilesY_);
+        obj.info()->addParam(obj, "temporalSmoothing", obj.smoothing_);
+        obj.info()->addParam(obj, "incrementalUpdate", obj.incremental_))
 
     void CLAHE_Impl::apply(cv::InputArray _src, cv::OutputArray _dst)
     {
@@ -293,13 +509,59 @@ namespace
             clipLimit = std::max(clipLimit, 1);
         }
 
-        CLAHE_CalcLut_Body calcLutBody(srcForLut, lut_, tileSize, tilesX_, tilesY_, clipLimit, lutScale);
-        cv::parallel_for_(cv::Range(0, tilesX_ * tilesY_), calcLutBody);
+        if (smoothing_ > 0.0 || incremental_)
+        {
+            calcLutStreaming(srcForLut, tileSize, clipLimit, lutScale);
+        }
+        else
+        {
+            streamValid_ = false;
+
+            CLAHE_CalcLut_Body calcLutBody(srcForLut, lut_, tileSize, tilesX_, tilesY_, clipLimit, lutScale);
+            cv::parallel_for_(cv::Range(0, tilesX_ * tilesY_), calcLutBody);
+        }
 
         CLAHE_Interpolation_Body interpolationBody(src, dst, lut_, tileSize, tilesX_, tilesY_);
         cv::parallel_for_(cv::Range(0, src.rows), interpolationBody);
     }
 
+    void CLAHE_Impl::calcLutStreaming(const cv::Mat& srcForLut, cv::Size tileSize, int clipLimit, float lutScale)
+    {
+        const int histSize = CLAHE_HIST_SIZE;
+        const int tilesTotal = tilesX_ * tilesY_;
+
+        // the state of the previous frames can only be used for the frames of the same size
+        // split into the same tiles (tilesX/tilesY may also be changed through Algorithm::set),
+        // the previous frame is only stored in the incremental mode
+        if (streamSize_ != srcForLut.size() || streamGrid_ != cv::Size(tilesX_, tilesY_) ||
+            streamIncremental_ != incremental_)
+            streamValid_ = false;
+
+        if (!streamValid_)
+        {
+            streamSize_ = srcForLut.size();
+            streamGrid_ = cv::Size(tilesX_, tilesY_);
+            streamIncremental_ = incremental_;
+            hist_.create(tilesTotal, histSize, CV_32SC1);
+            lutTarget_.create(tilesTotal, histSize, CV_32FC1);
+            lutSmooth_.create(tilesTotal, histSize, CV_32FC1);
+        }
+
+        if (incremental_)
+            prevSrc_.create(srcForLut.size(), CV_8UC1);
+
+        const bool updateHist = streamValid_ && incremental_;
+        const bool recalcLut = !streamValid_ || clipLimit != prevClipLimit_;
+        const float smoothing = streamValid_ ? static_cast<float>(std::min(std::max(smoothing_, 0.0), 1.0)) : 0.0f;
+
+        CLAHE_UpdateLut_Body updateLutBody(srcForLut, prevSrc_, hist_, lutTarget_, lutSmooth_, lut_,
+                                           tileSize, tilesX_, clipLimit, lutScale, updateHist, incremental_, recalcLut, smoothing);
+        cv::parallel_for_(cv::Range(0, tilesTotal), updateLutBody);
+
+        prevClipLimit_ = clipLimit;
+        streamValid_ = true;
+    }
+
     void CLAHE_Impl::setClipLimit(double clipLimit)
     {
         clipLimit_ = clipLimit;
@@ -321,10 +583,37 @@ namespace
         return cv::Size(tilesX_, tilesY_);
     }
 
+    void CLAHE_Impl::setTemporalSmoothing(double smoothing)
+    {
+        CV_Assert( smoothing >= 0.0 && smoothing < 1.0 );
+        smoothing_ = smoothing;
+    }
+
+    double CLAHE_Impl::getTemporalSmoothing() const
+    {
+        return smoothing_;
+    }
+
+    void CLAHE_Impl::setIncrementalUpdate(bool incremental)
+    {
+        incremental_ = incremental;
+    }
+
+    bool CLAHE_Impl::getIncrementalUpdate() const
+    {
+        return incremental_;
+    }
+
     void CLAHE_Impl::collectGarbage()
     {
         srcExt_.release();
         lut_.release();
+
+        prevSrc_.release();
+        hist_.release();
+        lutTarget_.release();
+        lutSmooth_.release();
+        streamValid_ = false;
     }
 }
 
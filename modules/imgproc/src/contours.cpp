@@ -178,10 +178,10 @@ _CvContourScanner;
    Initializes scanner structure.
    Prepare image for scanning ( clear borders and convert all pixels to 0-1.
 */
-CV_IMPL CvContourScanner
-cvStartFindContours( void* _img, CvMemStorage* storage,
-                     int  header_size, int mode,
-                     int  method, CvPoint offset )
+static CvContourScanner
+icvStartFindContours( void* _img, CvMemStorage* storage,
+                      int  header_size, int mode,
+                      int  method, CvPoint offset, int needFillBorder )
 {
     if( !storage )
         CV_Error( CV_StsNullPtr, "" );
@@ -284,25 +284,36 @@ cvStartFindContours( void* _img, CvMemStorage* storage,
                                           scanner->cinfo_storage );
     }
 
-    /* make zero borders */
-    int esz = CV_ELEM_SIZE(mat->type);
-    memset( img, 0, size.width*esz );
-    memset( img + step * (size.height - 1), 0, size.width*esz );
-
-    img += step;
-    for( int y = 1; y < size.height - 1; y++, img += step )
+    if( needFillBorder )
     {
-        for( int k = 0; k < esz; k++ )
-            img[k] = img[(size.width - 1)*esz + k] = (schar)0;
-    }
+        /* make zero borders */
+        int esz = CV_ELEM_SIZE(mat->type);
+        memset( img, 0, size.width*esz );
+        memset( img + step * (size.height - 1), 0, size.width*esz );
 
-    /* converts all pixels to 0 or 1 */
-    if( CV_MAT_TYPE(mat->type) != CV_32S )
-        cvThreshold( mat, mat, 0, 1, CV_THRESH_BINARY );
+        img += step;
+        for( int y = 1; y < size.height - 1; y++, img += step )
+        {
+            for( int k = 0; k < esz; k++ )
+                img[k] = img[(size.width - 1)*esz + k] = (schar)0;
+        }
+
+        /* converts all pixels to 0 or 1 */
+        if( CV_MAT_TYPE(mat->type) != CV_32S )
+            cvThreshold( mat, mat, 0, 1, CV_THRESH_BINARY );
+    }
 
     return scanner;
 }
 
+CV_IMPL CvContourScanner
+cvStartFindContours( void* _img, CvMemStorage* storage,
+                     int  header_size, int mode,
+                     int  method, CvPoint offset )
+{
+    return icvStartFindContours( _img, storage, header_size, mode, method, offset, 1 );
+}
+
 /*
    Final stage of contour processing.
    Three variants possible:
@@ -1700,16 +1711,167 @@ cvFindContours( void*  img,  CvMemStorage*  storage,
     return count;
 }
 
+namespace cv
+{
+
+/*
+   Rows that contain only background pixels can not be crossed by any contour and
+   no contour below such a row can be nested into a contour above it. So the prepared
+   image is cut at such rows into stripes, the stripes are traced independently and
+   their contour trees are linked together in the order the serial scan would produce.
+*/
+class FindContoursStripeInvoker : public ParallelLoopBody
+{
+public:
+    FindContoursStripeInvoker( Mat& _image, const std::vector<int>& _cuts,
+                               std::vector<MemStorage>& _storages, std::vector<CvSeq*>& _first,
+                               int _mode, int _method, Point _offset )
+        : image(&_image), cuts(&_cuts), storages(&_storages), first(&_first),
+          mode(_mode), method(_method), offset(_offset)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        for( int i = range.start; i < range.end; i++ )
+        {
+            int y0 = (*cuts)[i], y1 = (*cuts)[i+1];
+            CvMat _cstripe = image->rowRange(y0, y1 + 1);
+            CvContourScanner scanner = icvStartFindContours( &_cstripe, (*storages)[i], sizeof(CvContour),
+                                                             mode, method, cvPoint(offset.x, offset.y + y0), 0 );
+            try
+            {
+                while( cvFindNextContour( scanner ) != 0 )
+                    ;
+            }
+            catch(...)
+            {
+                cvEndFindContours( &scanner );
+                throw;
+            }
+            (*first)[i] = cvEndFindContours( &scanner );
+        }
+    }
+
+private:
+    Mat* image;
+    const std::vector<int>* cuts;
+    std::vector<MemStorage>* storages;
+    std::vector<CvSeq*>* first;
+    int mode;
+    int method;
+    Point offset;
+};
+
+static const int FIND_CONTOURS_MIN_STRIPE_HEIGHT = 128;
+static const int FIND_CONTOURS_MAX_STRIPES = 16;
+
+/* Picks the stripe borders: the first background row at or after each of the equally spaced
+   positions. The layout depends only on the image, so the result does not depend on the number of threads */
+static void findContoursStripes( const Mat& image, std::vector<int>& cuts )
+{
+    int rows = image.rows;
+    int nstripes = std::min(rows / FIND_CONTOURS_MIN_STRIPE_HEIGHT, FIND_CONTOURS_MAX_STRIPES);
+
+    cuts.clear();
+    cuts.push_back(0);
+    for( int k = 1; k < nstripes; k++ )
+    {
+        int y = std::max(rows*k/nstripes, cuts.back() + 2);
+        for( ; y < rows - 2; y++ )
+            if( countNonZero(image.row(y)) == 0 )
+                break;
+        if( y >= rows - 2 )
+            break;
+        cuts.push_back(y);
+    }
+    cuts.push_back(rows - 1);
+}
+
+static CvSeq* findContoursTree( Mat& image, CvMemStorage* storage, std::vector<MemStorage>& stripeStorages,
+                                int mode, int method, Point offset )
+{
+    CvSeq* first = 0;
+
+    if( image.type() != CV_8UC1 || mode < RETR_EXTERNAL || mode > RETR_TREE ||
+        method < CHAIN_APPROX_NONE || method > CHAIN_APPROX_TC89_KCOS ||
+        image.rows < FIND_CONTOURS_MIN_STRIPE_HEIGHT*2 || image.cols < 3 )
+    {
+        CvMat _cimage = image;
+        cvFindContours(&_cimage, storage, &first, sizeof(CvContour), mode, method, offset);
+        return first;
+    }
+
+    // prepare the image the same way cvStartFindContours does it
+    image.row(0).setTo(Scalar::all(0));
+    image.row(image.rows - 1).setTo(Scalar::all(0));
+    image.col(0).setTo(Scalar::all(0));
+    image.col(image.cols - 1).setTo(Scalar::all(0));
+    threshold(image, image, 0, 1, THRESH_BINARY);
+
+    std::vector<int> cuts;
+    findContoursStripes(image, cuts);
+
+    int i, nstripes = (int)cuts.size() - 1;
+    std::vector<CvSeq*> stripeFirst(nstripes, (CvSeq*)0);
+    stripeStorages.resize(nstripes);
+    for( i = 0; i < nstripes; i++ )
+        stripeStorages[i].reset(cvCreateMemStorage());
+
+    parallel_for_(Range(0, nstripes),
+                  FindContoursStripeInvoker(image, cuts, stripeStorages, stripeFirst, mode, method, offset));
+
+    // cvInsertNodeIntoTree prepends the new contours,
+    // so the top-level contours of the later stripes go first
+    CvSeq* last = 0;
+    for( i = nstripes - 1; i >= 0; i-- )
+    {
+        CvSeq* c = stripeFirst[i];
+        if( !c )
+            continue;
+        if( last )
+        {
+            last->h_next = c;
+            c->h_prev = last;
+        }
+        else
+            first = c;
+        for( last = c; last->h_next; last = last->h_next )
+            ;
+    }
+
+    return first;
+}
+
+static void storeContourHierarchy( const Seq<CvSeq*>& all_contours, OutputArray _hierarchy )
+{
+    int i, total = (int)all_contours.size();
+    _hierarchy.create(1, total, CV_32SC4, -1, true);
+    Vec4i* hierarchy = _hierarchy.getMat().ptr<Vec4i>();
+
+    SeqIterator<CvSeq*> it = all_contours.begin();
+    for( i = 0; i < total; i++, ++it )
+    {
+        CvSeq* c = *it;
+        int h_next = c->h_next ? ((CvContour*)c->h_next)->color : -1;
+        int h_prev = c->h_prev ? ((CvContour*)c->h_prev)->color : -1;
+        int v_next = c->v_next ? ((CvContour*)c->v_next)->color : -1;
+        int v_prev = c->v_prev ? ((CvContour*)c->v_prev)->color : -1;
+        hierarchy[i] = Vec4i(h_next, h_prev, v_next, v_prev);
+    }
+}
+
+}
+
 void cv::findContours( InputOutputArray _image, OutputArrayOfArrays _contours,
                    OutputArray _hierarchy, int mode, int method, Point offset )
 {
     Mat image = _image.getMat();
     MemStorage storage(cvCreateMemStorage());
-    CvMat _cimage = image;
-    CvSeq* _ccontours = 0;
+    std::vector<MemStorage> stripeStorages;
     if( _hierarchy.needed() )
         _hierarchy.clear();
-    cvFindContours(&_cimage, storage, &_ccontours, sizeof(CvContour), mode, method, offset);
+    CvSeq* _ccontours = findContoursTree(image, storage, stripeStorages, mode, method, offset);
     if( !_ccontours )
     {
         _contours.clear();
@@ -1730,21 +1892,49 @@ void cv::findContours( InputOutputArray _image, OutputArrayOfArrays _contours,
     }
 
     if( _hierarchy.needed() )
-    {
-        _hierarchy.create(1, total, CV_32SC4, -1, true);
-        Vec4i* hierarchy = _hierarchy.getMat().ptr<Vec4i>();
+        storeContourHierarchy(all_contours, _hierarchy);
+}
 
-        it = all_contours.begin();
-        for( i = 0; i < total; i++, ++it )
-        {
-            CvSeq* c = *it;
-            int h_next = c->h_next ? ((CvContour*)c->h_next)->color : -1;
-            int h_prev = c->h_prev ? ((CvContour*)c->h_prev)->color : -1;
-            int v_next = c->v_next ? ((CvContour*)c->v_next)->color : -1;
-            int v_prev = c->v_prev ? ((CvContour*)c->v_prev)->color : -1;
-            hierarchy[i] = Vec4i(h_next, h_prev, v_next, v_prev);
-        }
+void cv::findContours( InputOutputArray _image, OutputArray _points, OutputArray _offsets,
+                       OutputArray _hierarchy, int mode, int method, Point offset )
+{
+    Mat image = _image.getMat();
+    MemStorage storage(cvCreateMemStorage());
+    std::vector<MemStorage> stripeStorages;
+    if( _hierarchy.needed() )
+        _hierarchy.clear();
+    CvSeq* _ccontours = findContoursTree(image, storage, stripeStorages, mode, method, offset);
+    if( !_ccontours )
+    {
+        _points.release();
+        _offsets.create(1, 1, CV_32S);
+        _offsets.getMat().setTo(Scalar::all(0));
+        return;
     }
+    Seq<CvSeq*> all_contours(cvTreeToNodeSeq( _ccontours, sizeof(CvSeq), storage ));
+    int i, total = (int)all_contours.size(), npoints = 0;
+    _offsets.create(total + 1, 1, CV_32S);
+    int* offsets = _offsets.getMat().ptr<int>();
+    SeqIterator<CvSeq*> it = all_contours.begin();
+    for( i = 0; i < total; i++, ++it )
+    {
+        CvSeq* c = *it;
+        ((CvContour*)c)->color = (int)i;
+        offsets[i] = npoints;
+        npoints += c->total;
+    }
+    offsets[total] = npoints;
+
+    _points.create(npoints, 1, CV_32SC2);
+    Mat points = _points.getMat();
+    CV_Assert( points.isContinuous() );
+    Point* pts = points.ptr<Point>();
+    it = all_contours.begin();
+    for( i = 0; i < total; i++, ++it )
+        cvCvtSeqToArray(*it, pts + offsets[i]);
+
+    if( _hierarchy.needed() )
+        storeContourHierarchy(all_contours, _hierarchy);
 }
 
 void cv::findContours( InputOutputArray _image, OutputArrayOfArrays _contours,
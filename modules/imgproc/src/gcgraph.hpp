@@ -42,6 +42,11 @@
 #ifndef _CV_GCGRAPH_H_
 #define _CV_GCGRAPH_H_
 
+/*
+  Max-flow/min-cut graph (Boykov-Kolmogorov algorithm).
+  maxFlow() may be called again after changing the terminal weights with addTermWeights()
+  (negative increments are allowed); it continues from the residual graph left by the previous call.
+*/
 template <class TWeight> class GCGraph
 {
 public:
@@ -174,7 +179,10 @@ TWeight GCGraph<TWeight>::maxFlow()
             v->t = v->weight < 0;
         }
         else
+        {
             v->parent = 0;
+            v->t = 0;
+        }
     }
     first = first->next;
     last->next = nilNode;
@@ -368,8 +368,14 @@ namespace
         int levels_;
         int votesThreshold_;
 
-        std::vector< std::vector<Point> > r_table_;
+        // R-table in the SoA form: displacements of the template edge points with the n-th
+        // gradient direction are (r_table_x_[k], r_table_y_[k]) for r_table_ofs_[n] <= k < r_table_ofs_[n+1]
+        std::vector<int> r_table_ofs_;
+        std::vector<int> r_table_x_;
+        std::vector<int> r_table_y_;
         Mat hist_;
+
+        friend class BallardVotesInvoker;
     };
 
     GeneralizedHoughBallardImpl::GeneralizedHoughBallardImpl()
@@ -384,8 +390,8 @@ namespace
 
         const double thetaScale = levels_ / 360.0;
 
-        r_table_.resize(levels_ + 1);
-        std::for_each(r_table_.begin(), r_table_.end(), std::mem_fun_ref(&std::vector<Point>::clear));
+        // (n, dx, dy) for every template edge point
+        std::vector<Vec3i> entries;
 
         for (int y = 0; y < templSize_.height; ++y)
         {
@@ -395,18 +401,95 @@ namespace
 
             for (int x = 0; x < templSize_.width; ++x)
             {
-                const Point p(x, y);
-
                 if (edgesRow[x] && (notNull(dyRow[x]) || notNull(dxRow[x])))
                 {
                     const float theta = fastAtan2(dyRow[x], dxRow[x]);
                     const int n = cvRound(theta * thetaScale);
-                    r_table_[n].push_back(p - templCenter_);
+                    entries.push_back(Vec3i(n, x - templCenter_.x, y - templCenter_.y));
                 }
             }
         }
+
+        // counting sort by n keeps the raster order inside every level
+        r_table_ofs_.assign(levels_ + 2, 0);
+        for (size_t i = 0; i < entries.size(); ++i)
+            ++r_table_ofs_[entries[i][0] + 1];
+        for (int n = 0; n <= levels_; ++n)
+            r_table_ofs_[n + 1] += r_table_ofs_[n];
+
+        r_table_x_.resize(entries.size());
+        r_table_y_.resize(entries.size());
+
+        std::vector<int> pos(r_table_ofs_.begin(), r_table_ofs_.end() - 1);
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            const int k = pos[entries[i][0]]++;
+            r_table_x_[k] = entries[i][1];
+            r_table_y_[k] = entries[i][2];
+        }
     }
 
+    // accumulates the votes of a range of image rows into its own histogram
+    class BallardVotesInvoker : public ParallelLoopBody
+    {
+    public:
+        BallardVotesInvoker(const GeneralizedHoughBallardImpl* _impl, std::vector<Mat>& _hists)
+            : impl(_impl), hists(&_hists)
+        {
+        }
+
+        void operator()(const Range& range) const
+        {
+            const int nstripes = static_cast<int>(hists->size());
+            const int height = impl->imageSize_.height;
+
+            for (int i = range.start; i < range.end; ++i)
+                vote(height * i / nstripes, height * (i + 1) / nstripes, (*hists)[i]);
+        }
+
+    private:
+        void vote(int startRow, int endRow, Mat& hist) const
+        {
+            const double thetaScale = impl->levels_ / 360.0;
+            const double idp = 1.0 / impl->dp_;
+
+            const int rows = hist.rows - 2;
+            const int cols = hist.cols - 2;
+
+            const int* r_ofs = &impl->r_table_ofs_[0];
+            const int* r_x = impl->r_table_x_.empty() ? 0 : &impl->r_table_x_[0];
+            const int* r_y = impl->r_table_y_.empty() ? 0 : &impl->r_table_y_[0];
+
+            for (int y = startRow; y < endRow; ++y)
+            {
+                const uchar* edgesRow = impl->imageEdges_.ptr(y);
+                const float* dxRow = impl->imageDx_.ptr<float>(y);
+                const float* dyRow = impl->imageDy_.ptr<float>(y);
+
+                for (int x = 0; x < impl->imageSize_.width; ++x)
+                {
+                    if (edgesRow[x] && (notNull(dyRow[x]) || notNull(dxRow[x])))
+                    {
+                        const float theta = fastAtan2(dyRow[x], dxRow[x]);
+                        const int n = cvRound(theta * thetaScale);
+
+                        for (int j = r_ofs[n]; j < r_ofs[n + 1]; ++j)
+                        {
+                            const int cx = cvRound((x - r_x[j]) * idp);
+                            const int cy = cvRound((y - r_y[j]) * idp);
+
+                            if (cx >= 0 && cx < cols && cy >= 0 && cy < rows)
+                                ++hist.at<int>(cy + 1, cx + 1);
+                        }
+                    }
+                }
+            }
+        }
+
+        const GeneralizedHoughBallardImpl* impl;
+        std::vector<Mat>* hists;
+    };
+
     void GeneralizedHoughBallardImpl::processImage()
     {
         calcHist();
@@ -418,48 +501,26 @@ namespace
         CV_Assert( imageEdges_.type() == CV_8UC1 );
         CV_Assert( imageDx_.type() == CV_32FC1 && imageDx_.size() == imageSize_);
         CV_Assert( imageDy_.type() == imageDx_.type() && imageDy_.size() == imageSize_);
-        CV_Assert( levels_ > 0 && r_table_.size() == static_cast<size_t>(levels_ + 1) );
+        CV_Assert( levels_ > 0 && r_table_ofs_.size() == static_cast<size_t>(levels_ + 2) );
         CV_Assert( dp_ > 0.0 );
 
-        const double thetaScale = levels_ / 360.0;
         const double idp = 1.0 / dp_;
 
         hist_.create(cvCeil(imageSize_.height * idp) + 2, cvCeil(imageSize_.width * idp) + 2, CV_32SC1);
         hist_.setTo(0);
 
-        const int rows = hist_.rows - 2;
-        const int cols = hist_.cols - 2;
+        // the votes are integer, so the result does not depend on the number of stripes
+        const int nstripes = std::max(std::min(getNumThreads(), imageSize_.height), 1);
 
-        for (int y = 0; y < imageSize_.height; ++y)
-        {
-            const uchar* edgesRow = imageEdges_.ptr(y);
-            const float* dxRow = imageDx_.ptr<float>(y);
-            const float* dyRow = imageDy_.ptr<float>(y);
+        std::vector<Mat> hists(nstripes);
+        hists[0] = hist_;
+        for (int i = 1; i < nstripes; ++i)
+            hists[i] = Mat::zeros(hist_.size(), hist_.type());
 
-            for (int x = 0; x < imageSize_.width; ++x)
-            {
-                const Point p(x, y);
+        parallel_for_(Range(0, nstripes), BallardVotesInvoker(this, hists));
 
-                if (edgesRow[x] && (notNull(dyRow[x]) || notNull(dxRow[x])))
-                {
-                    const float theta = fastAtan2(dyRow[x], dxRow[x]);
-                    const int n = cvRound(theta * thetaScale);
-
-                    const std::vector<Point>& r_row = r_table_[n];
-
-                    for (size_t j = 0; j < r_row.size(); ++j)
-                    {
-                        Point c = p - r_row[j];
-
-                        c.x = cvRound(c.x * idp);
-                        c.y = cvRound(c.y * idp);
-
-                        if (c.x >= 0 && c.x < cols && c.y >= 0 && c.y < rows)
-                            ++hist_.at<int>(c.y + 1, c.x + 1);
-                    }
-                }
-            }
-        }
+        for (int i = 1; i < nstripes; ++i)
+            hist_ += hists[i];
     }
 
     void GeneralizedHoughBallardImpl::findPosInHist()
@@ -603,14 +664,19 @@ namespace
         void getContourPoints(const Mat& edges, const Mat& dx, const Mat& dy, std::vector<ContourPoint>& points);
 
         void calcOrientation();
-        void calcScale(double angle);
-        void calcPosition(double angle, int angleVotes, double scale, int scaleVotes);
+        void calcOrientationHist(const Range& levels, std::vector<int>& OHist) const;
+        void calcScale(double angle, std::vector< std::pair<double, int> >& scales) const;
+        void calcPosition(double angle, int angleVotes, double scale, int scaleVotes, Mat& DHist,
+                          std::vector<Vec4f>& posOut, std::vector<Vec3i>& voteOut) const;
 
         std::vector< std::vector<Feature> > templFeatures_;
         std::vector< std::vector<Feature> > imageFeatures_;
 
         std::vector< std::pair<double, int> > angles_;
-        std::vector< std::pair<double, int> > scales_;
+
+        friend class GuilOrientationInvoker;
+        friend class GuilScaleInvoker;
+        friend class GuilPositionInvoker;
     };
 
     double clampAngle(double a)
@@ -655,27 +721,123 @@ namespace
         buildFeatureList(templEdges_, templDx_, templDy_, templFeatures_, templCenter_);
     }
 
+    // every stripe of levels accumulates the orientation votes into its own histogram
+    class GuilOrientationInvoker : public ParallelLoopBody
+    {
+    public:
+        GuilOrientationInvoker(const GeneralizedHoughGuilImpl* _impl, std::vector< std::vector<int> >& _hists)
+            : impl(_impl), hists(&_hists)
+        {
+        }
+
+        void operator()(const Range& range) const
+        {
+            const int nstripes = static_cast<int>(hists->size());
+            const int nlevels = impl->levels_ + 1;
+
+            for (int i = range.start; i < range.end; ++i)
+                impl->calcOrientationHist(Range(nlevels * i / nstripes, nlevels * (i + 1) / nstripes), (*hists)[i]);
+        }
+
+    private:
+        const GeneralizedHoughGuilImpl* impl;
+        std::vector< std::vector<int> >* hists;
+    };
+
+    // searches the scale for every rotation hypothesis
+    class GuilScaleInvoker : public ParallelLoopBody
+    {
+    public:
+        GuilScaleInvoker(const GeneralizedHoughGuilImpl* _impl, std::vector< std::vector< std::pair<double, int> > >& _scales)
+            : impl(_impl), scales(&_scales)
+        {
+        }
+
+        void operator()(const Range& range) const
+        {
+            for (int i = range.start; i < range.end; ++i)
+                impl->calcScale(impl->angles_[i].first, (*scales)[i]);
+        }
+
+    private:
+        const GeneralizedHoughGuilImpl* impl;
+        std::vector< std::vector< std::pair<double, int> > >* scales;
+    };
+
+    struct GuilHypothesis
+    {
+        double angle;
+        int angleVotes;
+        double scale;
+        int scaleVotes;
+    };
+
+    // searches the positions for every rotation+scale hypothesis,
+    // the histogram buffer is shared by the hypotheses of one stripe
+    class GuilPositionInvoker : public ParallelLoopBody
+    {
+    public:
+        GuilPositionInvoker(const GeneralizedHoughGuilImpl* _impl, const std::vector<GuilHypothesis>& _hypotheses,
+                            std::vector< std::vector<Vec4f> >& _posOut, std::vector< std::vector<Vec3i> >& _voteOut)
+            : impl(_impl), hypotheses(&_hypotheses), posOut(&_posOut), voteOut(&_voteOut)
+        {
+        }
+
+        void operator()(const Range& range) const
+        {
+            Mat DHist;
+
+            for (int i = range.start; i < range.end; ++i)
+            {
+                const GuilHypothesis& h = (*hypotheses)[i];
+                impl->calcPosition(h.angle, h.angleVotes, h.scale, h.scaleVotes, DHist, (*posOut)[i], (*voteOut)[i]);
+            }
+        }
+
+    private:
+        const GeneralizedHoughGuilImpl* impl;
+        const std::vector<GuilHypothesis>* hypotheses;
+        std::vector< std::vector<Vec4f> >* posOut;
+        std::vector< std::vector<Vec3i> >* voteOut;
+    };
+
     void GeneralizedHoughGuilImpl::processImage()
     {
         buildFeatureList(imageEdges_, imageDx_, imageDy_, imageFeatures_);
 
         calcOrientation();
 
-        for (size_t i = 0; i < angles_.size(); ++i)
-        {
-            const double angle = angles_[i].first;
-            const int angleVotes = angles_[i].second;
+        const int anglesCount = static_cast<int>(angles_.size());
 
-            calcScale(angle);
+        std::vector< std::vector< std::pair<double, int> > > scales(anglesCount);
+        parallel_for_(Range(0, anglesCount), GuilScaleInvoker(this, scales));
 
-            for (size_t j = 0; j < scales_.size(); ++j)
+        std::vector<GuilHypothesis> hypotheses;
+        for (int i = 0; i < anglesCount; ++i)
+        {
+            for (size_t j = 0; j < scales[i].size(); ++j)
             {
-                const double scale = scales_[j].first;
-                const int scaleVotes = scales_[j].second;
-
-                calcPosition(angle, angleVotes, scale, scaleVotes);
+                GuilHypothesis h;
+                h.angle = angles_[i].first;
+                h.angleVotes = angles_[i].second;
+                h.scale = scales[i][j].first;
+                h.scaleVotes = scales[i][j].second;
+                hypotheses.push_back(h);
             }
         }
+
+        const int hypothesesCount = static_cast<int>(hypotheses.size());
+
+        std::vector< std::vector<Vec4f> > posOut(hypothesesCount);
+        std::vector< std::vector<Vec3i> > voteOut(hypothesesCount);
+        parallel_for_(Range(0, hypothesesCount), GuilPositionInvoker(this, hypotheses, posOut, voteOut));
+
+        // keep the order of the serial search
+        for (int i = 0; i < hypothesesCount; ++i)
+        {
+            posOutBuf_.insert(posOutBuf_.end(), posOut[i].begin(), posOut[i].end());
+            voteOutBuf_.insert(voteOutBuf_.end(), voteOut[i].begin(), voteOut[i].end());
+        }
     }
 
     void GeneralizedHoughGuilImpl::buildFeatureList(const Mat& edges, const Mat& dx, const Mat& dy, std::vector< std::vector<Feature> >& features, Point2d center)
@@ -770,19 +932,47 @@ namespace
         const double iAngleStep = 1.0 / angleStep_;
         const int angleRange = cvCeil((maxAngle_ - minAngle_) * iAngleStep);
 
-        std::vector<int> OHist(angleRange + 1, 0);
-        for (int i = 0; i <= levels_; ++i)
+        // the votes are integer, so the result does not depend on the number of stripes
+        const int nstripes = std::max(std::min(getNumThreads(), levels_ + 1), 1);
+
+        std::vector< std::vector<int> > OHists(nstripes, std::vector<int>(angleRange + 1, 0));
+        parallel_for_(Range(0, nstripes), GuilOrientationInvoker(this, OHists));
+
+        std::vector<int>& OHist = OHists[0];
+        for (int i = 1; i < nstripes; ++i)
+        {
+            for (int n = 0; n <= angleRange; ++n)
+                OHist[n] += OHists[i][n];
+        }
+
+        angles_.clear();
+
+        for (int n = 0; n < angleRange; ++n)
+        {
+            if (OHist[n] >= angleThresh_)
+            {
+                const double angle = minAngle_ + n * angleStep_;
+                angles_.push_back(std::make_pair(angle, OHist[n]));
+            }
+        }
+    }
+
+    void GeneralizedHoughGuilImpl::calcOrientationHist(const Range& levels, std::vector<int>& OHist) const
+    {
+        const double iAngleStep = 1.0 / angleStep_;
+
+        for (int i = levels.start; i < levels.end; ++i)
         {
             const std::vector<Feature>& templRow = templFeatures_[i];
             const std::vector<Feature>& imageRow = imageFeatures_[i];
 
             for (size_t j = 0; j < templRow.size(); ++j)
             {
-                Feature templF = templRow[j];
+                const Feature& templF = templRow[j];
 
                 for (size_t k = 0; k < imageRow.size(); ++k)
                 {
-                    Feature imF = imageRow[k];
+                    const Feature& imF = imageRow[k];
 
                     const double angle = clampAngle(imF.p1.theta - templF.p1.theta);
                     if (angle >= minAngle_ && angle <= maxAngle_)
@@ -793,20 +983,9 @@ namespace
                 }
             }
         }
-
-        angles_.clear();
-
-        for (int n = 0; n < angleRange; ++n)
-        {
-            if (OHist[n] >= angleThresh_)
-            {
-                const double angle = minAngle_ + n * angleStep_;
-                angles_.push_back(std::make_pair(angle, OHist[n]));
-            }
-        }
     }
 
-    void GeneralizedHoughGuilImpl::calcScale(double angle)
+    void GeneralizedHoughGuilImpl::calcScale(double angle, std::vector< std::pair<double, int> >& scales) const
     {
         CV_Assert( levels_ > 0 );
         CV_Assert( templFeatures_.size() == static_cast<size_t>(levels_ + 1) );
@@ -833,7 +1012,7 @@ namespace
 
                 for (size_t k = 0; k < imageRow.size(); ++k)
                 {
-                    Feature imF = imageRow[k];
+                    const Feature& imF = imageRow[k];
 
                     if (angleEq(imF.p1.theta, templF.p1.theta, angleEpsilon_))
                     {
@@ -848,19 +1027,20 @@ namespace
             }
         }
 
-        scales_.clear();
+        scales.clear();
 
         for (int s = 0; s < scaleRange; ++s)
         {
             if (SHist[s] >= scaleThresh_)
             {
                 const double scale = minScale_ + s * scaleStep_;
-                scales_.push_back(std::make_pair(scale, SHist[s]));
+                scales.push_back(std::make_pair(scale, SHist[s]));
             }
         }
     }
 
-    void GeneralizedHoughGuilImpl::calcPosition(double angle, int angleVotes, double scale, int scaleVotes)
+    void GeneralizedHoughGuilImpl::calcPosition(double angle, int angleVotes, double scale, int scaleVotes, Mat& DHist,
+                                                std::vector<Vec4f>& posOut, std::vector<Vec3i>& voteOut) const
     {
         CV_Assert( levels_ > 0 );
         CV_Assert( templFeatures_.size() == static_cast<size_t>(levels_ + 1) );
@@ -875,7 +1055,8 @@ namespace
         const int histRows = cvCeil(imageSize_.height * idp);
         const int histCols = cvCeil(imageSize_.width * idp);
 
-        Mat DHist(histRows + 2, histCols + 2, CV_32SC1, Scalar::all(0));
+        DHist.create(histRows + 2, histCols + 2, CV_32SC1);
+        DHist.setTo(Scalar::all(0));
 
         for (int i = 0; i <= levels_; ++i)
         {
@@ -896,7 +1077,7 @@ namespace
 
                 for (size_t k = 0; k < imageRow.size(); ++k)
                 {
-                    Feature imF = imageRow[k];
+                    const Feature& imF = imageRow[k];
 
                     if (angleEq(imF.p1.theta, templF.p1.theta, angleEpsilon_))
                     {
@@ -930,8 +1111,8 @@ namespace
 
                 if (votes > posThresh_ && votes > curRow[x] && votes >= curRow[x + 2] && votes > prevRow[x + 1] && votes >= nextRow[x + 1])
                 {
-                    posOutBuf_.push_back(Vec4f(static_cast<float>(x * dp_), static_cast<float>(y * dp_), static_cast<float>(scale), static_cast<float>(angle)));
-                    voteOutBuf_.push_back(Vec3i(votes, scaleVotes, angleVotes));
+                    posOut.push_back(Vec4f(static_cast<float>(x * dp_), static_cast<float>(y * dp_), static_cast<float>(scale), static_cast<float>(angle)));
+                    voteOut.push_back(Vec3i(votes, scaleVotes, angleVotes));
                 }
             }
         }
@@ -66,6 +66,7 @@ public:
 
     void initLearning();
     void addSample( int ci, const Vec3d color );
+    void addSamples( const GMM& gmm );
     void endLearning();
 
 private:
@@ -171,6 +172,25 @@ void GMM::addSample( int ci, const Vec3d color )
     totalSampleCount++;
 }
 
+/*
+  Adds the samples accumulated by another model since its initLearning().
+*/
+void GMM::addSamples( const GMM& gmm )
+{
+    for( int ci = 0; ci < componentsCount; ci++ )
+    {
+        for( int j = 0; j < 3; j++ )
+        {
+            sums[ci][j] += gmm.sums[ci][j];
+            prods[ci][j][0] += gmm.prods[ci][j][0];
+            prods[ci][j][1] += gmm.prods[ci][j][1];
+            prods[ci][j][2] += gmm.prods[ci][j][2];
+        }
+        sampleCounts[ci] += gmm.sampleCounts[ci];
+    }
+    totalSampleCount += gmm.totalSampleCount;
+}
+
 void GMM::endLearning()
 {
     const double variance = 0.01;
@@ -272,48 +292,74 @@ static double calcBeta( const Mat& img )
   Calculate weights of noterminal vertices of graph.
   beta and gamma - parameters of GrabCut algorithm.
  */
-static void calcNWeights( const Mat& img, Mat& leftW, Mat& upleftW, Mat& upW, Mat& uprightW, double beta, double gamma )
+class CalcNWeightsInvoker : public ParallelLoopBody
 {
-    const double gammaDivSqrt2 = gamma / std::sqrt(2.0f);
-    leftW.create( img.rows, img.cols, CV_64FC1 );
-    upleftW.create( img.rows, img.cols, CV_64FC1 );
-    upW.create( img.rows, img.cols, CV_64FC1 );
-    uprightW.create( img.rows, img.cols, CV_64FC1 );
-    for( int y = 0; y < img.rows; y++ )
+public:
+    CalcNWeightsInvoker( const Mat& _img, Mat& _leftW, Mat& _upleftW, Mat& _upW, Mat& _uprightW,
+                         double _beta, double _gamma )
+        : img(&_img), leftW(&_leftW), upleftW(&_upleftW), upW(&_upW), uprightW(&_uprightW),
+          beta(_beta), gamma(_gamma)
     {
-        for( int x = 0; x < img.cols; x++ )
+    }
+
+    void operator()( const Range& range ) const
+    {
+        const double gammaDivSqrt2 = gamma / std::sqrt(2.0f);
+        for( int y = range.start; y < range.end; y++ )
         {
-            Vec3d color = img.at<Vec3b>(y,x);
-            if( x-1>=0 ) // left
-            {
-                Vec3d diff = color - (Vec3d)img.at<Vec3b>(y,x-1);
-                leftW.at<double>(y,x) = gamma * exp(-beta*diff.dot(diff));
-            }
-            else
-                leftW.at<double>(y,x) = 0;
-            if( x-1>=0 && y-1>=0 ) // upleft
-            {
-                Vec3d diff = color - (Vec3d)img.at<Vec3b>(y-1,x-1);
-                upleftW.at<double>(y,x) = gammaDivSqrt2 * exp(-beta*diff.dot(diff));
-            }
-            else
-                upleftW.at<double>(y,x) = 0;
-            if( y-1>=0 ) // up
+            for( int x = 0; x < img->cols; x++ )
             {
-                Vec3d diff = color - (Vec3d)img.at<Vec3b>(y-1,x);
-                upW.at<double>(y,x) = gamma * exp(-beta*diff.dot(diff));
-            }
-            else
-                upW.at<double>(y,x) = 0;
-            if( x+1<img.cols && y-1>=0 ) // upright
-            {
-                Vec3d diff = color - (Vec3d)img.at<Vec3b>(y-1,x+1);
-                uprightW.at<double>(y,x) = gammaDivSqrt2 * exp(-beta*diff.dot(diff));
+                Vec3d color = img->at<Vec3b>(y,x);
+                if( x-1>=0 ) // left
+                {
+                    Vec3d diff = color - (Vec3d)img->at<Vec3b>(y,x-1);
+                    leftW->at<double>(y,x) = gamma * exp(-beta*diff.dot(diff));
+                }
+                else
+                    leftW->at<double>(y,x) = 0;
+                if( x-1>=0 && y-1>=0 ) // upleft
+                {
+                    Vec3d diff = color - (Vec3d)img->at<Vec3b>(y-1,x-1);
+                    upleftW->at<double>(y,x) = gammaDivSqrt2 * exp(-beta*diff.dot(diff));
+                }
+                else
+                    upleftW->at<double>(y,x) = 0;
+                if( y-1>=0 ) // up
+                {
+                    Vec3d diff = color - (Vec3d)img->at<Vec3b>(y-1,x);
+                    upW->at<double>(y,x) = gamma * exp(-beta*diff.dot(diff));
+                }
+                else
+                    upW->at<double>(y,x) = 0;
+                if( x+1<img->cols && y-1>=0 ) // upright
+                {
+                    Vec3d diff = color - (Vec3d)img->at<Vec3b>(y-1,x+1);
+                    uprightW->at<double>(y,x) = gammaDivSqrt2 * exp(-beta*diff.dot(diff));
+                }
+                else
+                    uprightW->at<double>(y,x) = 0;
             }
-            else
-                uprightW.at<double>(y,x) = 0;
         }
     }
+
+private:
+    const Mat* img;
+    Mat* leftW;
+    Mat* upleftW;
+    Mat* upW;
+    Mat* uprightW;
+    double beta;
+    double gamma;
+};
+
+static void calcNWeights( const Mat& img, Mat& leftW, Mat& upleftW, Mat& upW, Mat& uprightW, double beta, double gamma )
+{
+    leftW.create( img.rows, img.cols, CV_64FC1 );
+    upleftW.create( img.rows, img.cols, CV_64FC1 );
+    upW.create( img.rows, img.cols, CV_64FC1 );
+    uprightW.create( img.rows, img.cols, CV_64FC1 );
+    parallel_for_( Range(0, img.rows), CalcNWeightsInvoker(img, leftW, upleftW, upW, uprightW, beta, gamma),
+                   img.total()/(double)(1<<16) );
 }
 
 /*
@@ -398,52 +444,157 @@ static void initGMMs( const Mat& img, const Mat& mask, GMM& bgdGMM, GMM& fgdGMM
 /*
   Assign GMMs components for each pixel.
 */
-static void assignGMMsComponents( const Mat& img, const Mat& mask, const GMM& bgdGMM, const GMM& fgdGMM, Mat& compIdxs )
+class AssignGMMsComponentsInvoker : public ParallelLoopBody
 {
-    Point p;
-    for( p.y = 0; p.y < img.rows; p.y++ )
+public:
+    AssignGMMsComponentsInvoker( const Mat& _img, const Mat& _mask, const GMM& _bgdGMM, const GMM& _fgdGMM,
+                                 Mat& _compIdxs )
+        : img(&_img), mask(&_mask), bgdGMM(&_bgdGMM), fgdGMM(&_fgdGMM), compIdxs(&_compIdxs)
     {
-        for( p.x = 0; p.x < img.cols; p.x++ )
+    }
+
+    void operator()( const Range& range ) const
+    {
+        for( int y = range.start; y < range.end; y++ )
         {
-            Vec3d color = img.at<Vec3b>(p);
-            compIdxs.at<int>(p) = mask.at<uchar>(p) == GC_BGD || mask.at<uchar>(p) == GC_PR_BGD ?
-                bgdGMM.whichComponent(color) : fgdGMM.whichComponent(color);
+            const Vec3b* colors = img->ptr<Vec3b>(y);
+            const uchar* labels = mask->ptr<uchar>(y);
+            int* comps = compIdxs->ptr<int>(y);
+            for( int x = 0; x < img->cols; x++ )
+            {
+                Vec3d color = colors[x];
+                comps[x] = labels[x] == GC_BGD || labels[x] == GC_PR_BGD ?
+                    bgdGMM->whichComponent(color) : fgdGMM->whichComponent(color);
+            }
         }
     }
+
+private:
+    const Mat* img;
+    const Mat* mask;
+    const GMM* bgdGMM;
+    const GMM* fgdGMM;
+    Mat* compIdxs;
+};
+
+static void assignGMMsComponents( const Mat& img, const Mat& mask, const GMM& bgdGMM, const GMM& fgdGMM, Mat& compIdxs )
+{
+    parallel_for_( Range(0, img.rows), AssignGMMsComponentsInvoker(img, mask, bgdGMM, fgdGMM, compIdxs),
+                   img.total()/(double)(1<<16) );
 }
 
 /*
   Learn GMMs parameters.
+  Every stripe of rows accumulates its samples into its own pair of models,
+  they are merged afterwards in the stripe order.
 */
-static void learnGMMs( const Mat& img, const Mat& mask, const Mat& compIdxs, GMM& bgdGMM, GMM& fgdGMM )
+class LearnGMMsInvoker : public ParallelLoopBody
 {
-    bgdGMM.initLearning();
-    fgdGMM.initLearning();
-    Point p;
-    for( int ci = 0; ci < GMM::componentsCount; ci++ )
+public:
+    LearnGMMsInvoker( const Mat& _img, const Mat& _mask, const Mat& _compIdxs,
+                      std::vector<GMM>& _bgdGMMs, std::vector<GMM>& _fgdGMMs )
+        : img(&_img), mask(&_mask), compIdxs(&_compIdxs), bgdGMMs(&_bgdGMMs), fgdGMMs(&_fgdGMMs)
+    {
+    }
+
+    void operator()( const Range& range ) const
     {
-        for( p.y = 0; p.y < img.rows; p.y++ )
+        int nstripes = (int)bgdGMMs->size();
+        for( int i = range.start; i < range.end; i++ )
         {
-            for( p.x = 0; p.x < img.cols; p.x++ )
+            GMM& bgdGMM = (*bgdGMMs)[i];
+            GMM& fgdGMM = (*fgdGMMs)[i];
+            int y0 = img->rows*i/nstripes, y1 = img->rows*(i+1)/nstripes;
+            for( int y = y0; y < y1; y++ )
             {
-                if( compIdxs.at<int>(p) == ci )
+                const Vec3b* colors = img->ptr<Vec3b>(y);
+                const uchar* labels = mask->ptr<uchar>(y);
+                const int* comps = compIdxs->ptr<int>(y);
+                for( int x = 0; x < img->cols; x++ )
                 {
-                    if( mask.at<uchar>(p) == GC_BGD || mask.at<uchar>(p) == GC_PR_BGD )
-                        bgdGMM.addSample( ci, img.at<Vec3b>(p) );
+                    if( labels[x] == GC_BGD || labels[x] == GC_PR_BGD )
+                        bgdGMM.addSample( comps[x], colors[x] );
                     else
-                        fgdGMM.addSample( ci, img.at<Vec3b>(p) );
+                        fgdGMM.addSample( comps[x], colors[x] );
                 }
             }
         }
     }
+
+private:
+    const Mat* img;
+    const Mat* mask;
+    const Mat* compIdxs;
+    std::vector<GMM>* bgdGMMs;
+    std::vector<GMM>* fgdGMMs;
+};
+
+static void learnGMMs( const Mat& img, const Mat& mask, const Mat& compIdxs, GMM& bgdGMM, GMM& fgdGMM )
+{
+    // the samples are integer-valued, so the sums do not depend on the order of accumulation
+    const int nstripes = std::max(std::min(img.rows, 16), 1);
+
+    bgdGMM.initLearning();
+    fgdGMM.initLearning();
+    std::vector<GMM> bgdGMMs(nstripes, bgdGMM), fgdGMMs(nstripes, fgdGMM);
+    parallel_for_( Range(0, nstripes), LearnGMMsInvoker(img, mask, compIdxs, bgdGMMs, fgdGMMs) );
+    for( int i = 0; i < nstripes; i++ )
+    {
+        bgdGMM.addSamples( bgdGMMs[i] );
+        fgdGMM.addSamples( fgdGMMs[i] );
+    }
     bgdGMM.endLearning();
     fgdGMM.endLearning();
 }
 
 /*
-  Construct GCGraph
+  Calculate weights of terminal edges: (fromSource, toSink) for each pixel.
+*/
+class CalcTermWeightsInvoker : public ParallelLoopBody
+{
+public:
+    CalcTermWeightsInvoker( const Mat& _img, const Mat& _mask, const GMM& _bgdGMM, const GMM& _fgdGMM,
+                            double _lambda, Mat& _termW )
+        : img(&_img), mask(&_mask), bgdGMM(&_bgdGMM), fgdGMM(&_fgdGMM), lambda(_lambda), termW(&_termW)
+    {
+    }
+
+    void operator()( const Range& range ) const
+    {
+        for( int y = range.start; y < range.end; y++ )
+        {
+            const Vec3b* colors = img->ptr<Vec3b>(y);
+            const uchar* labels = mask->ptr<uchar>(y);
+            Vec2d* weights = termW->ptr<Vec2d>(y);
+            for( int x = 0; x < img->cols; x++ )
+            {
+                if( labels[x] == GC_PR_BGD || labels[x] == GC_PR_FGD )
+                {
+                    Vec3d color = colors[x];
+                    weights[x] = Vec2d( -log( (*bgdGMM)(color) ), -log( (*fgdGMM)(color) ) );
+                }
+                else if( labels[x] == GC_BGD )
+                    weights[x] = Vec2d( 0, lambda );
+                else // GC_FGD
+                    weights[x] = Vec2d( lambda, 0 );
+            }
+        }
+    }
+
+private:
+    const Mat* img;
+    const Mat* mask;
+    const GMM* bgdGMM;
+    const GMM* fgdGMM;
+    double lambda;
+    Mat* termW;
+};
+
+/*
+  Construct GCGraph with n-weights only.
+  The graph is built once and reused by all the iterations.
 */
-static void constructGCGraph( const Mat& img, const Mat& mask, const GMM& bgdGMM, const GMM& fgdGMM, double lambda,
+static void constructGCGraph( const Mat& img,
                        const Mat& leftW, const Mat& upleftW, const Mat& upW, const Mat& uprightW,
                        GCGraph<double>& graph )
 {
@@ -457,26 +608,6 @@ static void constructGCGraph( const Mat& img, const Mat& mask, const GMM& bgdGMM
         {
             // add node
             int vtxIdx = graph.addVtx();
-            Vec3b color = img.at<Vec3b>(p);
-
-            // set t-weights
-            double fromSource, toSink;
-            if( mask.at<uchar>(p) == GC_PR_BGD || mask.at<uchar>(p) == GC_PR_FGD )
-            {
-                fromSource = -log( bgdGMM(color) );
-                toSink = -log( fgdGMM(color) );
-            }
-            else if( mask.at<uchar>(p) == GC_BGD )
-            {
-                fromSource = 0;
-                toSink = lambda;
-            }
-            else // GC_FGD
-            {
-                fromSource = lambda;
-                toSink = 0;
-            }
-            graph.addTermWeights( vtxIdx, fromSource, toSink );
 
             // set n-weights
             if( p.x>0 )
@@ -503,6 +634,32 @@ static void constructGCGraph( const Mat& img, const Mat& mask, const GMM& bgdGMM
     }
 }
 
+/*
+  Set t-weights of GCGraph.
+  Only the difference with the previous iteration t-weights is added, so the flow
+  found by the previous maxFlow() stays valid and the next maxFlow() continues from it.
+*/
+static void setTermWeights( const Mat& img, const Mat& mask, const GMM& bgdGMM, const GMM& fgdGMM, double lambda,
+                            Mat& termW, Mat& prevTermW, GCGraph<double>& graph )
+{
+    parallel_for_( Range(0, img.rows), CalcTermWeightsInvoker(img, mask, bgdGMM, fgdGMM, lambda, termW),
+                   img.total()/(double)(1<<16) );
+
+    int vtxIdx = 0;
+    for( int y = 0; y < img.rows; y++ )
+    {
+        const Vec2d* weights = termW.ptr<Vec2d>(y);
+        const Vec2d* prevWeights = prevTermW.ptr<Vec2d>(y);
+        for( int x = 0; x < img.cols; x++, vtxIdx++ )
+        {
+            Vec2d dw = weights[x] - prevWeights[x];
+            if( dw[0] != 0 || dw[1] != 0 )
+                graph.addTermWeights( vtxIdx, dw[0], dw[1] );
+        }
+    }
+    std::swap( termW, prevTermW );
+}
+
 /*
   Estimate segmentation using MaxFlow algorithm
 */
@@ -564,12 +721,15 @@ void cv::grabCut( InputArray _img, InputOutputArray _mask, Rect rect,
     Mat leftW, upleftW, upW, uprightW;
     calcNWeights( img, leftW, upleftW, upW, uprightW, beta, gamma );
 
+    GCGraph<double> graph;
+    constructGCGraph( img, leftW, upleftW, upW, uprightW, graph );
+
+    Mat termW( img.size(), CV_64FC2 ), prevTermW( img.size(), CV_64FC2, Scalar::all(0) );
     for( int i = 0; i < iterCount; i++ )
     {
-        GCGraph<double> graph;
         assignGMMsComponents( img, mask, bgdGMM, fgdGMM, compIdxs );
         learnGMMs( img, mask, compIdxs, bgdGMM, fgdGMM );
-        constructGCGraph(img, mask, bgdGMM, fgdGMM, lambda, leftW, upleftW, upW, uprightW, graph );
+        setTermWeights( img, mask, bgdGMM, fgdGMM, lambda, termW, prevTermW, graph );
         estimateSegmentation( graph, mask );
     }
 }
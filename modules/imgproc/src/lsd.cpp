@@ -230,6 +230,7 @@ public:
 
 private:
     Mat image;
+    Mat gaussian_image;
     Mat_<double> scaled_image;
     double *scaled_image_data;
     Mat_<double> angles;     // in rads
@@ -238,6 +239,11 @@ private:
     double *modgrad_data;
     Mat_<uchar> used;
 
+    // buffers kept between the detect() calls
+    std::vector<Point> ordered_points;   // points pseudo ordered by the gradient magnitude
+    std::vector<int> bin_counts;
+    std::vector<double> row_max_grad;
+
     int img_width;
     int img_height;
     double LOG_NT;
@@ -263,12 +269,7 @@ private:
         double modgrad;
     };
 
-
-    struct coorlist
-    {
-        Point2i p;
-        struct coorlist* next;
-    };
+    std::vector<RegionPoint> reg;
 
     struct rect
     {
@@ -303,13 +304,13 @@ private:
 
 /**
  * Finds the angles and the gradients of the image. Generates a list of pseudo ordered points.
+ * The result is stored in ordered_points: coordinate points that are pseudo ordered by magnitude,
+ * from the largest to the smallest. Pixels would be ordered by norm value, up to a precision given by max_grad/n_bins.
  *
  * @param threshold The minimum value of the angle that is considered defined, otherwise NOTDEF
  * @param n_bins    The number of bins with which gradients are ordered by, using bucket sort.
- * @param list      Return: Vector of coordinate points that are pseudo ordered by magnitude.
- *                  Pixels would be ordered by norm value, up to a precision given by max_grad/n_bins.
  */
-    void ll_angle(const double& threshold, const unsigned int& n_bins, std::vector<coorlist>& list);
+    void ll_angle(const double& threshold, const unsigned int& n_bins);
 
 /**
  * Grow a region starting from point s with a defined precision,
@@ -412,7 +413,7 @@ LineSegmentDetectorImpl::LineSegmentDetectorImpl(int _refine, double _scale, dou
 void LineSegmentDetectorImpl::detect(InputArray _image, OutputArray _lines,
                 OutputArray _width, OutputArray _prec, OutputArray _nfa)
 {
-    Mat_<double> img = _image.getMat();
+    Mat img = _image.getMat();
     CV_Assert(!img.empty() && img.channels() == 1);
 
     // Convert image to double
@@ -444,23 +445,21 @@ void LineSegmentDetectorImpl::flsd(std::vector<Vec4i>& lines,
     const double p = ANG_TH / 180;
     const double rho = QUANT / sin(prec);    // gradient magnitude threshold
 
-    std::vector<coorlist> list;
     if(SCALE != 1)
     {
-        Mat gaussian_img;
         const double sigma = (SCALE < 1)?(SIGMA_SCALE / SCALE):(SIGMA_SCALE);
         const double sprec = 3;
         const unsigned int h =  (unsigned int)(ceil(sigma * sqrt(2 * sprec * log(10.0))));
         Size ksize(1 + 2 * h, 1 + 2 * h); // kernel size
-        GaussianBlur(image, gaussian_img, ksize, sigma);
+        GaussianBlur(image, gaussian_image, ksize, sigma);
         // Scale image to needed size
-        resize(gaussian_img, scaled_image, Size(), SCALE, SCALE);
-        ll_angle(rho, N_BINS, list);
+        resize(gaussian_image, scaled_image, Size(), SCALE, SCALE);
+        ll_angle(rho, N_BINS);
     }
     else
     {
         scaled_image = image;
-        ll_angle(rho, N_BINS, list);
+        ll_angle(rho, N_BINS);
     }
 
     LOG_NT = 5 * (log10(double(img_width)) + log10(double(img_height))) / 2 + log10(11.0);
@@ -468,20 +467,22 @@ void LineSegmentDetectorImpl::flsd(std::vector<Vec4i>& lines,
 
     // // Initialize region only when needed
     // Mat region = Mat::zeros(scaled_image.size(), CV_8UC1);
-    used = Mat_<uchar>::zeros(scaled_image.size()); // zeros = NOTUSED
-    std::vector<RegionPoint> reg(img_width * img_height);
+    used.create(scaled_image.size());
+    used.setTo(NOTUSED);
+    reg.resize(img_width * img_height);
 
     // Search for line segments
     unsigned int ls_count = 0;
-    unsigned int list_size = list.size();
+    unsigned int list_size = (unsigned int)ordered_points.size();
     for(unsigned int i = 0; i < list_size; ++i)
     {
-        unsigned int adx = list[i].p.x + list[i].p.y * img_width;
+        const Point2i& point = ordered_points[i];
+        unsigned int adx = point.x + point.y * img_width;
         if((used.data[adx] == NOTUSED) && (angles_data[adx] != NOTDEF))
         {
             int reg_size;
             double reg_angle;
-            region_grow(list[i].p, reg, reg_size, reg_angle, prec);
+            region_grow(point, reg, reg_size, reg_angle, prec);
 
             // Ignore small regions
             if(reg_size < min_reg_size) { continue; }
@@ -534,13 +535,102 @@ void LineSegmentDetectorImpl::flsd(std::vector<Vec4i>& lines,
     }
 }
 
+/**
+ * Computes the gradient magnitude and angle for a range of rows,
+ * and the maximal magnitude of the defined gradients of every row.
+ */
+class LsdGradientInvoker : public ParallelLoopBody
+{
+public:
+    LsdGradientInvoker(const Mat_<double>& _image, Mat_<double>& _modgrad, Mat_<double>& _angles,
+                       double* _row_max_grad, double _threshold)
+        : image(&_image), modgrad(&_modgrad), angles(&_angles), row_max_grad(_row_max_grad), threshold(_threshold)
+    {
+    }
+
+    void operator()(const Range& range) const
+    {
+        const int width = image->cols - 1;
+        AutoBuffer<float> _buf(width*3);
+        float *gx_buf = _buf, *ngy_buf = gx_buf + width, *angle_buf = ngy_buf + width;
+        Mat gx_row(1, width, CV_32F, gx_buf), ngy_row(1, width, CV_32F, ngy_buf), angle_row(1, width, CV_32F, angle_buf);
+
+#if CV_SSE2
+        const bool haveSSE2 = checkHardwareSupport(CV_CPU_SSE2);
+#endif
+
+        for(int y = range.start; y < range.end; ++y)
+        {
+            const double* src = image->ptr<double>(y);
+            const double* src_next = image->ptr<double>(y + 1);
+            double* norm_row = modgrad->ptr<double>(y);
+            double* angle_dst = angles->ptr<double>(y);
+            int x = 0;
+
+#if CV_SSE2
+            if(haveSSE2)
+            {
+                const __m128d quarter = _mm_set1_pd(0.25);
+                for( ; x <= width - 2; x += 2)
+                {
+                    __m128d DA = _mm_sub_pd(_mm_loadu_pd(src_next + x + 1), _mm_loadu_pd(src + x));
+                    __m128d BC = _mm_sub_pd(_mm_loadu_pd(src + x + 1), _mm_loadu_pd(src_next + x));
+                    __m128d gx = _mm_add_pd(DA, BC);
+                    __m128d gy = _mm_sub_pd(DA, BC);
+                    __m128d norm = _mm_sqrt_pd(_mm_mul_pd(_mm_add_pd(_mm_mul_pd(gx, gx), _mm_mul_pd(gy, gy)), quarter));
+                    _mm_storeu_pd(norm_row + x, norm);
+                    __m128 gxf = _mm_cvtpd_ps(gx), ngyf = _mm_cvtpd_ps(_mm_sub_pd(_mm_setzero_pd(), gy));
+                    _mm_storel_pi((__m64*)(gx_buf + x), gxf);
+                    _mm_storel_pi((__m64*)(ngy_buf + x), ngyf);
+                }
+            }
+#endif
+            for( ; x < width; ++x)
+            {
+                double DA = src_next[x + 1] - src[x];
+                double BC = src[x + 1] - src_next[x];
+                double gx = DA + BC;    // gradient x component
+                double gy = DA - BC;    // gradient y component
+                norm_row[x] = std::sqrt((gx * gx + gy * gy) / 4); // gradient norm
+                gx_buf[x] = float(gx);
+                ngy_buf[x] = float(-gy);
+            }
+
+            // gradient angle computation, the same as fastAtan2(gx, -gy) for every pixel
+            phase(ngy_row, gx_row, angle_row, true);
+
+            double max_grad = -1;
+            for(x = 0; x < width; ++x)
+            {
+                double norm = norm_row[x];
+                if (norm <= threshold)  // norm too small, gradient no defined
+                {
+                    angle_dst[x] = NOTDEF;
+                }
+                else
+                {
+                    angle_dst[x] = angle_buf[x] * DEG_TO_RADS;
+                    if (norm > max_grad) { max_grad = norm; }
+                }
+            }
+            row_max_grad[y] = max_grad;
+        }
+    }
+
+private:
+    const Mat_<double>* image;
+    Mat_<double>* modgrad;
+    Mat_<double>* angles;
+    double* row_max_grad;
+    double threshold;
+};
+
 void LineSegmentDetectorImpl::ll_angle(const double& threshold,
-                                   const unsigned int& n_bins,
-                                   std::vector<coorlist>& list)
+                                   const unsigned int& n_bins)
 {
     //Initialize data
-    angles = Mat_<double>(scaled_image.size());
-    modgrad = Mat_<double>(scaled_image.size());
+    angles.create(scaled_image.size());
+    modgrad.create(scaled_image.size());
 
     angles_data = angles.ptr<double>(0);
     modgrad_data = modgrad.ptr<double>(0);
@@ -558,78 +648,44 @@ void LineSegmentDetectorImpl::ll_angle(const double& threshold,
               modgrad.isContinuous() &&
               angles.isContinuous());   // Accessing image data linearly
 
+    row_max_grad.resize(img_height);
     double max_grad = -1;
-    for(int y = 0; y < img_height - 1; ++y)
+    if(img_height > 1 && img_width > 1)
     {
-        for(int addr = y * img_width, addr_end = addr + img_width - 1; addr < addr_end; ++addr)
-        {
-            double DA = scaled_image_data[addr + img_width + 1] - scaled_image_data[addr];
-            double BC = scaled_image_data[addr + 1] - scaled_image_data[addr + img_width];
-            double gx = DA + BC;    // gradient x component
-            double gy = DA - BC;    // gradient y component
-            double norm = std::sqrt((gx * gx + gy * gy) / 4); // gradient norm
-
-            modgrad_data[addr] = norm;    // store gradient
-
-            if (norm <= threshold)  // norm too small, gradient no defined
-            {
-                angles_data[addr] = NOTDEF;
-            }
-            else
-            {
-                angles_data[addr] = fastAtan2(float(gx), float(-gy)) * DEG_TO_RADS;  // gradient angle computation
-                if (norm > max_grad) { max_grad = norm; }
-            }
-
-        }
+        parallel_for_(Range(0, img_height - 1),
+                      LsdGradientInvoker(scaled_image, modgrad, angles, &row_max_grad[0], threshold),
+                      scaled_image.total()/(double)(1<<16));
+        for(int y = 0; y < img_height - 1; ++y)
+            max_grad = std::max(max_grad, row_max_grad[y]);
     }
 
     // Compute histogram of gradient values
-    list = std::vector<coorlist>(img_width * img_height);
-    std::vector<coorlist*> range_s(n_bins);
-    std::vector<coorlist*> range_e(n_bins);
-    unsigned int count = 0;
+    bin_counts.assign(n_bins + 1, 0);
     double bin_coef = (max_grad > 0) ? double(n_bins - 1) / max_grad : 0; // If all image is smooth, max_grad <= 0
 
     for(int y = 0; y < img_height - 1; ++y)
     {
         const double* norm = modgrad_data + y * img_width;
-        for(int x = 0; x < img_width - 1; ++x, ++norm)
-        {
-            // Store the point in the right bin according to its norm
-            int i = int((*norm) * bin_coef);
-            if(!range_e[i])
-            {
-                range_e[i] = range_s[i] = &list[count];
-                ++count;
-            }
-            else
-            {
-                range_e[i]->next = &list[count];
-                range_e[i] = &list[count];
-                ++count;
-            }
-            range_e[i]->p = Point(x, y);
-            range_e[i]->next = 0;
-        }
+        for(int x = 0; x < img_width - 1; ++x)
+            ++bin_counts[int(norm[x] * bin_coef)];
     }
 
-    // Sort
-    int idx = n_bins - 1;
-    for(;idx > 0 && !range_s[idx]; --idx);
-    coorlist* start = range_s[idx];
-    coorlist* end = range_e[idx];
-    if(start)
+    // Bucket sort: the bins go from the largest norm to the smallest one,
+    // inside of a bin the points keep the raster order
+    int count = 0;
+    for(int i = (int)n_bins - 1; i >= 0; --i)
     {
-        while(idx > 0)
-        {
-            --idx;
-            if(range_s[idx])
-            {
-                end->next = range_s[idx];
-                end = range_e[idx];
-            }
-        }
+        int bin_size = bin_counts[i];
+        bin_counts[i] = count;
+        count += bin_size;
+    }
+
+    ordered_points.resize(count);
+    for(int y = 0; y < img_height - 1; ++y)
+    {
+        const double* norm = modgrad_data + y * img_width;
+        for(int x = 0; x < img_width - 1; ++x)
+            ordered_points[bin_counts[int(norm[x] * bin_coef)]++] = Point(x, y);
     }
 }
 
@@ -390,4 +390,82 @@ _exit_:
 
 TEST(Imgproc_FindContours, accuracy) { CV_FindContourTest test; test.safe_run(); }
 
+static void findContoursReference( const Mat& src, vector<vector<Point> >& contours,
+                                   vector<Vec4i>& hierarchy, int mode, int method )
+{
+    Mat img = src.clone();
+    CvMat _cimg = img;
+    MemStorage storage(cvCreateMemStorage());
+    CvSeq* first = 0;
+
+    contours.clear();
+    hierarchy.clear();
+    cvFindContours( &_cimg, storage, &first, sizeof(CvContour), mode, method );
+    if( !first )
+        return;
+
+    Seq<CvSeq*> all_contours(cvTreeToNodeSeq( first, sizeof(CvSeq), storage ));
+    SeqIterator<CvSeq*> it = all_contours.begin();
+    for( size_t i = 0; i < all_contours.size(); i++, ++it )
+    {
+        ((CvContour*)*it)->color = (int)i;
+        contours.push_back(vector<Point>((*it)->total));
+        cvCvtSeqToArray(*it, &contours.back()[0]);
+    }
+    it = all_contours.begin();
+    for( size_t i = 0; i < all_contours.size(); i++, ++it )
+    {
+        CvSeq* c = *it;
+        hierarchy.push_back(Vec4i(c->h_next ? ((CvContour*)c->h_next)->color : -1,
+                                  c->h_prev ? ((CvContour*)c->h_prev)->color : -1,
+                                  c->v_next ? ((CvContour*)c->v_next)->color : -1,
+                                  c->v_prev ? ((CvContour*)c->v_prev)->color : -1));
+    }
+}
+
+TEST(Imgproc_FindContours, stripes)
+{
+    RNG& rng = theRNG();
+    Mat src(640, 480, CV_8UC1, Scalar::all(0));
+
+    // nested rings give a non-trivial hierarchy
+    for( int i = 0; i < 60; i++ )
+    {
+        Point center(rng.uniform(0, src.cols), rng.uniform(0, src.rows));
+        int r = rng.uniform(5, 60);
+        for( ; r > 2; r -= 6 )
+            circle(src, center, r, Scalar::all(rng.uniform(1, 256)), 2);
+    }
+    // background rows where the image can be split
+    for( int i = 0; i < 20; i++ )
+        src.row(rng.uniform(1, src.rows - 1)).setTo(Scalar::all(0));
+
+    for( int mode = RETR_EXTERNAL; mode <= RETR_TREE; mode++ )
+        for( int method = CHAIN_APPROX_NONE; method <= CHAIN_APPROX_TC89_KCOS; method++ )
+        {
+            vector<vector<Point> > refContours, contours;
+            vector<Vec4i> refHierarchy, hierarchy, flatHierarchy;
+            findContoursReference(src, refContours, refHierarchy, mode, method);
+
+            Mat img = src.clone();
+            findContours(img, contours, hierarchy, mode, method);
+
+            ASSERT_EQ(refContours.size(), contours.size()) << "mode=" << mode << ", method=" << method;
+            for( size_t i = 0; i < contours.size(); i++ )
+                ASSERT_TRUE(refContours[i] == contours[i]) << "contour " << i << ", mode=" << mode << ", method=" << method;
+            ASSERT_TRUE(refHierarchy == hierarchy) << "mode=" << mode << ", method=" << method;
+
+            vector<Point> points;
+            vector<int> offsets;
+            img = src.clone();
+            findContours(img, points, offsets, flatHierarchy, mode, method);
+
+            ASSERT_EQ(contours.size() + 1, offsets.size());
+            ASSERT_EQ((int)points.size(), offsets.back());
+            for( size_t i = 0; i < contours.size(); i++ )
+                ASSERT_TRUE(contours[i] == vector<Point>(points.begin() + offsets[i], points.begin() + offsets[i+1]));
+            ASSERT_TRUE(hierarchy == flatHierarchy);
+        }
+}
+
 /* End of file. */
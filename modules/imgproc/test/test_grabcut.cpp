@@ -170,3 +170,30 @@ TEST(Imgproc_GrabCut, repeatability)
     EXPECT_EQ(0, countNonZero(mask_1 != mask_3));
     EXPECT_EQ(0, countNonZero(mask_2 != mask_3));
 }
+
+TEST(Imgproc_GrabCut, iterations_warm_start)
+{
+    RNG rng(12345);
+    Mat image(240, 320, CV_8UC3);
+    rng.fill(image, RNG::UNIFORM, Scalar::all(0), Scalar::all(120));
+    circle(image, Point(160, 120), 70, Scalar(30, 200, 100), -1);
+    circle(image, Point(140, 110), 25, Scalar(200, 50, 90), -1);
+    GaussianBlur(image, image, Size(5, 5), 1.5);
+    Rect roi(70, 30, 180, 180);
+
+    Mat mask_1, bgdModel_1, fgdModel_1;
+    theRNG().state = 12378213;
+    grabCut(image, mask_1, roi, bgdModel_1, fgdModel_1, 0, GC_INIT_WITH_RECT);
+
+    Mat mask_2 = mask_1.clone(), bgdModel_2 = bgdModel_1.clone(), fgdModel_2 = fgdModel_1.clone();
+
+    // one graph is reused by all the iterations
+    grabCut(image, mask_1, roi, bgdModel_1, fgdModel_1, 4, GC_EVAL);
+    // a new graph for every iteration
+    for( int i = 0; i < 4; i++ )
+        grabCut(image, mask_2, roi, bgdModel_2, fgdModel_2, 1, GC_EVAL);
+
+    EXPECT_EQ(0, countNonZero(mask_1 != mask_2));
+    EXPECT_EQ(0, norm(bgdModel_1, bgdModel_2, NORM_INF));
+    EXPECT_EQ(0, norm(fgdModel_1, fgdModel_2, NORM_INF));
+}
@@ -1844,4 +1844,96 @@ TEST(Imgproc_Hist_CalcBackProject, accuracy) { CV_CalcBackProjectTest test; test
 TEST(Imgproc_Hist_CalcBackProjectPatch, accuracy) { CV_CalcBackProjectPatchTest test; test.safe_run(); }
 TEST(Imgproc_Hist_BayesianProb, accuracy) { CV_BayesianProbTest test; test.safe_run(); }
 
+TEST(Imgproc_CLAHE, incrementalUpdate)
+{
+    RNG& rng = theRNG();
+    Mat frame(481, 643, CV_8UC1);
+    rng.fill(frame, RNG::UNIFORM, 0, 256);
+
+    Ptr<CLAHE> clahe = createCLAHE(4.0, Size(8, 8));
+    Ptr<CLAHE> incremental = createCLAHE(4.0, Size(8, 8));
+    incremental->setIncrementalUpdate(true);
+
+    for (int i = 0; i < 10; ++i)
+    {
+        // modify a part of the frame, leave the rest unchanged
+        Rect roi(rng.uniform(0, frame.cols / 2), rng.uniform(0, frame.rows / 2), frame.cols / 4, frame.rows / 4);
+        Mat part = frame(roi);
+        rng.fill(part, RNG::UNIFORM, 0, 256);
+
+        if (i == 5)
+        {
+            clahe->setClipLimit(2.0);
+            incremental->setClipLimit(2.0);
+        }
+
+        Mat expected, actual;
+        clahe->apply(frame, expected);
+        incremental->apply(frame, actual);
+
+        ASSERT_EQ(0, norm(expected, actual, NORM_INF)) << "frame " << i;
+    }
+}
+
+TEST(Imgproc_CLAHE, incrementalUpdateAfterGridChange)
+{
+    // 8x8 and 4x16 grids have the same number of tiles and need no border for this frame size
+    Mat frame(480, 640, CV_8UC1);
+    randu(frame, Scalar::all(0), Scalar::all(256));
+
+    Ptr<CLAHE> incremental = createCLAHE(4.0, Size(8, 8));
+    incremental->setIncrementalUpdate(true);
+    Mat expected, actual;
+    incremental->apply(frame, actual);
+
+    incremental->set("tilesX", 4);
+    incremental->set("tilesY", 16);
+    Mat part = frame(Rect(100, 50, 200, 100));
+    randu(part, Scalar::all(0), Scalar::all(256));
+
+    createCLAHE(4.0, Size(4, 16))->apply(frame, expected);
+    incremental->apply(frame, actual);
+    ASSERT_EQ(0, norm(expected, actual, NORM_INF));
+}
+
+TEST(Imgproc_CLAHE, temporalSmoothing)
+{
+    Mat dark(240, 320, CV_8UC1), bright;
+    randu(dark, Scalar::all(0), Scalar::all(64));
+    add(dark, Scalar::all(128), bright);
+
+    Ptr<CLAHE> clahe = createCLAHE(40.0, Size(4, 4));
+    Ptr<CLAHE> smooth = createCLAHE(40.0, Size(4, 4));
+    smooth->setTemporalSmoothing(0.5);
+    ASSERT_EQ(0.5, smooth->getTemporalSmoothing());
+
+    Mat expected, actual;
+
+    // the first frame is processed without smoothing
+    clahe->apply(dark, expected);
+    smooth->apply(dark, actual);
+    ASSERT_EQ(0, norm(expected, actual, NORM_INF));
+
+    // the LUTs change gradually after the scene change and converge to the new ones
+    clahe->apply(bright, expected);
+    smooth->apply(bright, actual);
+    double prevDiff = norm(expected, actual, NORM_L1);
+    ASSERT_GT(prevDiff, 0);
+
+    for (int i = 0; i < 30; ++i)
+    {
+        smooth->apply(bright, actual);
+        double diff = norm(expected, actual, NORM_L1);
+        ASSERT_LE(diff, prevDiff);
+        prevDiff = diff;
+    }
+    ASSERT_LE(norm(expected, actual, NORM_INF), 1);
+
+    // collectGarbage resets the state
+    smooth->collectGarbage();
+    clahe->apply(dark, expected);
+    smooth->apply(dark, actual);
+    ASSERT_EQ(0, norm(expected, actual, NORM_INF));
+}
+
 /* End Of File */
@@ -726,6 +726,7 @@ struct CV_EXPORTS_W_MAP CvDTreeParams
     CV_PROP_RW bool  use_1se_rule;
     CV_PROP_RW bool  truncate_pruned_tree;
     CV_PROP_RW float regression_accuracy;
+    CV_PROP_RW int   max_bins; // 0 or the number of bins of the binned split search
     const float* priors;
 
     CvDTreeParams();
@@ -737,6 +738,11 @@ struct CV_EXPORTS_W_MAP CvDTreeParams
 };
 
 
+namespace cv
+{
+    struct DTreeTrainWork;
+}
+
 struct CV_EXPORTS CvDTreeTrainData
 {
     CvDTreeTrainData();
@@ -761,6 +767,11 @@ struct CV_EXPORTS CvDTreeTrainData
          float* values, uchar* missing, float* responses, bool get_class_idx=false );
 
     virtual CvDTreeNode* subsample_data( const CvMat* _subsample_idx );
+    // subsamples the data into the work_idx-th work buffer of the shared data
+    CvDTreeNode* subsample_data( const CvMat* _subsample_idx, int work_idx );
+    // reserves the work buffers for growing up to max_work_count trees at once on the shared data,
+    // as many as fit into max_memory bytes (at least one); returns the number of the reserved buffers
+    int set_work_count( int max_work_count, int64 max_memory );
 
     virtual void write_params( CvFileStorage* fs ) const;
     virtual void read_params( CvFileStorage* fs, CvFileNode* node );
@@ -781,6 +792,18 @@ struct CV_EXPORTS CvDTreeTrainData
                                    const float** ord_values, const int** sorted_indices, int* sample_indices_buf );
     virtual int get_child_buf_idx( CvDTreeNode* n );
 
+    // the row of buf that keeps the vi-th variable (or the labels, cv labels, sample indices),
+    // and the value that separates the bins of a split found in the bin units (binned mode)
+    int get_buf_row( int vi ) const;
+    float get_bin_edge( int vi, float c ) const;
+
+    // the index of the work buffer of the tree that the node belongs to,
+    // and the per-tree parts of the direction, split_buf and counts arrays
+    int get_work_idx( const CvDTreeNode* n ) const { return shared && n->buf_idx > 0 ? n->buf_idx - 1 : 0; }
+    uchar* get_direction( const CvDTreeNode* n );
+    int* get_split_buf( const CvDTreeNode* n );
+    int* get_counts( const CvDTreeNode* n );
+
     ////////////////////////////////////
 
     virtual bool set_params( const CvDTreeParams& params );
@@ -805,6 +828,7 @@ struct CV_EXPORTS CvDTreeTrainData
     CvMat* responses_copy; // used in Boosting
 
     int buf_count, buf_size; // buf_size is obsolete, please do not use it, use expression ((int64)buf->rows * (int64)buf->cols / buf_count) instead
+    cv::DTreeTrainWork* work; // the trees grown at once on the shared data, 0 if they are grown one by one
     bool shared;
     int is_buf_16u;
 
@@ -816,10 +840,16 @@ struct CV_EXPORTS CvDTreeTrainData
     CvMat* buf;
     inline size_t get_length_subbuf() const
     {
-        size_t res = (size_t)(work_var_count + 1) * (size_t)sample_count;
+        // in the binned mode the ordered variables are kept in bin_buf only
+        size_t res = (size_t)(work_var_count + 1 - (bin_buf ? ord_var_count : 0)) * (size_t)sample_count;
         return res;
     }
 
+    CvMat* bin_count; // the number of bins of every ordered variable
+    CvMat* bin_ofs;
+    CvMat* bin_edges; // the values between the neighbour bins
+    CvMat* bin_buf;   // the bin index of every training sample, a row per ordered variable
+
     CvMat* direction;
     CvMat* split_buf;
 
@@ -852,6 +882,9 @@ namespace cv
 {
     struct DTreeBestSplitFinder;
     struct ForestTreeBestSplitFinder;
+    struct ForestTreeGrower;
+    struct ForestTreeWork;
+    struct DTreeBinHistograms;
 }
 
 class CV_EXPORTS_W CvDTree : public CvStatModel
@@ -903,6 +936,7 @@ public:
 
 protected:
     friend struct cv::DTreeBestSplitFinder;
+    friend struct cv::DTreeBinHistograms;
 
     virtual bool do_train( const CvMat* _subsample_idx );
 
@@ -926,6 +960,13 @@ protected:
 
     virtual void calc_node_value( CvDTreeNode* node );
 
+    // the split search on the per-node histograms of the binned ordered variables
+    CvDTreeSplit* find_split_bin_class( CvDTreeNode* n, int vi, float init_quality,
+                                        CvDTreeSplit* _split, bool misclass );
+    CvDTreeSplit* find_split_bin_reg( CvDTreeNode* n, int vi, float init_quality, CvDTreeSplit* _split );
+    // the weights of the node samples in the histograms, 0 if every sample weighs 1
+    virtual const double* get_bin_weights( CvDTreeNode* n, double* weights_buf );
+
     virtual void prune_cv();
     virtual double update_tree_rnc( int T, int fold );
     virtual int cut_tree( int T, int fold, double min_alpha );
@@ -942,6 +983,7 @@ protected:
     CvDTreeNode* root;
     CvMat* var_importance;
     CvDTreeTrainData* data;
+    cv::DTreeBinHistograms* bin_hists;
     CvMat train_data_hdr, responses_hdr;
     cv::Mat train_data_mat, responses_mat;
 
@@ -982,9 +1024,14 @@ public:
 
 protected:
     friend struct cv::ForestTreeBestSplitFinder;
+    friend struct cv::ForestTreeGrower;
 
+    virtual bool do_train( const CvMat* _subsample_idx );
     virtual CvDTreeSplit* find_best_split( CvDTreeNode* n );
     CvRTrees* forest;
+
+    // the state of the tree grown concurrently with the other trees of the forest, 0 otherwise
+    cv::ForestTreeWork* work;
 };
 
 
@@ -994,6 +1041,7 @@ struct CV_EXPORTS_W_MAP CvRTParams : public CvDTreeParams
     CV_PROP_RW bool calc_var_importance; // true <=> RF processes variable importance
     CV_PROP_RW int nactive_vars;
     CV_PROP_RW CvTermCriteria term_crit;
+    CV_PROP_RW int max_work_memory; // the memory (in MB) the work buffers of the trees grown at once may take
 
     CvRTParams();
     CvRTParams( int max_depth, int min_sample_count,
@@ -1065,6 +1113,7 @@ protected:
 
     cv::RNG* rng;
     CvMat* active_var_mask;
+    int max_work_memory;
 };
 
 /****************************************************************************************\
@@ -1188,6 +1237,7 @@ protected:
         float init_quality = 0, CvDTreeSplit* _split = 0, uchar* ext_buf = 0 );
     virtual void calc_node_value( CvDTreeNode* n );
     virtual double calc_node_dir( CvDTreeNode* n );
+    virtual const double* get_bin_weights( CvDTreeNode* n, double* weights_buf );
 
     CvBoost* ensemble;
 };
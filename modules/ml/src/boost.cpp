@@ -181,7 +181,7 @@ CvBoostTree::try_split_node( CvDTreeNode* node )
 double
 CvBoostTree::calc_node_dir( CvDTreeNode* node )
 {
-    char* dir = (char*)data->direction->data.ptr;
+    char* dir = (char*)data->get_direction( node );
     const double* weights = ensemble->get_subtree_weights()->data.db;
     int i, n = node->sample_count, vi = node->split->var_idx;
     double L, R;
@@ -253,6 +253,15 @@ CvBoostTree::find_split_ord_class( CvDTreeNode* node, int vi, float init_quality
 {
     const float epsilon = FLT_EPSILON*2;
 
+    int boost_type = ensemble->get_params().boost_type;
+    int split_criteria = ensemble->get_params().split_criteria;
+
+    if( split_criteria != CvBoost::GINI && split_criteria != CvBoost::MISCLASS )
+        split_criteria = boost_type == CvBoost::DISCRETE ? CvBoost::MISCLASS : CvBoost::GINI;
+
+    if( bin_hists )
+        return find_split_bin_class( node, vi, init_quality, _split, split_criteria == CvBoost::MISCLASS );
+
     const double* weights = ensemble->get_subtree_weights()->data.db;
     int n = node->sample_count;
     int n1 = node->get_num_valid(vi);
@@ -273,8 +282,6 @@ CvBoostTree::find_split_ord_class( CvDTreeNode* node, int vi, float init_quality
     double lcw[2] = {0,0}, rcw[2];
     int i, best_i = -1;
     double best_val = init_quality;
-    int boost_type = ensemble->get_params().boost_type;
-    int split_criteria = ensemble->get_params().split_criteria;
 
     rcw[0] = rcw0[0]; rcw[1] = rcw0[1];
     for( i = n1; i < n; i++ )
@@ -284,9 +291,6 @@ CvBoostTree::find_split_ord_class( CvDTreeNode* node, int vi, float init_quality
         rcw[responses[idx]] -= w;
     }
 
-    if( split_criteria != CvBoost::GINI && split_criteria != CvBoost::MISCLASS )
-        split_criteria = boost_type == CvBoost::DISCRETE ? CvBoost::MISCLASS : CvBoost::GINI;
-
     if( split_criteria == CvBoost::GINI )
     {
         double L = 0, R = rcw[0] + rcw[1];
@@ -482,6 +486,9 @@ CvBoostTree::find_split_cat_class( CvDTreeNode* node, int vi, float init_quality
 CvDTreeSplit*
 CvBoostTree::find_split_ord_reg( CvDTreeNode* node, int vi, float init_quality, CvDTreeSplit* _split, uchar* _ext_buf )
 {
+    if( bin_hists )
+        return find_split_bin_reg( node, vi, init_quality, _split );
+
     const float epsilon = FLT_EPSILON*2;
     const double* weights = ensemble->get_subtree_weights()->data.db;
     int n = node->sample_count;
@@ -661,7 +668,7 @@ CvBoostTree::find_surrogate_split_ord( CvDTreeNode* node, int vi, uchar* _ext_bu
     data->get_ord_var_data( node, vi, values_buf, indices_buf, &values, &indices, sample_indices_buf );
 
     const double* weights = ensemble->get_subtree_weights()->data.db;
-    const char* dir = (char*)data->direction->data.ptr;
+    const char* dir = (char*)data->get_direction( node );
     int n1 = node->get_num_valid(vi);
     // LL - number of samples that both the primary and the surrogate splits send to the left
     // LR - ... primary split sends to the left and the surrogate split sends to the right
@@ -724,7 +731,7 @@ CvBoostTree::find_surrogate_split_ord( CvDTreeNode* node, int vi, uchar* _ext_bu
 CvDTreeSplit*
 CvBoostTree::find_surrogate_split_cat( CvDTreeNode* node, int vi, uchar* _ext_buf )
 {
-    const char* dir = (char*)data->direction->data.ptr;
+    const char* dir = (char*)data->get_direction( node );
     const double* weights = ensemble->get_subtree_weights()->data.db;
     int n = node->sample_count;
     int i, mi = data->cat_count->data.i[data->get_var_type(vi)];
@@ -808,7 +815,7 @@ CvBoostTree::calc_node_value( CvDTreeNode* node )
         int* _responses_buf = labels_buf + n;
         const int* _responses = data->get_class_labels(node, _responses_buf);
         int m = data->get_num_classes();
-        int* cls_count = data->counts->data.i;
+        int* cls_count = data->get_counts( node );
         for( int k = 0; k < m; k++ )
             cls_count[k] = 0;
 
@@ -876,6 +883,21 @@ CvBoostTree::calc_node_value( CvDTreeNode* node )
 }
 
 
+const double*
+CvBoostTree::get_bin_weights( CvDTreeNode* node, double* weights_buf )
+{
+    // the same weights as calc_node_value() puts into the subtree weights
+    int i, n = node->sample_count;
+    const double* weights = ensemble->get_weights()->data.db;
+    cv::AutoBuffer<int> inn_buf(n);
+    const int* labels = data->get_cv_labels( node, (int*)inn_buf );
+
+    for( i = 0; i < n; i++ )
+        weights_buf[i] = weights[labels[i]];
+    return weights_buf;
+}
+
+
 void CvBoostTree::read( CvFileStorage* fs, CvFileNode* fnode, CvBoost* _ensemble, CvDTreeTrainData* _data )
 {
     CvDTree::read( fs, fnode, _data );
@@ -1144,7 +1166,7 @@ CvBoost::update_weights( CvBoostTree* tree )
     else
     {
         if( have_subsample )
-            _buf_size += data->get_length_subbuf()*(sizeof(float)+sizeof(uchar));
+            _buf_size += (size_t)data->sample_count*data->var_count*(sizeof(float)+sizeof(uchar));
     }
     inn_buf.allocate(_buf_size);
     uchar* cur_buf_pos = (uchar*)inn_buf;
@@ -1200,7 +1222,7 @@ CvBoost::update_weights( CvBoostTree* tree )
         if (data->is_buf_16u)
         {
             unsigned short* labels = (unsigned short*)(dtree_data_buf->data.s + data->data_root->buf_idx*length_buf_row +
-                data->data_root->offset + (data->work_var_count-1)*data->sample_count);
+                data->data_root->offset + data->get_buf_row(data->work_var_count-1)*data->sample_count);
             for( i = 0; i < n; i++ )
             {
                 // save original categorical responses {0,1}, convert them to {-1,1}
@@ -1218,7 +1240,7 @@ CvBoost::update_weights( CvBoostTree* tree )
         else
         {
             int* labels = dtree_data_buf->data.i + data->data_root->buf_idx*length_buf_row +
-                data->data_root->offset + (data->work_var_count-1)*data->sample_count;
+                data->data_root->offset + data->get_buf_row(data->work_var_count-1)*data->sample_count;
 
             for( i = 0; i < n; i++ )
             {
@@ -1264,9 +1286,9 @@ CvBoost::update_weights( CvBoostTree* tree )
         if( have_subsample )
         {
             float* values = (float*)cur_buf_pos;
-            cur_buf_pos = (uchar*)(values + data->get_length_subbuf());
+            cur_buf_pos = (uchar*)(values + (size_t)data->sample_count*data->var_count);
             uchar* missing = cur_buf_pos;
-            cur_buf_pos = missing + data->get_length_subbuf() * (size_t)CV_ELEM_SIZE(data->buf->type);
+            cur_buf_pos = missing + (size_t)data->sample_count*data->var_count;
 
             CvMat _sample, _mask;
 
@@ -152,8 +152,9 @@ void CvERTreeTrainData::set_data( const CvMat* _train_data, int _tflag,
                   "floating-point vector containing as many elements as "
                   "the total number of samples in the training data matrix" );
 
+    // the sample label row keeps the original sample indices, so they all have to fit
     is_buf_16u = false;
-    if ( sample_count < 65536 )
+    if ( sample_all < 65536 )
         is_buf_16u = true;
 
     r_type = CV_VAR_CATEGORICAL;
@@ -759,7 +760,7 @@ CvDTreeNode* CvERTreeTrainData::subsample_data( const CvMat* _subsample_idx )
 
 double CvForestERTree::calc_node_dir( CvDTreeNode* node )
 {
-    char* dir = (char*)data->direction->data.ptr;
+    char* dir = (char*)data->get_direction( node );
     int i, n = node->sample_count, vi = node->split->var_idx;
     double L, R;
 
@@ -1353,7 +1354,7 @@ CvDTreeSplit* CvForestERTree::find_split_cat_reg( CvDTreeNode* node, int vi, flo
 void CvForestERTree::split_node_data( CvDTreeNode* node )
 {
     int vi, i, n = node->sample_count, nl, nr, scount = data->sample_count;
-    char* dir = (char*)data->direction->data.ptr;
+    char* dir = (char*)data->get_direction( node );
     CvDTreeNode *left = 0, *right = 0;
     int new_buf_idx = data->get_child_buf_idx( node );
     CvMat* buf = data->buf;
@@ -349,27 +349,112 @@ const float** cvGetTrainSamples( const CvMat* train_data, int tflag,
 
 namespace cv
 {
-    struct DTreeBestSplitFinder
+    // Evaluates the candidate splits of a node variable by variable. Every variable
+    // writes its best split into its own slot, so the stripes do not share any state;
+    // the slots are then reduced in variable order, which gives the same split as
+    // the sequential search.
+    struct DTreeBestSplitFinder : ParallelLoopBody
     {
-        DTreeBestSplitFinder(){ tree = 0; node = 0; }
-        DTreeBestSplitFinder( CvDTree* _tree, CvDTreeNode* _node);
-        DTreeBestSplitFinder( const DTreeBestSplitFinder& finder, Split );
+        DTreeBestSplitFinder( CvDTree* _tree, CvDTreeNode* _node );
         virtual ~DTreeBestSplitFinder() {}
-        virtual void operator()(const BlockedRange& range);
-        void join( DTreeBestSplitFinder& rhs );
-        Ptr<CvDTreeSplit> bestSplit;
-        Ptr<CvDTreeSplit> split;
-        int splitSize;
+        virtual void operator()(const Range& range) const;
+        virtual bool isActiveVar( int vi ) const;
+        CvDTreeSplit* findBestSplit( bool parallel );
+
         CvDTree* tree;
         CvDTreeNode* node;
+        int splitSize;
+        AutoBuffer<uchar> buf;
+        uchar* splits;
+        uchar* found;
     };
 
     struct ForestTreeBestSplitFinder : DTreeBestSplitFinder
     {
-        ForestTreeBestSplitFinder() : DTreeBestSplitFinder() {}
-        ForestTreeBestSplitFinder( CvForestTree* _tree, CvDTreeNode* _node );
-        ForestTreeBestSplitFinder( const ForestTreeBestSplitFinder& finder, Split );
-        virtual void operator()(const BlockedRange& range);
+        ForestTreeBestSplitFinder( CvForestTree* _tree, CvDTreeNode* _node, const CvMat* _activeVarMask );
+        virtual bool isActiveVar( int vi ) const;
+        const CvMat* activeVarMask;
+    };
+
+    // The histograms of the binned ordered variables in the nodes of a tree (see
+    // CvDTreeParams::max_bins). Every bin keeps the number of the samples and their weights
+    // per class (classification) or the sum of the weights and of the weighted responses
+    // (regression). When a node is split, the histograms of the smaller child are collected
+    // from its samples and those of the larger child are the difference with the parent.
+    struct DTreeBinHistograms : ParallelLoopBody
+    {
+        DTreeBinHistograms( CvDTree* _tree );
+        virtual ~DTreeBinHistograms();
+        // loads the samples of the node before its split search
+        void setNode( CvDTreeNode* node );
+        // the histogram of the vi-th variable in the node, collected on the first request
+        const double* get( CvDTreeNode* node, int vi );
+        // derives the histograms of the children from the ones of the split node
+        void split( CvDTreeNode* node );
+        // drops the histograms of a node that is not split
+        void release( CvDTreeNode* node );
+        virtual void operator()(const Range& range) const;
+
+        struct NodeHistograms
+        {
+            std::vector<double> hist;
+            std::vector<uchar> valid;
+        };
+
+        NodeHistograms* create( CvDTreeNode* node );
+        void load( CvDTreeNode* node );
+        void collect( int vi, double* hist ) const;
+
+        CvDTree* tree;
+        CvDTreeTrainData* data;
+        int stride;
+        int histSize;
+        std::vector<int> varOfs;
+        std::map<const CvDTreeNode*, NodeHistograms*> nodes;
+
+        // the samples of the loaded node
+        CvDTreeNode* node;
+        AutoBuffer<uchar> sampleBuf;
+        const int* sampleIdx;
+        const int* labels;
+        const float* responses;
+        const double* weights;
+
+        // the node being split, its smaller and its larger child
+        NodeHistograms *parent, *small, *large;
+    };
+
+    // true if the split search of the trees draws random numbers from data->rng,
+    // which happens when the categories of a variable are clustered
+    bool dtreeClustersCategories( const CvDTreeTrainData* data );
+
+    // Grows a batch of the forest trees, one tree per index of the range, and evaluates
+    // each tree on its out-of-bag samples. Every tree has its own random generator seeded
+    // by the forest, so the trees do not depend on how the batch is scheduled.
+    struct ForestTreeGrower : ParallelLoopBody
+    {
+        ForestTreeGrower( CvRTrees* _forest, CvDTreeTrainData* _data, const CvMat* _activeVarMask,
+                          CvForestTree** _trees, const uint64* _seeds, bool _concurrent );
+        virtual void operator()(const Range& range) const;
+
+        CvRTrees* forest;
+        CvDTreeTrainData* data;
+        const CvMat* activeVarMask;
+        CvForestTree** trees;
+        const uint64* seeds;
+        bool concurrent;
+
+        // the out-of-bag evaluation: the samples, and for every tree of the batch
+        // the in-bag mask, the predictions and the importance of the variables
+        const float* samples;
+        const uchar* missing;
+        const float* responses;
+        float maxResponse;
+        bool calcImportance;
+        uchar* inBag;
+        float* predValues;
+        int* predClasses;
+        double* importance;
     };
 }
 
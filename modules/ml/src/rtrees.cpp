@@ -40,9 +40,24 @@
 
 #include "precomp.hpp"
 
+namespace cv
+{
+
+// the state of a tree grown concurrently with the other trees of the forest: its work buffer
+// in the shared data, its own random generator and its own mask of the active variables
+struct ForestTreeWork
+{
+    int work_idx;
+    CvRNG* rng;
+    CvMat* active_var_mask;
+};
+
+}
+
 CvForestTree::CvForestTree()
 {
     forest = NULL;
+    work = 0;
 }
 
 
@@ -65,6 +80,43 @@ bool CvForestTree::train( CvDTreeTrainData* _data,
 }
 
 
+bool CvForestTree::do_train( const CvMat* _subsample_idx )
+{
+    bool result = false;
+
+    CV_FUNCNAME( "CvForestTree::do_train" );
+
+    __BEGIN__;
+
+    // only the trees grown concurrently use the work buffers other than the first one
+    root = !work || work->work_idx == 0 ? data->subsample_data( _subsample_idx ) :
+                                          data->subsample_data( _subsample_idx, work->work_idx );
+
+    if( data->bin_buf )
+        bin_hists = new cv::DTreeBinHistograms( this );
+
+    CV_CALL( try_split_node(root));
+
+    if( root->split )
+    {
+        CV_Assert( root->left );
+        CV_Assert( root->right );
+
+        if( data->params.cv_folds > 0 )
+            CV_CALL( prune_cv() );
+
+        result = true;
+    }
+
+    __END__;
+
+    delete bin_hists;
+    bin_hists = 0;
+
+    return result;
+}
+
+
 bool
 CvForestTree::train( const CvMat*, int, const CvMat*, const CvMat*,
                     const CvMat*, const CvMat*, const CvMat*, CvDTreeParams )
@@ -86,86 +138,49 @@ CvForestTree::train( CvDTreeTrainData*, const CvMat* )
 namespace cv
 {
 
-ForestTreeBestSplitFinder::ForestTreeBestSplitFinder( CvForestTree* _tree, CvDTreeNode* _node ) :
-    DTreeBestSplitFinder(_tree, _node) {}
-
-ForestTreeBestSplitFinder::ForestTreeBestSplitFinder( const ForestTreeBestSplitFinder& finder, Split spl ) :
-    DTreeBestSplitFinder( finder, spl ) {}
-
-void ForestTreeBestSplitFinder::operator()(const BlockedRange& range)
+ForestTreeBestSplitFinder::ForestTreeBestSplitFinder( CvForestTree* _tree, CvDTreeNode* _node,
+                                                      const CvMat* _activeVarMask ) :
+    DTreeBestSplitFinder(_tree, _node)
 {
-    int vi, vi1 = range.begin(), vi2 = range.end();
-    int n = node->sample_count;
-    CvDTreeTrainData* data = tree->get_data();
-    AutoBuffer<uchar> inn_buf(2*n*(sizeof(int) + sizeof(float)));
-
-    CvForestTree* ftree = (CvForestTree*)tree;
-    const CvMat* active_var_mask = ftree->forest->get_active_var_mask();
-
-    for( vi = vi1; vi < vi2; vi++ )
-    {
-        CvDTreeSplit *res;
-        int ci = data->var_type->data.i[vi];
-        if( node->num_valid[vi] <= 1
-            || (active_var_mask && !active_var_mask->data.ptr[vi]) )
-            continue;
-
-        if( data->is_classifier )
-        {
-            if( ci >= 0 )
-                res = ftree->find_split_cat_class( node, vi, bestSplit->quality, split, (uchar*)inn_buf );
-            else
-                res = ftree->find_split_ord_class( node, vi, bestSplit->quality, split, (uchar*)inn_buf );
-        }
-        else
-        {
-            if( ci >= 0 )
-                res = ftree->find_split_cat_reg( node, vi, bestSplit->quality, split, (uchar*)inn_buf );
-            else
-                res = ftree->find_split_ord_reg( node, vi, bestSplit->quality, split, (uchar*)inn_buf );
-        }
+    activeVarMask = _activeVarMask;
+}
 
-        if( res && bestSplit->quality < split->quality )
-            memcpy( bestSplit.get(), split.get(), splitSize );
-    }
+bool ForestTreeBestSplitFinder::isActiveVar( int vi ) const
+{
+    return DTreeBestSplitFinder::isActiveVar(vi) &&
+        (!activeVarMask || activeVarMask->data.ptr[vi]);
 }
 }
 
 CvDTreeSplit* CvForestTree::find_best_split( CvDTreeNode* node )
 {
-    CvMat* active_var_mask = 0;
+    CvMat* var_mask = 0;
     if( forest )
     {
         int var_count;
-        CvRNG* rng = forest->get_rng();
+        CvRNG* var_rng = work ? work->rng : forest->get_rng();
 
-        active_var_mask = forest->get_active_var_mask();
-        var_count = active_var_mask->cols;
+        var_mask = work ? work->active_var_mask : forest->get_active_var_mask();
+        var_count = var_mask->cols;
 
         CV_Assert( var_count == data->var_count );
 
         for( int vi = 0; vi < var_count; vi++ )
         {
             uchar temp;
-            int i1 = cvRandInt(rng) % var_count;
-            int i2 = cvRandInt(rng) % var_count;
-            CV_SWAP( active_var_mask->data.ptr[i1],
-                active_var_mask->data.ptr[i2], temp );
+            int i1 = cvRandInt(var_rng) % var_count;
+            int i2 = cvRandInt(var_rng) % var_count;
+            CV_SWAP( var_mask->data.ptr[i1],
+                var_mask->data.ptr[i2], temp );
         }
     }
 
-    cv::ForestTreeBestSplitFinder finder( this, node );
-
-    cv::parallel_reduce(cv::BlockedRange(0, data->var_count), finder);
-
-    CvDTreeSplit *bestSplit = 0;
-    if( finder.bestSplit->quality > 0 )
-    {
-        bestSplit = data->new_split_cat( 0, -1.0f );
-        memcpy( bestSplit, finder.bestSplit, finder.splitSize );
-    }
+    // the extremely randomized trees draw their split thresholds from the shared RNGs
+    // while evaluating the variables, so they keep the sequential search
+    bool parallel = dynamic_cast<CvForestERTree*>(this) == 0;
 
-    return bestSplit;
+    cv::ForestTreeBestSplitFinder finder( this, node, var_mask );
+    return finder.findBestSplit( parallel );
 }
 
 void CvForestTree::read( CvFileStorage* fs, CvFileNode* fnode, CvRTrees* _forest, CvDTreeTrainData* _data )
@@ -191,7 +206,7 @@ void CvForestTree::read( CvFileStorage* _fs, CvFileNode* _node,
 //                                  Random trees                                        //
 //////////////////////////////////////////////////////////////////////////////////////////
 CvRTParams::CvRTParams() : CvDTreeParams( 5, 10, 0, false, 10, 0, false, false, 0 ),
-    calc_var_importance(false), nactive_vars(0)
+    calc_var_importance(false), nactive_vars(0), max_work_memory(1024)
 {
     term_crit = cvTermCriteria( CV_TERMCRIT_ITER+CV_TERMCRIT_EPS, 50, 0.1 );
 }
@@ -205,7 +220,7 @@ CvRTParams::CvRTParams( int _max_depth, int _min_sample_count,
                    _use_surrogates, _max_categories, 0,
                    false, false, _priors ),
     calc_var_importance(_calc_var_importance),
-    nactive_vars(_nactive_vars)
+    nactive_vars(_nactive_vars), max_work_memory(1024)
 {
     term_crit = cvTermCriteria(termcrit_type,
         max_num_of_trees_in_the_forest, forest_accuracy);
@@ -221,6 +236,7 @@ CvRTrees::CvRTrees()
     active_var_mask  = NULL;
     var_importance   = NULL;
     rng = &cv::theRNG();
+    max_work_memory  = CvRTParams().max_work_memory;
     default_model_name = "my_random_trees";
 }
 
@@ -272,6 +288,10 @@ bool CvRTrees::train( const CvMat* _train_data, int _tflag,
     CvDTreeParams tree_params( params.max_depth, params.min_sample_count,
         params.regression_accuracy, params.use_surrogates, params.max_categories,
         params.cv_folds, params.use_1se_rule, false, params.priors );
+    tree_params.max_bins = params.max_bins;
+    if( params.max_work_memory < 0 )
+        CV_Error( CV_StsBadArg, "<max_work_memory> must be non-negative" );
+    max_work_memory = params.max_work_memory;
 
     data = new CvDTreeTrainData();
     data->set_data( _train_data, _tflag, _responses, _var_idx,
@@ -320,11 +340,151 @@ bool CvRTrees::train( CvMLData* _data, CvRTParams params )
                   train_sidx, var_types, missing, params );
 }
 
-bool CvRTrees::grow_forest( const CvTermCriteria term_crit )
+namespace cv
 {
-    CvMat* sample_idx_mask_for_tree = 0;
-    CvMat* sample_idx_for_tree      = 0;
 
+ForestTreeGrower::ForestTreeGrower( CvRTrees* _forest, CvDTreeTrainData* _data, const CvMat* _activeVarMask,
+                                    CvForestTree** _trees, const uint64* _seeds, bool _concurrent )
+{
+    forest = _forest;
+    data = _data;
+    activeVarMask = _activeVarMask;
+    trees = _trees;
+    seeds = _seeds;
+    concurrent = _concurrent;
+
+    samples = 0;
+    missing = 0;
+    responses = 0;
+    maxResponse = 0;
+    calcImportance = false;
+    inBag = 0;
+    predValues = 0;
+    predClasses = 0;
+    importance = 0;
+}
+
+void ForestTreeGrower::operator()(const Range& range) const
+{
+    int nsamples = data->sample_count, dims = data->var_count;
+    AutoBuffer<int> _sampleIdx(nsamples);
+    int* sampleIdx = _sampleIdx;
+    Mat varMask;
+
+    for( int j = range.start; j < range.end; j++ )
+    {
+        RNG rng(seeds[j]);
+        uchar* inBagJ = inBag + j*nsamples;
+        int i;
+
+        // form the bootstrap sample of the tree
+        memset( inBagJ, 0, nsamples );
+        for( i = 0; i < nsamples; i++ )
+        {
+            int idx = rng(nsamples);
+            sampleIdx[i] = idx;
+            inBagJ[idx] = (uchar)1;
+        }
+
+        cvarrToMat(activeVarMask).copyTo(varMask);
+        CvMat sampleIdxHdr = cvMat( 1, nsamples, CV_32SC1, sampleIdx ), varMaskHdr = varMask;
+
+        ForestTreeWork work;
+        work.work_idx = concurrent ? j : 0;
+        work.rng = &rng.state;
+        work.active_var_mask = &varMaskHdr;
+
+        CvForestTree* tree = new CvForestTree();
+        tree->work = &work;
+        tree->train( data, &sampleIdxHdr, forest );
+        tree->work = 0;
+        trees[j] = tree;
+
+        if( !samples )
+            continue;
+
+        // predict the out-of-bag samples
+        float* values = predValues + j*nsamples;
+        int* classes = predClasses + j*nsamples;
+        double ncorrect = 0;
+        std::vector<int> oob;
+
+        for( i = 0; i < nsamples; i++ )
+        {
+            if( inBagJ[i] )
+                continue;
+
+            CvMat sample = cvMat( 1, dims, CV_32FC1, (void*)(samples + i*dims) );
+            CvMat miss = cvMat( 1, dims, CV_8UC1, (void*)(missing + i*dims) );
+            CvDTreeNode* node = tree->predict( &sample, &miss, true );
+            values[i] = (float)node->value;
+            classes[i] = node->class_idx;
+            if( data->is_classifier )
+                ncorrect += cvRound(node->value - responses[i]) == 0;
+            else
+            {
+                double resp = (node->value - responses[i])/maxResponse;
+                ncorrect += exp( -resp*resp );
+            }
+            oob.push_back(i);
+        }
+
+        if( !calcImportance )
+            continue;
+
+        // estimate the variable importance: the out-of-bag samples are predicted once again
+        // with the values of one variable randomly permuted between them
+        int noob = (int)oob.size();
+        double* importanceJ = importance + j*dims;
+        memset( importanceJ, 0, dims*sizeof(importanceJ[0]) );
+        if( noob == 0 )
+            continue;
+
+        Mat oobSamples(noob, dims, CV_32F), oobMissing(noob, dims, CV_8U);
+        std::vector<int> perm(noob);
+        for( i = 0; i < noob; i++ )
+        {
+            memcpy( oobSamples.ptr<float>(i), samples + oob[i]*dims, dims*sizeof(float) );
+            memcpy( oobMissing.ptr(i), missing + oob[i]*dims, dims );
+        }
+
+        for( int m = 0; m < dims; m++ )
+        {
+            double ncorrectPermuted = 0;
+
+            for( i = 0; i < noob; i++ )
+                perm[i] = i;
+            for( i = noob - 1; i > 0; i-- )
+                std::swap( perm[i], perm[rng(i + 1)] );
+            for( i = 0; i < noob; i++ )
+                oobSamples.at<float>(i, m) = samples[oob[perm[i]]*dims + m];
+
+            for( i = 0; i < noob; i++ )
+            {
+                CvMat sample = cvMat( 1, dims, CV_32FC1, oobSamples.ptr<float>(i) );
+                CvMat miss = cvMat( 1, dims, CV_8UC1, oobMissing.ptr(i) );
+                double predictedResp = tree->predict( &sample, &miss, true )->value;
+                double trueResp = responses[oob[i]];
+                if( data->is_classifier )
+                    ncorrectPermuted += cvRound(trueResp - predictedResp) == 0;
+                else
+                {
+                    trueResp = (trueResp - predictedResp)/maxResponse;
+                    ncorrectPermuted += exp( -trueResp*trueResp );
+                }
+            }
+
+            for( i = 0; i < noob; i++ )
+                oobSamples.at<float>(i, m) = samples[oob[i]*dims + m];
+            importanceJ[m] = ncorrect - ncorrectPermuted;
+        }
+    }
+}
+
+}
+
+bool CvRTrees::grow_forest( const CvTermCriteria term_crit )
+{
     const int max_ntrees = term_crit.max_iter;
     const double max_oob_err = term_crit.epsilon;
 
@@ -334,8 +494,6 @@ bool CvRTrees::grow_forest( const CvTermCriteria term_crit )
     CvMat* oob_sample_votes    = 0;
     CvMat* oob_responses       = 0;
 
-    float* oob_samples_perm_ptr= 0;
-
     float* samples_ptr     = 0;
     uchar* missing_ptr     = 0;
     float* true_resp_ptr   = 0;
@@ -370,7 +528,6 @@ bool CvRTrees::grow_forest( const CvTermCriteria term_crit )
             cvGetRow( oob_responses, &oob_num_of_predictions, 1 );
         }
 
-        oob_samples_perm_ptr     = (float*)cvAlloc( sizeof(float)*nsamples*dims );
         samples_ptr              = (float*)cvAlloc( sizeof(float)*nsamples*dims );
         missing_ptr              = (uchar*)cvAlloc( sizeof(uchar)*nsamples*dims );
         true_resp_ptr            = (float*)cvAlloc( sizeof(float)*nsamples );
@@ -386,142 +543,123 @@ bool CvRTrees::grow_forest( const CvTermCriteria term_crit )
     trees = (CvForestTree**)cvAlloc( sizeof(trees[0])*max_ntrees );
     memset( trees, 0, sizeof(trees[0])*max_ntrees );
 
-    sample_idx_mask_for_tree = cvCreateMat( 1, nsamples, CV_8UC1 );
-    sample_idx_for_tree      = cvCreateMat( 1, nsamples, CV_32SC1 );
-
-    ntrees = 0;
-    while( ntrees < max_ntrees )
+    // The trees are grown in batches, several trees at once, each one in its own work buffer
+    // of the shared training data; the batch is limited by the memory the buffers may take.
+    // The trees whose split search uses data->rng are grown one by one. The trees are then
+    // evaluated in order, so that the forest stops growing at the same tree whatever the batch size is.
+    bool concurrent = !cv::dtreeClustersCategories(data) && data->params.cv_folds == 0;
+    int batch_size = concurrent ? std::max(std::min(cv::getNumThreads(), max_ntrees), 1) : 1;
+    if( batch_size > 1 )
+        batch_size = data->set_work_count( batch_size, (int64)max_work_memory << 20 );
+
+    std::vector<uint64> seeds(batch_size);
+    std::vector<uchar> in_bag;
+    std::vector<float> pred_values;
+    std::vector<int> pred_classes;
+    std::vector<double> importance;
+
+    cv::ForestTreeGrower grower( this, data, active_var_mask, 0, &seeds[0], batch_size > 1 );
+    in_bag.resize( batch_size*nsamples );
+    grower.inBag = &in_bag[0];
+    if( is_oob_or_vimportance )
     {
-        int i, oob_samples_count = 0;
-        double ncorrect_responses = 0; // used for estimation of variable importance
-        CvForestTree* tree = 0;
-
-        cvZero( sample_idx_mask_for_tree );
-        for(i = 0; i < nsamples; i++ ) //form sample for creation one tree
+        pred_values.resize( batch_size*nsamples );
+        pred_classes.resize( batch_size*nsamples );
+        grower.samples = samples_ptr;
+        grower.missing = missing_ptr;
+        grower.responses = true_resp_ptr;
+        grower.maxResponse = maximal_response;
+        grower.predValues = &pred_values[0];
+        grower.predClasses = &pred_classes[0];
+        if( var_importance )
         {
-            int idx = (*rng)(nsamples);
-            sample_idx_for_tree->data.i[i] = idx;
-            sample_idx_mask_for_tree->data.ptr[idx] = 0xFF;
+            importance.resize( batch_size*dims );
+            grower.calcImportance = true;
+            grower.importance = &importance[0];
         }
+    }
 
-        trees[ntrees] = new CvForestTree();
-        tree = trees[ntrees];
-        tree->train( data, sample_idx_for_tree, this );
+    ntrees = 0;
+    bool stop = false;
+    while( ntrees < max_ntrees && !stop )
+    {
+        int j, count = std::min(batch_size, max_ntrees - ntrees);
+        for( j = 0; j < count; j++ )
+            seeds[j] = ((uint64)rng->next() << 32) | rng->next();
+
+        grower.trees = trees + ntrees;
+        if( count > 1 )
+            cv::parallel_for_( cv::Range(0, count), grower );
+        else
+            grower( cv::Range(0, count) );
 
-        if ( is_oob_or_vimportance )
+        for( j = 0; j < count; j++ )
         {
-            CvMat sample, missing;
-            // form array of OOB samples indices and get these samples
-            sample   = cvMat( 1, dims, CV_32FC1, samples_ptr );
-            missing  = cvMat( 1, dims, CV_8UC1,  missing_ptr );
-
-            oob_error = 0;
-            for( i = 0; i < nsamples; i++,
-                sample.data.fl += dims, missing.data.ptr += dims )
+            if ( is_oob_or_vimportance )
             {
-                CvDTreeNode* predicted_node = 0;
-                // check if the sample is OOB
-                if( sample_idx_mask_for_tree->data.ptr[i] )
-                    continue;
-
-                // predict oob samples
-                if( !predicted_node )
-                    predicted_node = tree->predict(&sample, &missing, true);
+                const uchar* in_bag_j = &in_bag[j*nsamples];
+                const float* values_j = &pred_values[j*nsamples];
+                const int* classes_j = &pred_classes[j*nsamples];
+                int i, oob_samples_count = 0;
 
-                if( !data->is_classifier ) //regression
+                oob_error = 0;
+                for( i = 0; i < nsamples; i++ )
                 {
-                    double avg_resp, resp = predicted_node->value;
-                    oob_predictions_sum.data.fl[i] += (float)resp;
-                    oob_num_of_predictions.data.fl[i] += 1;
-
-                    // compute oob error
-                    avg_resp = oob_predictions_sum.data.fl[i]/oob_num_of_predictions.data.fl[i];
-                    avg_resp -= true_resp_ptr[i];
-                    oob_error += avg_resp*avg_resp;
-                    resp = (resp - true_resp_ptr[i])/maximal_response;
-                    ncorrect_responses += exp( -resp*resp );
-                }
-                else //classification
-                {
-                    double prdct_resp;
-                    CvPoint max_loc;
-                    CvMat votes;
+                    // check if the sample is OOB
+                    if( in_bag_j[i] )
+                        continue;
 
-                    cvGetRow(oob_sample_votes, &votes, i);
-                    votes.data.i[predicted_node->class_idx]++;
+                    if( !data->is_classifier ) //regression
+                    {
+                        double avg_resp;
+                        oob_predictions_sum.data.fl[i] += values_j[i];
+                        oob_num_of_predictions.data.fl[i] += 1;
+
+                        // compute oob error
+                        avg_resp = oob_predictions_sum.data.fl[i]/oob_num_of_predictions.data.fl[i];
+                        avg_resp -= true_resp_ptr[i];
+                        oob_error += avg_resp*avg_resp;
+                    }
+                    else //classification
+                    {
+                        double prdct_resp;
+                        CvPoint max_loc;
+                        CvMat votes;
 
-                    // compute oob error
-                    cvMinMaxLoc( &votes, 0, 0, 0, &max_loc );
+                        cvGetRow(oob_sample_votes, &votes, i);
+                        votes.data.i[classes_j[i]]++;
 
-                    prdct_resp = data->cat_map->data.i[max_loc.x];
-                    oob_error += (fabs(prdct_resp - true_resp_ptr[i]) < FLT_EPSILON) ? 0 : 1;
+                        // compute oob error
+                        cvMinMaxLoc( &votes, 0, 0, 0, &max_loc );
 
-                    ncorrect_responses += cvRound(predicted_node->value - true_resp_ptr[i]) == 0;
+                        prdct_resp = data->cat_map->data.i[max_loc.x];
+                        oob_error += (fabs(prdct_resp - true_resp_ptr[i]) < FLT_EPSILON) ? 0 : 1;
+                    }
+                    oob_samples_count++;
+                }
+                if( oob_samples_count > 0 )
+                    oob_error /= (double)oob_samples_count;
+
+                if( var_importance && oob_samples_count > 0 )
+                {
+                    for( int m = 0; m < dims; m++ )
+                        var_importance->data.fl[m] += (float)importance[j*dims + m];
                 }
-                oob_samples_count++;
             }
-            if( oob_samples_count > 0 )
-                oob_error /= (double)oob_samples_count;
 
-            // estimate variable importance
-            if( var_importance && oob_samples_count > 0 )
+            ntrees++;
+            if( term_crit.type != CV_TERMCRIT_ITER && oob_error < max_oob_err )
             {
-                int m;
-
-                memcpy( oob_samples_perm_ptr, samples_ptr, dims*nsamples*sizeof(float));
-                for( m = 0; m < dims; m++ )
+                // the rest of the batch would not have been grown one tree at a time
+                for( int k = j + 1; k < count; k++ )
                 {
-                    double ncorrect_responses_permuted = 0;
-                    // randomly permute values of the m-th variable in the oob samples
-                    float* mth_var_ptr = oob_samples_perm_ptr + m;
-
-                    for( i = 0; i < nsamples; i++ )
-                    {
-                        int i1, i2;
-                        float temp;
-
-                        if( sample_idx_mask_for_tree->data.ptr[i] ) //the sample is not OOB
-                            continue;
-                        i1 = (*rng)(nsamples);
-                        i2 = (*rng)(nsamples);
-                        CV_SWAP( mth_var_ptr[i1*dims], mth_var_ptr[i2*dims], temp );
-
-                        // turn values of (m-1)-th variable, that were permuted
-                        // at the previous iteration, untouched
-                        if( m > 1 )
-                            oob_samples_perm_ptr[i*dims+m-1] = samples_ptr[i*dims+m-1];
-                    }
-
-                    // predict "permuted" cases and calculate the number of votes for the
-                    // correct class in the variable-m-permuted oob data
-                    sample  = cvMat( 1, dims, CV_32FC1, oob_samples_perm_ptr );
-                    missing = cvMat( 1, dims, CV_8UC1, missing_ptr );
-                    for( i = 0; i < nsamples; i++,
-                        sample.data.fl += dims, missing.data.ptr += dims )
-                    {
-                        double predct_resp, true_resp;
-
-                        if( sample_idx_mask_for_tree->data.ptr[i] ) //the sample is not OOB
-                            continue;
-
-                        predct_resp = tree->predict(&sample, &missing, true)->value;
-                        true_resp   = true_resp_ptr[i];
-                        if( data->is_classifier )
-                            ncorrect_responses_permuted += cvRound(true_resp - predct_resp) == 0;
-                        else
-                        {
-                            true_resp = (true_resp - predct_resp)/maximal_response;
-                            ncorrect_responses_permuted += exp( -true_resp*true_resp );
-                        }
-                    }
-                    var_importance->data.fl[m] += (float)(ncorrect_responses
-                        - ncorrect_responses_permuted);
+                    delete trees[ntrees + k - j - 1];
+                    trees[ntrees + k - j - 1] = 0;
                 }
+                stop = true;
+                break;
             }
         }
-        ntrees++;
-        if( term_crit.type != CV_TERMCRIT_ITER && oob_error < max_oob_err )
-            break;
     }
 
     if( var_importance )
@@ -532,14 +670,10 @@ bool CvRTrees::grow_forest( const CvTermCriteria term_crit )
         cvNormalize( var_importance, var_importance, 1., 0, CV_L1 );
     }
 
-    cvFree( &oob_samples_perm_ptr );
     cvFree( &samples_ptr );
     cvFree( &missing_ptr );
     cvFree( &true_resp_ptr );
 
-    cvReleaseMat( &sample_idx_mask_for_tree );
-    cvReleaseMat( &sample_idx_for_tree );
-
     cvReleaseMat( &oob_sample_votes );
     cvReleaseMat( &oob_responses );
 
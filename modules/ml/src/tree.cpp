@@ -47,11 +47,38 @@ static const float ord_nan = FLT_MAX*0.5f;
 static const int min_block_size = 1 << 16;
 static const int block_size_delta = 1 << 10;
 
+namespace cv
+{
+
+// the trees grown at once on the shared training data, see CvDTreeTrainData::set_work_count()
+struct DTreeTrainWork
+{
+    int count; // the number of trees, one work buffer each
+    Mutex heap_mutex; // guards the node and split heaps
+};
+
+}
+
+static int getWorkCount( const DTreeTrainWork* work )
+{
+    return work ? work->count : 1;
+}
+
+// locks the node and split heaps of the training data when several trees are grown on it at once
+struct TreeHeapLock
+{
+    TreeHeapLock( DTreeTrainWork* _work ) : work(_work) { if( work ) work->heap_mutex.lock(); }
+    ~TreeHeapLock() { if( work ) work->heap_mutex.unlock(); }
+    DTreeTrainWork* work;
+};
+
 CvDTreeTrainData::CvDTreeTrainData()
 {
     var_idx = var_type = cat_count = cat_ofs = cat_map =
         priors = priors_mult = counts = direction = split_buf = responses_copy = 0;
+    bin_count = bin_ofs = bin_edges = bin_buf = 0;
     buf = 0;
+    work = 0;
     tree_storage = temp_storage = 0;
 
     clear();
@@ -66,7 +93,9 @@ CvDTreeTrainData::CvDTreeTrainData( const CvMat* _train_data, int _tflag,
 {
     var_idx = var_type = cat_count = cat_ofs = cat_map =
         priors = priors_mult = counts = direction = split_buf = responses_copy = 0;
+    bin_count = bin_ofs = bin_edges = bin_buf = 0;
     buf = 0;
+    work = 0;
 
     tree_storage = temp_storage = 0;
 
@@ -113,6 +142,12 @@ bool CvDTreeTrainData::set_params( const CvDTreeParams& _params )
     if( params.regression_accuracy < 0 )
         CV_ERROR( CV_StsOutOfRange, "params.regression_accuracy should be >= 0" );
 
+    // the bin index 255 marks the missing values
+    if( params.max_bins != 0 && (params.max_bins < 2 || params.max_bins > 255) )
+        CV_ERROR( CV_StsOutOfRange,
+        "params.max_bins should be =0 (the ordered variables are not binned) "
+        "or between 2 and 255" );
+
     ok = true;
 
     __END__;
@@ -142,6 +177,46 @@ public:
     bool operator()(const CvPair16u32s& a, const CvPair16u32s& b) const { return *a.i < *b.i; }
 };
 
+static const uchar missing_bin = 255;
+
+// splits the sorted values of an ordered variable into at most max_bins bins holding about
+// the same number of samples; if there are not more distinct values than bins,
+// every value gets its own bin. The values of the missing samples follow the valid ones
+static int binOrdVar( const float* values, const int* sorted_idx, int count, int num_valid,
+                      int max_bins, const int* sidx, uchar* bins, float* edges )
+{
+    int i, nbins = 0, distinct = num_valid > 0;
+
+    for( i = 1; i < num_valid && distinct <= max_bins; i++ )
+        distinct += values[sorted_idx[i-1]] < values[sorted_idx[i]];
+
+    for( i = 0; i < num_valid; i++ )
+    {
+        int idx = sorted_idx[i];
+        bins[sidx ? sidx[idx] : idx] = (uchar)nbins;
+
+        if( i + 1 < num_valid )
+        {
+            float v0 = values[idx], v1 = values[sorted_idx[i+1]];
+            if( v0 < v1 && (distinct <= max_bins ||
+                (int64)(i + 1)*max_bins >= (int64)(nbins + 1)*num_valid) )
+            {
+                // v0 <= edge < v1, so that the predictions agree with the training bins
+                float edge = (v0 + v1)*0.5f;
+                edges[nbins++] = edge < v1 ? edge : v0;
+            }
+        }
+    }
+
+    for( ; i < count; i++ )
+    {
+        int idx = sorted_idx[i];
+        bins[sidx ? sidx[idx] : idx] = missing_bin;
+    }
+
+    return num_valid > 0 ? nbins + 1 : 0;
+}
+
 void CvDTreeTrainData::set_data( const CvMat* _train_data, int _tflag,
     const CvMat* _responses, const CvMat* _var_idx, const CvMat* _sample_idx,
     const CvMat* _var_type, const CvMat* _missing_mask, const CvDTreeParams& _params,
@@ -157,13 +232,14 @@ void CvDTreeTrainData::set_data( const CvMat* _train_data, int _tflag,
     int *_idst = 0;
     unsigned short* udst = 0;
     int* idst = 0;
+    int* _bidx = 0;
 
     CV_FUNCNAME( "CvDTreeTrainData::set_data" );
 
     __BEGIN__;
 
     int sample_all = 0, r_type, cv_n;
-    int total_c_count = 0;
+    int total_c_count = 0, total_b_count = 0, buf_rows;
     int tree_block_size, temp_block_size, max_split_size, nv_size, cv_size = 0;
     int ds_step, dv_step, ms_step = 0, mv_step = 0; // {data|mask}{sample|var}_step
     int vi, i, size;
@@ -197,7 +273,17 @@ void CvDTreeTrainData::set_data( const CvMat* _train_data, int _tflag,
         priors = data->priors; data->priors = 0;
         priors_mult = data->priors_mult; data->priors_mult = 0;
         buf = data->buf; data->buf = 0;
+        cvReleaseMat( &bin_count );
+        cvReleaseMat( &bin_ofs );
+        cvReleaseMat( &bin_edges );
+        cvReleaseMat( &bin_buf );
+        bin_count = data->bin_count; data->bin_count = 0;
+        bin_ofs = data->bin_ofs; data->bin_ofs = 0;
+        bin_edges = data->bin_edges; data->bin_edges = 0;
+        bin_buf = data->bin_buf; data->bin_buf = 0;
         buf_count = data->buf_count; buf_size = data->buf_size;
+        delete work;
+        work = data->work; data->work = 0;
         sample_count = data->sample_count;
 
         direction = data->direction; data->direction = 0;
@@ -255,8 +341,9 @@ void CvDTreeTrainData::set_data( const CvMat* _train_data, int _tflag,
         var_count = var_idx->rows + var_idx->cols - 1;
     }
 
+    // the sample label row keeps the original sample indices, so they all have to fit
     is_buf_16u = false;
-    if ( sample_count < 65536 )
+    if ( sample_all < 65536 )
         is_buf_16u = true;
 
     if( !CV_IS_MAT(_responses) ||
@@ -306,9 +393,22 @@ void CvDTreeTrainData::set_data( const CvMat* _train_data, int _tflag,
 
     buf_size = -1; // the member buf_size is obsolete
 
-    effective_buf_size = (uint64)(work_var_count + 1)*(uint64)sample_count * buf_count; // this is the total size of "CvMat buf" to be allocated
+    // in the binned mode the ordered variables are quantized once for all the nodes
+    // and the trees, and buf keeps only the categorical variables and the labels
+    buf_rows = (int)(get_length_subbuf()/sample_count);
+    if( params.max_bins > 0 && ord_var_count > 0 )
+    {
+        CV_CALL( bin_count = cvCreateMat( 1, ord_var_count, CV_32SC1 ));
+        CV_CALL( bin_ofs = cvCreateMat( 1, ord_var_count, CV_32SC1 ));
+        CV_CALL( bin_edges = cvCreateMat( 1, ord_var_count*(params.max_bins - 1), CV_32FC1 ));
+        CV_CALL( bin_buf = cvCreateMat( ord_var_count, sample_all, CV_8UC1 ));
+        CV_CALL( _bidx = (int*)cvAlloc( sample_count*sizeof(_bidx[0]) ));
+        buf_rows -= ord_var_count;
+    }
+
+    effective_buf_size = (uint64)buf_rows*(uint64)sample_count * buf_count; // this is the total size of "CvMat buf" to be allocated
     effective_buf_width = sample_count;
-    effective_buf_height = work_var_count+1;
+    effective_buf_height = buf_rows;
 
     if (effective_buf_width >= effective_buf_height)
         effective_buf_height *= buf_count;
@@ -424,9 +524,9 @@ void CvDTreeTrainData::set_data( const CvMat* _train_data, int _tflag,
             int* c_map;
 
             if (is_buf_16u)
-                udst = (unsigned short*)(buf->data.s + vi*sample_count);
+                udst = (unsigned short*)(buf->data.s + get_buf_row(vi)*sample_count);
             else
-                idst = buf->data.i + vi*sample_count;
+                idst = buf->data.i + get_buf_row(vi)*sample_count;
 
             // copy data
             for( i = 0; i < sample_count; i++ )
@@ -539,7 +639,10 @@ void CvDTreeTrainData::set_data( const CvMat* _train_data, int _tflag,
         }
         else if( ci < 0 ) // process ordered variable
         {
-            if (is_buf_16u)
+            bool sort16u = is_buf_16u && !bin_buf;
+            if( bin_buf )
+                idst = _bidx;
+            else if (is_buf_16u)
                 udst = (unsigned short*)(buf->data.s + vi*sample_count);
             else
                 idst = buf->data.i + vi*sample_count;
@@ -564,17 +667,28 @@ void CvDTreeTrainData::set_data( const CvMat* _train_data, int _tflag,
                     num_valid++;
                 }
 
-                if (is_buf_16u)
+                if (sort16u)
                     udst[i] = (unsigned short)i; // TODO: memory corruption may be here
                 else
                     idst[i] = i;
                 _fdst[i] = val;
 
             }
-            if (is_buf_16u)
+            if (sort16u)
                 std::sort(udst, udst + sample_count, LessThanIdx<float, unsigned short>(_fdst));
             else
                 std::sort(idst, idst + sample_count, LessThanIdx<float, int>(_fdst));
+
+            if( bin_buf )
+            {
+                int oi = ~ci, b_count;
+                b_count = binOrdVar( _fdst, idst, sample_count, num_valid, params.max_bins, sidx,
+                                     bin_buf->data.ptr + (size_t)oi*bin_buf->step,
+                                     bin_edges->data.fl + total_b_count );
+                bin_count->data.i[oi] = b_count;
+                bin_ofs->data.i[oi] = total_b_count;
+                total_b_count += MAX(b_count - 1, 0);
+            }
         }
 
         if( vi < var_count )
@@ -583,9 +697,9 @@ void CvDTreeTrainData::set_data( const CvMat* _train_data, int _tflag,
 
     // set sample labels
     if (is_buf_16u)
-        udst = (unsigned short*)(buf->data.s + work_var_count*sample_count);
+        udst = (unsigned short*)(buf->data.s + get_buf_row(work_var_count)*sample_count);
     else
-        idst = buf->data.i + work_var_count*sample_count;
+        idst = buf->data.i + get_buf_row(work_var_count)*sample_count;
 
     for (i = 0; i < sample_count; i++)
     {
@@ -602,7 +716,7 @@ void CvDTreeTrainData::set_data( const CvMat* _train_data, int _tflag,
 
         if (is_buf_16u)
         {
-            usdst = (unsigned short*)(buf->data.s + (get_work_var_count()-1)*sample_count);
+            usdst = (unsigned short*)(buf->data.s + get_buf_row(get_work_var_count()-1)*sample_count);
             for( i = vi = 0; i < sample_count; i++ )
             {
                 usdst[i] = (unsigned short)vi++;
@@ -619,7 +733,7 @@ void CvDTreeTrainData::set_data( const CvMat* _train_data, int _tflag,
         }
         else
         {
-            idst2 = buf->data.i + (get_work_var_count()-1)*sample_count;
+            idst2 = buf->data.i + get_buf_row(get_work_var_count()-1)*sample_count;
             for( i = vi = 0; i < sample_count; i++ )
             {
                 idst2[i] = vi++;
@@ -637,6 +751,8 @@ void CvDTreeTrainData::set_data( const CvMat* _train_data, int _tflag,
 
     if ( cat_map )
         cat_map->cols = MAX( total_c_count, 1 );
+    if( bin_edges )
+        bin_edges->cols = MAX( total_b_count, 1 );
 
     max_split_size = cvAlign(sizeof(CvDTreeSplit) +
         (MAX(0,max_c_count - 33)/32)*sizeof(int),sizeof(void*));
@@ -678,6 +794,7 @@ void CvDTreeTrainData::set_data( const CvMat* _train_data, int _tflag,
         cvFree( &_fdst );
     if (_idst)
         cvFree( &_idst );
+    cvFree( &_bidx );
     cvFree( &int_ptr );
     cvFree( &pair16u32s_ptr);
     cvReleaseMat( &var_type0 );
@@ -693,6 +810,12 @@ void CvDTreeTrainData::do_responses_copy()
 }
 
 CvDTreeNode* CvDTreeTrainData::subsample_data( const CvMat* _subsample_idx )
+{
+    return subsample_data( _subsample_idx, 0 );
+}
+
+
+CvDTreeNode* CvDTreeTrainData::subsample_data( const CvMat* _subsample_idx, int work_idx )
 {
     CvDTreeNode* root = 0;
     CvMat* isubsample_idx = 0;
@@ -707,6 +830,9 @@ CvDTreeNode* CvDTreeTrainData::subsample_data( const CvMat* _subsample_idx )
     if( !data_root )
         CV_ERROR( CV_StsError, "No training data has been set" );
 
+    if( work_idx < 0 || work_idx >= getWorkCount(work) )
+        CV_ERROR( CV_StsOutOfRange, "There is no such work buffer" );
+
     if( _subsample_idx )
     {
         CV_CALL( isubsample_idx = cvPreprocessIndexArray( _subsample_idx, sample_count ));
@@ -727,7 +853,9 @@ CvDTreeNode* CvDTreeTrainData::subsample_data( const CvMat* _subsample_idx )
             isMakeRootCopy = false;
     }
 
-    if( isMakeRootCopy )
+    // the copy of the root refers to the whole training set, and its children go
+    // to the first work buffer, so the other work buffers always get a real copy
+    if( isMakeRootCopy && work_idx == 0 )
     {
         // make a copy of the root node
         CvDTreeNode temp;
@@ -747,6 +875,13 @@ CvDTreeNode* CvDTreeTrainData::subsample_data( const CvMat* _subsample_idx )
     }
     else
     {
+        if( !isubsample_idx )
+        {
+            CV_CALL( isubsample_idx = cvCreateMat( 1, sample_count, CV_32SC1 ));
+            for( int i = 0; i < sample_count; i++ )
+                isubsample_idx->data.i[i] = i;
+        }
+
         int* sidx = isubsample_idx->data.i;
         // co - array of count/offset pairs (to handle duplicated values in _subsample_idx)
         int* co, cur_ofs = 0;
@@ -754,7 +889,7 @@ CvDTreeNode* CvDTreeTrainData::subsample_data( const CvMat* _subsample_idx )
         int workVarCount = get_work_var_count();
         int count = isubsample_idx->rows + isubsample_idx->cols - 1;
 
-        root = new_node( 0, count, 1, 0 );
+        root = new_node( 0, count, 1 + work_idx, 0 );
 
         CV_CALL( subsample_co = cvCreateMat( 1, sample_count*2, CV_32SC1 ));
         cvZero( subsample_co );
@@ -773,6 +908,8 @@ CvDTreeNode* CvDTreeTrainData::subsample_data( const CvMat* _subsample_idx )
         }
 
         cv::AutoBuffer<uchar> inn_buf(sample_count*(2*sizeof(int) + sizeof(float)));
+        cv::AutoBuffer<int> bin_sidx_buf(bin_buf ? sample_count : 1);
+        const int* bin_sidx = bin_buf ? get_sample_indices( data_root, (int*)bin_sidx_buf ) : 0;
         for( vi = 0; vi < workVarCount; vi++ )
         {
             int ci = get_var_type(vi);
@@ -785,7 +922,7 @@ CvDTreeNode* CvDTreeTrainData::subsample_data( const CvMat* _subsample_idx )
                 if (is_buf_16u)
                 {
                     unsigned short* udst = (unsigned short*)(buf->data.s + root->buf_idx*get_length_subbuf() +
-                        vi*sample_count + root->offset);
+                        get_buf_row(vi)*sample_count + root->offset);
                     for( i = 0; i < count; i++ )
                     {
                         int val = src[sidx[i]];
@@ -796,7 +933,7 @@ CvDTreeNode* CvDTreeTrainData::subsample_data( const CvMat* _subsample_idx )
                 else
                 {
                     int* idst = buf->data.i + root->buf_idx*get_length_subbuf() +
-                        vi*sample_count + root->offset;
+                        get_buf_row(vi)*sample_count + root->offset;
                     for( i = 0; i < count; i++ )
                     {
                         int val = src[sidx[i]];
@@ -808,6 +945,15 @@ CvDTreeNode* CvDTreeTrainData::subsample_data( const CvMat* _subsample_idx )
                 if( vi < var_count )
                     root->set_num_valid(vi, num_valid);
             }
+            else if( bin_buf )
+            {
+                // the binned variables stay in bin_buf, only count the valid values
+                const uchar* bins = bin_buf->data.ptr + (size_t)(~ci)*bin_buf->step;
+                int num_valid = 0;
+                for( i = 0; i < count; i++ )
+                    num_valid += bins[bin_sidx[sidx[i]]] != missing_bin;
+                root->set_num_valid(vi, num_valid);
+            }
             else
             {
                 int *src_idx_buf = (int*)(uchar*)inn_buf;
@@ -874,14 +1020,14 @@ CvDTreeNode* CvDTreeTrainData::subsample_data( const CvMat* _subsample_idx )
         if (is_buf_16u)
         {
             unsigned short* sample_idx_dst = (unsigned short*)(buf->data.s + root->buf_idx*get_length_subbuf() +
-                workVarCount*sample_count + root->offset);
+                get_buf_row(workVarCount)*sample_count + root->offset);
             for (i = 0; i < count; i++)
                 sample_idx_dst[i] = (unsigned short)sample_idx_src[sidx[i]];
         }
         else
         {
             int* sample_idx_dst = buf->data.i + root->buf_idx*get_length_subbuf() +
-                workVarCount*sample_count + root->offset;
+                get_buf_row(workVarCount)*sample_count + root->offset;
             for (i = 0; i < count; i++)
                 sample_idx_dst[i] = sample_idx_src[sidx[i]];
         }
@@ -957,6 +1103,40 @@ void CvDTreeTrainData::get_vectors( const CvMat* _subsample_idx,
                 }
             }
         }
+        else if( bin_buf ) // binned, take the values from the training data
+        {
+            float* dst = values + vi;
+            uchar* m = missing ? missing + vi : 0;
+            const uchar* bins = bin_buf->data.ptr + (size_t)(~ci)*bin_buf->step;
+            const int* sample_indices = get_sample_indices(data_root, (int*)(uchar*)inn_buf);
+            int vidx = var_idx ? var_idx->data.i[vi] : vi;
+            int td_step = train_data->step/CV_ELEM_SIZE(train_data->type);
+            int s_step = tflag == CV_ROW_SAMPLE ? td_step : 1, v_step = tflag == CV_ROW_SAMPLE ? 1 : td_step;
+
+            for( i = 0; i < total; i++ )
+            {
+                int si = sample_indices[i], count_i = 1;
+                if( bins[si] == missing_bin )
+                    continue;
+                if( co )
+                {
+                    count_i = co[i*2];
+                    cur_ofs = co[i*2+1];
+                }
+                else
+                    cur_ofs = i*var_count;
+                if( count_i )
+                {
+                    float val = train_data->data.fl[(size_t)si*s_step + (size_t)vidx*v_step];
+                    for( ; count_i > 0; count_i--, cur_ofs += var_count )
+                    {
+                        dst[cur_ofs] = val;
+                        if( m )
+                            m[cur_ofs] = 0;
+                    }
+                }
+            }
+        }
         else // ordered
         {
             float* dst = values + vi;
@@ -1031,6 +1211,7 @@ void CvDTreeTrainData::get_vectors( const CvMat* _subsample_idx,
 CvDTreeNode* CvDTreeTrainData::new_node( CvDTreeNode* parent, int count,
                                          int storage_idx, int offset )
 {
+    TreeHeapLock lock(work);
     CvDTreeNode* node = (CvDTreeNode*)cvSetNew( node_heap );
 
     node->sample_count = count;
@@ -1074,6 +1255,7 @@ CvDTreeNode* CvDTreeTrainData::new_node( CvDTreeNode* parent, int count,
 CvDTreeSplit* CvDTreeTrainData::new_split_ord( int vi, float cmp_val,
                 int split_point, int inversed, float quality )
 {
+    TreeHeapLock lock(work);
     CvDTreeSplit* split = (CvDTreeSplit*)cvSetNew( split_heap );
     split->var_idx = vi;
     split->condensed_idx = INT_MIN;
@@ -1089,6 +1271,7 @@ CvDTreeSplit* CvDTreeTrainData::new_split_ord( int vi, float cmp_val,
 
 CvDTreeSplit* CvDTreeTrainData::new_split_cat( int vi, float quality )
 {
+    TreeHeapLock lock(work);
     CvDTreeSplit* split = (CvDTreeSplit*)cvSetNew( split_heap );
     int i, n = (max_c_count + 31)/32;
 
@@ -1108,6 +1291,7 @@ void CvDTreeTrainData::free_node( CvDTreeNode* node )
 {
     CvDTreeSplit* split = node->split;
     free_node_data( node );
+    TreeHeapLock lock(work);
     while( split )
     {
         CvDTreeSplit* next = split->next;
@@ -1123,6 +1307,7 @@ void CvDTreeTrainData::free_node_data( CvDTreeNode* node )
 {
     if( node->num_valid )
     {
+        TreeHeapLock lock(work);
         cvSetRemoveByPtr( nv_heap, node->num_valid );
         node->num_valid = 0;
     }
@@ -1134,6 +1319,10 @@ void CvDTreeTrainData::free_train_data()
 {
     cvReleaseMat( &counts );
     cvReleaseMat( &buf );
+    cvReleaseMat( &bin_count );
+    cvReleaseMat( &bin_ofs );
+    cvReleaseMat( &bin_edges );
+    cvReleaseMat( &bin_buf );
     cvReleaseMat( &direction );
     cvReleaseMat( &split_buf );
     cvReleaseMemStorage( &temp_storage );
@@ -1162,6 +1351,8 @@ void CvDTreeTrainData::clear()
     have_labels = have_priors = is_classifier = false;
 
     buf_count = buf_size = 0;
+    delete work;
+    work = 0;
     shared = false;
 
     data_root = 0;
@@ -1190,6 +1381,39 @@ void CvDTreeTrainData::get_ord_var_data( CvDTreeNode* n, int vi, float* ord_valu
 
     const int* sample_indices = get_sample_indices(n, sample_indices_buf);
 
+    if( bin_buf )
+    {
+        // the bin indices are the values of the binned variables; the samples
+        // are sorted by counting the bins, the missing ones go last
+        int oi = ~get_var_type(vi), b_count = bin_count->data.i[oi];
+        const uchar* bins = bin_buf->data.ptr + (size_t)oi*bin_buf->step;
+        cv::AutoBuffer<int> ofs_buf(b_count + 2);
+        int* ofs = ofs_buf;
+        int i;
+
+        for( i = 0; i <= b_count + 1; i++ )
+            ofs[i] = 0;
+        for( i = 0; i < node_sample_count; i++ )
+        {
+            int b = bins[sample_indices[i]];
+            ofs[(b == missing_bin ? b_count : b) + 1]++;
+        }
+        for( i = 1; i <= b_count; i++ )
+            ofs[i] += ofs[i-1];
+        for( i = 0; i < node_sample_count; i++ )
+        {
+            int b = bins[sample_indices[i]], pos;
+            b = b == missing_bin ? b_count : b;
+            pos = ofs[b]++;
+            sorted_indices_buf[pos] = i;
+            ord_values_buf[pos] = (float)b;
+        }
+
+        *sorted_indices = sorted_indices_buf;
+        *ord_values = ord_values_buf;
+        return;
+    }
+
     if( !is_buf_16u )
         *sorted_indices = buf->data.i + n->buf_idx*get_length_subbuf() +
         vi*sample_count + n->offset;
@@ -1266,10 +1490,10 @@ const int* CvDTreeTrainData::get_cat_var_data( CvDTreeNode* n, int vi, int* cat_
     const int* cat_values = 0;
     if( !is_buf_16u )
         cat_values = buf->data.i + n->buf_idx*get_length_subbuf() +
-            vi*sample_count + n->offset;
+            get_buf_row(vi)*sample_count + n->offset;
     else {
         const unsigned short* short_values = (const unsigned short*)(buf->data.s + n->buf_idx*get_length_subbuf() +
-            vi*sample_count + n->offset);
+            get_buf_row(vi)*sample_count + n->offset);
         for( int i = 0; i < n->sample_count; i++ )
             cat_values_buf[i] = short_values[i];
         cat_values = cat_values_buf;
@@ -1278,12 +1502,119 @@ const int* CvDTreeTrainData::get_cat_var_data( CvDTreeNode* n, int vi, int* cat_
 }
 
 
+int CvDTreeTrainData::get_buf_row( int vi ) const
+{
+    if( !bin_buf )
+        return vi;
+    // the categorical variables keep their order, followed by the labels and the sample indices
+    return vi < var_count ? get_var_type(vi) : vi - ord_var_count;
+}
+
+
+float CvDTreeTrainData::get_bin_edge( int vi, float c ) const
+{
+    int oi = ~get_var_type(vi);
+    int b = cvFloor(c), b_count = bin_count->data.i[oi];
+    b = MIN( MAX( b, 0 ), b_count - 2 );
+    return bin_edges->data.fl[bin_ofs->data.i[oi] + b];
+}
+
+
 int CvDTreeTrainData::get_child_buf_idx( CvDTreeNode* n )
 {
-    int idx = n->buf_idx + 1;
-    if( idx >= buf_count )
-        idx = shared ? 1 : 0;
-    return idx;
+    // the shared data keeps the whole training set in the 0-th buffer,
+    // and the nodes of every tree stay in the work buffer of the tree
+    if( !shared )
+        return 0;
+    return n->buf_idx > 0 ? n->buf_idx : 1;
+}
+
+
+int CvDTreeTrainData::set_work_count( int max_work_count, int64 max_memory )
+{
+    CvMat* new_buf = 0;
+
+    CV_FUNCNAME( "CvDTreeTrainData::set_work_count" );
+
+    __BEGIN__;
+
+    int _work_count, buf_rows;
+    int64 work_buf_size;
+
+    if( !shared || !buf )
+        CV_ERROR( CV_StsError, "The work buffers can only be reserved in the shared training data" );
+    if( max_work_count < 1 )
+        CV_ERROR( CV_StsOutOfRange, "The number of work buffers should be positive" );
+
+    // every work buffer takes a part of buf and a row of direction, split_buf and counts;
+    // reserve as many of them as fit into the memory and into the integer matrix sizes
+    buf_rows = (int)(get_length_subbuf()/sample_count);
+    work_buf_size = (int64)get_length_subbuf()*CV_ELEM_SIZE(buf->type) +
+        (int64)sample_count*(sizeof(uchar) + sizeof(int)) + (counts ? counts->cols*sizeof(int) : 0);
+    _work_count = (int)MIN( (int64)max_work_count, MAX( max_memory/work_buf_size, (int64)1 ));
+    _work_count = MIN( _work_count, INT_MAX/MIN(buf_rows, sample_count) - 1 );
+    _work_count = MAX( _work_count, 1 );
+
+    if( _work_count != getWorkCount(work) )
+    {
+        // keep the 0-th buffer with the whole training set and reallocate the work buffers,
+        // laid out as in set_data
+        int new_buf_count = _work_count + 1;
+        int height = buf_rows, width = sample_count;
+        if( width >= height )
+            height *= new_buf_count;
+        else
+            width *= new_buf_count;
+
+        CV_CALL( new_buf = cvCreateMat( height, width, CV_MAT_TYPE(buf->type) ));
+        memcpy( new_buf->data.ptr, buf->data.ptr, get_length_subbuf()*CV_ELEM_SIZE(buf->type) );
+        cvReleaseMat( &buf );
+        buf = new_buf;
+        new_buf = 0;
+        buf_count = new_buf_count;
+
+        cvReleaseMat( &direction );
+        cvReleaseMat( &split_buf );
+        CV_CALL( direction = cvCreateMat( _work_count, sample_count, CV_8UC1 ));
+        CV_CALL( split_buf = cvCreateMat( _work_count, sample_count, CV_32SC1 ));
+        if( counts )
+        {
+            int m = counts->cols;
+            cvReleaseMat( &counts );
+            CV_CALL( counts = cvCreateMat( _work_count, m, CV_32SC1 ));
+        }
+
+        delete work;
+        work = 0;
+        if( _work_count > 1 )
+        {
+            work = new DTreeTrainWork;
+            work->count = _work_count;
+        }
+    }
+
+    __END__;
+
+    cvReleaseMat( &new_buf );
+    return getWorkCount(work);
+}
+
+
+uchar* CvDTreeTrainData::get_direction( const CvDTreeNode* n )
+{
+    return direction->data.ptr + get_work_idx(n)*direction->step;
+}
+
+
+int* CvDTreeTrainData::get_split_buf( const CvDTreeNode* n )
+{
+    return (int*)(split_buf->data.ptr + get_work_idx(n)*split_buf->step);
+}
+
+
+int* CvDTreeTrainData::get_counts( const CvDTreeNode* n )
+{
+    return (int*)(counts->data.ptr + get_work_idx(n)*counts->step);
 }
 
 
@@ -1317,6 +1648,9 @@ void CvDTreeTrainData::write_params( CvFileStorage* fs ) const
     cvWriteInt( fs, "min_sample_count", params.min_sample_count );
     cvWriteInt( fs, "cross_validation_folds", params.cv_folds );
 
+    if( params.max_bins > 0 )
+        cvWriteInt( fs, "max_bins", params.max_bins );
+
     if( params.cv_folds > 1 )
     {
         cvWriteInt( fs, "use_1se_rule", params.use_1se_rule ? 1 : 0 );
@@ -1384,6 +1718,7 @@ void CvDTreeTrainData::read_params( CvFileStorage* fs, CvFileNode* node )
         params.max_depth = cvReadIntByName( fs, tparams_node, "max_depth" );
         params.min_sample_count = cvReadIntByName( fs, tparams_node, "min_sample_count" );
         params.cv_folds = cvReadIntByName( fs, tparams_node, "cross_validation_folds" );
+        params.max_bins = cvReadIntByName( fs, tparams_node, "max_bins", 0 );
 
         if( params.cv_folds > 1 )
         {
@@ -1501,7 +1836,7 @@ void CvDTreeTrainData::read_params( CvFileStorage* fs, CvFileNode* node )
 /////////////////////// Decision Tree /////////////////////////
 CvDTreeParams::CvDTreeParams() : max_categories(10), max_depth(INT_MAX), min_sample_count(10),
     cv_folds(10), use_surrogates(true), use_1se_rule(true),
-    truncate_pruned_tree(true), regression_accuracy(0.01f), priors(0)
+    truncate_pruned_tree(true), regression_accuracy(0.01f), max_bins(0), priors(0)
 {}
 
 CvDTreeParams::CvDTreeParams( int _max_depth, int _min_sample_count,
@@ -1513,7 +1848,7 @@ CvDTreeParams::CvDTreeParams( int _max_depth, int _min_sample_count,
     min_sample_count(_min_sample_count), cv_folds (_cv_folds),
     use_surrogates(_use_surrogates), use_1se_rule(_use_1se_rule),
     truncate_pruned_tree(_truncate_pruned_tree),
-    regression_accuracy(_regression_accuracy),
+    regression_accuracy(_regression_accuracy), max_bins(0),
     priors(_priors)
 {}
 
@@ -1521,6 +1856,7 @@ CvDTree::CvDTree()
 {
     data = 0;
     var_importance = 0;
+    bin_hists = 0;
     default_model_name = "my_tree";
 
     clear();
@@ -1529,6 +1865,8 @@ CvDTree::CvDTree()
 
 void CvDTree::clear()
 {
+    delete bin_hists;
+    bin_hists = 0;
     cvReleaseMat( &var_importance );
     if( data )
     {
@@ -1658,6 +1996,9 @@ bool CvDTree::do_train( const CvMat* _subsample_idx )
 
     root = data->subsample_data( _subsample_idx );
 
+    if( data->bin_buf )
+        bin_hists = new cv::DTreeBinHistograms( this );
+
     CV_CALL( try_split_node(root));
 
     if( root->split )
@@ -1676,6 +2017,9 @@ bool CvDTree::do_train( const CvMat* _subsample_idx )
 
     __END__;
 
+    delete bin_hists;
+    bin_hists = 0;
+
     return result;
 }
 
@@ -1697,7 +2041,7 @@ void CvDTree::try_split_node( CvDTreeNode* node )
     {
         // check if we have a "pure" node,
         // we assume that cls_count is filled by calc_node_value()
-        int* cls_count = data->counts->data.i;
+        int* cls_count = data->get_counts( node );
         int nz = 0, m = data->get_num_classes();
         for( i = 0; i < m; i++ )
             nz += cls_count[i] != 0;
@@ -1712,12 +2056,16 @@ void CvDTree::try_split_node( CvDTreeNode* node )
 
     if( can_split )
     {
+        if( bin_hists )
+            bin_hists->setNode( node );
         best_split = find_best_split(node);
         // TODO: check the split quality ...
         node->split = best_split;
     }
     if( !can_split || !best_split )
     {
+        if( bin_hists )
+            bin_hists->release( node );
         data->free_node_data(node);
         return;
     }
@@ -1754,7 +2102,18 @@ void CvDTree::try_split_node( CvDTreeNode* node )
             }
         }
     }
+
+    if( data->bin_buf )
+    {
+        // the splits on the binned variables are found in the bin units
+        for( CvDTreeSplit* split = node->split; split; split = split->next )
+            if( data->get_var_type(split->var_idx) < 0 )
+                split->ord.c = data->get_bin_edge( split->var_idx, split->ord.c );
+    }
+
     split_node_data( node );
+    if( bin_hists )
+        bin_hists->split( node );
     try_split_node( node->left );
     try_split_node( node->right );
 }
@@ -1773,7 +2132,7 @@ void CvDTree::try_split_node( CvDTreeNode* node )
 // are not discarded.
 double CvDTree::calc_node_dir( CvDTreeNode* node )
 {
-    char* dir = (char*)data->direction->data.ptr;
+    char* dir = (char*)data->get_direction( node );
     int i, n = node->sample_count, vi = node->split->var_idx;
     double L, R;
 
@@ -1812,7 +2171,8 @@ double CvDTree::calc_node_dir( CvDTreeNode* node )
             {
                 int idx = labels[i];
                 double w = priors[responses[i]];
-                int d = idx >= 0 ? CV_DTREE_CAT_DIR(idx,subset) : 0;
+                int d = ( ((idx >= 0)&&(!data->is_buf_16u)) || ((idx != 65535)&&(data->is_buf_16u)) ) ?
+                    CV_DTREE_CAT_DIR(idx,subset) : 0;
                 sum += d*w; sum_abs += (d & 1)*w;
                 dir[i] = (char)d;
             }
@@ -1887,94 +2247,300 @@ template<> CV_EXPORTS void DefaultDeleter<CvDTreeSplit>::operator ()(CvDTreeSpli
     fastFree(obj);
 }
 
+bool dtreeClustersCategories( const CvDTreeTrainData* data )
+{
+    if( data->is_classifier && data->get_num_classes() > 2 )
+    {
+        for( int ci = 0; ci < data->cat_var_count; ci++ )
+            if( data->cat_count->data.i[ci] > data->params.max_categories )
+                return true;
+    }
+    return false;
+}
+
 DTreeBestSplitFinder::DTreeBestSplitFinder( CvDTree* _tree, CvDTreeNode* _node)
 {
     tree = _tree;
     node = _node;
-    splitSize = tree->get_data()->split_heap->elem_size;
-
-    bestSplit.reset((CvDTreeSplit*)fastMalloc(splitSize));
-    memset(bestSplit.get(), 0, splitSize);
-    bestSplit->quality = -1;
-    bestSplit->condensed_idx = INT_MIN;
-    split.reset((CvDTreeSplit*)fastMalloc(splitSize));
-    memset(split.get(), 0, splitSize);
-    //haveSplit = false;
+    CvDTreeTrainData* data = tree->get_data();
+    int var_count = data->var_count;
+    splitSize = data->split_heap->elem_size;
+
+    buf.allocate(var_count*(splitSize + 1));
+    splits = (uchar*)buf;
+    found = splits + var_count*splitSize;
+    memset(splits, 0, var_count*splitSize);
+    memset(found, 0, var_count);
 }
 
-DTreeBestSplitFinder::DTreeBestSplitFinder( const DTreeBestSplitFinder& finder, Split )
+bool DTreeBestSplitFinder::isActiveVar( int vi ) const
 {
-    tree = finder.tree;
-    node = finder.node;
-    splitSize = tree->get_data()->split_heap->elem_size;
-
-    bestSplit.reset((CvDTreeSplit*)fastMalloc(splitSize));
-    memcpy(bestSplit.get(), finder.bestSplit.get(), splitSize);
-    split.reset((CvDTreeSplit*)fastMalloc(splitSize));
-    memset(split.get(), 0, splitSize);
+    return node->get_num_valid(vi) > 1;
 }
 
-void DTreeBestSplitFinder::operator()(const BlockedRange& range)
+void DTreeBestSplitFinder::operator()(const Range& range) const
 {
-    int vi, vi1 = range.begin(), vi2 = range.end();
+    int vi, vi1 = range.start, vi2 = range.end;
     int n = node->sample_count;
     CvDTreeTrainData* data = tree->get_data();
     AutoBuffer<uchar> inn_buf(2*n*(sizeof(int) + sizeof(float)));
+    // the best quality seen so far in this stripe; the splits that do not beat it
+    // could not win the final reduction either
+    float quality = -1;
 
     for( vi = vi1; vi < vi2; vi++ )
     {
-        CvDTreeSplit *res;
+        CvDTreeSplit *res, *split = (CvDTreeSplit*)(splits + vi*splitSize);
         int ci = data->get_var_type(vi);
-        if( node->get_num_valid(vi) <= 1 )
+        if( !isActiveVar(vi) )
             continue;
 
         if( data->is_classifier )
         {
             if( ci >= 0 )
-                res = tree->find_split_cat_class( node, vi, bestSplit->quality, split, (uchar*)inn_buf );
+                res = tree->find_split_cat_class( node, vi, quality, split, (uchar*)inn_buf );
             else
-                res = tree->find_split_ord_class( node, vi, bestSplit->quality, split, (uchar*)inn_buf );
+                res = tree->find_split_ord_class( node, vi, quality, split, (uchar*)inn_buf );
         }
         else
         {
             if( ci >= 0 )
-                res = tree->find_split_cat_reg( node, vi, bestSplit->quality, split, (uchar*)inn_buf );
+                res = tree->find_split_cat_reg( node, vi, quality, split, (uchar*)inn_buf );
             else
-                res = tree->find_split_ord_reg( node, vi, bestSplit->quality, split, (uchar*)inn_buf );
+                res = tree->find_split_ord_reg( node, vi, quality, split, (uchar*)inn_buf );
         }
 
-        if( res && bestSplit->quality < split->quality )
-                memcpy( bestSplit.get(), split.get(), splitSize );
+        if( res && quality < split->quality )
+        {
+            found[vi] = (uchar)1;
+            quality = split->quality;
+        }
+    }
+}
+
+CvDTreeSplit* DTreeBestSplitFinder::findBestSplit( bool parallel )
+{
+    CvDTreeTrainData* data = tree->get_data();
+    Range range(0, data->var_count);
+
+    // the clustering of the categories draws random centers from data->rng,
+    // so that case keeps the sequential order of the random numbers
+    if( dtreeClustersCategories(data) )
+        parallel = false;
+
+    if( parallel )
+        parallel_for_(range, *this);
+    else
+        (*this)(range);
+
+    const CvDTreeSplit* best = 0;
+    for( int vi = 0; vi < data->var_count; vi++ )
+    {
+        const CvDTreeSplit* split = (const CvDTreeSplit*)(splits + vi*splitSize);
+        if( found[vi] && (!best || best->quality < split->quality) )
+            best = split;
+    }
+
+    CvDTreeSplit* bestSplit = 0;
+    if( best && best->quality > 0 )
+    {
+        bestSplit = data->new_split_cat( 0, -1.0f );
+        memcpy( bestSplit, best, splitSize );
     }
+    return bestSplit;
 }
 
-void DTreeBestSplitFinder::join( DTreeBestSplitFinder& rhs )
+DTreeBinHistograms::DTreeBinHistograms( CvDTree* _tree )
 {
-    if( bestSplit->quality < rhs.bestSplit->quality )
-        memcpy( bestSplit.get(), rhs.bestSplit.get(), splitSize );
+    tree = _tree;
+    data = tree->get_data();
+    stride = data->is_classifier ? data->get_num_classes() + 1 : 3;
+    histSize = 0;
+    varOfs.resize(data->var_count);
+    for( int vi = 0; vi < data->var_count; vi++ )
+    {
+        int ci = data->get_var_type(vi);
+        varOfs[vi] = histSize;
+        if( ci < 0 )
+            histSize += data->bin_count->data.i[~ci]*stride;
+    }
+
+    node = 0;
+    sampleIdx = labels = 0;
+    responses = 0;
+    weights = 0;
+    parent = small = large = 0;
 }
+
+DTreeBinHistograms::~DTreeBinHistograms()
+{
+    std::map<const CvDTreeNode*, NodeHistograms*>::iterator it = nodes.begin();
+    for( ; it != nodes.end(); ++it )
+        delete it->second;
 }
 
+DTreeBinHistograms::NodeHistograms* DTreeBinHistograms::create( CvDTreeNode* n )
+{
+    NodeHistograms*& h = nodes[n];
+    if( !h )
+    {
+        h = new NodeHistograms;
+        h->hist.resize(histSize);
+        h->valid.resize(data->var_count, (uchar)0);
+    }
+    return h;
+}
 
-CvDTreeSplit* CvDTree::find_best_split( CvDTreeNode* node )
+void DTreeBinHistograms::setNode( CvDTreeNode* n )
 {
-    DTreeBestSplitFinder finder( this, node );
+    create( n );
+    load( n );
+}
 
-    cv::parallel_reduce(cv::BlockedRange(0, data->var_count), finder);
+void DTreeBinHistograms::load( CvDTreeNode* n )
+{
+    int count = n->sample_count;
+    node = n;
+
+    sampleBuf.allocate(count*(sizeof(double) + 3*sizeof(int)));
+    double* weights_buf = (double*)(uchar*)sampleBuf;
+    int* sample_idx_buf = (int*)(weights_buf + count);
+    int* labels_buf = sample_idx_buf + count;
+    int* aux_buf = labels_buf + count;
+
+    sampleIdx = data->get_sample_indices( n, sample_idx_buf );
+    labels = 0;
+    responses = 0;
+    if( data->is_classifier )
+        labels = data->get_class_labels( n, labels_buf );
+    else
+        responses = data->get_ord_responses( n, (float*)labels_buf, aux_buf );
+    weights = tree->get_bin_weights( n, weights_buf );
+}
+
+void DTreeBinHistograms::collect( int vi, double* hist ) const
+{
+    int ci = data->get_var_type(vi), n = node->sample_count;
+    const uchar* bins = data->bin_buf->data.ptr + (size_t)(~ci)*data->bin_buf->step;
+
+    memset( hist, 0, data->bin_count->data.i[~ci]*stride*sizeof(hist[0]) );
 
-    CvDTreeSplit *bestSplit = 0;
-    if( finder.bestSplit->quality > 0 )
+    for( int i = 0; i < n; i++ )
     {
-        bestSplit = data->new_split_cat( 0, -1.0f );
-        memcpy( bestSplit, finder.bestSplit, finder.splitSize );
+        int b = bins[sampleIdx[i]];
+        if( b == missing_bin )
+            continue;
+
+        double w = weights ? weights[i] : 1.;
+        double* h = hist + b*stride;
+        h[0] += 1;
+        if( labels )
+            h[labels[i] + 1] += w;
+        else
+        {
+            h[1] += w;
+            h[2] += w*responses[i];
+        }
     }
+}
 
-    return bestSplit;
+const double* DTreeBinHistograms::get( CvDTreeNode* n, int vi )
+{
+    // the variables of a node are requested in parallel, so the map is only read here
+    std::map<const CvDTreeNode*, NodeHistograms*>::const_iterator it = nodes.find(n);
+    CV_Assert( it != nodes.end() );
+
+    NodeHistograms* h = it->second;
+    double* hist = &h->hist[varOfs[vi]];
+    if( !h->valid[vi] )
+    {
+        CV_Assert( n == node );
+        collect( vi, hist );
+        h->valid[vi] = (uchar)1;
+    }
+    return hist;
+}
+
+static bool dtreeNodeCanSplit( const CvDTreeTrainData* data, const CvDTreeNode* n )
+{
+    return n->sample_count > data->params.min_sample_count && n->depth < data->params.max_depth;
+}
+
+void DTreeBinHistograms::split( CvDTreeNode* n )
+{
+    std::map<const CvDTreeNode*, NodeHistograms*>::iterator it = nodes.find(n);
+    if( it == nodes.end() )
+        return;
+    parent = it->second;
+    nodes.erase(it);
+
+    CvDTreeNode* s = n->left->sample_count <= n->right->sample_count ? n->left : n->right;
+    CvDTreeNode* l = s == n->left ? n->right : n->left;
+    small = dtreeNodeCanSplit(data, s) ? create(s) : 0;
+    large = dtreeNodeCanSplit(data, l) ? create(l) : 0;
+
+    if( small || large )
+    {
+        load( s );
+        parallel_for_(Range(0, data->var_count), *this);
+    }
+
+    delete parent;
+    parent = small = large = 0;
+}
+
+void DTreeBinHistograms::operator()(const Range& range) const
+{
+    AutoBuffer<double> inn_buf;
+    if( !small )
+        inn_buf.allocate(data->params.max_bins*stride);
+
+    for( int vi = range.start; vi < range.end; vi++ )
+    {
+        int ci = data->get_var_type(vi);
+        if( ci >= 0 || !parent->valid[vi] )
+            continue;
+
+        double* sh = small ? &small->hist[varOfs[vi]] : (double*)inn_buf;
+        collect( vi, sh );
+        if( small )
+            small->valid[vi] = (uchar)1;
+
+        if( large )
+        {
+            const double* ph = &parent->hist[varOfs[vi]];
+            double* lh = &large->hist[varOfs[vi]];
+            for( int j = 0, size = data->bin_count->data.i[~ci]*stride; j < size; j++ )
+                lh[j] = ph[j] - sh[j];
+            large->valid[vi] = (uchar)1;
+        }
+    }
+}
+
+void DTreeBinHistograms::release( CvDTreeNode* n )
+{
+    std::map<const CvDTreeNode*, NodeHistograms*>::iterator it = nodes.find(n);
+    if( it != nodes.end() )
+    {
+        delete it->second;
+        nodes.erase(it);
+    }
+}
+}
+
+
+CvDTreeSplit* CvDTree::find_best_split( CvDTreeNode* node )
+{
+    DTreeBestSplitFinder finder( this, node );
+    return finder.findBestSplit( true );
 }
 
 CvDTreeSplit* CvDTree::find_split_ord_class( CvDTreeNode* node, int vi,
                                              float init_quality, CvDTreeSplit* _split, uchar* _ext_buf )
 {
+    if( bin_hists )
+        return find_split_bin_class( node, vi, init_quality, _split, false );
+
     const float epsilon = FLT_EPSILON*2;
     int n = node->sample_count;
     int n1 = node->get_num_valid(vi);
@@ -1996,7 +2562,7 @@ CvDTreeSplit* CvDTree::find_split_ord_class( CvDTreeNode* node, int vi,
     int* responses_buf =  sample_indices_buf + n;
     const int* responses = data->get_class_labels( node, responses_buf );
 
-    const int* rc0 = data->counts->data.i;
+    const int* rc0 = data->get_counts( node );
     int* lc = (int*)base_buf;
     int* rc = lc + m;
     int i, best_i = -1;
@@ -2378,6 +2944,9 @@ CvDTreeSplit* CvDTree::find_split_cat_class( CvDTreeNode* node, int vi, float in
 
 CvDTreeSplit* CvDTree::find_split_ord_reg( CvDTreeNode* node, int vi, float init_quality, CvDTreeSplit* _split, uchar* _ext_buf )
 {
+    if( bin_hists )
+        return find_split_bin_reg( node, vi, init_quality, _split );
+
     const float epsilon = FLT_EPSILON*2;
     int n = node->sample_count;
     int n1 = node->get_num_valid(vi);
@@ -2435,6 +3004,142 @@ CvDTreeSplit* CvDTree::find_split_ord_reg( CvDTreeNode* node, int vi, float init
     return split;
 }
 
+// the split points of the histograms are the bin boundaries; the split is returned in the bin
+// units with the split point counted in the samples sorted by bins (see get_ord_var_data)
+CvDTreeSplit* CvDTree::find_split_bin_class( CvDTreeNode* node, int vi, float init_quality,
+                                             CvDTreeSplit* _split, bool misclass )
+{
+    const double* hist = bin_hists->get( node, vi );
+    int m = data->get_num_classes(), stride = m + 1;
+    int b_count = data->bin_count->data.i[~data->get_var_type(vi)];
+    int b, k, last = -1, count = 0, best_b = -1, best_count = 0;
+    double best_val = init_quality;
+    cv::AutoBuffer<double> inn_buf(2*m);
+    double* lc = inn_buf;
+    double* rc = lc + m;
+
+    for( k = 0; k < m; k++ )
+        lc[k] = rc[k] = 0;
+
+    for( b = 0; b < b_count; b++ )
+    {
+        const double* h = hist + b*stride;
+        if( h[0] == 0 )
+            continue;
+        last = b;
+        for( k = 0; k < m; k++ )
+            rc[k] += h[k+1];
+    }
+
+    for( b = 0; b < last; b++ )
+    {
+        const double* h = hist + b*stride;
+        double L = 0, R = 0, lsum2 = 0, rsum2 = 0, val;
+        if( h[0] == 0 )
+            continue;
+
+        count += cvRound(h[0]);
+        for( k = 0; k < m; k++ )
+        {
+            double lv = lc[k] + h[k+1], rv = rc[k] - h[k+1];
+            lc[k] = lv; rc[k] = rv;
+            L += lv; R += rv;
+            lsum2 += lv*lv; rsum2 += rv*rv;
+        }
+
+        if( misclass )
+            val = MAX(lc[0] + rc[1], lc[1] + rc[0]);
+        else
+            val = (lsum2*R + rsum2*L)/(L*R);
+
+        if( best_val < val )
+        {
+            best_val = val;
+            best_b = b;
+            best_count = count;
+        }
+    }
+
+    CvDTreeSplit* split = 0;
+    if( best_b >= 0 )
+    {
+        split = _split ? _split : data->new_split_ord( 0, 0.0f, 0, 0, 0.0f );
+        split->var_idx = vi;
+        split->ord.c = best_b + 0.5f;
+        split->ord.split_point = best_count - 1;
+        split->inversed = 0;
+        split->quality = (float)best_val;
+    }
+    return split;
+}
+
+
+CvDTreeSplit* CvDTree::find_split_bin_reg( CvDTreeNode* node, int vi, float init_quality, CvDTreeSplit* _split )
+{
+    const double* hist = bin_hists->get( node, vi );
+    int b_count = data->bin_count->data.i[~data->get_var_type(vi)];
+    int b, last = -1, count = 0, best_b = -1, best_count = 0;
+    double best_val = init_quality, L = 0, R = 0, lsum = 0, rsum = 0;
+
+    for( b = 0; b < b_count; b++ )
+    {
+        const double* h = hist + b*3;
+        if( h[0] == 0 )
+            continue;
+        last = b;
+        R += h[1];
+        rsum += h[2];
+    }
+
+    for( b = 0; b < last; b++ )
+    {
+        const double* h = hist + b*3;
+        if( h[0] == 0 )
+            continue;
+
+        count += cvRound(h[0]);
+        L += h[1]; R -= h[1];
+        lsum += h[2]; rsum -= h[2];
+
+        double val = (lsum*lsum*R + rsum*rsum*L)/(L*R);
+        if( best_val < val )
+        {
+            best_val = val;
+            best_b = b;
+            best_count = count;
+        }
+    }
+
+    CvDTreeSplit* split = 0;
+    if( best_b >= 0 )
+    {
+        split = _split ? _split : data->new_split_ord( 0, 0.0f, 0, 0, 0.0f );
+        split->var_idx = vi;
+        split->ord.c = best_b + 0.5f;
+        split->ord.split_point = best_count - 1;
+        split->inversed = 0;
+        split->quality = (float)best_val;
+    }
+    return split;
+}
+
+
+const double* CvDTree::get_bin_weights( CvDTreeNode* node, double* weights_buf )
+{
+    if( !data->is_classifier || !data->have_priors )
+        return 0;
+
+    int i, n = node->sample_count;
+    const double* priors = data->priors_mult->data.db;
+    cv::AutoBuffer<int> inn_buf(n);
+    const int* responses = data->get_class_labels( node, (int*)inn_buf );
+
+    for( i = 0; i < n; i++ )
+        weights_buf[i] = priors[responses[i]];
+    return weights_buf;
+}
+
+
 CvDTreeSplit* CvDTree::find_split_cat_reg( CvDTreeNode* node, int vi, float init_quality, CvDTreeSplit* _split, uchar* _ext_buf )
 {
     int ci = data->get_var_type(vi);
@@ -2531,7 +3236,7 @@ CvDTreeSplit* CvDTree::find_split_cat_reg( CvDTreeNode* node, int vi, float init
 CvDTreeSplit* CvDTree::find_surrogate_split_ord( CvDTreeNode* node, int vi, uchar* _ext_buf )
 {
     const float epsilon = FLT_EPSILON*2;
-    const char* dir = (char*)data->direction->data.ptr;
+    const char* dir = (char*)data->get_direction( node );
     int n = node->sample_count, n1 = node->get_num_valid(vi);
     cv::AutoBuffer<uchar> inn_buf;
     if( !_ext_buf )
@@ -2652,7 +3357,7 @@ CvDTreeSplit* CvDTree::find_surrogate_split_ord( CvDTreeNode* node, int vi, ucha
 
 CvDTreeSplit* CvDTree::find_surrogate_split_cat( CvDTreeNode* node, int vi, uchar* _ext_buf )
 {
-    const char* dir = (char*)data->direction->data.ptr;
+    const char* dir = (char*)data->get_direction( node );
     int n = node->sample_count;
     int i, mi = data->cat_count->data.i[data->get_var_type(vi)], l_win = 0;
 
@@ -2746,7 +3451,10 @@ CvDTreeSplit* CvDTree::find_surrogate_split_cat( CvDTreeNode* node, int vi, ucha
 
     split->quality = (float)best_val;
     if( split->quality <= node->maxlr || l_win == 0 || l_win == mi )
+    {
+        TreeHeapLock lock(data->work);
         cvSetRemoveByPtr( data->split_heap, split ), split = 0;
+    }
 
     return split;
 }
@@ -2777,7 +3485,7 @@ void CvDTree::calc_node_value( CvDTreeNode* node )
         //    misclassified samples with cv_labels(*)==j.
 
         // compute the number of instances of each class
-        int* cls_count = data->counts->data.i;
+        int* cls_count = data->get_counts( node );
         int* responses_buf = cv_labels_buf + n;
         const int* responses = data->get_class_labels(node, responses_buf);
         int* cv_cls_count = (int*)base_buf;
@@ -2949,7 +3657,7 @@ void CvDTree::complete_node_dir( CvDTreeNode* node )
 {
     int vi, i, n = node->sample_count, nl, nr, d0 = 0, d1 = -1;
     int nz = n - node->get_num_valid(node->split->var_idx);
-    char* dir = (char*)data->direction->data.ptr;
+    char* dir = (char*)data->get_direction( node );
 
     // try to complete direction using surrogate splits
     if( nz && data->params.use_surrogates )
@@ -3036,9 +3744,9 @@ void CvDTree::complete_node_dir( CvDTreeNode* node )
 void CvDTree::split_node_data( CvDTreeNode* node )
 {
     int vi, i, n = node->sample_count, nl, nr, scount = data->sample_count;
-    char* dir = (char*)data->direction->data.ptr;
+    char* dir = (char*)data->get_direction( node );
     CvDTreeNode *left = 0, *right = 0;
-    int* new_idx = data->split_buf->data.i;
+    int* new_idx = data->get_split_buf( node );
     int new_buf_idx = data->get_child_buf_idx( node );
     int work_var_count = data->get_work_var_count();
     CvMat* buf = data->buf;
@@ -3065,12 +3773,31 @@ void CvDTree::split_node_data( CvDTreeNode* node )
         (node->left->sample_count > data->params.min_sample_count ||
         node->right->sample_count > data->params.min_sample_count);
 
+    // the binned variables are not moved, only count their valid values in the children
+    if( data->bin_buf && split_input_data )
+    {
+        const int* sample_idx = data->get_sample_indices(node, temp_buf);
+
+        for( vi = 0; vi < data->var_count; vi++ )
+        {
+            int ci = data->get_var_type(vi), nr1 = 0;
+            if( ci >= 0 )
+                continue;
+
+            const uchar* bins = data->bin_buf->data.ptr + (size_t)(~ci)*data->bin_buf->step;
+            for( i = 0; i < n; i++ )
+                nr1 += (bins[sample_idx[i]] != missing_bin) & dir[i];
+            left->set_num_valid(vi, node->get_num_valid(vi) - nr1);
+            right->set_num_valid(vi, nr1);
+        }
+    }
+
     // split ordered variables, keep both halves sorted.
     for( vi = 0; vi < data->var_count; vi++ )
     {
         int ci = data->get_var_type(vi);
 
-        if( ci >= 0 || !split_input_data )
+        if( ci >= 0 || !split_input_data || data->bin_buf )
             continue;
 
         int n1 = node->get_num_valid(vi);
@@ -3198,9 +3925,9 @@ void CvDTree::split_node_data( CvDTreeNode* node )
         if (data->is_buf_16u)
         {
             unsigned short *ldst = (unsigned short *)(buf->data.s + left->buf_idx*length_buf_row +
-                vi*scount + left->offset);
+                data->get_buf_row(vi)*scount + left->offset);
             unsigned short *rdst = (unsigned short *)(buf->data.s + right->buf_idx*length_buf_row +
-                vi*scount + right->offset);
+                data->get_buf_row(vi)*scount + right->offset);
 
             for( i = 0; i < n; i++ )
             {
@@ -3228,9 +3955,9 @@ void CvDTree::split_node_data( CvDTreeNode* node )
         else
         {
             int *ldst = buf->data.i + left->buf_idx*length_buf_row +
-                vi*scount + left->offset;
+                data->get_buf_row(vi)*scount + left->offset;
             int *rdst = buf->data.i + right->buf_idx*length_buf_row +
-                vi*scount + right->offset;
+                data->get_buf_row(vi)*scount + right->offset;
 
             for( i = 0; i < n; i++ )
             {
@@ -3266,7 +3993,7 @@ void CvDTree::split_node_data( CvDTreeNode* node )
     for(i = 0; i < n; i++)
         temp_buf[i] = sample_idx_src[i];
 
-    int pos = data->get_work_var_count();
+    int pos = data->get_buf_row(data->get_work_var_count());
     if (data->is_buf_16u)
     {
         unsigned short* ldst = (unsigned short*)(buf->data.s + left->buf_idx*length_buf_row +
@@ -0,0 +1,112 @@
+#include "test_precomp.hpp"
+#include "test_tree_helpers.hpp"
+
+using namespace cv;
+using namespace std;
+
+static float predictValue( const CvDTree& model, const Mat& sample, const Mat& missing )
+{
+    return (float)model.predict(sample, missing)->value;
+}
+
+template<typename Model> static float predictValue( const Model& model, const Mat& sample, const Mat& missing )
+{
+    return model.predict(sample, missing);
+}
+
+template<typename Model> static double trainingError( const Model& model, const Mat& samples, const Mat& responses,
+                                                     const Mat& missing, bool classification )
+{
+    double err = 0;
+    for( int i = 0; i < samples.rows; i++ )
+    {
+        float d = predictValue(model, samples.row(i), missing.empty() ? Mat() : missing.row(i)) - responses.at<float>(i);
+        err += classification ? (fabs(d) > FLT_EPSILON) : d*d;
+    }
+    return err/samples.rows;
+}
+
+// the training error of a model with binned splits is close to the one of the exact splits
+template<typename Model, typename Params> static void checkBinnedAccuracy( bool classification, Params params,
+                                                                         uint64 seed = 0,
+                                                                         TreeResponseTransform transform = 0,
+                                                                         bool withMissing = false )
+{
+    Mat samples, responses, varType, missing;
+    makeTreeData(3000, 8, classification, samples, responses, varType, false);
+    if( transform )
+        responses = transform(responses);
+    if( withMissing )
+    {
+        missing.create(samples.size(), CV_8U);
+        randu(missing, 0, 20);
+        missing = missing == 0;
+    }
+
+    double err[2];
+    for( int k = 0; k < 2; k++ )
+    {
+        params.max_bins = k == 0 ? 0 : 64;
+        if( seed )
+            theRNG().state = seed;
+        Model model;
+        model.train(samples, CV_ROW_SAMPLE, responses, Mat(), Mat(), varType, missing, params);
+        err[k] = trainingError(model, samples, responses, missing, classification);
+    }
+    double scale = classification ? 1 : norm(responses, NORM_L2SQR)/responses.rows;
+    EXPECT_LE(err[1], err[0]*1.2 + 0.01*scale) << (classification ? "classification" : "regression");
+}
+
+TEST(ML_DTree, binnedSplitsMatchExactOnFewDistinctValues)
+{
+    Mat samples, responses, varType;
+    makeTreeData(2000, 6, true, samples, responses, varType, false, true);
+
+    CvDTreeParams params(6, 10, 0, false, 10, 0, false, false, 0);
+    CvDTree exact;
+    exact.train(samples, CV_ROW_SAMPLE, responses, Mat(), Mat(), varType, Mat(), params);
+    params.max_bins = 32;
+    CvDTree binned;
+    binned.train(samples, CV_ROW_SAMPLE, responses, Mat(), Mat(), varType, Mat(), params);
+
+    // every distinct value has a bin of its own, so the same partitions are found
+    for( int i = 0; i < samples.rows; i++ )
+        ASSERT_EQ(exact.predict(samples.row(i))->value, binned.predict(samples.row(i))->value) << "sample " << i;
+}
+
+TEST(ML_DTree, binnedSplitsAccuracy)
+{
+    CvDTreeParams params(8, 10, 0, true, 10, 0, false, false, 0);
+    checkBinnedAccuracy<CvDTree>(false, params, 0, 0, true);
+    checkBinnedAccuracy<CvDTree>(true, params, 0, 0, true);
+}
+
+TEST(ML_Boost, binnedSplitsAccuracy)
+{
+    CvBoostParams params(CvBoost::REAL, 50, 0.95, 3, false, 0);
+    checkBinnedAccuracy<CvBoost>(true, params, 0, twoClassResponses);
+}
+
+TEST(ML_RTrees, binnedSplitsAccuracy)
+{
+    CvRTParams params(8, 10, 0, false, 10, 0, false, 4, 30, 0.01f, CV_TERMCRIT_ITER);
+    checkBinnedAccuracy<CvRTrees>(false, params, 0x12345);
+}
+
+TEST(ML_DTree, binnedModelDoesNotDependOnThreadCount)
+{
+    CvDTreeParams params(8, 10, 0, false, 10, 0, false, false, 0);
+    params.max_bins = 64;
+    checkThreadCountIndependence<CvDTree>(true, params, 0, 0, false);
+}
+
+TEST(ML_DTree, binnedSplitsRejectTooManyBins)
+{
+    Mat samples, responses, varType;
+    makeTreeData(100, 3, true, samples, responses, varType, false);
+    CvDTreeParams params(4, 10, 0, false, 10, 0, false, false, 0);
+    params.max_bins = 256;
+    CvDTree dtree;
+    EXPECT_THROW(dtree.train(samples, CV_ROW_SAMPLE, responses, Mat(), Mat(), varType, Mat(), params),
+                 cv::Exception);
+}
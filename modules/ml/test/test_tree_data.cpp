@@ -0,0 +1,79 @@
+#include "test_precomp.hpp"
+#include "test_tree_helpers.hpp"
+
+using namespace cv;
+using namespace std;
+
+// the model trained on the rows of a larger training set selected by sample_idx is the one
+// trained on a copy of these rows; the models drawing random numbers start from the same seed
+template<typename Model, typename Params> static void checkSubsetMatchesCopy( const Mat& samples, const Mat& responses,
+                                                                            const Mat& varType, const Mat& missing,
+                                                                            Range rows, const Params& params,
+                                                                            uint64 seed = 0 )
+{
+    Mat sampleIdx(1, rows.size(), CV_32S);
+    for( int i = 0; i < sampleIdx.cols; i++ )
+        sampleIdx.at<int>(i) = rows.start + i;
+
+    if( seed )
+        theRNG().state = seed;
+    Model subset;
+    subset.train(samples, CV_ROW_SAMPLE, responses, Mat(), sampleIdx, varType, missing, params);
+
+    if( seed )
+        theRNG().state = seed;
+    Model copy;
+    copy.train(samples.rowRange(rows).clone(), CV_ROW_SAMPLE, responses.rowRange(rows).clone(), Mat(), Mat(),
+               varType, missing.empty() ? Mat() : missing.rowRange(rows).clone(), params);
+
+    string subsetDump = dumpModel(subset);
+    ASSERT_FALSE(subsetDump.empty());
+    EXPECT_EQ(dumpModel(copy), subsetDump);
+}
+
+TEST(ML_DTree, sampleIdxBeyond16BitRange)
+{
+    // a subset of less than 65536 samples taken from the end of a larger training set
+    Mat samples, responses, varType;
+    makeTreeData(66000, 3, true, samples, responses, varType, false);
+
+    CvDTreeParams params(6, 10, 0, false, 10, 0, false, false, 0);
+    checkSubsetMatchesCopy<CvDTree>(samples, responses, varType, Mat(), Range(65000, 66000), params);
+    params.max_bins = 64;
+    checkSubsetMatchesCopy<CvDTree>(samples, responses, varType, Mat(), Range(65000, 66000), params);
+}
+
+TEST(ML_ERTrees, sampleIdxBeyond16BitRange)
+{
+    Mat samples, responses, varType;
+    makeTreeData(66000, 3, true, samples, responses, varType, false);
+
+    CvRTParams params(6, 10, 0, false, 10, 0, false, 2, 5, 0.01f, CV_TERMCRIT_ITER);
+    checkSubsetMatchesCopy<CvERTrees>(samples, responses, varType, Mat(), Range(65000, 66000), params, 0x12345);
+}
+
+TEST(ML_DTree, priorsWithMissingCategoricalValues)
+{
+    // a single categorical variable that separates a large group of categories from a small one,
+    // with the responses of the large group being either class; the copy of the head rows goes through
+    // the 16-bit buffers, the subset of the full training set through the 32-bit ones, and the missing
+    // values must follow the larger side of the split in both
+    const int nsamples = 66000, ncategories = 6;
+    Mat samples(nsamples, 1, CV_32F), missing(nsamples, 1, CV_8U), responses(nsamples, 1, CV_32F);
+    Mat varType(1, 2, CV_8U, Scalar::all(CV_VAR_CATEGORICAL));
+    RNG rng(54321);
+    for( int i = 0; i < nsamples; i++ )
+    {
+        samples.at<float>(i) = (float)rng.uniform(0, ncategories);
+        missing.at<uchar>(i) = rng.uniform(0, 5) == 0;
+    }
+
+    const float priors[] = { 1.f, 2.f };
+    CvDTreeParams params(1, 10, 0, false, 10, 0, false, false, priors);
+    for( int k = 0; k < 2; k++ )
+    {
+        for( int i = 0; i < nsamples; i++ )
+            responses.at<float>(i) = (float)((samples.at<float>(i) == ncategories - 1) ^ k);
+        checkSubsetMatchesCopy<CvDTree>(samples, responses, varType, missing, Range(0, 1000), params);
+    }
+}
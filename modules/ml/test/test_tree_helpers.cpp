@@ -0,0 +1,41 @@
+#include "test_precomp.hpp"
+#include "test_tree_helpers.hpp"
+
+using namespace cv;
+using namespace std;
+
+void makeTreeData( int nsamples, int nvars, bool classification, Mat& samples, Mat& responses,
+                   Mat& varType, bool catVars, bool intValues )
+{
+    RNG rng(12345);
+    samples.create(nsamples, nvars, CV_32F);
+    responses.create(nsamples, 1, CV_32F);
+    varType.create(1, nvars + 1, CV_8U);
+    varType.setTo(Scalar::all(CV_VAR_ORDERED));
+    varType.at<uchar>(nvars) = (uchar)(classification ? CV_VAR_CATEGORICAL : CV_VAR_ORDERED);
+
+    const int catIdx[] = { 3, 7 };
+    if( catVars )
+        varType.at<uchar>(catIdx[0]) = varType.at<uchar>(catIdx[1]) = (uchar)CV_VAR_CATEGORICAL;
+
+    for( int i = 0; i < nsamples; i++ )
+    {
+        float* s = samples.ptr<float>(i);
+        for( int j = 0; j < nvars; j++ )
+            s[j] = intValues ? (float)rng.uniform(0, 10) : (float)rng.uniform(0., 10.);
+
+        float v = s[1] + 0.5f*s[nvars - 1];
+        if( catVars )
+        {
+            s[catIdx[0]] = (float)rng.uniform(0, 6);
+            s[catIdx[1]] = (float)rng.uniform(0, 4);
+            v += (s[catIdx[0]] > 2 ? 3.f : 0.f) - s[catIdx[1]];
+        }
+        responses.at<float>(i) = classification ? (float)(v < 4 ? 0 : v < 8 ? 1 : 2) : v;
+    }
+}
+
+Mat twoClassResponses( const Mat& responses )
+{
+    return min(responses, 1.f);
+}
@@ -0,0 +1,67 @@
+#ifndef __OPENCV_TEST_TREE_HELPERS_HPP__
+#define __OPENCV_TEST_TREE_HELPERS_HPP__
+
+#include "opencv2/ts.hpp"
+#include "opencv2/ml.hpp"
+
+// the training data of the decision tree tests: the responses depend on a few of the variables only,
+// two of the variables are categorical if catVars is set, the values are integer if intValues is set
+void makeTreeData( int nsamples, int nvars, bool classification, cv::Mat& samples, cv::Mat& responses,
+                   cv::Mat& varType, bool catVars = true, bool intValues = false );
+
+typedef cv::Mat (*TreeResponseTransform)( const cv::Mat& responses );
+
+// boosting supports two-class problems only
+cv::Mat twoClassResponses( const cv::Mat& responses );
+
+template<typename Model> std::string dumpModel( const Model& model )
+{
+    cv::FileStorage fs(".xml", cv::FileStorage::WRITE + cv::FileStorage::MEMORY);
+    model.write(*fs, "model");
+    return fs.releaseAndGetString();
+}
+
+// the models drawing random numbers from theRNG() are trained from the given seed, if any
+template<typename Model, typename Params> std::string trainAndDump( const cv::Mat& samples, const cv::Mat& responses,
+                                                                  const cv::Mat& varType, const Params& params,
+                                                                  uint64 seed = 0 )
+{
+    if( seed )
+        cv::theRNG().state = seed;
+    Model model;
+    model.train(samples, CV_ROW_SAMPLE, responses, cv::Mat(), cv::Mat(), varType, cv::Mat(), params);
+    return dumpModel(model);
+}
+
+template<typename Model, typename Params> void checkThreadCountIndependence( bool classification, const Params& params,
+                                                                           uint64 seed = 0,
+                                                                           TreeResponseTransform transform = 0,
+                                                                           bool catVars = true )
+{
+    cv::Mat samples, responses, varType;
+    makeTreeData(1500, 40, classification, samples, responses, varType, catVars);
+    if( transform )
+        responses = transform(responses);
+
+    // without a parallel backend there is nothing to compare
+    const int parallelThreads = 4;
+    int threads = cv::getNumThreads();
+    cv::setNumThreads(parallelThreads);
+    if( cv::getNumThreads() < 2 )
+    {
+        cv::setNumThreads(threads);
+        printf("There is no parallel backend, the thread count check is skipped\n");
+        return;
+    }
+
+    cv::setNumThreads(1);
+    std::string sequential = trainAndDump<Model>(samples, responses, varType, params, seed);
+    cv::setNumThreads(parallelThreads);
+    std::string parallel = trainAndDump<Model>(samples, responses, varType, params, seed);
+    cv::setNumThreads(threads);
+
+    ASSERT_FALSE(sequential.empty());
+    EXPECT_EQ(sequential, parallel);
+}
+
+#endif
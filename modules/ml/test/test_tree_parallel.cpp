@@ -0,0 +1,43 @@
+#include "test_precomp.hpp"
+#include "test_tree_helpers.hpp"
+
+using namespace cv;
+using namespace std;
+
+TEST(ML_DTree, parallelSplitSearchMatchesSequential)
+{
+    CvDTreeParams params(8, 5, 0, false, 10, 0, false, false, 0);
+    checkThreadCountIndependence<CvDTree>(true, params);
+    checkThreadCountIndependence<CvDTree>(false, params);
+}
+
+TEST(ML_Boost, parallelSplitSearchMatchesSequential)
+{
+    CvBoostParams params(CvBoost::GENTLE, 20, 0.95, 3, false, 0);
+    checkThreadCountIndependence<CvBoost>(true, params, 0, twoClassResponses);
+}
+
+TEST(ML_RTrees, forestDoesNotDependOnThreadCount)
+{
+    // regression with the oob error and variable importance, then classification with
+    // the training stopped early by the oob error
+    CvRTParams regParams(8, 5, 0, false, 10, 0, true, 6, 12, 0.01f, CV_TERMCRIT_ITER);
+    CvRTParams clsParams(8, 5, 0, false, 10, 0, true, 6, 100, 0.3f, CV_TERMCRIT_ITER + CV_TERMCRIT_EPS);
+    checkThreadCountIndependence<CvRTrees>(false, regParams, 0x12345);
+    checkThreadCountIndependence<CvRTrees>(true, clsParams, 0x12345);
+}
+
+TEST(ML_RTrees, forestDoesNotDependOnWorkMemory)
+{
+    // no memory for the extra work buffers, so the trees are grown one by one
+    CvRTParams params(8, 5, 0, false, 10, 0, true, 6, 12, 0.01f, CV_TERMCRIT_ITER);
+    Mat samples, responses, varType;
+    makeTreeData(1500, 40, false, samples, responses, varType);
+
+    string batched = trainAndDump<CvRTrees>(samples, responses, varType, params, 0x12345);
+    params.max_work_memory = 0;
+    string sequential = trainAndDump<CvRTrees>(samples, responses, varType, params, 0x12345);
+
+    ASSERT_FALSE(batched.empty());
+    EXPECT_EQ(batched, sequential);
+}
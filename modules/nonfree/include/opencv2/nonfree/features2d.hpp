@@ -66,6 +66,8 @@ public:
     //! returns the descriptor type
     CV_WRAP int descriptorType() const;
 
+    bool isThreadSafe() const;
+
     //! finds the keypoints using SIFT algorithm
     void operator()(InputArray img, InputArray mask,
                     std::vector<KeyPoint>& keypoints) const;
@@ -118,6 +120,8 @@ public:
     //! returns the descriptor type
     CV_WRAP int descriptorType() const;
 
+    bool isThreadSafe() const;
+
     //! finds the keypoints using fast hessian detector used in SURF
     void operator()(InputArray img, InputArray mask,
                     CV_OUT std::vector<KeyPoint>& keypoints) const;
@@ -715,6 +715,11 @@ int SIFT::descriptorType() const
     return CV_32F;
 }
 
+bool SIFT::isThreadSafe() const
+{
+    return true;
+}
+
 
 void SIFT::operator()(InputArray _image, InputArray _mask,
                       std::vector<KeyPoint>& keypoints) const